@@ -24,9 +24,16 @@
 #include <sys/stat.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <boost/shared_ptr.hpp>
 #include <geometry_msgs/TransformStamped.h>
 #include "mikro_serial/mikoCmd.h"
 #include "control_toolbox/pid.h"
+#include "controller/min_snap.h"
+#include "controller/lqr_schedule.h"
+#include "controller/mpc.h"
+
+namespace diff_flat_control
+{
 
 extern pthread_mutex_t list_mutex_; //!< mutex just in case for the waypoint_list_ vector (used by multiple callbacks)
 extern pthread_mutex_t hpt_mutex_; //!< and one just in case for and hoverpoint
@@ -145,6 +152,74 @@ public:
   Eigen::Vector4d circlePath(Eigen::Vector3d &position, Eigen::Quaterniond &quat,
                              Eigen::Vector3d &velocity, ros::Time &time, ros::Duration &dt, double *voltage = NULL);
 
+  /*!
+   *  \brief Follows the current min-snap trajectory (see setTrajectory).  The trajectory gives the desired position and
+   *  velocity and the feed forward acceleration, so it can be flown much faster than the waypoint paths.
+   *
+   *  Before the trajectory clock starts, the vehicle hovers at the start of the trajectory, facing along it (the same
+   *  idea as the YAW_MAX_ check in pathFollower).  The yaw follows the direction of travel, with the feed forward yaw
+   *  rate from the velocity and acceleration.  At the end it hovers at the last waypoint.
+   *
+   *  \param position is the position in the reference frame
+   *  \param quat is the rotation from the current node to the body-fixed coordinate frame
+   *  \param velocity is the velocity of the body-fixed frame w.r.t. the node frame, expressed in the <b> body </b> frame
+   *  \param time is the current ros::Time
+   *  \param dt is the ros::Duration since the last control was computed
+   *  \param goal_achieved is set to true when the end of the trajectory is reached
+   *  \returns A vector of commands in the order: [pitch; roll; thrust; yaw]
+  */
+  Eigen::Vector4d trajectoryPath(Eigen::Vector3d &position, Eigen::Quaterniond &quat,
+                                 Eigen::Vector3d &velocity, ros::Time &time, ros::Duration &dt, bool *goal_achieved,
+                                 double *voltage = NULL);
+
+
+  /*!
+   *  \brief Replaces the trajectory followed by trajectoryPath.  The trajectory must be in the current node frame
+   *  (later node changes are applied by applyNewNodeToWaypoints).
+   *  \param trajectory is the new trajectory, NULL to drop the current one (and hover)
+  */
+  void setTrajectory(const boost::shared_ptr<const MinSnapTrajectory> &trajectory);
+
+
+  /*!
+   *  \brief Sets how far ahead (s) the jerk leads the feed forward acceleration in trajectoryPath.  The commands are
+   *  attitude angles, so the jerk is used to make up for the lag of the attitude loop: a_ff = a + lead*jerk.
+  */
+  void setJerkLead(double lead){jerk_lead_ = lead;}
+
+
+  /*!
+   *  \brief Schedules the LQR gains over the speed and battery voltage with a gain table, in place of the single pair
+   *  from the gain file.  The table is loaded from the file, or if it isn't there (or was made for another envelope or
+   *  design), it is computed and saved to it.
+   *
+   *  \param filename is the path of the binary table file
+   *  \param weights are the design weights of the table
+   *  \returns false if there is no table (the gains from the gain file are used)
+  */
+  bool useGainTable(const std::string &filename, const LQRWeights &weights);
+
+
+  /*!
+   *  \brief Computes the feedback with model predictive control (MPCController) instead of the LQR gains.  The
+   *  limits are the ones the commands are saturated to, so the control plans around them instead of being clipped.  A
+   *  solve that misses the deadline falls back to the LQR for that control.
+   *
+   *  \param weights are the design weights
+   *  \param deadline is the time (s) a solve may take
+  */
+  void useMPC(const LQRWeights &weights, double deadline);
+
+
+  /*!
+   *  \brief Creates an MPCController with the limits of this vehicle (also used by the mpc_benchmark)
+   *
+   *  \param weights are the design weights
+   *  \param deadline is the time (s) a solve may take
+   *  \returns the new controller (the caller deletes it)
+  */
+  static MPCController* createMPC(const LQRWeights &weights, double deadline);
+
   //A few of other paths like circlePath are available on the windows "DEMOQuad" program.  Just need to be translated
   //into C++ (and improved - yes, it is horribly written code, sorry.  Just follow how I've done it with circlePath)
 
@@ -214,14 +289,39 @@ protected:
 
   /*!
    *  \brief This function computes the LQR feedback control terms, given the error in the control state.  The gain
-   *  matrix is input from a file (which is genereated from the Matlab script "LQR_script_heavy.m").
+   *  matrix is input from a file (which is genereated from the Matlab script "LQR_script_heavy.m").  The caller
+   *  saturates the feedback.
    *
-   *  \param error Is again the error in the control state (desired - actual)
+   *  \param error Is again the error in the control state (desired - actual), with the yaw wrapped
    *  \param dt Is the ros::Duration between the last control and this one.
   */
   Eigen::Vector4d computeLQRControl(Eigen::Matrix<double,7,1> &error, ros::Duration &dt);
 
 
+  /*!
+   *  \brief This function computes the feedback terms with the MPC (see useMPC), plus the LQR integrator terms.  The
+   *  caller saturates the feedback, as for computeLQRControl().
+   *
+   *  \param error Is the error in the control state (desired - actual), with the yaw wrapped
+   *  \param dt Is the ros::Duration between the last control and this one.
+   *  \param feed_forward Is the feed forward input, including gravity
+   *  \param control Is the returned feedback
+   *  \returns false if the MPC missed its deadline (control isn't set)
+  */
+  bool computeMPCControl(Eigen::Matrix<double,7,1> &error, ros::Duration &dt, Eigen::Vector4d &feed_forward,
+                         Eigen::Vector4d *control);
+
+
+  /*!
+   *  \brief Integrates the position and yaw error and returns the (saturated) integrator terms, zero when the
+   *  integrator isn't in use.
+   *
+   *  \param error Is the error in the control state, with the yaw wrapped
+   *  \param dt Is the ros::Duration between the last control and this one.
+  */
+  Eigen::Vector4d computeIntegralControl(Eigen::Matrix<double,7,1> &error, ros::Duration &dt);
+
+
   /*!
    *  \brief This function creates a right-handed rotation about the inertial (nodal) z-axis for the yaw.
    *
@@ -288,7 +388,7 @@ protected:
    *  \param batt_volt is the most recent battery voltage in units of 0.1 V i.e. 15.0 V = 150,
    *  \param accel is the returned acceleration that should be added in the feedforward term (instead of gravity const)
   */
-  inline void computeGravityOffset(double batt_volt, double *accel)
+  static void computeGravityOffset(double batt_volt, double *accel)
   {
     if(batt_volt > 150)
     {
@@ -305,6 +405,19 @@ protected:
     }
   }
 
+
+  /*!
+   *  \brief The acceleration actually produced per unit of commanded acceleration at a battery voltage (from the
+   *  thrust curve in computeGravityOffset), used to design the gain table.
+   *  \param batt_volt is the battery voltage in units of 0.1 V
+  */
+  static double thrustEffectiveness(double batt_volt)
+  {
+    double accel;
+    computeGravityOffset(batt_volt, &accel);
+    return GRAVITY_/accel;
+  }
+
 //  /*!
 //   *  \brief Given a line from the file and the delimiter, parse the line into a vector of doubles. We assume that just
 //   *  numbers are in the file (for reading in the gains)
@@ -348,6 +461,9 @@ protected:
   control_toolbox::Pid pid_phi_; //!< PID controller for the roll (necessary since we don't know correct converstion for Mikrokopter stuff
   control_toolbox::Pid pid_theta_; //!< PID controller for the pitch
   std::ifstream gain_reader_; //!< reader for the gain matrices file
+  LQRSchedule gain_schedule_; //!< gain table over speed and voltage (when it's valid, it sets LQR_K_ and LQR_KI_)
+  double schedule_speed_; //!< (m/s) the current speed, for looking up the gains
+  MPCController *mpc_; //!< the MPC, NULL when the LQR is used
 
   std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >::iterator current_waypoint_; //!< iterator for the current waypoint
   const static double WAYPOINT_SPEED_ = 0.2;//0.15;// //!< the speed to pursue along the paths between waypoints
@@ -371,6 +487,17 @@ protected:
   const static double N_OFFSET_ = 0.0; //!< optional offset from the origin in "north"
   const static double E_OFFSET_ = 0.0; //!< optional offset from origin in "east"
 
+  //Trajectory Variables:
+  boost::shared_ptr<const MinSnapTrajectory> trajectory_; //!< the trajectory being followed (NULL for none)
+  bool trajectory_started_; //!< flag for when the trajectory clock has started (after lining up at the start)
+  ros::Time trajectory_start_; //!< time that the trajectory clock started
+  int trajectory_segment_; //!< the segment of the last sample (makes finding the next one O(1))
+  Eigen::Matrix3d trajectory_rotation_; //!< rotation from the trajectory frame to the current node frame
+  Eigen::Vector3d trajectory_offset_; //!< and the offset: p_node = trajectory_rotation_*p + trajectory_offset_
+  double trajectory_yaw_; //!< the last desired yaw along the trajectory (held when the speed is too low to define one)
+  double jerk_lead_; //!< (s) the jerk lead on the feed forward acceleration
+  const static double MIN_HEADING_SPEED_ = 0.05; //!< (m/s) below this the direction of travel doesn't set the yaw
+
   //Other (including vehicle) constants:
   const static double PI_ = 3.1415926535897932384626; //!< pi
   const static double GRAVITY_ = 9.80665; //!< gravity
@@ -378,6 +505,8 @@ protected:
   const static double YAW_RATE_GAIN_ = 73.0; //!< the gain to convert r/s to MikroKopter units (found by trial/error)
   const static double NUM_ROTORS_ = 6.0; //!< number of rotors on the platform
   const static double KF_ = 0.00028; //!< gain for the thrust model: kF*w^2, where w = motor speed
+  const static double MPC_MAX_TILT_ = 0.3; //!< (rad) max tilt the MPC plans with
+  const static double DRAG_ = 0.15; //!< (1/m) rough quadratic drag coefficient, a_drag = DRAG_*v^2 (for the gain table)
   const static double BOUNDS_ = 0.3; //!< the error sphere radius needed to be met to switch nodes (in addition to the plane)
   const static double MIN_BOUNDS_ =0.15; //!< if we are within this, switch waypoints, even if we haven't crossed the half plane
   const static double YAW_MAX_ = 0.15;//0.25; //!< if the abs(yaw_error) when following a path is > this, hover in place and yaw.
@@ -400,6 +529,8 @@ protected:
 
 };
 
+}
+
 #endif
 
 
@@ -0,0 +1,214 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file lqr_schedule.h
+ *  \author agent
+ *  \date October 2026
+ *
+ *  \brief The lqr_schedule.h file is the header for the LQRSchedule class (and the LQRWeights it is designed with).
+*/
+
+#ifndef LQR_SCHEDULE_H
+#define LQR_SCHEDULE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+namespace diff_flat_control
+{
+
+/*!
+ *  \struct LQRWeights
+ *  \brief The Bryson's rule maximums (and the integrator weights) that the LQR gains are designed with.  The presets
+ *  are the values in the Matlab scripts, so the gains at the nominal point of the schedule match the gain files.
+*/
+struct LQRWeights
+{
+  double max_n; //!< (m) max north error
+  double max_e; //!< (m) max east error
+  double max_d; //!< (m) max down error
+  double max_ndot; //!< (m/s) max north and east velocity error
+  double max_ddot; //!< (m/s) max down velocity error
+  double max_psi; //!< (rad) max yaw error
+  double max_thrust; //!< (m/s^2) max thrust input
+  double max_angle; //!< max pitch, roll and yaw rate inputs
+  Eigen::Vector4d integral_q; //!< weights on the integral states (int_n, int_e, int_d, int_psi)
+  double integral_r; //!< weight on the inputs for the integral gains
+
+  /// \returns the weights in LQR_script_heavy.m (HeavyGainMatrices.txt, used for truth control)
+  static LQRWeights heavy();
+
+  /// \returns the weights in LQR_script_relative_heavy.m (RelativeHeavyGainMatrices.txt, used with the estimates)
+  static LQRWeights relativeHeavy();
+};
+
+
+/*!
+ *  \class LQRSchedule lqr_schedule.h "include/controller/lqr_schedule.h"
+ *  \brief This class holds a table of LQR gains over the operating envelope (speed and battery voltage), computes it
+ *  with Riccati solvers, and interpolates it for the control.
+ *
+ *  The model is the one in the Matlab scripts (states n,e,d,ndot,edot,ddot,psi, acceleration and yaw rate inputs),
+ *  with what changes over the envelope added to it: the drag on the horizontal velocities grows with the speed, and
+ *  the acceleration a command actually gives falls with the battery voltage.  Each point is discretized (zero order
+ *  hold at SAMPLE_TIME_) and solved with the doubling algorithm, which converges in a few tens of iterations.  The
+ *  integrator gains are solved on the continuous model with the integral states appended, like the scripts (they use
+ *  lqrd for K but lqr for these).  At the nominal point KI matches the gain files, and K is within 0.1% (lqrd also
+ *  discretizes Q, here it is kept as is).
+ *
+ *  The table is saved in a small binary file (native byte order, it is only read on the machine it was made on):
+ *  "LQRT", the version, the grid size and ranges, a hash of the design (designHash()), then K (4x7) and KI (4x4) for
+ *  every point, column major.
+*/
+class LQRSchedule
+{
+public:
+  /// Eigen macro used when there are fixed-sized class member variables and you dynamically create an instance of the
+  /// class.  (See: http://eigen.tuxfamily.org/dox/TopicStructHavingEigenMembers.html)
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef Eigen::Matrix<double,4,7> GainMatrix;
+  typedef Eigen::Matrix<double,4,4> IntegralGainMatrix;
+
+  /*!
+   *  \brief The constructor sets the envelope of the table, it is empty until compute() or load().
+  */
+  LQRSchedule();
+
+
+  /*!
+   *  \brief Computes the gains at every point of the envelope.
+   *
+   *  \param weights are the design weights
+   *  \param drag is the quadratic drag coefficient (1/m), the drag acceleration is drag*speed^2
+   *  \param thrust_effectiveness returns the acceleration produced per unit of commanded acceleration at a battery
+   *  voltage (in 0.1 V, like the hex reports it)
+   *  \returns false if the Riccati equation could not be solved at some point
+  */
+  bool compute(const LQRWeights &weights, double drag, double (*thrust_effectiveness)(double));
+
+
+  /*!
+   *  \brief Interpolates (bilinear) the gains at the speed and voltage, values outside the envelope are clamped to it.
+   *
+   *  \param speed is the speed (m/s)
+   *  \param voltage is the battery voltage (0.1 V)
+   *  \param K is the returned feedback gain
+   *  \param KI is the returned integrator gain
+  */
+  void gains(double speed, double voltage, GainMatrix *K, IntegralGainMatrix *KI) const;
+
+
+  /*!
+   *  \brief Saves the table to a binary file.
+   *  \returns false if the file couldn't be written
+  */
+  bool save(const std::string &filename) const;
+
+
+  /*!
+   *  \brief Loads a table saved by save(), if it was designed with the same weights, drag and thrust effectiveness.
+   *
+   *  \param filename is the table file
+   *  \param weights, drag and thrust_effectiveness are what the table would be computed with (see compute())
+   *  \returns false if the file couldn't be read, isn't a gain table or was designed with something else
+  */
+  bool load(const std::string &filename, const LQRWeights &weights, double drag,
+            double (*thrust_effectiveness)(double));
+
+
+  /// \returns true if the table has been computed or loaded
+  bool valid() const {return !K_table_.empty();}
+
+
+  /*!
+   *  \brief Solves the discrete-time algebraic Riccati equation and returns the LQR gain, u = -K*x.
+   *
+   *  \param A is the discrete state transition matrix
+   *  \param B is the discrete input matrix
+   *  \param Q is the state weight
+   *  \param R is the input weight
+   *  \param K is the returned gain
+   *  \param P is the returned solution (optional, the cost-to-go is x'*P*x)
+   *  \returns false if the solution didn't converge
+  */
+  static bool solveRiccati(const Eigen::MatrixXd &A, const Eigen::MatrixXd &B, const Eigen::MatrixXd &Q,
+                           const Eigen::MatrixXd &R, Eigen::MatrixXd *K, Eigen::MatrixXd *P = NULL);
+
+
+  /*!
+   *  \brief Solves the continuous-time algebraic Riccati equation and returns the LQR gain, u = -K*x (like lqr).
+   *
+   *  \param A is the state matrix
+   *  \param B is the input matrix
+   *  \param Q is the state weight
+   *  \param R is the input weight
+   *  \param K is the returned gain
+   *  \param P is the returned solution (optional)
+   *  \returns false if the solution didn't converge
+  */
+  static bool solveContinuousRiccati(const Eigen::MatrixXd &A, const Eigen::MatrixXd &B, const Eigen::MatrixXd &Q,
+                                     const Eigen::MatrixXd &R, Eigen::MatrixXd *K, Eigen::MatrixXd *P = NULL);
+
+
+  /*!
+   *  \brief A hash of what a table is designed with, saved with it so load() can tell if it is stale.  The thrust
+   *  effectiveness is hashed by its values at the grid voltages.
+  */
+  static uint64_t designHash(const LQRWeights &weights, double drag, double (*thrust_effectiveness)(double));
+
+
+  /*!
+   *  \brief Zero order hold discretization of dx/dt = A*x + B*u (the exponential of [A B; 0 0]*Ts).
+  */
+  static void discretize(const Eigen::MatrixXd &A, const Eigen::MatrixXd &B, double Ts, Eigen::MatrixXd *Ad,
+                         Eigen::MatrixXd *Bd);
+
+
+protected:
+
+  /// \returns the index in the table of a grid point
+  inline int index(int speed_i, int voltage_i) const {return voltage_i*SPEED_POINTS_ + speed_i;}
+
+  /*!
+   *  \brief Finds the grid cell and the fraction across it for a value (clamped to the range)
+  */
+  inline void cell(double value, double min, double max, int points, int *i, double *fraction) const
+  {
+    double position = (value - min)/(max - min)*(points - 1);
+    if(position <= 0.0)
+      position = 0.0;
+    if(position >= points - 1)
+      position = points - 1;
+    *i = (int)position;
+    if(*i > points - 2)
+      *i = points - 2;
+    *fraction = position - *i;
+  }
+
+  std::vector<GainMatrix, Eigen::aligned_allocator<GainMatrix> > K_table_; //!< feedback gains at the grid points
+  std::vector<IntegralGainMatrix, Eigen::aligned_allocator<IntegralGainMatrix> > KI_table_; //!< integrator gains
+  uint64_t design_; //!< designHash() of the table
+
+  //The envelope:
+  static const int SPEED_POINTS_ = 5; //!< points in the speed direction of the table
+  static const int VOLTAGE_POINTS_ = 6; //!< points in the voltage direction
+  static const double SPEED_MIN_ = 0.0; //!< (m/s) hover
+  static const double SPEED_MAX_ = 2.0; //!< (m/s) fastest path following
+  static const double VOLTAGE_MIN_ = 135.0; //!< (0.1 V) the battery alarm
+  static const double VOLTAGE_MAX_ = 160.0; //!< (0.1 V) a full battery
+
+  static const double SAMPLE_TIME_ = 0.05; //!< (s) the sample time the gains are designed for (as in the scripts)
+  static const int MAX_ITERATIONS_ = 100; //!< doubling iterations before giving up
+  static const int FILE_VERSION_ = 2; //!< version written in the file (2 added the design hash)
+};
+
+}
+
+#endif
@@ -0,0 +1,162 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file min_snap.h
+ *  \author agent
+ *  \date October 2026
+ *
+ *  \brief The min_snap.h file is the header for the MinSnapTrajectory class.
+*/
+
+#ifndef MIN_SNAP_H
+#define MIN_SNAP_H
+
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+namespace diff_flat_control
+{
+
+/*!
+ *  \struct TrajectoryPoint
+ *  \brief The desired state (and its derivatives) of the trajectory at one time.  Used as the reference and the
+ *  feed forward terms by DiffFlat::trajectoryPath.
+*/
+struct TrajectoryPoint
+{
+  Eigen::Vector3d position; //!< (m)
+  Eigen::Vector3d velocity; //!< (m/s)
+  Eigen::Vector3d acceleration; //!< (m/s^2)
+  Eigen::Vector3d jerk; //!< (m/s^3)
+};
+
+
+/*!
+ *  \class MinSnapTrajectory min_snap.h "include/controller/min_snap.h"
+ *  \brief This class computes a minimum-snap trajectory through a list of waypoints and samples it.
+ *
+ *  The trajectory is a piecewise 7th order polynomial (one per segment between waypoints) in each axis.  With the
+ *  segment times fixed, the polynomials that minimize the integral of the squared snap, and pass through the waypoints,
+ *  are continuous up to the 6th derivative at the interior waypoints (the Euler-Lagrange conditions).  So it is found
+ *  in closed form by a single linear solve: 8 coefficients per segment, from the waypoint positions, the continuity of
+ *  derivatives 1-6 at the interior waypoints, and zero velocity, acceleration and jerk at both ends (from and to hover).
+ *
+ *  The segment times come from the distance between waypoints with a trapezoidal speed profile (max_speed and
+ *  max_accel).  Then all the times are scaled by the same factor, so the sampled speed and acceleration of the solution
+ *  stay under those limits (a uniform time scale doesn't change the shape, only how fast it is flown).
+ *
+ *  The coefficients are stored in normalized time (0-1 on each segment) and are precomputed for each derivative, so
+ *  sample() is a few Horner evaluations, no matter how long the trajectory is.
+*/
+class MinSnapTrajectory
+{
+public:
+  /// Eigen macro used when there are fixed-sized class member variables and you dynamically create an instance of the
+  /// class.  (See: http://eigen.tuxfamily.org/dox/TopicStructHavingEigenMembers.html)
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > WaypointList;
+
+  /*!
+   *  \brief The constructor solves for the trajectory.  Check valid() afterwards.
+   *
+   *  \param waypoints is the list of waypoints (at least 2 that are not on top of each other) in the control frame
+   *  \param max_speed is the speed (m/s) the trajectory should not exceed
+   *  \param max_accel is the acceleration (m/s^2) the trajectory should not exceed
+  */
+  MinSnapTrajectory(const WaypointList &waypoints, double max_speed, double max_accel);
+
+
+  /*!
+   *  \brief Samples the trajectory.  Times before the start or after the end give the end points (at rest).
+   *
+   *  \param time is the time (s) since the start of the trajectory
+   *  \param[in,out] segment is the segment the last sample was in (start at 0).  Sampling forward in time from it
+   *  makes finding the segment O(1).
+   *  \param point is the sampled position, velocity, acceleration, and jerk
+  */
+  void sample(double time, int *segment, TrajectoryPoint *point) const;
+
+
+  /// \returns true if the trajectory was solved
+  bool valid() const {return valid_;}
+
+  /// \returns the total time (s) of the trajectory
+  double duration() const {return duration_;}
+
+  /// \returns the number of polynomial segments
+  int segments() const {return (int)segments_.size();}
+
+  /// \returns the first waypoint
+  Eigen::Vector3d startPoint() const {return start_point_;}
+
+  /// \returns the last waypoint
+  Eigen::Vector3d endPoint() const {return end_point_;}
+
+  /// \returns the unit direction from the first waypoint to the second (the direction the trajectory starts in)
+  Eigen::Vector3d startDirection() const {return start_direction_;}
+
+
+protected:
+
+  /*!
+   *  \struct Segment
+   *  \brief One polynomial segment.  deriv[k] holds the coefficients (in the normalized time s = (t - start)/T, rows
+   *  are the powers of s, columns are the axes) of the k-th time derivative, already scaled by 1/T^k.
+  */
+  struct Segment
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    double start; //!< time (s) the segment starts
+    double T; //!< length (s) of the segment
+    Eigen::Matrix<double,8,3> deriv[4]; //!< position, velocity, acceleration, and jerk coefficients
+  };
+
+
+  /*!
+   *  \brief Solves the linear system for the normalized coefficients of all the segments
+   *  \param waypoints is the list of waypoints (duplicates removed)
+   *  \param times is the time of each segment
+   *  \param coefficients is returned, 8 rows per segment, 3 columns (the axes)
+   *  \returns false if the system could not be solved
+  */
+  bool solve(const WaypointList &waypoints, const std::vector<double> &times, Eigen::MatrixXd *coefficients);
+
+
+  /*!
+   *  \brief Sets the segment times (scaled by time_scale) and the derivative coefficients from the solution
+  */
+  void buildSegments(const Eigen::MatrixXd &coefficients, const std::vector<double> &times, double time_scale);
+
+
+  /*!
+   *  \brief Evaluates the polynomial with the coefficients c (rows = powers) at s, using only the first n rows.
+  */
+  inline Eigen::Vector3d horner(const Eigen::Matrix<double,8,3> &c, int n, double s) const
+  {
+    Eigen::Vector3d value = c.row(n - 1).transpose();
+    for(int j = n - 2; j >= 0; j--)
+    {
+      value = value*s + c.row(j).transpose();
+    }
+    return value;
+  }
+
+  std::vector<Segment, Eigen::aligned_allocator<Segment> > segments_; //!< the polynomial segments
+  bool valid_; //!< true if the trajectory was solved
+  double duration_; //!< (s) total time
+  Eigen::Vector3d start_point_; //!< the first waypoint
+  Eigen::Vector3d end_point_; //!< the last waypoint
+  Eigen::Vector3d start_direction_; //!< unit direction of the first segment
+
+  static const double MIN_SEPARATION_ = 0.01; //!< (m) waypoints closer than this to the previous one are dropped
+  static const int CHECK_SAMPLES_ = 20; //!< samples per segment used to check the speed and acceleration limits
+};
+
+}
+
+#endif
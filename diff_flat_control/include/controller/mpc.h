@@ -0,0 +1,137 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file mpc.h
+ *  \author agent
+ *  \date October 2026
+ *
+ *  \brief The mpc.h file is the header for the MPCController class.
+*/
+
+#ifndef MPC_H
+#define MPC_H
+
+#include <Eigen/Core>
+#include "controller/lqr_schedule.h"
+
+namespace diff_flat_control
+{
+
+/*!
+ *  \class MPCController mpc.h "include/controller/mpc.h"
+ *  \brief This class computes the feedback accelerations with model predictive control, in place of LQR_K_*error.
+ *
+ *  The model is the same one the LQR gains are designed with: double integrators in north, east and down (inputs are
+ *  accelerations) and an integrator in yaw (input is the yaw rate).  The axes only couple through the limits, so with
+ *  box limits on each input the problem splits into four small QPs, one per axis.  Each is condensed (the states are
+ *  eliminated, the only variables are the HORIZON_ inputs), so the matrices are fixed size and precomputed here:
+ *  solving is a matrix-vector product for the unconstrained optimum, and only if that breaks a limit, an accelerated
+ *  projected gradient (FISTA) started from the last solution shifted by one step.  The terminal cost is the LQR
+ *  Riccati solution, so with no active limits the first input is the LQR one.
+ *
+ *  The limits are on the total command (feed forward + feedback), which is what saturate() clips in DiffFlat.  If a
+ *  solve runs past the deadline, solve() gives up and returns false, and DiffFlat uses the LQR instead.
+*/
+class MPCController
+{
+public:
+  /// Eigen macro used when there are fixed-sized class member variables and you dynamically create an instance of the
+  /// class.  (See: http://eigen.tuxfamily.org/dox/TopicStructHavingEigenMembers.html)
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  static const int HORIZON_ = 30; //!< steps in the horizon (20-50 are reasonable, the sizes are fixed at compile time)
+
+  typedef Eigen::Matrix<double,HORIZON_,1> InputSequence;
+  typedef Eigen::Matrix<double,HORIZON_,HORIZON_> Hessian;
+
+  /*!
+   *  \brief The constructor sets up the condensed QPs.
+   *
+   *  \param weights are the design weights (the same as the LQR gains)
+   *  \param max_horizontal is the max north and east acceleration (m/s^2), each - from the max tilt, inside its circle
+   *  \param min_down is the min down acceleration (m/s^2, the most thrust)
+   *  \param max_down is the max down acceleration (m/s^2, the least thrust)
+   *  \param max_yaw_rate is the max yaw rate (rad/s)
+   *  \param deadline is the time (s) a solve may take before it is abandoned
+  */
+  MPCController(const LQRWeights &weights, double max_horizontal, double min_down, double max_down,
+                double max_yaw_rate, double deadline);
+
+
+  /*!
+   *  \brief Computes the feedback inputs.
+   *
+   *  \param error is the error in the control state (desired - actual), with the yaw error wrapped
+   *  \param feed_forward is the feed forward input [north, east, down, yaw rate] (gravity included), which uses up
+   *  part of the limits
+   *  \param control is the returned feedback input (same order)
+   *  \returns false if the deadline was missed (control is not set)
+  */
+  bool solve(const Eigen::Matrix<double,7,1> &error, const Eigen::Vector4d &feed_forward, Eigen::Vector4d *control);
+
+
+  /// \brief Drops the warm start (the next constrained solve starts from the unconstrained one)
+  void reset();
+
+  /// \returns the time (s) the last solve took
+  double lastSolveTime() const {return last_solve_time_;}
+
+  /// \returns the projected gradient iterations of the last solve (0 when no limit was active)
+  int lastIterations() const {return last_iterations_;}
+
+  /// \returns how many solves missed the deadline
+  int deadlineMisses() const {return deadline_misses_;}
+
+
+protected:
+
+  /*!
+   *  \struct Axis
+   *  \brief The condensed QP for one axis: min 0.5*U'*H*U + U'*G*x0, lower <= U <= upper.  The state x0 is [position;
+   *  velocity] (only the first element for yaw).
+  */
+  struct Axis
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Hessian H; //!< Hessian
+    Eigen::Matrix<double,HORIZON_,2> G; //!< maps the initial state to the gradient
+    Eigen::Matrix<double,HORIZON_,2> unconstrained; //!< the unconstrained optimum: U = unconstrained*x0
+    double step; //!< gradient step, 1/(largest eigenvalue of H)
+    double lower; //!< limit on the total input
+    double upper; //!< limit on the total input
+    InputSequence U; //!< the last solution (the warm start)
+  };
+
+
+  /*!
+   *  \brief Builds the condensed QP of an axis (x+ = A*x + B*u, stage cost x'Qx + Ru, terminal cost from the Riccati
+   *  equation)
+  */
+  void setupAxis(const Eigen::Matrix2d &A, const Eigen::Vector2d &B, const Eigen::Matrix2d &Q, double R, Axis *axis);
+
+
+  /*!
+   *  \brief Solves the QP of an axis with the limits shifted by the feed forward.
+   *  \returns false on a deadline miss
+  */
+  bool solveAxis(const Eigen::Vector2d &x0, double feed_forward, Axis *axis);
+
+  Axis axes_[4]; //!< north, east, down, yaw
+  double deadline_; //!< (s)
+  double solve_start_; //!< wall time (s) the current solve started
+  double last_solve_time_; //!< (s)
+  int last_iterations_; //!< iterations of the last solve
+  int deadline_misses_; //!< count
+
+  static const double SAMPLE_TIME_ = 0.05; //!< (s) the step of the horizon (the control rate)
+  static const int MAX_ITERATIONS_ = 500; //!< projected gradient iterations before stopping
+  static const int DEADLINE_CHECK_ = 10; //!< iterations between checks of the clock
+  static const double TOLERANCE_ = 1e-5; //!< (m/s^2) converged when no input changes by more than this
+};
+
+}
+
+#endif
@@ -31,14 +31,16 @@
 #include <mikro_serial/mikoImu.h>
 #include <evart_bridge/transform_plus.h>
 #include "controller/diff_flat.h"
+#include "controller/trajectory_generator.h"
 #include <rel_MEKF/relative_state.h>
 #include <rel_MEKF/edge.h>
+#include "latency_trace.h"
 #include <diff_flat_control/request_turn.h>
 
+namespace diff_flat_control
+{
 
-
-
-extern pthread_mutex_t mutex_; //!< mutex just in case for the waypoint_list_ vector (used by multiple callbacks)
+extern pthread_mutex_t control_mutex_; //!< mutex just in case for the waypoint_list_ vector (used by multiple callbacks)
 
 
 /*!
@@ -58,9 +60,10 @@ public:
   /*!
    *  \brief The constructor for the ROSServer class.
    *
-   *  \param nh is the node handle for the current ROS node
+   *  \param nh is the node handle for the current ROS node (or nodelet), topics are relative to it
+   *  \param private_nh is the private node handle, the parameters are read from it
   */
-  ROSServer(ros::NodeHandle &nh);
+  ROSServer(ros::NodeHandle &nh, ros::NodeHandle &private_nh);
 
 
   /*!
@@ -145,6 +148,21 @@ protected:
   void edgeCallback(const rel_MEKF::edge &new_edge);
 
 
+  /*!
+   *  \brief Computes the commands for following the current path: the min-snap trajectory (if ~use_trajectory is
+   *  set) or the waypoint list.  Called by the ekf and truth callbacks with the control_mutex_ locked.
+   *
+   *  \param position is the current position
+   *  \param quat is the current attitude
+   *  \param vel_body is the current body frame velocity
+   *  \param timestamp is the time of the control
+   *  \param dt is the time since the last control
+   *  \returns the control commands
+  */
+  Eigen::Vector4d followPath(Eigen::Vector3d &position, Eigen::Quaterniond &quat, Eigen::Vector3d &vel_body,
+                             ros::Time &timestamp, ros::Duration &dt);
+
+
   /*!
    *  \brief Subscribe to the debug out stuff from the hexacopter to get battery voltage
    *  \todo Make batt_voltage_ threadsafe
@@ -162,7 +180,7 @@ protected:
   */
   void goalLocationCallback(const geometry_msgs::PoseStamped goal)
   {
-    pthread_mutex_lock(&mutex_);
+    pthread_mutex_lock(&control_mutex_);
       //The goal location is really a 2D point in NWU coordinates, convert to NED and add a down component:      
       Eigen::Vector3d goal_vec(goal.pose.position.x,-goal.pose.position.y,desired_global_z_);
       if(!goal_vec.isApprox(goal_location_,0.01))
@@ -175,7 +193,7 @@ protected:
       /// that when it reaches hover at the end, set this yaw (expressed in the right node frame) as the final yaw
       /// angle for hover.
 
-    pthread_mutex_unlock(&mutex_);
+    pthread_mutex_unlock(&control_mutex_);
   }
 
 
@@ -186,9 +204,9 @@ protected:
   */
   void nodeGlobalPoseCallback(const geometry_msgs::TransformStamped node_g)
   {
-    pthread_mutex_lock(&mutex_);
+    pthread_mutex_lock(&control_mutex_);
       node_global_z_ = -node_g.transform.translation.z;
-    pthread_mutex_unlock(&mutex_);
+    pthread_mutex_unlock(&control_mutex_);
   }
 
   /*!
@@ -278,6 +296,9 @@ protected:
   bool new_batt_volt_;  //!< flag for battery voltage
 
   ros::Time old_time_; //!< to save the last timestamp that control was called
+  double min_control_period_; //!< minimum time (s) between control computations, 0 = every estimate (nodelet rate limit)
+  kinect_vo::LatencyTrace latency_trace_; //!< publishes the control stages of the camera frame to motor command trace
+  uint32_t last_trace_id_; //!< the trace id of the last VO frame that a command was computed with
   ros::Time flying_; //!< time that the vehicle started flying
   bool flying_flag_; //!< flag for setting flying_
 
@@ -291,6 +312,9 @@ protected:
   DiffFlat *controller_; //!< Instance of the controller
 
   bool new_waypoint_list_; //!< flag for determining when to pass in a new waypoint list
+  bool use_trajectory_; //!< follow min-snap trajectories through the waypoints instead of the waypoints themselves
+  bool trajectory_requested_; //!< flag for when a trajectory has been requested (only new goals are re-requested)
+  TrajectoryGenerator *trajectory_generator_; //!< computes the trajectories off the control thread (NULL if not used)
   std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > waypoint_list_; //!< used for passing a new list to the control
   /// \note The waypoints should be in global coordinates.  They are converted into node coordinates by the functions
   /// in the diff_flat class (NEED TO FIGURE THIS OUT FOR RELATIVE COORDINATES)
@@ -302,4 +326,6 @@ protected:
   /// the new edge information.
 };
 
+}
+
 #endif
@@ -0,0 +1,90 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file trajectory_generator.h
+ *  \author agent
+ *  \date October 2026
+ *
+ *  \brief The trajectory_generator.h file is the header for the TrajectoryGenerator class.
+*/
+
+#ifndef TRAJECTORY_GENERATOR_H
+#define TRAJECTORY_GENERATOR_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include "controller/min_snap.h"
+
+namespace diff_flat_control
+{
+
+/*!
+ *  \class TrajectoryGenerator trajectory_generator.h "include/controller/trajectory_generator.h"
+ *  \brief This class computes the MinSnapTrajectory for a waypoint list on its own thread, so the solve never holds up
+ *  the control.
+ *
+ *  request() hands over a waypoint list and returns right away.  When the trajectory is done, takeResult() returns it
+ *  (once).  Only the newest request matters: a request that comes in while another is being solved replaces any that
+ *  is still waiting, and the result of a request that was replaced before it finished is thrown away.
+*/
+class TrajectoryGenerator
+{
+public:
+
+  /*!
+   *  \brief The constructor starts the thread
+   *  \param max_speed is the speed limit (m/s) for the trajectories
+   *  \param max_accel is the acceleration limit (m/s^2) for the trajectories
+  */
+  TrajectoryGenerator(double max_speed, double max_accel);
+
+
+  /*!
+   *  \brief The destructor stops the thread (after the solve it is working on, if any)
+  */
+  ~TrajectoryGenerator();
+
+
+  /*!
+   *  \brief Requests a trajectory through the waypoints (non-blocking)
+  */
+  void request(const MinSnapTrajectory::WaypointList &waypoints);
+
+
+  /*!
+   *  \brief Gets the newest trajectory, if one was finished since the last call
+   *  \param trajectory is set to the new trajectory (NULL if the waypoints could not be solved)
+   *  \returns true if there was a new result
+  */
+  bool takeResult(boost::shared_ptr<const MinSnapTrajectory> *trajectory);
+
+
+protected:
+
+  /*!
+   *  \brief The thread: waits for requests and solves them
+  */
+  void run();
+
+  double max_speed_; //!< (m/s) speed limit
+  double max_accel_; //!< (m/s^2) acceleration limit
+
+  boost::mutex mutex_; //!< protects everything below
+  boost::condition_variable condition_; //!< signals a new request (or stop)
+  MinSnapTrajectory::WaypointList waypoints_; //!< the waiting request
+  unsigned int request_id_; //!< incremented with each request
+  unsigned int solving_id_; //!< the request being solved
+  bool pending_; //!< true when a request is waiting
+  bool stop_; //!< tells the thread to exit
+  bool new_result_; //!< true when result_ hasn't been taken
+  boost::shared_ptr<const MinSnapTrajectory> result_; //!< the newest trajectory
+
+  boost::thread thread_; //!< the solver thread (started last in the constructor)
+};
+
+}
+
+#endif
@@ -13,6 +13,9 @@
 
 #include "controller/diff_flat.h"
 
+namespace diff_flat_control
+{
+
 using namespace Eigen;
 
 
@@ -50,6 +53,8 @@ DiffFlat::DiffFlat(bool &allow_integrator, std::string &gain_file_location,
   //Read in the gains:
   //std::string filename = "../Matlab/HeavyGainMatricies.txt";
   readKFromFile(gain_file_location);
+  schedule_speed_ = 0.d;
+  mpc_ = NULL;
 
   int_error_.setZero();
   old_error_.setZero();
@@ -66,6 +71,14 @@ DiffFlat::DiffFlat(bool &allow_integrator, std::string &gain_file_location,
   //circle path stuff
   circle_started_ = false;
 
+  //trajectory stuff
+  trajectory_started_ = false;
+  trajectory_segment_ = 0;
+  trajectory_rotation_.setIdentity();
+  trajectory_offset_.setZero();
+  trajectory_yaw_ = 0.d;
+  jerk_lead_ = 0.d;
+
   //dirty derivative stuff
   dphi_old_ = 0.d;
   der_dphi_ = 0.d;
@@ -101,6 +114,7 @@ DiffFlat::DiffFlat(bool &allow_integrator, std::string &gain_file_location,
 //
 DiffFlat::~DiffFlat()
 {
+  delete mpc_;
 
 }
 
@@ -119,6 +133,11 @@ void DiffFlat::applyNewNodeToWaypoints(Vector3d &translation, Eigen::Quaterniond
       temp = rotation*(-translation + (*i)); //translation and rotation are in the old coordinate frame
       *i = temp;
     }
+    //the trajectory, the same way: rotation*(-translation + (R*p + b))
+    trajectory_rotation_ = (rotation.toRotationMatrix()*trajectory_rotation_).eval();
+    trajectory_offset_ = rotation*(-translation + trajectory_offset_);
+    trajectory_yaw_ = trajectory_yaw_ + //headings turn with the positions
+        atan2(2.*rotation.x()*rotation.y() + 2.*rotation.w()*rotation.z(), 2.*rotation.w()*rotation.w() + 2.*rotation.x()*rotation.x() - 1.0);
   pthread_mutex_unlock(&list_mutex_);
   pthread_mutex_lock(&hpt_mutex_);
     //change the hoverpoint:
@@ -140,6 +159,7 @@ void DiffFlat::applyNewNodeToWaypoints(Vector3d &translation, Eigen::Quaterniond
 Vector4d DiffFlat::hoverPath(Vector3d &position, Quaterniond &quat, Vector3d &velocity,
                              ros::Time &time, ros::Duration &dt, Vector3d *position_hold, double *yaw_hold, double *voltage)
 {
+  schedule_speed_ = velocity.norm(); //for the gain table
   pthread_mutex_lock(&hpt_mutex_);
     if(hover_flag_ && position_hold != NULL && !position_hold->isApprox(hover_setpoint_,0.01))
     {
@@ -239,6 +259,7 @@ Vector4d DiffFlat::waypointPath(Vector3d &position, Quaterniond &quat, Vector3d
                                 ros::Duration &dt,  bool *goal_achieved,
                                 std::vector<Vector3d, aligned_allocator<Vector3d> > *wypt_list, double *voltage)
 {
+  schedule_speed_ = velocity.norm(); //for the gain table
   Vector3d startpt, direction, *hoverpt;
   Matrix<double,7,1> error;
   Vector4d control_commands;
@@ -313,6 +334,120 @@ Vector4d DiffFlat::waypointPath(Vector3d &position, Quaterniond &quat, Vector3d
 
 
 
+//
+//  Trajectory Path:  Follow the min-snap trajectory
+//
+Vector4d DiffFlat::trajectoryPath(Vector3d &position, Quaterniond &quat, Vector3d &velocity, ros::Time &time,
+                                  ros::Duration &dt, bool *goal_achieved, double *voltage)
+{
+  schedule_speed_ = velocity.norm(); //for the gain table
+  Vector4d control_commands;
+  double yaw = atan2(2.*quat.x()*quat.y() + 2.*quat.w()*quat.z(), 2.*quat.w()*quat.w() + 2.*quat.x()*quat.x() - 1.0);
+
+  pthread_mutex_lock(&list_mutex_); /// the trajectory and its frame can't change midway through
+    //Without a trajectory, we cannot proceed!
+    if(!trajectory_)
+    {
+      ROS_WARN_THROTTLE(1.0,"No trajectory to follow - Hovering will continue!  Send a new path to proceed!");
+      control_commands = hoverPath(position,quat,velocity,time,dt,NULL,NULL,voltage);
+      pthread_mutex_unlock(&list_mutex_);
+      return control_commands;
+    }
+
+    if(!trajectory_started_)
+    {
+      //Line up at the start of the trajectory, facing along it, before starting the clock:
+      Vector3d start_point = trajectory_rotation_*trajectory_->startPoint() + trajectory_offset_;
+      Vector3d start_direction = trajectory_rotation_*trajectory_->startDirection();
+      double start_yaw = atan2(start_direction(1),start_direction(0));
+      double yaw_error = start_yaw - yaw;
+      while(yaw_error > PI_)
+        yaw_error -= 2.0*PI_;
+      while(yaw_error < -1.0*PI_)
+        yaw_error += 2.0*PI_;
+
+      if((start_point - position).norm() <= BOUNDS_ && fabs(yaw_error) <= YAW_MAX_)
+      {
+        trajectory_started_ = true;
+        trajectory_start_ = time;
+        trajectory_segment_ = 0;
+        trajectory_yaw_ = start_yaw;
+        hover_flag_ = false;
+        ROS_INFO("CONTROL: Starting the trajectory (%.1f s long)", trajectory_->duration());
+      }
+      else
+      {
+        ROS_INFO_THROTTLE(0.5,"CONTROL: Lining up at the start of the trajectory before following it.");
+        *goal_achieved = false;
+        control_commands = hoverPath(position, quat, velocity, time, dt, &start_point, &start_yaw, voltage);
+        pthread_mutex_unlock(&list_mutex_);
+        return control_commands;
+      }
+    }
+
+    double path_time = (time - trajectory_start_).toSec();
+    if(path_time >= trajectory_->duration())
+    {
+      //Really means that the goal has been reached, hover at the end:
+      *goal_achieved = true;
+      Vector3d end_point = trajectory_rotation_*trajectory_->endPoint() + trajectory_offset_;
+      control_commands = hoverPath(position, quat, velocity, time, dt, &end_point, NULL, voltage);
+      pthread_mutex_unlock(&list_mutex_);
+      return control_commands;
+    }
+    *goal_achieved = false;
+
+    //Desired state from the trajectory (in the node frame):
+    TrajectoryPoint point;
+    trajectory_->sample(path_time, &trajectory_segment_, &point);
+    Vector3d desired_pos, desired_vel, desired_accel, desired_jerk;
+    desired_pos = trajectory_rotation_*point.position + trajectory_offset_;
+    desired_vel = trajectory_rotation_*point.velocity;
+    desired_accel = trajectory_rotation_*point.acceleration;
+    desired_jerk = trajectory_rotation_*point.jerk;
+
+    //Face the direction of travel, the yaw rate is the rate the direction turns: (vn*ae - ve*an)/(vn^2 + ve^2)
+    double yaw_rate = 0.d;
+    double speed_sq = desired_vel(0)*desired_vel(0) + desired_vel(1)*desired_vel(1);
+    if(speed_sq > MIN_HEADING_SPEED_*MIN_HEADING_SPEED_)
+    {
+      trajectory_yaw_ = atan2(desired_vel(1),desired_vel(0));
+      yaw_rate = (desired_vel(0)*desired_accel(1) - desired_vel(1)*desired_accel(0))/speed_sq;
+    }
+
+    Matrix<double,7,1> error;
+    error.block<3,1>(0,0) = desired_pos - position;
+    error.block<3,1>(3,0) = desired_vel - quat*velocity; //conjugate*conjugate
+    error(6,0) = trajectory_yaw_ - yaw;
+
+    Vector4d feed_forward;
+    feed_forward.block<3,1>(0,0) = desired_accel + jerk_lead_*desired_jerk;
+    feed_forward(3) = yaw_rate;
+
+    control_commands = applyDiffFlatness(error, quat, dt, &feed_forward, voltage);
+  pthread_mutex_unlock(&list_mutex_);
+
+  return control_commands;
+}
+
+
+
+//
+//  Set the trajectory that trajectoryPath follows
+//
+void DiffFlat::setTrajectory(const boost::shared_ptr<const MinSnapTrajectory> &trajectory)
+{
+  pthread_mutex_lock(&list_mutex_);
+    trajectory_ = trajectory;
+    trajectory_started_ = false;
+    trajectory_segment_ = 0;
+    trajectory_rotation_.setIdentity();
+    trajectory_offset_.setZero();
+  pthread_mutex_unlock(&list_mutex_);
+}
+
+
+
 //
 //  Path Manager: Given a waypoint list, determine the starting point and direction of travel
 //  This is done according to the path manager outlined in the book by Beard & McLain: "Small Unmanned Aircraft"
@@ -464,6 +599,10 @@ Vector4d DiffFlat::applyDiffFlatness(Matrix<double, 7, 1> &error, Quaterniond &q
 
   //counteract gravity:
   u_ref(2) -= GRAVITY_;
+  if(voltage != NULL)
+  {
+    batt_voltage_ = *voltage; //for the gain table
+  }
 //  double gravity_offset;
 //  if(voltage != NULL)
 //  {
@@ -478,7 +617,26 @@ Vector4d DiffFlat::applyDiffFlatness(Matrix<double, 7, 1> &error, Quaterniond &q
 
   if(!open_Loop_)
   {
-    u_control = computeLQRControl(error, dt);
+    //wrap the error in yaw:
+    while(error(6,0) > PI_)
+    {
+      error(6,0) -= 2.0*PI_;
+    }
+    while(error(6,0) < -1.0*PI_)
+    {
+      error(6,0) += 2.0*PI_;
+    }
+
+    if(mpc_ == NULL || !computeMPCControl(error, dt, u_ref, &u_control))
+    {
+      u_control = computeLQRControl(error, dt);
+    }
+
+    //the LQR and the MPC feedback (with the integrator terms) are limited the same way
+    u_control(0) = saturate(u_control(0), -30, 30); //pitch
+    u_control(1) = saturate(u_control(1), -30, 30); //roll
+    u_control(2) = saturate(u_control(2), -80, 80); //thrust
+    u_control(3) = saturate(u_control(3), -60, 60); //yaw
   }
 
   //add feedforward and feedback terms:
@@ -550,19 +708,49 @@ Vector4d DiffFlat::applyDiffFlatness(Matrix<double, 7, 1> &error, Quaterniond &q
 //
 Vector4d DiffFlat::computeLQRControl(Eigen::Matrix<double, 7, 1> &error, ros::Duration &dt)
 {
-  //wrap the error in yaw:
-  while(error(6,0) > PI_)
+  Vector4d LQR_output;
+
+  //look up the gains for the current speed and battery voltage:
+  if(gain_schedule_.valid())
   {
-    error(6,0) -= 2.0*PI_;
+    gain_schedule_.gains(schedule_speed_, batt_voltage_, &LQR_K_, &LQR_KI_);
   }
-  while(error(6,0) < -1.0*PI_)
+
+  LQR_output = LQR_K_*error;  
+
+  LQR_output += computeIntegralControl(error, dt);
+
+  return LQR_output;
+}
+
+
+
+//
+//  Calculate the MPC Feedback
+//
+bool DiffFlat::computeMPCControl(Eigen::Matrix<double, 7, 1> &error, ros::Duration &dt, Vector4d &feed_forward,
+                                 Vector4d *control)
+{
+  if(!mpc_->solve(error, feed_forward, control))
   {
-    error(6,0) += 2.0*PI_;
+    ROS_WARN_THROTTLE(1.0,"CONTROL: MPC missed its deadline (%.2f ms), using the LQR (%d misses so far)",
+                      mpc_->lastSolveTime()*1000.0, mpc_->deadlineMisses());
+    return false;
   }
 
-  Vector4d LQR_output, LQRI_output;
+  *control += computeIntegralControl(error, dt);
+  return true;
+}
+
 
-  LQR_output = LQR_K_*error;  
+
+//
+//  Calculate the integrator terms
+//
+Vector4d DiffFlat::computeIntegralControl(Eigen::Matrix<double, 7, 1> &error, ros::Duration &dt)
+{
+  Vector4d LQRI_output;
+  LQRI_output.setZero();
 
   if(use_Integrator_ && flying_ && error.transpose()*error < 0.8)
   {
@@ -575,18 +763,11 @@ Vector4d DiffFlat::computeLQRControl(Eigen::Matrix<double, 7, 1> &error, ros::Du
     LQRI_output(1) = saturate(LQRI_output(1),-3,3); //roll
     LQRI_output(2) = saturate(LQRI_output(2),-3,3); //thrust
     LQRI_output(3) = saturate(LQRI_output(3),-2,2); //yaw
-
-    LQR_output += LQRI_output;
   }
 
-  LQR_output(0) = saturate(LQR_output(0), -30, 30); //pitch
-  LQR_output(1) = saturate(LQR_output(1), -30, 30); //roll
-  LQR_output(2) = saturate(LQR_output(2), -80, 80); //thrust
-  LQR_output(3) = saturate(LQR_output(3), -60, 60); //yaw
-
   old_error_ = error;
 
-  return LQR_output;
+  return LQRI_output;
 }
 
 
@@ -645,12 +826,73 @@ void DiffFlat::readKFromFile(std::string &filename)
 
 
 
+//
+//  Use a gain table for the LQR gains
+//
+bool DiffFlat::useGainTable(const std::string &filename, const LQRWeights &weights)
+{
+  if(gain_schedule_.load(filename, weights, DRAG_, &DiffFlat::thrustEffectiveness))
+  {
+    ROS_INFO("CONTROL: LQR gain table loaded from %s", filename.c_str());
+    return true;
+  }
+
+  ros::WallTime start = ros::WallTime::now();
+  if(!gain_schedule_.compute(weights, DRAG_, &DiffFlat::thrustEffectiveness))
+  {
+    ROS_ERROR("The LQR gain table could not be computed!  Using the gains from the gain file.");
+    gain_schedule_ = LQRSchedule();
+    return false;
+  }
+  ROS_INFO("CONTROL: LQR gain table computed in %.1f ms", (ros::WallTime::now() - start).toSec()*1000.0);
+
+  if(!gain_schedule_.save(filename))
+  {
+    ROS_WARN("The LQR gain table could not be saved to %s", filename.c_str());
+  }
+  return true;
+}
+
+
+
+//
+//  Use the MPC for the feedback
+//
+void DiffFlat::useMPC(const LQRWeights &weights, double deadline)
+{
+  delete mpc_;
+  mpc_ = createMPC(weights, deadline);
+  ROS_INFO("CONTROL: MPC feedback with a %d step horizon (%.1f ms deadline)", MPCController::HORIZON_,
+           deadline*1000.0);
+}
+
+
+
+//
+//  Create an MPC with this vehicle's limits
+//
+MPCController* DiffFlat::createMPC(const LQRWeights &weights, double deadline)
+{
+  //The thrust limits are the saturation of the motor command in applyDiffFlatness (125 - 255), as accelerations:
+  double min_thrust = NUM_ROTORS_*KF_*125.0*125.0/MASS_;
+  double max_thrust = NUM_ROTORS_*KF_*255.0*255.0/MASS_;
+
+  //The north and east are limited separately (a box), so each gets 1/sqrt(2) of the tilt acceleration: the corner of
+  //the box is then the max tilt, where separate limits at the full tilt would allow sqrt(2) times it on a diagonal
+  double max_horizontal = GRAVITY_*tan(MPC_MAX_TILT_)/sqrt(2.0);
+
+  return new MPCController(weights, max_horizontal, -1.0*max_thrust, -1.0*min_thrust, 30.0/YAW_RATE_GAIN_, deadline);
+}
+
+
+
 //
 //  Circle Path: Follow a predefined circle around at a constant velocity (with optional height change)
 //
 Vector4d DiffFlat::circlePath(Vector3d &position, Quaterniond &quat, Vector3d &velocity, ros::Time &time,
                               ros::Duration &dt, double *voltage)
 {
+  schedule_speed_ = velocity.norm(); //for the gain table
   //not hovering, set the flag to false:
   if(hover_flag_)
     hover_flag_ = false;
@@ -666,13 +908,17 @@ Vector4d DiffFlat::circlePath(Vector3d &position, Quaterniond &quat, Vector3d &v
   omega = VELOCITY_/RADIUS_;
   path_time = time.toSec() - start_time_.toSec();
 
+  //the trig is the same for every term, compute it once:
+  double sin_wt = sin(omega*path_time);
+  double cos_wt = cos(omega*path_time);
+
   //Path as a function of time (position, velocity, and yaw)
-  predicted(0,0) = RADIUS_*cos(omega*path_time) + N_OFFSET_; //north (or node f)
-  predicted(1,0) = RADIUS_*sin(omega*path_time) + E_OFFSET_; //east (or node r) position as function of time
-  predicted(2,0) = -1.0*HEIGHT_GAIN_*sin(omega*path_time) - base_height_; //down (or node d) position as function of time
-  predicted(3,0) = -1.0*RADIUS_*sin(omega*path_time)*omega;   //d(predicted(0,0))/dt
-  predicted(4,0) = -1.0*RADIUS_*cos(omega*path_time)*omega;   //d(predicted(1,0))/dt
-  predicted(5,0) = -1.0*HEIGHT_GAIN_*cos(omega*path_time)*omega;   //d(predicted(2,0))/dt
+  predicted(0,0) = RADIUS_*cos_wt + N_OFFSET_; //north (or node f)
+  predicted(1,0) = RADIUS_*sin_wt + E_OFFSET_; //east (or node r) position as function of time
+  predicted(2,0) = -1.0*HEIGHT_GAIN_*sin_wt - base_height_; //down (or node d) position as function of time
+  predicted(3,0) = -1.0*RADIUS_*sin_wt*omega;   //d(predicted(0,0))/dt
+  predicted(4,0) = -1.0*RADIUS_*cos_wt*omega;   //d(predicted(1,0))/dt
+  predicted(5,0) = -1.0*HEIGHT_GAIN_*cos_wt*omega;   //d(predicted(2,0))/dt
   predicted(6,0) = YAW_RATE_*path_time;
 
   actual.block<3,1>(0,0) = position;
@@ -684,9 +930,9 @@ Vector4d DiffFlat::circlePath(Vector3d &position, Quaterniond &quat, Vector3d &v
   //Calc the feedforward accelerations/velocity:
   Vector4d feed_forward;
 
-  feed_forward(0,0) = -1.0*RADIUS_*cos(omega*path_time)*omega*omega; //d(predicted(3,0))/dt
-  feed_forward(1,0) = -1.0*RADIUS_*sin(omega*path_time)*omega*omega; //d(predicted(4,0))/dt
-  feed_forward(2,0) = HEIGHT_GAIN_*sin(omega*path_time)*omega*omega; //d(predicted(5,0))/dt
+  feed_forward(0,0) = -1.0*RADIUS_*cos_wt*omega*omega; //d(predicted(3,0))/dt
+  feed_forward(1,0) = -1.0*RADIUS_*sin_wt*omega*omega; //d(predicted(4,0))/dt
+  feed_forward(2,0) = HEIGHT_GAIN_*sin_wt*omega*omega; //d(predicted(5,0))/dt
   feed_forward(3,0) = YAW_RATE_; //d(predicted(6,0))/dt
 
   Vector4d control_commands;
@@ -724,3 +970,5 @@ std::string DiffFlat::timeStructFilename(tm *time_struct)
 
   return temp;
 }
+
+}
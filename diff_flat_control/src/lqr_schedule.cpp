@@ -0,0 +1,406 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file lqr_schedule.cpp
+ *  \author agent
+ *  \date October 2026
+ *
+*/
+
+#include <math.h>
+#include <string.h>
+#include <fstream>
+#include <Eigen/LU>
+#include <Eigen/QR>
+#include "controller/lqr_schedule.h"
+
+namespace diff_flat_control
+{
+
+using namespace Eigen;
+
+
+//
+// Weights from LQR_script_heavy.m
+//
+LQRWeights LQRWeights::heavy()
+{
+  LQRWeights weights;
+  weights.max_n = 0.05;
+  weights.max_e = 0.05;
+  weights.max_d = 0.05;
+  weights.max_ndot = 0.1;
+  weights.max_ddot = 0.18;
+  weights.max_psi = 10.0*M_PI/180.0;
+  weights.max_thrust = 1.7;
+  weights.max_angle = 0.20;
+  weights.integral_q << 3.0, 3.0, 1.0, 1.0;
+  weights.integral_r = 10.0;
+  return weights;
+}
+
+
+
+//
+// Weights from LQR_script_relative_heavy.m
+//
+LQRWeights LQRWeights::relativeHeavy()
+{
+  LQRWeights weights;
+  weights.max_n = 0.03;
+  weights.max_e = 0.03;
+  weights.max_d = 0.02;
+  weights.max_ndot = 0.03;
+  weights.max_ddot = 0.10;
+  weights.max_psi = 20.0*M_PI/180.0;
+  weights.max_thrust = 1.8;
+  weights.max_angle = 0.18;
+  weights.integral_q << 3.0, 3.0, 3.0, 0.0001;
+  weights.integral_r = 10.0;
+  return weights;
+}
+
+
+
+//
+// Constructor
+//
+LQRSchedule::LQRSchedule(): design_(0)
+{
+}
+
+
+
+//
+// Compute the gain at every point in the envelope
+//
+bool LQRSchedule::compute(const LQRWeights &weights, double drag, double (*thrust_effectiveness)(double))
+{
+  K_table_.assign(SPEED_POINTS_*VOLTAGE_POINTS_, GainMatrix::Zero());
+  KI_table_.assign(SPEED_POINTS_*VOLTAGE_POINTS_, IntegralGainMatrix::Zero());
+
+  //States are: n,e,d,ndot,edot,ddot,psi and inputs are: pitch, roll, thrust, yaw-dot (all as accelerations/rates)
+  MatrixXd Q = MatrixXd::Zero(7,7);
+  Q(0,0) = 1.0/(weights.max_n*weights.max_n);
+  Q(1,1) = 1.0/(weights.max_e*weights.max_e);
+  Q(2,2) = 1.0/weights.max_d*2.0; //this is how the scripts have it (not squared), kept so the gains match the files
+  Q(3,3) = 1.0/(weights.max_ndot*weights.max_ndot);
+  Q(4,4) = 1.0/(weights.max_ndot*weights.max_ndot);
+  Q(5,5) = 1.0/(weights.max_ddot*weights.max_ddot);
+  Q(6,6) = 1.0/(weights.max_psi*weights.max_psi);
+
+  MatrixXd R = MatrixXd::Zero(4,4);
+  R(0,0) = 1.0/(weights.max_angle*weights.max_angle);
+  R(1,1) = 1.0/(weights.max_angle*weights.max_angle);
+  R(2,2) = 1.0/(weights.max_thrust*weights.max_thrust);
+  R(3,3) = 1.0/(weights.max_angle*weights.max_angle);
+
+  //Integrator design: the integral states (int_n, int_e, int_d, int_psi) appended to the model
+  MatrixXd Qz = MatrixXd::Zero(11,11);
+  Qz.block<4,4>(7,7) = weights.integral_q.asDiagonal();
+  MatrixXd Rv = MatrixXd::Identity(4,4)*weights.integral_r;
+
+  for(int v = 0; v < VOLTAGE_POINTS_; v++)
+  {
+    double voltage = VOLTAGE_MIN_ + (VOLTAGE_MAX_ - VOLTAGE_MIN_)*v/(VOLTAGE_POINTS_ - 1);
+    double effectiveness = thrust_effectiveness(voltage);
+
+    for(int s = 0; s < SPEED_POINTS_; s++)
+    {
+      double speed = SPEED_MIN_ + (SPEED_MAX_ - SPEED_MIN_)*s/(SPEED_POINTS_ - 1);
+
+      MatrixXd A = MatrixXd::Zero(7,7);
+      A(0,3) = 1.0;
+      A(1,4) = 1.0;
+      A(2,5) = 1.0;
+      A(3,3) = -2.0*drag*speed; //drag linearized about the speed: d(drag*v^2)/dv
+      A(4,4) = -2.0*drag*speed;
+
+      MatrixXd B = MatrixXd::Zero(7,4);
+      B(3,0) = effectiveness;
+      B(4,1) = effectiveness;
+      B(5,2) = effectiveness;
+      B(6,3) = 1.0;
+
+      MatrixXd Ad, Bd, K;
+      discretize(A, B, SAMPLE_TIME_, &Ad, &Bd);
+      if(!solveRiccati(Ad, Bd, Q, R, &K))
+        return false;
+
+      //Augmented dynamics:
+      MatrixXd Abar = MatrixXd::Zero(11,11);
+      Abar.block<7,7>(0,0) = A;
+      Abar(7,0) = 1.0;
+      Abar(8,1) = 1.0;
+      Abar(9,2) = 1.0;
+      Abar(10,6) = 1.0;
+      MatrixXd Bbar = MatrixXd::Zero(11,4);
+      Bbar.block<7,4>(0,0) = B;
+
+      //the scripts design these in continuous time (lqr, where K uses lqrd), so they are kept that way to match
+      MatrixXd Kint;
+      if(!solveContinuousRiccati(Abar, Bbar, Qz, Rv, &Kint))
+        return false;
+
+      K_table_[index(s,v)] = K;
+      KI_table_[index(s,v)] = Kint.block<4,4>(0,7);
+    }
+  }
+
+  design_ = designHash(weights, drag, thrust_effectiveness);
+  return true;
+}
+
+
+
+//
+// Bilinear interpolation of the gains
+//
+void LQRSchedule::gains(double speed, double voltage, GainMatrix *K, IntegralGainMatrix *KI) const
+{
+  int s, v;
+  double fs, fv;
+  cell(speed, SPEED_MIN_, SPEED_MAX_, SPEED_POINTS_, &s, &fs);
+  cell(voltage, VOLTAGE_MIN_, VOLTAGE_MAX_, VOLTAGE_POINTS_, &v, &fv);
+
+  double w00 = (1.0 - fs)*(1.0 - fv), w10 = fs*(1.0 - fv), w01 = (1.0 - fs)*fv, w11 = fs*fv;
+  *K = w00*K_table_[index(s,v)] + w10*K_table_[index(s + 1,v)] + w01*K_table_[index(s,v + 1)]
+       + w11*K_table_[index(s + 1,v + 1)];
+  *KI = w00*KI_table_[index(s,v)] + w10*KI_table_[index(s + 1,v)] + w01*KI_table_[index(s,v + 1)]
+        + w11*KI_table_[index(s + 1,v + 1)];
+}
+
+
+
+//
+// Save the table to a binary file
+//
+bool LQRSchedule::save(const std::string &filename) const
+{
+  if(!valid())
+    return false;
+
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if(!file.is_open())
+    return false;
+
+  int header[3] = {FILE_VERSION_, SPEED_POINTS_, VOLTAGE_POINTS_};
+  double range[4] = {SPEED_MIN_, SPEED_MAX_, VOLTAGE_MIN_, VOLTAGE_MAX_};
+  file.write("LQRT", 4);
+  file.write((const char *)header, sizeof(header));
+  file.write((const char *)range, sizeof(range));
+  file.write((const char *)&design_, sizeof(design_));
+  for(int i = 0; i < (int)K_table_.size(); i++)
+  {
+    file.write((const char *)K_table_[i].data(), sizeof(double)*K_table_[i].size());
+    file.write((const char *)KI_table_[i].data(), sizeof(double)*KI_table_[i].size());
+  }
+
+  return file.good();
+}
+
+
+
+//
+// Load a table saved by save()
+//
+bool LQRSchedule::load(const std::string &filename, const LQRWeights &weights, double drag,
+                       double (*thrust_effectiveness)(double))
+{
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  if(!file.is_open())
+    return false;
+
+  char magic[4];
+  int header[3];
+  double range[4];
+  uint64_t design;
+  file.read(magic, 4);
+  file.read((char *)header, sizeof(header));
+  file.read((char *)range, sizeof(range));
+  file.read((char *)&design, sizeof(design));
+
+  //The envelope is compiled in, so a table made with a different one is rejected (and recomputed by the caller), and
+  //so is one designed with other weights, drag or thrust effectiveness
+  uint64_t expected = designHash(weights, drag, thrust_effectiveness);
+  if(!file.good() || strncmp(magic, "LQRT", 4) != 0 || header[0] != FILE_VERSION_ || header[1] != SPEED_POINTS_ ||
+     header[2] != VOLTAGE_POINTS_ || range[0] != SPEED_MIN_ || range[1] != SPEED_MAX_ || range[2] != VOLTAGE_MIN_ ||
+     range[3] != VOLTAGE_MAX_ || design != expected)
+    return false;
+
+  std::vector<GainMatrix, aligned_allocator<GainMatrix> > K_table(SPEED_POINTS_*VOLTAGE_POINTS_);
+  std::vector<IntegralGainMatrix, aligned_allocator<IntegralGainMatrix> > KI_table(SPEED_POINTS_*VOLTAGE_POINTS_);
+  for(int i = 0; i < (int)K_table.size(); i++)
+  {
+    file.read((char *)K_table[i].data(), sizeof(double)*K_table[i].size());
+    file.read((char *)KI_table[i].data(), sizeof(double)*KI_table[i].size());
+  }
+  if(!file.good())
+    return false;
+
+  K_table_.swap(K_table);
+  KI_table_.swap(KI_table);
+  design_ = design;
+  return true;
+}
+
+
+
+//
+// Hash of what the table is designed with (64 bit FNV-1a of the values)
+//
+uint64_t LQRSchedule::designHash(const LQRWeights &weights, double drag, double (*thrust_effectiveness)(double))
+{
+  std::vector<double> values;
+  values.push_back(weights.max_n);
+  values.push_back(weights.max_e);
+  values.push_back(weights.max_d);
+  values.push_back(weights.max_ndot);
+  values.push_back(weights.max_ddot);
+  values.push_back(weights.max_psi);
+  values.push_back(weights.max_thrust);
+  values.push_back(weights.max_angle);
+  for(int i = 0; i < 4; i++)
+    values.push_back(weights.integral_q(i));
+  values.push_back(weights.integral_r);
+  values.push_back(drag);
+  double sample_time = SAMPLE_TIME_; //(push_back takes a reference, which the static constant doesn't have)
+  values.push_back(sample_time);
+  //the effectiveness is a function, so its values at the grid voltages stand for it:
+  for(int v = 0; v < VOLTAGE_POINTS_; v++)
+    values.push_back(thrust_effectiveness(VOLTAGE_MIN_ + (VOLTAGE_MAX_ - VOLTAGE_MIN_)*v/(VOLTAGE_POINTS_ - 1)));
+
+  uint64_t hash = 14695981039346656037ULL;
+  const unsigned char *bytes = (const unsigned char *)&values[0];
+  for(int i = 0; i < (int)(values.size()*sizeof(double)); i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+
+//
+// Discrete-time algebraic Riccati equation, solved by the structure-preserving doubling algorithm
+//
+bool LQRSchedule::solveRiccati(const MatrixXd &A, const MatrixXd &B, const MatrixXd &Q, const MatrixXd &R,
+                               MatrixXd *K, MatrixXd *P)
+{
+  int n = A.rows();
+  MatrixXd I = MatrixXd::Identity(n,n);
+
+  /// Each iteration doubles the horizon of the Riccati recursion, H converges to the solution P:
+  /// W = I + G*H,  A' = A*W^-1*A,  G' = G + A*W^-1*G*A^T,  H' = H + A^T*H*W^-1*A
+  MatrixXd Ak = A;
+  MatrixXd G = B*R.lu().solve(B.transpose());
+  MatrixXd H = Q;
+  bool converged = false;
+  for(int i = 0; i < MAX_ITERATIONS_ && !converged; i++)
+  {
+    PartialPivLU<MatrixXd> W(I + G*H);
+    MatrixXd WA = W.solve(Ak);
+    MatrixXd WG = W.solve(G);
+    MatrixXd H_new = H + Ak.transpose()*H*WA;
+    G = G + Ak*WG*Ak.transpose();
+    Ak = Ak*WA;
+
+    converged = (H_new - H).norm() <= 1e-10*H_new.norm();
+    H = H_new;
+  }
+  if(!converged || !(H.norm() < 1e300)) //the second catches NaN too
+    return false;
+
+  //K = (R + B^T*P*B)^-1 * B^T*P*A
+  MatrixXd BtP = B.transpose()*H;
+  *K = (R + BtP*B).lu().solve(BtP*A);
+  if(P != NULL)
+    *P = H;
+  return true;
+}
+
+
+
+//
+// Continuous-time algebraic Riccati equation, solved with the matrix sign function of the Hamiltonian
+//
+bool LQRSchedule::solveContinuousRiccati(const MatrixXd &A, const MatrixXd &B, const MatrixXd &Q, const MatrixXd &R,
+                                         MatrixXd *K, MatrixXd *P)
+{
+  int n = A.rows();
+  MatrixXd I = MatrixXd::Identity(n,n);
+
+  /// The Newton iteration Z' = (c*Z + (c*Z)^-1)/2 converges to sign(Z), the scaling c = |det Z|^(-1/2n) makes it take
+  /// a handful of iterations.  The stable invariant subspace of the Hamiltonian then gives P:
+  /// [W12; W22 + I]*P = -[W11 + I; W21] with W = sign([A -G; -Q -A^T]), G = B*R^-1*B^T
+  MatrixXd G = B*R.lu().solve(B.transpose());
+  MatrixXd Z(2*n,2*n);
+  Z << A, -G, -Q, -A.transpose();
+  bool converged = false;
+  for(int i = 0; i < MAX_ITERATIONS_ && !converged; i++)
+  {
+    PartialPivLU<MatrixXd> lu(Z);
+    double log_det = lu.matrixLU().diagonal().cwiseAbs().array().log().sum();
+    double c = exp(-log_det/(2*n));
+    MatrixXd Z_new = 0.5*(c*Z + lu.inverse()/c);
+
+    converged = (Z_new - Z).norm() <= 1e-12*Z_new.norm();
+    Z = Z_new;
+  }
+  if(!converged || !(Z.norm() < 1e300)) //the second catches NaN too
+    return false;
+
+  MatrixXd M(2*n,n), N(2*n,n);
+  M << Z.topRightCorner(n,n), Z.bottomRightCorner(n,n) + I;
+  N << -(Z.topLeftCorner(n,n) + I), -Z.bottomLeftCorner(n,n);
+  MatrixXd H = M.colPivHouseholderQr().solve(N);
+  H = 0.5*(H + H.transpose());
+
+  //K = R^-1 * B^T*P
+  *K = R.lu().solve(B.transpose()*H);
+  if(P != NULL)
+    *P = H;
+  return true;
+}
+
+
+
+//
+// Zero order hold discretization
+//
+void LQRSchedule::discretize(const MatrixXd &A, const MatrixXd &B, double Ts, MatrixXd *Ad, MatrixXd *Bd)
+{
+  int n = A.rows(), m = B.cols();
+  MatrixXd M = MatrixXd::Zero(n + m, n + m);
+  M.block(0,0,n,n) = A*Ts;
+  M.block(0,n,n,m) = B*Ts;
+
+  //exponential by scaling and squaring (the Taylor series converges fast for a small norm):
+  int squarings = 0;
+  double norm = M.cwiseAbs().rowwise().sum().maxCoeff();
+  while(norm > 0.5)
+  {
+    norm /= 2.0;
+    squarings++;
+  }
+  M /= pow(2.0, squarings);
+
+  MatrixXd E = MatrixXd::Identity(n + m, n + m);
+  MatrixXd term = MatrixXd::Identity(n + m, n + m);
+  for(int k = 1; k <= 12; k++)
+  {
+    term = term*M/k;
+    E += term;
+  }
+  for(int i = 0; i < squarings; i++)
+    E = E*E;
+
+  *Ad = E.block(0,0,n,n);
+  *Bd = E.block(0,n,n,m);
+}
+
+}
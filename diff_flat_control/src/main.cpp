@@ -18,6 +18,8 @@
 #include <ros/ros.h>
 #include "controller/ros_server.h"
 
+using namespace diff_flat_control;
+
 
 /*!
  *  \brief The main function starts ROS and hands it off to ros_server.
@@ -29,8 +31,9 @@ int main(int argc, char **argv)
   ros::init(argc,argv,"control");
 
   ros::NodeHandle nh("control");
+  ros::NodeHandle private_nh("~");
 
-  ROSServer server(nh);
+  ROSServer server(nh, private_nh);
 
   //We want the control called at a specific rate - if it comes too fast, the hex cannot process all the commands
   ros::Rate r(25);
@@ -41,6 +44,5 @@ int main(int argc, char **argv)
     r.sleep();
   }
 
-  pthread_mutex_destroy(&mutex_);
-  server.~ROSServer();
+  pthread_mutex_destroy(&control_mutex_);
 }
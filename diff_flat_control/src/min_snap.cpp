@@ -0,0 +1,213 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file min_snap.cpp
+ *  \author agent
+ *  \date October 2026
+ *
+*/
+
+#include <math.h>
+#include <Eigen/LU>
+#include "controller/min_snap.h"
+
+namespace diff_flat_control
+{
+
+using namespace Eigen;
+
+
+//
+// Constructor: solve for the trajectory through the waypoints
+//
+MinSnapTrajectory::MinSnapTrajectory(const WaypointList &waypoints, double max_speed, double max_accel)
+{
+  valid_ = false;
+  duration_ = 0.0;
+  start_point_.setZero();
+  end_point_.setZero();
+  start_direction_.setZero();
+
+  //drop any waypoints on top of the previous one (they give zero length segments):
+  WaypointList points;
+  for(int i = 0; i < (int)waypoints.size(); i++)
+  {
+    if(points.empty() || (waypoints[i] - points.back()).norm() > MIN_SEPARATION_)
+      points.push_back(waypoints[i]);
+  }
+  if((int)points.size() < 2 || max_speed <= 0.0 || max_accel <= 0.0)
+    return;
+
+  start_point_ = points.front();
+  end_point_ = points.back();
+  start_direction_ = (points[1] - points[0]).normalized();
+
+  //segment times from a trapezoidal speed profile over each segment:
+  std::vector<double> times;
+  for(int i = 0; i + 1 < (int)points.size(); i++)
+  {
+    double distance = (points[i + 1] - points[i]).norm();
+    if(distance < max_speed*max_speed/max_accel)
+      times.push_back(2.0*sqrt(distance/max_accel));
+    else
+      times.push_back(distance/max_speed + max_speed/max_accel);
+  }
+
+  MatrixXd coefficients;
+  if(!solve(points, times, &coefficients))
+    return;
+
+  buildSegments(coefficients, times, 1.0);
+
+  //the min-snap solution overshoots the profile's speed between the waypoints, slow the whole thing down to the limits
+  double peak_speed = 0.0, peak_accel = 0.0;
+  for(int i = 0; i < (int)segments_.size(); i++)
+  {
+    for(int k = 0; k <= CHECK_SAMPLES_; k++)
+    {
+      double s = (double)k/CHECK_SAMPLES_;
+      peak_speed = std::max(peak_speed, horner(segments_[i].deriv[1], 7, s).norm());
+      peak_accel = std::max(peak_accel, horner(segments_[i].deriv[2], 6, s).norm());
+    }
+  }
+  double time_scale = std::max(1.0, std::max(peak_speed/max_speed, sqrt(peak_accel/max_accel)));
+  if(time_scale > 1.0)
+    buildSegments(coefficients, times, time_scale);
+
+  valid_ = true;
+}
+
+
+
+//
+// Solve for the polynomial coefficients
+//
+bool MinSnapTrajectory::solve(const WaypointList &waypoints, const std::vector<double> &times, MatrixXd *coefficients)
+{
+  int N = (int)times.size(); //number of segments
+  int n = 8*N; //unknowns (per axis)
+
+  //factorial ratios: falling(j,k) = j!/(j-k)!, the coefficient of s^(j-k) in the k-th derivative of s^j
+  double falling[8][7];
+  for(int j = 0; j < 8; j++)
+  {
+    for(int k = 0; k < 7; k++)
+    {
+      falling[j][k] = 1.0;
+      for(int m = 0; m < k; m++)
+        falling[j][k] *= (double)(j - m);
+    }
+  }
+
+  MatrixXd A = MatrixXd::Zero(n, n);
+  MatrixXd b = MatrixXd::Zero(n, 3);
+  int row = 0;
+
+  for(int i = 0; i < N; i++)
+  {
+    int col = 8*i;
+
+    //passes through both of its waypoints: p(0) = w_i, p(1) = w_i+1
+    A(row, col) = 1.0;
+    b.row(row++) = waypoints[i].transpose();
+    for(int j = 0; j < 8; j++)
+      A(row, col + j) = 1.0;
+    b.row(row++) = waypoints[i + 1].transpose();
+
+    if(i + 1 < N)
+    {
+      //continuous derivatives 1-6 at the interior waypoint.  In the normalized time the k-th derivative of segment i
+      //at its end is sum(falling*c)/T_i^k and of segment i+1 at its start is k!*c_k/T_i+1^k (scaled here by T_i^k)
+      double ratio = times[i]/times[i + 1];
+      for(int k = 1; k <= 6; k++)
+      {
+        for(int j = k; j < 8; j++)
+          A(row, col + j) = falling[j][k];
+        A(row, col + 8 + k) = -falling[k][k]*pow(ratio, k);
+        row++;
+      }
+    }
+  }
+
+  //start and end at rest: velocity, acceleration, and jerk are zero
+  for(int k = 1; k <= 3; k++)
+  {
+    A(row++, k) = 1.0;
+    int col = 8*(N - 1);
+    for(int j = k; j < 8; j++)
+      A(row, col + j) = falling[j][k];
+    row++;
+  }
+
+  PartialPivLU<MatrixXd> lu(A);
+  *coefficients = lu.solve(b);
+
+  //the system is square and should be well posed, but make sure the solve worked:
+  double residual = (A*(*coefficients) - b).norm();
+  return residual == residual && residual < 1e-6*(1.0 + b.norm());
+}
+
+
+
+//
+// Build the segments (times and derivative coefficients) from the normalized coefficients
+//
+void MinSnapTrajectory::buildSegments(const MatrixXd &coefficients, const std::vector<double> &times, double time_scale)
+{
+  segments_.resize(times.size());
+  double start = 0.0;
+  for(int i = 0; i < (int)times.size(); i++)
+  {
+    Segment &segment = segments_[i];
+    segment.start = start;
+    segment.T = times[i]*time_scale;
+    start += segment.T;
+
+    segment.deriv[0] = coefficients.block<8,3>(8*i, 0);
+    for(int k = 1; k < 4; k++)
+    {
+      //differentiate the previous one w.r.t. s, and the chain rule gives 1/T
+      segment.deriv[k].setZero();
+      for(int j = 1; j < 8; j++)
+        segment.deriv[k].row(j - 1) = segment.deriv[k - 1].row(j)*((double)j/segment.T);
+    }
+  }
+  duration_ = start;
+}
+
+
+
+//
+// Sample the trajectory
+//
+void MinSnapTrajectory::sample(double time, int *segment, TrajectoryPoint *point) const
+{
+  if(segments_.empty() || time <= 0.0 || time >= duration_)
+  {
+    point->position = (segments_.empty() || time <= 0.0) ? start_point_ : end_point_;
+    point->velocity.setZero();
+    point->acceleration.setZero();
+    point->jerk.setZero();
+    return;
+  }
+
+  //move the segment hint to the one holding time (forward is the normal case, but allow going back):
+  int i = std::max(0, std::min(*segment, (int)segments_.size() - 1));
+  while(i + 1 < (int)segments_.size() && time >= segments_[i + 1].start)
+    i++;
+  while(i > 0 && time < segments_[i].start)
+    i--;
+  *segment = i;
+
+  const Segment &seg = segments_[i];
+  double s = (time - seg.start)/seg.T;
+  point->position = horner(seg.deriv[0], 8, s);
+  point->velocity = horner(seg.deriv[1], 7, s);
+  point->acceleration = horner(seg.deriv[2], 6, s);
+  point->jerk = horner(seg.deriv[3], 5, s);
+}
+
+}
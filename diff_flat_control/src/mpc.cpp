@@ -0,0 +1,225 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file mpc.cpp
+ *  \author agent
+ *  \date October 2026
+ *
+*/
+
+#include <math.h>
+#include <ros/ros.h>
+#include <Eigen/Cholesky>
+#include <Eigen/Eigenvalues>
+#include "controller/mpc.h"
+
+namespace diff_flat_control
+{
+
+using namespace Eigen;
+
+
+//
+// Constructor: set up the condensed QP of each axis
+//
+MPCController::MPCController(const LQRWeights &weights, double max_horizontal, double min_down, double max_down,
+                             double max_yaw_rate, double deadline)
+{
+  deadline_ = deadline;
+  solve_start_ = 0.0;
+  last_solve_time_ = 0.0;
+  last_iterations_ = 0;
+  deadline_misses_ = 0;
+
+  //Double integrator with a zero order hold (the position/velocity part of the LQR model):
+  Matrix2d A;
+  Vector2d B;
+  A << 1.0, SAMPLE_TIME_, 0.0, 1.0;
+  B << 0.5*SAMPLE_TIME_*SAMPLE_TIME_, SAMPLE_TIME_;
+
+  //Same weights as the LQR design (see LQRSchedule::compute):
+  Matrix2d Q = Matrix2d::Zero();
+  Q(0,0) = 1.0/(weights.max_n*weights.max_n);
+  Q(1,1) = 1.0/(weights.max_ndot*weights.max_ndot);
+  setupAxis(A, B, Q, 1.0/(weights.max_angle*weights.max_angle), &axes_[0]);
+
+  Q(0,0) = 1.0/(weights.max_e*weights.max_e);
+  setupAxis(A, B, Q, 1.0/(weights.max_angle*weights.max_angle), &axes_[1]);
+
+  Q(0,0) = 1.0/weights.max_d*2.0; //as in the scripts
+  Q(1,1) = 1.0/(weights.max_ddot*weights.max_ddot);
+  setupAxis(A, B, Q, 1.0/(weights.max_thrust*weights.max_thrust), &axes_[2]);
+
+  //Yaw is a single integrator, the second state is unused:
+  A << 1.0, 0.0, 0.0, 0.0;
+  B << SAMPLE_TIME_, 0.0;
+  Q.setZero();
+  Q(0,0) = 1.0/(weights.max_psi*weights.max_psi);
+  setupAxis(A, B, Q, 1.0/(weights.max_angle*weights.max_angle), &axes_[3]);
+
+  axes_[0].lower = -max_horizontal;
+  axes_[0].upper = max_horizontal;
+  axes_[1].lower = -max_horizontal;
+  axes_[1].upper = max_horizontal;
+  axes_[2].lower = min_down;
+  axes_[2].upper = max_down;
+  axes_[3].lower = -max_yaw_rate;
+  axes_[3].upper = max_yaw_rate;
+
+  reset();
+}
+
+
+
+//
+// Compute the feedback inputs
+//
+bool MPCController::solve(const Matrix<double,7,1> &error, const Vector4d &feed_forward, Vector4d *control)
+{
+  solve_start_ = ros::WallTime::now().toSec();
+  last_iterations_ = 0;
+
+  //The state is actual - desired = -error:
+  bool solved = true;
+  for(int i = 0; i < 3 && solved; i++)
+  {
+    solved = solveAxis(Vector2d(-error(i,0), -error(i + 3,0)), feed_forward(i), &axes_[i]);
+  }
+  if(solved)
+    solved = solveAxis(Vector2d(-error(6,0), 0.0), feed_forward(3), &axes_[3]);
+
+  last_solve_time_ = ros::WallTime::now().toSec() - solve_start_;
+  if(!solved)
+  {
+    deadline_misses_++;
+    return false;
+  }
+
+  for(int i = 0; i < 4; i++)
+  {
+    (*control)(i) = axes_[i].U(0);
+  }
+  return true;
+}
+
+
+
+//
+// Drop the warm start
+//
+void MPCController::reset()
+{
+  for(int i = 0; i < 4; i++)
+  {
+    axes_[i].U.setZero();
+  }
+}
+
+
+
+//
+// Build the condensed QP of one axis
+//
+void MPCController::setupAxis(const Matrix2d &A, const Vector2d &B, const Matrix2d &Q, double R, Axis *axis)
+{
+  //Terminal cost from the Riccati equation (the cost-to-go of the LQR after the horizon):
+  MatrixXd K, P;
+  MatrixXd Rm = MatrixXd::Constant(1,1,R);
+  LQRSchedule::solveRiccati(A, B, Q, Rm, &K, &P);
+
+  //Stacked predictions X = [x1; ...; xN] = Phi*x0 + Gamma*U
+  const int N = HORIZON_;
+  MatrixXd Phi = MatrixXd::Zero(2*N,2);
+  MatrixXd Gamma = MatrixXd::Zero(2*N,N);
+  MatrixXd Qbar = MatrixXd::Zero(2*N,2*N);
+  Matrix2d A_k = A;
+  for(int k = 0; k < N; k++)
+  {
+    Phi.block<2,2>(2*k,0) = A_k;
+    A_k = A*A_k;
+
+    Vector2d AB = B;
+    for(int j = k; j >= 0; j--)
+    {
+      Gamma.block<2,1>(2*k,j) = AB; //x_(k+1) depends on u_j through A^(k-j)*B
+      AB = A*AB;
+    }
+
+    Qbar.block<2,2>(2*k,2*k) = (k < N - 1) ? MatrixXd(Q) : P;
+  }
+
+  MatrixXd H = Gamma.transpose()*Qbar*Gamma + MatrixXd::Identity(N,N)*R;
+  MatrixXd G = Gamma.transpose()*Qbar*Phi;
+
+  axis->H = H;
+  axis->G = G;
+  axis->unconstrained = -1.0*H.ldlt().solve(G);
+  SelfAdjointEigenSolver<MatrixXd> eigen(H, EigenvaluesOnly);
+  axis->step = 1.0/eigen.eigenvalues().maxCoeff();
+}
+
+
+
+//
+// Solve the QP of one axis
+//
+bool MPCController::solveAxis(const Vector2d &x0, double feed_forward, Axis *axis)
+{
+  //The limits are on the total input:
+  InputSequence lower = InputSequence::Constant(axis->lower - feed_forward);
+  InputSequence upper = InputSequence::Constant(axis->upper - feed_forward);
+
+  //Most of the time nothing is near a limit, and the unconstrained optimum is the answer:
+  InputSequence U = axis->unconstrained*x0;
+  if((U.array() >= lower.array()).all() && (U.array() <= upper.array()).all())
+  {
+    axis->U = U;
+    return true;
+  }
+
+  //Otherwise, projected gradient (FISTA, with restarts) starting from the last solution shifted by one step:
+  InputSequence gradient = axis->G*x0;
+  U.head(HORIZON_ - 1) = axis->U.tail(HORIZON_ - 1);
+  U(HORIZON_ - 1) = axis->U(HORIZON_ - 1);
+  U = U.cwiseMax(lower).cwiseMin(upper);
+
+  InputSequence Y = U, U_new;
+  double t = 1.0;
+  for(int i = 0; i < MAX_ITERATIONS_; i++)
+  {
+    U_new = (Y - axis->step*(axis->H*Y + gradient)).cwiseMax(lower).cwiseMin(upper);
+    double change = (U_new - U).cwiseAbs().maxCoeff();
+
+    if((Y - U_new).dot(U_new - U) > 0.0)
+    {
+      //the momentum is pointing uphill, restart it
+      t = 1.0;
+      Y = U_new;
+    }
+    else
+    {
+      double t_new = 0.5*(1.0 + sqrt(1.0 + 4.0*t*t));
+      Y = U_new + ((t - 1.0)/t_new)*(U_new - U);
+      t = t_new;
+    }
+    U = U_new;
+    last_iterations_++;
+
+    if(change < TOLERANCE_)
+      break;
+
+    if((i + 1) % DEADLINE_CHECK_ == 0 && ros::WallTime::now().toSec() - solve_start_ > deadline_)
+    {
+      axis->U = U;
+      return false;
+    }
+  }
+
+  axis->U = U;
+  return true;
+}
+
+}
@@ -0,0 +1,173 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*! \file mpc_benchmark.cpp
+  * \author agent
+  * \date October 2026
+  * \brief mpc_benchmark.cpp times the MPC solves (MPCController) in a simulated flight, to check that they fit in the
+  * control period on the onboard computer.
+  *
+  * Usage:
+  * \code
+  *   mpc_benchmark [--controls 20000] [--deadline 0.004] [--truth_weights] [--csv solves.csv]
+  * \endcode
+  *
+  * The vehicle is the model the MPC uses (with a random disturbance acceleration), flying to a new random setpoint
+  * every 2 seconds, a step big enough to put the inputs on their limits.  The count, mean, 50th, 90th, 99th percentile
+  * and the max of the solve time are printed in milliseconds, for all the solves and for the ones where a limit was
+  * active (the projected gradient ran), along with the deadline misses and the time of the LQR for comparison.
+  *
+  * With --csv, a line for every control is written: the solve time (ms), the iterations, and if it missed the deadline.
+*/
+
+#include <ros/ros.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include "controller/diff_flat.h"
+#include "timing_table.h"
+
+using namespace diff_flat_control;
+using kinect_vo::printTimes;
+using kinect_vo::printTimesHeader;
+
+
+/*!
+ *  \brief Uniform random number in [min, max]
+*/
+static double uniform(double min, double max)
+{
+  return min + (max - min)*rand()/(double)RAND_MAX;
+}
+
+
+/*!
+ *  \brief Thrust effectiveness of the nominal model (the table is only used for the LQR timing)
+*/
+static double nominalEffectiveness(double)
+{
+  return 1.0;
+}
+
+
+/*!
+ *  \brief Simulates the flight and prints the MPC solve times.
+*/
+int main(int argc, char **argv)
+{
+  int controls = 20000;
+  double deadline = 0.004;
+  bool truth_weights = false;
+  std::string csv_file;
+
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if(arg == "--controls" && i + 1 < argc)
+      controls = atoi(argv[++i]);
+    else if(arg == "--deadline" && i + 1 < argc)
+      deadline = atof(argv[++i]);
+    else if(arg == "--truth_weights")
+      truth_weights = true;
+    else if(arg == "--csv" && i + 1 < argc)
+      csv_file = argv[++i];
+    else
+    {
+      std::cout << "Usage: mpc_benchmark [--controls 20000] [--deadline 0.004] [--truth_weights] [--csv solves.csv]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  LQRWeights weights = truth_weights ? LQRWeights::heavy() : LQRWeights::relativeHeavy();
+  MPCController *mpc = DiffFlat::createMPC(weights, deadline);
+
+  //The LQR gain for the same model (the nominal point of the gain table), just for the timing comparison:
+  LQRSchedule schedule;
+  LQRSchedule::GainMatrix K;
+  LQRSchedule::IntegralGainMatrix KI;
+  schedule.compute(weights, 0.0, &nominalEffectiveness);
+  schedule.gains(0.0, 150.0, &K, &KI);
+
+  const double dt = 0.05, gravity = 9.80665;
+  Eigen::Matrix<double,7,1> state, desired, error;
+  state.setZero();
+  desired.setZero();
+  Eigen::Vector4d feed_forward(0.0, 0.0, -1.0*gravity, 0.0), control, lqr;
+
+  std::vector<double> all_times, constrained_times, lqr_times;
+  std::ofstream csv;
+  if(!csv_file.empty())
+  {
+    csv.open(csv_file.c_str());
+    if(!csv.is_open())
+    {
+      std::cout << "Unable to open " << csv_file << std::endl;
+      return 1;
+    }
+    csv << "solve_ms,iterations,missed" << std::endl;
+  }
+
+  srand(1);
+  int misses = 0;
+  for(int i = 0; i < controls; i++)
+  {
+    //a new setpoint every 2 s:
+    if(i % 40 == 0)
+    {
+      desired(0) = uniform(-2.0, 2.0);
+      desired(1) = uniform(-2.0, 2.0);
+      desired(2) = uniform(-1.5, -0.5);
+      desired(6) = uniform(-3.0, 3.0);
+    }
+    error = desired - state;
+    while(error(6) > M_PI)
+      error(6) -= 2.0*M_PI;
+    while(error(6) < -M_PI)
+      error(6) += 2.0*M_PI;
+
+    ros::WallTime lqr_start = ros::WallTime::now();
+    lqr = K*error;
+    lqr_times.push_back((ros::WallTime::now() - lqr_start).toSec()*1000.0);
+
+    bool solved = mpc->solve(error, feed_forward, &control);
+    double solve_ms = mpc->lastSolveTime()*1000.0;
+    all_times.push_back(solve_ms);
+    if(mpc->lastIterations() > 0)
+      constrained_times.push_back(solve_ms);
+    if(!solved)
+    {
+      misses++;
+      control = lqr;
+    }
+    if(csv.is_open())
+      csv << solve_ms << "," << mpc->lastIterations() << "," << (solved ? 0 : 1) << std::endl;
+
+    //the vehicle (the model the MPC uses, plus a disturbance):
+    for(int j = 0; j < 3; j++)
+    {
+      double accel = control(j) + uniform(-0.3, 0.3);
+      state(j) += dt*state(j + 3) + 0.5*dt*dt*accel;
+      state(j + 3) += dt*accel;
+    }
+    state(6) += dt*control(3);
+  }
+
+  std::cout << "Solve times (ms) for " << MPCController::HORIZON_ << " step horizon, deadline " << deadline*1000.0
+            << " ms" << std::endl;
+  printTimesHeader("", 16);
+  std::cout << std::fixed << std::setprecision(4);
+  printTimes("mpc", all_times, 16);
+  printTimes("mpc_limited", constrained_times, 16);
+  printTimes("lqr", lqr_times, 16);
+  std::cout << "Deadline misses: " << misses << " of " << controls << std::endl;
+
+  delete mpc;
+  return 0;
+}
@@ -0,0 +1,57 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*! \file nodelet.cpp
+  * \brief A nodelet version of the diff_flat_control node.  It runs the ROSServer inside a nodelet manager, so the
+  * estimated states come in (and the commands go out) without being serialized or copied.
+  *
+*/
+
+#include <ros/ros.h>
+#include <boost/shared_ptr.hpp>
+#include "pluginlib/class_list_macros.h"
+#include "nodelet/nodelet.h"
+#include "controller/ros_server.h"
+
+
+namespace diff_flat_control
+{
+
+/*!
+ *  \class ControlNodelet nodelet.cpp "src/nodelet.cpp"
+ *  \brief Nodelet wrapper for ROSServer.  The topics are in the "control" namespace like the standalone node.
+ *
+ *  The node limits the control rate with its spin rate (25 Hz), which a nodelet cannot do, so set the private
+ *  parameter "min_control_period" (e.g. 0.04) when this is loaded.
+*/
+class ControlNodelet : public nodelet::Nodelet
+{
+public:
+  //Constructor
+  ControlNodelet()
+  {
+  }
+
+private:
+
+  virtual void onInit()
+  {
+    ros::NodeHandle nh(getNodeHandle(), "control");
+    ros::NodeHandle& private_nh = getPrivateNodeHandle();
+
+    double min_period;
+    private_nh.param<double>("min_control_period", min_period, 0.0);
+    if(min_period <= 0.0)
+      NODELET_WARN("min_control_period is not set, control will be computed for every estimate received");
+
+    server_.reset(new ROSServer(nh, private_nh));
+  }
+
+  boost::shared_ptr<ROSServer> server_; //!< the control's ROS interface
+};
+
+//This code is essential for making the nodelet
+PLUGINLIB_DECLARE_CLASS(diff_flat_control, ControlNodelet, diff_flat_control::ControlNodelet, nodelet::Nodelet);
+}
@@ -12,15 +12,19 @@
 */
 
 #include "controller/ros_server.h"
+
+namespace diff_flat_control
+{
+
 using namespace Eigen;
 
 
-pthread_mutex_t mutex_ = PTHREAD_MUTEX_INITIALIZER; //!< mutex just in case for the waypoint_list_ vector
+pthread_mutex_t control_mutex_ = PTHREAD_MUTEX_INITIALIZER; //!< mutex just in case for the waypoint_list_ vector
 
 //
 // Constructor
 //
-ROSServer::ROSServer(ros::NodeHandle &nh)
+ROSServer::ROSServer(ros::NodeHandle &nh, ros::NodeHandle &private_nh)
 {
 //  Vector3d one(1.0,-1.0,-1.0);
 //  Vector3d two(1.5,0.0,-1.0);
@@ -42,45 +46,91 @@ ROSServer::ROSServer(ros::NodeHandle &nh)
    If false, control will be computed based on estimates. */
   bool allow_i_control;
   std::string command_topic,yaw_service_topic;
+  std::string latency_trace_topic;
+  bool latency_trace;
+  double trajectory_max_speed, trajectory_max_accel, trajectory_jerk_lead;
+  std::string gain_table_path;
+  bool use_mpc;
+  double mpc_deadline;
 
   /// retrieve variables from the parameter server:
-  ros::param::param<std::string>("~ekf_topic", ekf_topic_, "/relative/states");
-  ros::param::param<std::string>("~mocap_topic", truth_topic_, "/evart/heavy_ros/base");
-  ros::param::param<bool>("~truth_control", truth_control, false);
-  ros::param::param<bool>("~allow_integral_control",allow_i_control,true);
-  ros::param::param<std::string>("~path_topic", path_topic, "/hex_plan/navfn_planner/plan");
-  ros::param::param<std::string>("~gain_file_path", gain_file_location, "../Matlab/RelativeHeavyGainMatrices.txt");
-  ros::param::param<std::string>("~command_topic", command_topic, "/mikoCmd2");
-  ros::param::param<std::string>("~hex_debug_topic", hex_topic, "/mikoImu");
-  ros::param::param<double>("~desired_global_z",desired_global_z_, -1.0);
-  ros::param::param<std::string>("~edge_topic", edge_topic, "/relative/cur_edge/pose");
-  ros::param::param<std::string>("~goal_topic", goal_topic, "/hex_goal");
-  ros::param::param<double>("~seconds_to_hover",sec_to_hover_,10.0);
-  ros::param::param<std::string>("~node_topic", node_topic, "/relative/cur_node/global");
-  ros::param::param<std::string>("~yaw_service_topic",yaw_service_topic, "/request_yaw");
+  private_nh.param<std::string>("ekf_topic", ekf_topic_, "/relative/states");
+  private_nh.param<std::string>("mocap_topic", truth_topic_, "/evart/heavy_ros/base");
+  private_nh.param<bool>("truth_control", truth_control, false);
+  private_nh.param<bool>("allow_integral_control",allow_i_control,true);
+  private_nh.param<std::string>("path_topic", path_topic, "/hex_plan/navfn_planner/plan");
+  private_nh.param<std::string>("gain_file_path", gain_file_location, "../Matlab/RelativeHeavyGainMatrices.txt");
+  private_nh.param<std::string>("command_topic", command_topic, "/mikoCmd2");
+  private_nh.param<std::string>("hex_debug_topic", hex_topic, "/mikoImu");
+  private_nh.param<double>("desired_global_z",desired_global_z_, -1.0);
+  private_nh.param<std::string>("edge_topic", edge_topic, "/relative/cur_edge/pose");
+  private_nh.param<std::string>("goal_topic", goal_topic, "/hex_goal");
+  private_nh.param<double>("seconds_to_hover",sec_to_hover_,10.0);
+  private_nh.param<std::string>("node_topic", node_topic, "/relative/cur_node/global");
+  private_nh.param<std::string>("yaw_service_topic",yaw_service_topic, "/request_yaw");
+  private_nh.param<double>("min_control_period",min_control_period_, 0.0);
+  private_nh.param<bool>("latency_trace",latency_trace, true);
+  private_nh.param<std::string>("latency_trace_topic",latency_trace_topic, "/latency_trace");
+  private_nh.param<std::string>("gain_table_path", gain_table_path, "");
+  private_nh.param<bool>("use_mpc",use_mpc, false);
+  private_nh.param<double>("mpc_deadline",mpc_deadline, 0.004);
+  private_nh.param<bool>("use_trajectory",use_trajectory_, false);
+  private_nh.param<double>("trajectory_max_speed",trajectory_max_speed, 1.0);
+  private_nh.param<double>("trajectory_max_accel",trajectory_max_accel, 1.0);
+  private_nh.param<double>("trajectory_jerk_lead",trajectory_jerk_lead, 0.1);
 
   /*!
     \note Below are the private parameters that are available to change through the param server:
      \code{.cpp}
-  ros::param::param<std::string>("~ekf_topic", ekf_topic_, "/rel_estimator/rel_state"); //!< topic for bringing in estimated states
-  ros::param::param<std::string>("~mocap_topic", truth_topic_, "/evart/heavy_ros/base"); //!< topic for bringing in truth
-  ros::param::param<bool>("~truth_control", truth_control, "false");
-  ros::param::param<bool>("~allow_integral_control",allow_i_control,false); //!< allow integral control
-  ros::param::param<std::string>("~path_topic", path_topic, "/hex_plan/navfn_planner/plan"); //!< topic that the path plan is broadcast to
-  ros::param::param<std::string>("~gain_file_path", gain_file_location, "../Matlab/HeavyGainMatrices.txt"); //!< gain file produced using Matlab
-  ros::param::param<std::string>("~command_topic", command_topic, "/mikoCmd"); //!< topic on which the commands are published
-  ros::param::param<std::string>("~hex_debug_topic", hex_topic, "/mikoImu"); //!< topic for mikrokopter debug out stuff (for batt. volt.)
-  ros::param::param<double>("~desired_global_z",desired_global_z_, -1.0); //!< the global z value to add to the waypoints
-  ros::param::param<std::string>("~edge_topic", edge_topic, "/relative/cur_edge/pose"); //!< the topic the relative edges are published to.
-  ros::param::param<std::string>("~goal_topic", goal_topic, "/hex_goal"); //!< the high level nav goal sent by high level planner
-  ros::param::param<double>("~seconds_to_hover",sec_to_hover_,10.0); //!< the # of secs to hover in place before following any paths
-  ros::param::param<std::string>("~node_topic", node_topic, "/relative/cur_node/global"); //!< get the global node position
-  ros::param::param<std::string>("~yaw_service_topic",yaw_service_topic, "/request_yaw"); //!< topic for yawing in place
+  private_nh.param<std::string>("ekf_topic", ekf_topic_, "/rel_estimator/rel_state"); //!< topic for bringing in estimated states
+  private_nh.param<std::string>("mocap_topic", truth_topic_, "/evart/heavy_ros/base"); //!< topic for bringing in truth
+  private_nh.param<bool>("truth_control", truth_control, "false");
+  private_nh.param<bool>("allow_integral_control",allow_i_control,false); //!< allow integral control
+  private_nh.param<std::string>("path_topic", path_topic, "/hex_plan/navfn_planner/plan"); //!< topic that the path plan is broadcast to
+  private_nh.param<std::string>("gain_file_path", gain_file_location, "../Matlab/HeavyGainMatrices.txt"); //!< gain file produced using Matlab
+  private_nh.param<std::string>("command_topic", command_topic, "/mikoCmd"); //!< topic on which the commands are published
+  private_nh.param<std::string>("hex_debug_topic", hex_topic, "/mikoImu"); //!< topic for mikrokopter debug out stuff (for batt. volt.)
+  private_nh.param<double>("desired_global_z",desired_global_z_, -1.0); //!< the global z value to add to the waypoints
+  private_nh.param<std::string>("edge_topic", edge_topic, "/relative/cur_edge/pose"); //!< the topic the relative edges are published to.
+  private_nh.param<std::string>("goal_topic", goal_topic, "/hex_goal"); //!< the high level nav goal sent by high level planner
+  private_nh.param<double>("seconds_to_hover",sec_to_hover_,10.0); //!< the # of secs to hover in place before following any paths
+  private_nh.param<std::string>("node_topic", node_topic, "/relative/cur_node/global"); //!< get the global node position
+  private_nh.param<std::string>("yaw_service_topic",yaw_service_topic, "/request_yaw"); //!< topic for yawing in place
+  private_nh.param<double>("min_control_period",min_control_period_, 0.0); //!< min time (s) between controls, set when run as a nodelet
+  private_nh.param<bool>("latency_trace",latency_trace, true); //!< publish the control stages of the VO frames' latency trace
+  private_nh.param<std::string>("latency_trace_topic",latency_trace_topic, "/latency_trace"); //!< topic for the stages (same in every node)
+  private_nh.param<std::string>("gain_table_path", gain_table_path, ""); //!< LQR gain table over speed and voltage ("" = gain file only)
+  private_nh.param<bool>("use_mpc",use_mpc, false); //!< compute the feedback with MPC (falls back to the LQR on a deadline miss)
+  private_nh.param<double>("mpc_deadline",mpc_deadline, 0.004); //!< (s) time an MPC solve may take
+  private_nh.param<bool>("use_trajectory",use_trajectory_, false); //!< follow min-snap trajectories through the planned paths
+  private_nh.param<double>("trajectory_max_speed",trajectory_max_speed, 1.0); //!< (m/s) speed limit for the trajectories
+  private_nh.param<double>("trajectory_max_accel",trajectory_max_accel, 1.0); //!< (m/s^2) acceleration limit for the trajectories
+  private_nh.param<double>("trajectory_jerk_lead",trajectory_jerk_lead, 0.1); //!< (s) jerk lead on the trajectory feed forward
      \endcode
   */
 
   //setup the controller:
   controller_ = new DiffFlat(allow_i_control, gain_file_location, NULL, &desired_global_z_);
+  controller_->setJerkLead(trajectory_jerk_lead);
+  //the gain table and the MPC are designed with the same weights as the gain file that would be used (see the
+  //launch files):
+  LQRWeights weights = truth_control ? LQRWeights::heavy() : LQRWeights::relativeHeavy();
+  if(!gain_table_path.empty())
+  {
+    controller_->useGainTable(gain_table_path, weights);
+  }
+  if(use_mpc)
+  {
+    controller_->useMPC(weights, mpc_deadline);
+  }
+
+  trajectory_generator_ = NULL;
+  trajectory_requested_ = false;
+  if(use_trajectory_)
+  {
+    trajectory_generator_ = new TrajectoryGenerator(trajectory_max_speed, trajectory_max_accel);
+    ROS_WARN("Control will follow min-snap trajectories through the planned paths!");
+  }
 
   /// Only register one callback - either truth or estimates (this will help avoid any problems of having truth available
   /// on the network when we are trying to control based on the estimates)
@@ -103,6 +153,9 @@ ROSServer::ROSServer(ros::NodeHandle &nh)
   //publisher:
   command_publisher_ = nh.advertise<mikro_serial::mikoCmd>(command_topic, 3);
   dilluted_path_pub_ = nh.advertise<nav_msgs::Path>("dilluted_path_2",2);
+  last_trace_id_ = 0;
+  if(latency_trace)
+    latency_trace_.advertise(nh, latency_trace_topic);
   //subscribers:
   plan_subscriber_ = nh.subscribe(path_topic, 1, &ROSServer::pathCallback,this); 
   goal_subscriber_ = nh.subscribe(goal_topic,1,&ROSServer::goalLocationCallback,this);
@@ -117,7 +170,7 @@ ROSServer::ROSServer(ros::NodeHandle &nh)
   new_yaw_goal_ = false;
   yaw_goal_ = 0.d;
 
-  batt_voltage_ = 14.8;
+  batt_voltage_ = 148; //0.1 V, like the hex reports it
   node_global_z_ = 0;
 
 //  //quick log file:
@@ -136,7 +189,7 @@ ROSServer::~ROSServer()
 {
 //  log_file_.close();
 
-  controller_->~DiffFlat();
+  delete trajectory_generator_;
   delete controller_;
 }
 
@@ -148,6 +201,15 @@ void ROSServer::ekfCallback(const rel_MEKF::relative_state &ekf_message)
 {
   ROS_WARN_ONCE("ESTIMATES RECEIVED FOR IN-THE-LOOP CONTROL!");
   ros::Time timestamp = ros::Time::now();
+
+  /// In the nodelet nothing limits how fast the estimates come in (the standalone node limits it with its spin rate),
+  /// so skip the control if it was computed too recently - the hex cannot process all the commands
+  if(min_control_period_ > 0.0 && (timestamp - old_time_).toSec() < min_control_period_)
+  {
+    old_state_ = ekf_message;
+    return;
+  }
+
   Vector3d current,old;
   current << ekf_message.translation.x,ekf_message.translation.y,ekf_message.translation.z;
   old << old_state_.translation.x,old_state_.translation.y,old_state_.translation.z;
@@ -163,7 +225,8 @@ void ROSServer::ekfCallback(const rel_MEKF::relative_state &ekf_message)
     ros::Duration elapsed_time;
     Quaterniond quat(ekf_message.rotation.w, ekf_message.rotation.x,
                      ekf_message.rotation.y, ekf_message.rotation.z);
-    mikro_serial::mikoCmd cmd_message;
+    mikro_serial::mikoCmdPtr cmd_ptr(new mikro_serial::mikoCmd); //shared pointer, no copy to an in-process subscriber
+    mikro_serial::mikoCmd &cmd_message = *cmd_ptr;
 
     ros::Duration dt;
     dt = timestamp - old_time_;
@@ -186,21 +249,12 @@ void ROSServer::ekfCallback(const rel_MEKF::relative_state &ekf_message)
     position << ekf_message.translation.x, ekf_message.translation.y, ekf_message.translation.z;
     vel_body << ekf_message.velocity.x, ekf_message.velocity.y, ekf_message.velocity.z;
 
-    pthread_mutex_lock(&mutex_);
+    pthread_mutex_lock(&control_mutex_);
       //hover for some # secs before trying to follow waypoints and when we've reached the goal and need a new one
       if(!goal_achieved_ && (flying_flag_ && (elapsed_time.toSec() > sec_to_hover_)))
       {
-        if(new_waypoint_list_)
-        {
-          commands = controller_->waypointPath(position, quat, vel_body, timestamp, dt, &goal_achieved_, &waypoint_list_,&batt_voltage_);
-          new_waypoint_list_ = false;
-        }
-        else
-        {
-          commands = controller_->waypointPath(position, quat, vel_body, timestamp, dt,&goal_achieved_,NULL,&batt_voltage_);
-        }
+        commands = followPath(position, quat, vel_body, timestamp, dt);
         //commands = controller_->circlePath(position, quat, vel_body, timestamp, dt);
-        ROS_WARN_ONCE("Waypoint Control Enabled!!");
       }
       else
       {
@@ -218,14 +272,23 @@ void ROSServer::ekfCallback(const rel_MEKF::relative_state &ekf_message)
           commands = controller_->hoverPath(position, quat, vel_body, timestamp, dt,NULL,NULL,&batt_voltage_);
         }
       }
-    pthread_mutex_unlock(&mutex_);
+    pthread_mutex_unlock(&control_mutex_);
 
     cmd_message.pitch = commands(0);
     cmd_message.roll = commands(1);
     cmd_message.throttle = commands(2);
     cmd_message.yaw = commands(3);
     cmd_message.header.stamp = timestamp;
-    command_publisher_.publish(cmd_message);
+    command_publisher_.publish(cmd_ptr);
+
+    //the first command computed with a new VO frame in the state ends that frame's latency trace
+    if(ekf_message.trace_id != 0 && ekf_message.trace_id != last_trace_id_)
+    {
+      latency_trace_.stamp(ekf_message.trace_id, ekf_message.trace_stamp, kinect_vo::latency_stage::CONTROL_STARTED,
+                           timestamp);
+      latency_trace_.stamp(ekf_message.trace_id, ekf_message.trace_stamp, kinect_vo::latency_stage::COMMAND_PUBLISHED);
+      last_trace_id_ = ekf_message.trace_id;
+    }
 
 //    ros::Time out_time = ros::Time::now();
 //    log_file_out_.precision(20);
@@ -294,21 +357,12 @@ void ROSServer::truthCallback(const evart_bridge::transform_plus &truth)
   ros::Duration elapsed_time;
   elapsed_time = ros::Time::now() - flying_;
 
-  pthread_mutex_lock(&mutex_);
+  pthread_mutex_lock(&control_mutex_);
     //hover for # secs before trying to follow some waypoints and when we've reached the goal and need a new one
     if(!goal_achieved_ && (flying_flag_ && (elapsed_time.toSec() > sec_to_hover_)))
     {
-      if(new_waypoint_list_)
-      {
-        commands = controller_->waypointPath(position, quat, vel_body, timestamp, dt, &goal_achieved_, &waypoint_list_,&batt_voltage_);
-        new_waypoint_list_ = false;
-      }
-      else
-      {
-        commands = controller_->waypointPath(position, quat, vel_body, timestamp, dt, &goal_achieved_,NULL,&batt_voltage_);
-      }
+      commands = followPath(position, quat, vel_body, timestamp, dt);
       //commands = controller_->circlePath(position, quat, vel_body, timestamp, dt);
-      ROS_WARN_ONCE("Waypoint Control Enabled!!");
     }
     else
     {
@@ -325,16 +379,17 @@ void ROSServer::truthCallback(const evart_bridge::transform_plus &truth)
         commands = controller_->hoverPath(position, quat, vel_body, timestamp, dt,NULL,NULL,&batt_voltage_);
       }
     }
-  pthread_mutex_unlock(&mutex_);
+  pthread_mutex_unlock(&control_mutex_);
 
-  mikro_serial::mikoCmd cmd_message;
+  mikro_serial::mikoCmdPtr cmd_ptr(new mikro_serial::mikoCmd);
+  mikro_serial::mikoCmd &cmd_message = *cmd_ptr;
   cmd_message.pitch = commands(0);
   cmd_message.roll = commands(1);
   cmd_message.throttle = commands(2);
   cmd_message.yaw = commands(3);
   cmd_message.header.stamp = timestamp;
 
-  command_publisher_.publish(cmd_message);
+  command_publisher_.publish(cmd_ptr);
 //  ros::Time out_time = ros::Time::now();
 //  log_file_out_.precision(20);
 //  log_file_out_ << out_time.toSec() << std::endl;
@@ -382,7 +437,15 @@ void ROSServer::pathCallback(const nav_msgs::Path &path)
   //END DEBUG
 
   //Swap it to the class variable for use in the other callbacks:
-  pthread_mutex_lock(&mutex_);
+  pthread_mutex_lock(&control_mutex_);
+    /// The planner re-plans the same goal over and over.  The waypoints can just be swapped in, but each trajectory
+    /// starts and ends at rest, so following a re-plan would stop the vehicle: only new goals get a new trajectory
+    if(use_trajectory_ && (new_goal_received_ || !trajectory_requested_))
+    {
+      trajectory_generator_->request(waypt_list);
+      trajectory_requested_ = true;
+    }
+
     waypoint_list_.swap(waypt_list);
     new_waypoint_list_ = true;
 
@@ -394,7 +457,44 @@ void ROSServer::pathCallback(const nav_msgs::Path &path)
       new_goal_received_ = false;
       ROS_INFO("CONTROL: New goal and waypoint list received - following new waypoints!");
     }
-  pthread_mutex_unlock(&mutex_);
+  pthread_mutex_unlock(&control_mutex_);
+}
+
+
+//
+// Follow the current path (trajectory or waypoints)
+//
+Vector4d ROSServer::followPath(Vector3d &position, Quaterniond &quat, Vector3d &vel_body, ros::Time &timestamp,
+                               ros::Duration &dt)
+{
+  Vector4d commands;
+
+  if(use_trajectory_)
+  {
+    /// \note The trajectory is in the node frame the path was received in, a node change during the solve (~ms) is
+    /// not accounted for.
+    boost::shared_ptr<const MinSnapTrajectory> trajectory;
+    if(trajectory_generator_->takeResult(&trajectory))
+      controller_->setTrajectory(trajectory);
+
+    commands = controller_->trajectoryPath(position, quat, vel_body, timestamp, dt, &goal_achieved_, &batt_voltage_);
+    ROS_WARN_ONCE("Trajectory Control Enabled!!");
+  }
+  else
+  {
+    if(new_waypoint_list_)
+    {
+      commands = controller_->waypointPath(position, quat, vel_body, timestamp, dt, &goal_achieved_, &waypoint_list_,&batt_voltage_);
+      new_waypoint_list_ = false;
+    }
+    else
+    {
+      commands = controller_->waypointPath(position, quat, vel_body, timestamp, dt,&goal_achieved_,NULL,&batt_voltage_);
+    }
+    ROS_WARN_ONCE("Waypoint Control Enabled!!");
+  }
+
+  return commands;
 }
 
 
@@ -419,3 +519,5 @@ void ROSServer::edgeCallback(const rel_MEKF::edge &new_edge)
   }
 }
 
+}
+
@@ -0,0 +1,119 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file trajectory_generator.cpp
+ *  \author agent
+ *  \date October 2026
+ *
+*/
+
+#include <ros/ros.h>
+#include "controller/trajectory_generator.h"
+
+namespace diff_flat_control
+{
+
+//
+// Constructor: start the thread
+//
+TrajectoryGenerator::TrajectoryGenerator(double max_speed, double max_accel)
+  : max_speed_(max_speed), max_accel_(max_accel), request_id_(0), solving_id_(0), pending_(false), stop_(false),
+    new_result_(false)
+{
+  thread_ = boost::thread(&TrajectoryGenerator::run, this);
+}
+
+
+
+//
+// Destructor: stop the thread
+//
+TrajectoryGenerator::~TrajectoryGenerator()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_one();
+  thread_.join();
+}
+
+
+
+//
+// Request a new trajectory
+//
+void TrajectoryGenerator::request(const MinSnapTrajectory::WaypointList &waypoints)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    waypoints_ = waypoints;
+    request_id_++;
+    pending_ = true;
+  }
+  condition_.notify_one();
+}
+
+
+
+//
+// Take the newest result
+//
+bool TrajectoryGenerator::takeResult(boost::shared_ptr<const MinSnapTrajectory> *trajectory)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if(!new_result_)
+    return false;
+  *trajectory = result_;
+  new_result_ = false;
+  return true;
+}
+
+
+
+//
+// The solver thread
+//
+void TrajectoryGenerator::run()
+{
+  MinSnapTrajectory::WaypointList waypoints;
+  while(true)
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      while(!pending_ && !stop_)
+        condition_.wait(lock);
+      if(stop_)
+        return;
+      waypoints.swap(waypoints_);
+      solving_id_ = request_id_;
+      pending_ = false;
+    }
+
+    ros::WallTime start = ros::WallTime::now();
+    boost::shared_ptr<MinSnapTrajectory> trajectory(new MinSnapTrajectory(waypoints, max_speed_, max_accel_));
+    double solve_time = (ros::WallTime::now() - start).toSec();
+
+    boost::mutex::scoped_lock lock(mutex_);
+    if(solving_id_ != request_id_)
+      continue; //a newer request came in while solving, that one is what matters
+
+    if(trajectory->valid())
+    {
+      ROS_INFO("CONTROL: Min-snap trajectory through %d waypoints: %.1f s long, solved in %.1f ms",
+               trajectory->segments() + 1, trajectory->duration(), solve_time*1000.0);
+      result_ = trajectory;
+    }
+    else
+    {
+      ROS_WARN("CONTROL: Unable to compute a trajectory through the %d waypoints!", (int)waypoints.size());
+      result_.reset();
+    }
+    new_result_ = true;
+  }
+}
+
+}
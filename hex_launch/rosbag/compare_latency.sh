@@ -0,0 +1,18 @@
+#!/bin/bash
+# Compares the camera to motor command latency of a run with the nodes (estimates_in_loop.launch) and a run with the
+# nodelets (estimates_in_loop_nodelet.launch).  Both launch files record /latency_trace with estimator_record.sh.
+# Usage: compare_latency.sh <node run bag(s)> -- <nodelet run bag(s)>
+NODE_BAGS=()
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do NODE_BAGS+=("$1"); shift; done
+shift
+NODELET_BAGS=("$@")
+if [ ${#NODE_BAGS[@]} -eq 0 ] || [ ${#NODELET_BAGS[@]} -eq 0 ]; then
+  echo "Usage: $0 <node run bag(s)> -- <nodelet run bag(s)>"
+  exit 1
+fi
+
+echo "=== nodes (estimates_in_loop.launch) ==="
+rosrun kinect_vo latency_collector "${NODE_BAGS[@]}" || exit 1
+echo
+echo "=== nodelets (estimates_in_loop_nodelet.launch) ==="
+rosrun kinect_vo latency_collector "${NODELET_BAGS[@]}"
@@ -1,3 +1,3 @@
 #!/bin/bash
-rosbag record /imu/data /evart/heavy_ros/base /kinect_visual_odometry/vo_transformation /mikoCmd /mikoImu /alt_msgs /relative/global_pose relative/states /relative/cur_edge/pose /relative/cur_node/global /k_scan /scan /hex_goal /hex_plan/navfn_planner/plan /tf /hex_plan/cost_map/obstacles /hex_plan/cost_map/inflated_obstacles /control/dilluted_path /keyframe/rgb_image /keyframe/depth_image /downsampled_cloud --size=1024 --split -b 2200
+rosbag record /imu/data /evart/heavy_ros/base /kinect_visual_odometry/vo_transformation /mikoCmd /mikoImu /alt_msgs /relative/global_pose relative/states /relative/cur_edge/pose /relative/cur_node/global /k_scan /scan /hex_goal /hex_plan/navfn_planner/plan /tf /hex_plan/cost_map/obstacles /hex_plan/cost_map/inflated_obstacles /control/dilluted_path /keyframe/rgb_image /keyframe/depth_image /downsampled_cloud /latency_trace --size=1024 --split -b 2200
 
@@ -25,6 +25,7 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include "rel_MEKF/edge.h"
+#include "hex_planner/incremental_planner.h"
 
 
 
@@ -34,11 +35,18 @@
  *  avoider for a hexacopter UAV.  Currently this planning is done in a rolling window of the global frame, but
  *  it needs to eventually be brought over to a relative planner using the nodes/keyframes used by the rel_MEKF package.
  *
+ *  By default the plans are made by the IncrementalPlanner, which repairs its last search for each event (a new goal,
+ *  an edge that moves the goal into a new node frame, or the timer in main) rather than planning the whole costmap
+ *  again.  The navfn planner is still used to publish the plans, and makes them when ~incremental_planning is false.
+ *  The time of every plan is reported with its event.
 */
 class HexPlanner
 {
 public:
 
+    /// \brief The events that call for a new plan (reported with the plan time)
+    enum PlanEvent {TIMER_EVENT, GOAL_EVENT, EDGE_EVENT};
+
     /*!
      *  \brief The constructor of the class.  Simply provide it a nodehandle and a costmap2DROS pointer
      *  \param nh The ROS nodehandle
@@ -56,8 +64,9 @@ public:
     /*!
      *  \brief This function is called by to update the plan.
      *  It publishes the plan when sucessful
+     *  \param event is what called for the plan, it is reported with the time the plan took
     */
-    bool updatePlan();
+    bool updatePlan(PlanEvent event = TIMER_EVENT);
 
 
     /// \brief Return the last timestamp a plan was sucessful
@@ -91,6 +100,9 @@ private:
 
     costmap_2d::Costmap2DROS *costmap_; //!< a pointer to 2D costmap using the ROS wrapper.
     navfn::NavfnROS planner_; //!< the navfn ros wrapper planner
+    bool incremental_; //!< flag for planning with incremental_planner_ instead of planner_
+    IncrementalPlanner incremental_planner_; //!< the planner that repairs its last plan
+    costmap_2d::Costmap2D costmap_copy_; //!< the copy of the costmap the incremental planner plans on
     geometry_msgs::PoseStamped goal_location_; //!< current goal location (in global coordinates)!
     bool initial_goal_location_recieved_; //!< useful flag for not trying to plan a ton right at the first
     double max_path_length_; //!< set the max path length
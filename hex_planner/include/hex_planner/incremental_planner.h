@@ -0,0 +1,210 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file incremental_planner.h
+ *  \author agent
+ *  \date October 2026
+ *  \brief This file contains an incremental (D* Lite) planner over the costmap_2d grid, that repairs its last search
+ *  instead of planning the whole map again for each event.
+*/
+
+#ifndef INCREMENTAL_PLANNER_H
+#define INCREMENTAL_PLANNER_H
+
+
+#include <costmap_2d/costmap_2d.h>
+#include <algorithm>
+#include <cstdlib>
+#include <queue>
+#include <vector>
+#include <utility>
+
+
+
+/*!
+ *  \class IncrementalPlanner incremental_planner.h "include/hex_planner/incremental_planner.h"
+ *  \brief This class plans on the 8-connected grid of a costmap_2d with D* Lite (Koenig and Likhachev).  The search
+ *  is rooted at the goal, so the cost to the goal of every cell it expanded stays valid as the robot moves, and each
+ *  plan only repairs the cells whose costs changed since the last one.
+ *
+ *  Each plan compares the costmap with the copy from the last plan and updates the cells that changed, so the work
+ *  scales with the change instead of with the map.  The last search is kept across the three kinds of events of the
+ *  HexPlanner:
+ *    - the robot moves (and the rolling window with it): the search is shifted by the whole cells the origin moved,
+ *      the cells that came into the window are new and those that left are dropped,
+ *    - the same goal is expressed in a new frame (goalFrameShifted(), when a new node is declared): the search is
+ *      shifted so the goal keeps its cell, and the costs that moved relative to it are updated like any other change,
+ *    - the costs change (obstacles are seen or cleared): only those cells are updated.
+ *  A new goal starts a new search (unless it is in the same cell).
+ *
+ *  The costs follow navfn: a cell costs COST_NEUTRAL + COST_FACTOR times its costmap cost (times the step length), and
+ *  inscribed or lethal cells can't be entered (the start cell can always be left).  The unknown cells are the most
+ *  expensive free cells when they are allowed, otherwise they are obstacles.  If the goal is in an obstacle, the free
+ *  cell nearest to it within the tolerance is planned to instead.
+*/
+class IncrementalPlanner
+{
+public:
+
+    /*!
+     *  \struct Statistics
+     *  \brief The work of the last plan (reported with its time by the HexPlanner)
+    */
+    struct Statistics
+    {
+      bool new_search; //!< true when the last search couldn't be reused
+      int changed_cells; //!< the cells whose cost changed (or that are new to the search)
+      int expanded_cells; //!< the cells taken from the open list
+    };
+
+    /*!
+     *  \brief The constructor of the class.
+     *  \param allow_unknown plans through the unknown cells (like the navfn parameter of the same name)
+     *  \param tolerance is how far from an obstacle goal the plan can end (m)
+    */
+    IncrementalPlanner(bool allow_unknown = true, double tolerance = 0.0);
+
+
+    /*!
+     *  \brief Plans from the start to the goal on the costmap, repairing the last search.
+     *  \param costmap is a copy of the costmap (see Costmap2DROS::getCostmapCopy())
+     *  \param start_x,start_y is the robot position, in the costmap frame
+     *  \param goal_x,goal_y is the goal position, in the costmap frame
+     *  \param path is filled with the centers of the cells from the start to the goal (in the costmap frame)
+     *  \return false when the start or goal is off the map, or there isn't a path
+    */
+    bool makePlan(const costmap_2d::Costmap2D &costmap, double start_x, double start_y, double goal_x, double goal_y,
+                  std::vector<std::pair<double,double> > &path);
+
+
+    /*!
+     *  \brief Tells the planner that the goal of the next plan is the same goal in a new frame (so the search is kept
+     *  and shifted with the goal, rather than started again)
+    */
+    inline void goalFrameShifted(){ goal_frame_shifted_ = true; }
+
+
+    /// \brief Forget the last search (the next plan starts a new one)
+    inline void reset(){ size_x_ = 0; size_y_ = 0; }
+
+
+    /// \brief Return the work of the last plan
+    inline const Statistics& statistics() const { return statistics_; }
+
+private:
+
+    typedef std::pair<double,double> Key; //!< the D* Lite priority, compared lexicographically
+
+    /*!
+     *  \struct OpenEntry
+     *  \brief An entry of the open list (entries that no longer match their cell's key are skipped when popped)
+    */
+    struct OpenEntry
+    {
+      OpenEntry(const Key &k, int c): key(k), cell(c) {}
+      bool operator>(const OpenEntry &other) const { return key > other.key; }
+      Key key;
+      int cell;
+    };
+
+    typedef std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry> > OpenList;
+
+
+    /*!
+     *  \brief Starts a new search on a grid of the costmap's size, rooted at the goal cell
+    */
+    void initialize(const costmap_2d::Costmap2D &costmap, int goal_cell);
+
+
+    /*!
+     *  \brief Moves the search by whole cells (a cell at x,y goes to x + shift_x, y + shift_y).  The cells that come in
+     *  are new to the search (new_cell_), and the cells next to the ones that left are updated.
+     *  \return false if the goal or the last start left the grid (the search can't be kept)
+    */
+    bool shiftSearch(int shift_x, int shift_y);
+
+
+    /*!
+     *  \brief Compares the costmap with the costs of the search and updates the cells next to each change.
+     *  \return the number of changed cells
+    */
+    int updateCosts(const costmap_2d::Costmap2D &costmap);
+
+
+    /// \brief The D* Lite ComputeShortestPath(), repairs the search until the start is consistent
+    void computeShortestPath();
+
+
+    /// \brief The D* Lite UpdateVertex(), recomputes the rhs of the cell and puts it on the open list if inconsistent
+    void updateCell(int cell);
+
+
+    /// \brief Puts the cell on the open list if it is inconsistent, and takes it off if it isn't
+    void updateOpen(int cell);
+
+
+    /// \brief Return the least cost to the goal through the neighbors of the cell (its rhs)
+    double lookahead(int cell) const;
+
+
+    /// \brief Find the free cell nearest to the goal cell within the tolerance (-1 if there isn't one)
+    int freeCellNear(const costmap_2d::Costmap2D &costmap, int cell) const;
+
+
+    /// \brief Return the key of a cell
+    inline Key calculateKey(int cell) const
+    {
+      double k = std::min(g_[cell], rhs_[cell]);
+      return Key(k + heuristic(start_, cell) + km_, k);
+    }
+
+
+    /// \brief Return the octile distance times the least cost of a cell (consistent with the step costs)
+    inline double heuristic(int from, int to) const
+    {
+      int dx = std::abs(from % size_x_ - to % size_x_);
+      int dy = std::abs(from / size_x_ - to / size_x_);
+      return COST_NEUTRAL * (std::max(dx, dy) + (SQRT2 - 1.0) * std::min(dx, dy));
+    }
+
+
+    static const double INFINITE_COST; //!< the cost of the cells that haven't reached the goal (or can't be entered)
+    static const double COST_NEUTRAL; //!< the cost of a free cell (as in navfn)
+    static const double COST_FACTOR; //!< the cost of each unit of costmap cost (as in navfn)
+    static const double SQRT2; //!< the length of a diagonal step
+    static const int NEIGHBOR_X[8]; //!< the x offsets of the 8 neighbors
+    static const int NEIGHBOR_Y[8]; //!< the y offsets of the 8 neighbors
+    static const double NEIGHBOR_STEP[8]; //!< the length of the step to each neighbor (in cells)
+
+    double cell_costs_[256]; //!< the cell cost of each costmap value (INFINITE_COST if it can't be entered)
+    double tolerance_; //!< how far from an obstacle goal the plan can end (m)
+    bool goal_frame_shifted_; //!< the next goal is the same goal in a new frame
+
+    int size_x_; //!< the width of the grid the search is on (0 before the first search)
+    int size_y_; //!< the height of the grid the search is on
+    double resolution_; //!< the size of the cells (m)
+    double origin_x_; //!< the x coordinate of the corner of the grid (in the costmap frame)
+    double origin_y_; //!< the y coordinate of the corner of the grid
+    int requested_goal_; //!< the goal cell of the last plan
+    int goal_; //!< the cell the search is rooted at (the requested goal, or the free cell nearest to it)
+    int start_; //!< the start cell of the current plan
+    int last_start_; //!< the start cell when km_ was last updated
+    double km_; //!< the D* Lite key modifier (the heuristic distance the start has moved)
+
+    std::vector<double> g_; //!< the cost to the goal of each cell
+    std::vector<double> rhs_; //!< the one step lookahead of g_ (the cell is consistent when they are equal)
+    std::vector<unsigned char> cost_seen_; //!< the costmap cost each cell was last planned with
+    std::vector<bool> new_cell_; //!< the cells that came into the search without a cost
+    std::vector<int> changed_; //!< the cells changed in the current plan (kept to reuse its memory)
+    std::vector<Key> open_key_; //!< the key of each cell on the open list
+    std::vector<bool> open_; //!< the cells on the open list
+    OpenList open_list_; //!< the inconsistent cells, by key
+
+    Statistics statistics_; //!< the work of the last plan
+};
+
+
+#endif
@@ -15,6 +15,8 @@
 
 using namespace Eigen;
 
+static const char *EVENT_NAMES[] = {"Timer", "Goal", "Edge"}; //!< the names of the HexPlanner::PlanEvent
+
 //
 // Constructor
 //
@@ -26,6 +28,7 @@ HexPlanner::HexPlanner(ros::NodeHandle &nh, costmap_2d::Costmap2DROS *costmp)
   ros::param::param<double>("~max_path_length",max_path_length_, 2 );
   ros::param::param<bool>("~use_relative_planning", relative_plans_,"true");
    ros::param::param<std::string>("~edge_topic", edge_topic, "/relative/cur_edge/pose");
+  ros::param::param<bool>("~incremental_planning", incremental_, true);
 
   /*!
     \note Below are the private parameters that are available to change through the param server:
@@ -34,6 +37,7 @@ HexPlanner::HexPlanner(ros::NodeHandle &nh, costmap_2d::Costmap2DROS *costmp)
   ros::param::param<std::string>("~planner_name", planner_name,"hex_planner" ); //!< name for the planner (need this name to access its parameters)
   ros::param::param<double>("~max_path_length",max_path_length_, "2" ); //!< Don't plan farther than x meters away
   ros::param::param<bool>("~use_relative_planning", rel_planner,"true"); //!< if using relative states, need to modify goal
+  ros::param::param<bool>("~incremental_planning", incremental_, true); //!< repair the last plan (D* Lite) instead of a full navfn plan for each event
      \endcode
   */
 
@@ -54,6 +58,13 @@ HexPlanner::HexPlanner(ros::NodeHandle &nh, costmap_2d::Costmap2DROS *costmp)
   costmap_ = costmp;
   planner_.initialize(planner_name, costmap_);
 
+  //The incremental planner takes the allow_unknown parameter of navfn (so both plan through the same cells), and the
+  //max path length as its goal tolerance, as navfn does:
+  bool allow_unknown;
+  ros::NodeHandle planner_nh("~/" + planner_name);
+  planner_nh.param("allow_unknown", allow_unknown, true);
+  incremental_planner_ = IncrementalPlanner(allow_unknown, max_path_length_);
+
 
   //DEBUG!!!
   std::cout << "Base frame ID in costmap is " << costmap_->getBaseFrameID() << std::endl;
@@ -79,7 +90,7 @@ HexPlanner::~HexPlanner()
 //
 // Update the plan - do the work for this project
 //
-bool HexPlanner::updatePlan()
+bool HexPlanner::updatePlan(PlanEvent event)
 {
   //The costmap will be running on it's own thread, bringing in data at the rate set in the parameters.
   //The NavfnROS class accesses the costmap, as we sent in a pointer to it in the constructor.  Use the
@@ -104,7 +115,50 @@ bool HexPlanner::updatePlan()
   geometry_msgs::PoseStamped start;
   tf::poseStampedTFToMsg(current_pose, start);
 
-  if(!planner_.makePlan(start, goal_location_,max_path_length_,plan) || plan.empty())
+  ros::WallTime plan_start = ros::WallTime::now();
+  bool planned;
+  if(incremental_)
+  {
+    if(tf::resolve("", goal_location_.header.frame_id) != tf::resolve("", costmap_->getGlobalFrameID()))
+    {
+      ROS_ERROR_NAMED("PLANNER","The goal must be in the %s frame, it is in the %s frame",
+                      costmap_->getGlobalFrameID().c_str(), goal_location_.header.frame_id.c_str());
+      return false;
+    }
+
+    costmap_->getCostmapCopy(costmap_copy_);
+    std::vector<std::pair<double,double> > cells;
+    planned = incremental_planner_.makePlan(costmap_copy_, start.pose.position.x, start.pose.position.y,
+                                            goal_location_.pose.position.x, goal_location_.pose.position.y, cells);
+
+    //The plan is the centers of the cells, ending with the goal orientation:
+    geometry_msgs::PoseStamped pose;
+    pose.header.frame_id = costmap_->getGlobalFrameID();
+    pose.header.stamp = ros::Time::now();
+    pose.pose.orientation.w = 1.0;
+    for(int i = 0; i < (int)cells.size(); i++)
+    {
+      pose.pose.position.x = cells[i].first;
+      pose.pose.position.y = cells[i].second;
+      if(i == (int)cells.size() - 1)
+        pose.pose.orientation = goal_location_.pose.orientation;
+      plan.push_back(pose);
+    }
+
+    const IncrementalPlanner::Statistics &statistics = incremental_planner_.statistics();
+    ROS_INFO_NAMED("PLANNER", "%s plan: %.2f ms (%s, %d cells changed, %d expanded)", EVENT_NAMES[event],
+                   (ros::WallTime::now() - plan_start).toSec()*1000.0,
+                   statistics.new_search ? "new search" : "repaired", statistics.changed_cells,
+                   statistics.expanded_cells);
+  }
+  else
+  {
+    planned = planner_.makePlan(start, goal_location_,max_path_length_,plan);
+    ROS_INFO_NAMED("PLANNER", "%s plan: %.2f ms (navfn)", EVENT_NAMES[event],
+                   (ros::WallTime::now() - plan_start).toSec()*1000.0);
+  }
+
+  if(!planned || plan.empty())
   {
     ROS_DEBUG_NAMED("PLANNER", "Failed to find a plan to point (%.2f, %.2f",goal_location_.pose.position.x,
                     goal_location_.pose.position.y );
@@ -132,11 +186,11 @@ void HexPlanner::recieveGoalLocation(const geometry_msgs::PoseStamped goal_loc)
   goal_location_ = goal_loc;
 
   //Have a new goal, create a new plan (in either relative or global)
-  bool flag = updatePlan();
+  bool flag = updatePlan(GOAL_EVENT);
 
-  if(!flag)
+  if(!flag && !incremental_)
   {
-    flag = updatePlan(); //immediately try again
+    flag = updatePlan(GOAL_EVENT); //immediately try again (the incremental planner would give the same answer)
   }
 }
 
@@ -173,12 +227,13 @@ void HexPlanner::applyEdgeFromNewNode(const rel_MEKF::edge &edge_message)
     goal_location_.pose.orientation.z = g_q.z();
     goal_location_.pose.orientation.w = g_q.w();
 
-    //Have a new goal, create a new plan
-    bool flag = updatePlan();
+    //Have a new goal, create a new plan (the same goal in the new node frame, so the last search can be kept)
+    incremental_planner_.goalFrameShifted();
+    bool flag = updatePlan(EDGE_EVENT);
 
-    if(!flag)
+    if(!flag && !incremental_)
     {
-      flag = updatePlan(); //immediately try again
+      flag = updatePlan(EDGE_EVENT); //immediately try again
     }
   }
 
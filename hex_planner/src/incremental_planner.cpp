@@ -0,0 +1,476 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file incremental_planner.cpp
+ *  \author agent
+ *  \date October 2026
+*/
+
+
+#include "hex_planner/incremental_planner.h"
+#include <costmap_2d/cost_values.h>
+#include <ros/ros.h>
+#include <cmath>
+#include <limits>
+
+const double IncrementalPlanner::INFINITE_COST = std::numeric_limits<double>::infinity();
+const double IncrementalPlanner::COST_NEUTRAL = 50.0;
+const double IncrementalPlanner::COST_FACTOR = 0.8;
+const double IncrementalPlanner::SQRT2 = 1.4142135623730951;
+const int IncrementalPlanner::NEIGHBOR_X[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+const int IncrementalPlanner::NEIGHBOR_Y[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+const double IncrementalPlanner::NEIGHBOR_STEP[8] = {1.0, 1.0, 1.0, 1.0, IncrementalPlanner::SQRT2,
+                                                     IncrementalPlanner::SQRT2, IncrementalPlanner::SQRT2,
+                                                     IncrementalPlanner::SQRT2};
+
+//
+// Constructor
+//
+IncrementalPlanner::IncrementalPlanner(bool allow_unknown, double tolerance)
+{
+  tolerance_ = tolerance;
+  goal_frame_shifted_ = false;
+  size_x_ = 0;
+  size_y_ = 0;
+  resolution_ = 0.0;
+  origin_x_ = 0.0;
+  origin_y_ = 0.0;
+  requested_goal_ = 0;
+  goal_ = 0;
+  start_ = 0;
+  last_start_ = 0;
+  km_ = 0.0;
+  statistics_.new_search = false;
+  statistics_.changed_cells = 0;
+  statistics_.expanded_cells = 0;
+
+  //The cell costs, like navfn (the unknown cells are the most expensive free cells, if allowed):
+  for(int cost = 0; cost < 256; cost++)
+  {
+    int value = cost;
+    if(value == costmap_2d::NO_INFORMATION)
+      value = allow_unknown ? costmap_2d::INSCRIBED_INFLATED_OBSTACLE - 1 : costmap_2d::LETHAL_OBSTACLE;
+
+    if(value >= costmap_2d::INSCRIBED_INFLATED_OBSTACLE)
+      cell_costs_[cost] = INFINITE_COST;
+    else
+      cell_costs_[cost] = COST_NEUTRAL + COST_FACTOR*value;
+  }
+}
+
+
+
+//
+// Plan from the start to the goal, repairing the last search
+//
+bool IncrementalPlanner::makePlan(const costmap_2d::Costmap2D &costmap, double start_x, double start_y, double goal_x,
+                                  double goal_y, std::vector<std::pair<double,double> > &path)
+{
+  statistics_.new_search = false;
+  statistics_.changed_cells = 0;
+  statistics_.expanded_cells = 0;
+  bool frame_shifted = goal_frame_shifted_;
+  goal_frame_shifted_ = false;
+  path.clear();
+
+  int size_x = costmap.getSizeInCellsX();
+  int size_y = costmap.getSizeInCellsY();
+  unsigned int mx, my;
+  if(!costmap.worldToMap(goal_x, goal_y, mx, my))
+  {
+    ROS_DEBUG_NAMED("PLANNER", "The goal (%.2f, %.2f) is off the costmap", goal_x, goal_y);
+    return false;
+  }
+  int goal_cell = my*size_x + mx;
+  if(!costmap.worldToMap(start_x, start_y, mx, my))
+  {
+    ROS_DEBUG_NAMED("PLANNER", "The start (%.2f, %.2f) is off the costmap", start_x, start_y);
+    return false;
+  }
+  int start_cell = my*size_x + mx;
+
+  //Keep the last search if it's on the same grid and the goal is in the same cell, after the grid moved with the
+  //rolling window (or, when the goal frame shifted, move the search with the goal):
+  bool keep = size_x_ == size_x && size_y_ == size_y && resolution_ == costmap.getResolution();
+  if(keep)
+  {
+    int shift_x, shift_y;
+    if(frame_shifted)
+    {
+      shift_x = goal_cell % size_x - requested_goal_ % size_x;
+      shift_y = goal_cell / size_x - requested_goal_ / size_x;
+    }
+    else
+    {
+      shift_x = (int)floor((origin_x_ - costmap.getOriginX())/resolution_ + 0.5);
+      shift_y = (int)floor((origin_y_ - costmap.getOriginY())/resolution_ + 0.5);
+      keep = requested_goal_ % size_x + shift_x == goal_cell % size_x &&
+             requested_goal_ / size_x + shift_y == goal_cell / size_x;
+    }
+
+    if(keep && (shift_x != 0 || shift_y != 0))
+      keep = shiftSearch(shift_x, shift_y);
+  }
+  origin_x_ = costmap.getOriginX();
+  origin_y_ = costmap.getOriginY();
+  requested_goal_ = goal_cell;
+
+  //The search is rooted at the goal, or the free cell nearest to it:
+  int root = goal_cell;
+  if(cell_costs_[costmap.getCharMap()[goal_cell]] == INFINITE_COST)
+    root = freeCellNear(costmap, goal_cell);
+  if(root < 0)
+  {
+    ROS_DEBUG_NAMED("PLANNER", "The goal (%.2f, %.2f) is in an obstacle", goal_x, goal_y);
+    reset();
+    return false;
+  }
+
+  start_ = start_cell;
+  if(!keep || root != goal_)
+  {
+    initialize(costmap, root);
+    statistics_.new_search = true;
+    statistics_.changed_cells = size_x*size_y;
+  }
+  else
+  {
+    //The start moved (the keys already on the open list are lower bounds, see the D* Lite paper):
+    km_ += heuristic(last_start_, start_);
+    last_start_ = start_;
+    statistics_.changed_cells = updateCosts(costmap);
+  }
+
+  computeShortestPath();
+  if(rhs_[start_] == INFINITE_COST)
+  {
+    ROS_DEBUG_NAMED("PLANNER", "There isn't a path to the goal (%.2f, %.2f)", goal_x, goal_y);
+    return false;
+  }
+
+  //Follow the least cost to the goal:
+  int cell = start_;
+  for(int steps = 0; steps < size_x_*size_y_; steps++)
+  {
+    double x, y;
+    costmap.mapToWorld(cell % size_x_, cell / size_x_, x, y);
+    path.push_back(std::make_pair(x, y));
+    if(cell == goal_)
+      return true;
+
+    int next = -1;
+    double least = INFINITE_COST;
+    for(int i = 0; i < 8; i++)
+    {
+      int nx = cell % size_x_ + NEIGHBOR_X[i];
+      int ny = cell / size_x_ + NEIGHBOR_Y[i];
+      if(nx < 0 || ny < 0 || nx >= size_x_ || ny >= size_y_)
+        continue;
+
+      int neighbor = ny*size_x_ + nx;
+      double cost = NEIGHBOR_STEP[i]*cell_costs_[cost_seen_[neighbor]] + g_[neighbor];
+      if(cost < least)
+      {
+        least = cost;
+        next = neighbor;
+      }
+    }
+    if(next < 0)
+      break;
+    cell = next;
+  }
+
+  ROS_WARN_NAMED("PLANNER", "The incremental planner couldn't follow its search to the goal, starting a new one");
+  path.clear();
+  reset();
+  return false;
+}
+
+
+
+//
+// Start a new search
+//
+void IncrementalPlanner::initialize(const costmap_2d::Costmap2D &costmap, int goal_cell)
+{
+  size_x_ = costmap.getSizeInCellsX();
+  size_y_ = costmap.getSizeInCellsY();
+  resolution_ = costmap.getResolution();
+  int size = size_x_*size_y_;
+
+  g_.assign(size, INFINITE_COST);
+  rhs_.assign(size, INFINITE_COST);
+  cost_seen_.assign(costmap.getCharMap(), costmap.getCharMap() + size);
+  new_cell_.assign(size, false);
+  open_key_.assign(size, Key(INFINITE_COST, INFINITE_COST));
+  open_.assign(size, false);
+  open_list_ = OpenList();
+
+  goal_ = goal_cell;
+  last_start_ = start_;
+  km_ = 0.0;
+
+  rhs_[goal_] = 0.0;
+  updateOpen(goal_);
+}
+
+
+
+//
+// Move the search by whole cells
+//
+bool IncrementalPlanner::shiftSearch(int shift_x, int shift_y)
+{
+  int goal_x = goal_ % size_x_ + shift_x, goal_y = goal_ / size_x_ + shift_y;
+  int start_x = last_start_ % size_x_ + shift_x, start_y = last_start_ / size_x_ + shift_y;
+  if(goal_x < 0 || goal_y < 0 || goal_x >= size_x_ || goal_y >= size_y_ ||
+     start_x < 0 || start_y < 0 || start_x >= size_x_ || start_y >= size_y_)
+    return false;
+
+  int size = size_x_*size_y_;
+  std::vector<double> g(size, INFINITE_COST), rhs(size, INFINITE_COST);
+  std::vector<unsigned char> cost_seen(size, 0);
+  std::vector<bool> new_cell(size, true);
+  std::vector<Key> open_key(size, Key(INFINITE_COST, INFINITE_COST));
+  std::vector<bool> open(size, false);
+
+  //Copy the part of each row that stays on the grid:
+  int first_x = std::max(0, shift_x), last_x = std::min(size_x_, size_x_ + shift_x);
+  for(int y = std::max(0, shift_y); y < std::min(size_y_, size_y_ + shift_y); y++)
+  {
+    int from = (y - shift_y)*size_x_ - shift_x;
+    int to = y*size_x_;
+    std::copy(g_.begin() + from + first_x, g_.begin() + from + last_x, g.begin() + to + first_x);
+    std::copy(rhs_.begin() + from + first_x, rhs_.begin() + from + last_x, rhs.begin() + to + first_x);
+    std::copy(cost_seen_.begin() + from + first_x, cost_seen_.begin() + from + last_x, cost_seen.begin() + to + first_x);
+    std::copy(new_cell_.begin() + from + first_x, new_cell_.begin() + from + last_x, new_cell.begin() + to + first_x);
+    std::copy(open_key_.begin() + from + first_x, open_key_.begin() + from + last_x, open_key.begin() + to + first_x);
+    std::copy(open_.begin() + from + first_x, open_.begin() + from + last_x, open.begin() + to + first_x);
+  }
+  g_.swap(g);
+  rhs_.swap(rhs);
+  cost_seen_.swap(cost_seen);
+  new_cell_.swap(new_cell);
+  open_key_.swap(open_key);
+  open_.swap(open);
+
+  goal_ = goal_y*size_x_ + goal_x;
+  last_start_ = start_y*size_x_ + start_x;
+  start_ = last_start_;
+
+  //The keys don't change with the shift (the heuristic only depends on the offsets), so the open list is rebuilt:
+  std::vector<OpenEntry> entries;
+  for(int cell = 0; cell < size; cell++)
+    if(open_[cell])
+      entries.push_back(OpenEntry(open_key_[cell], cell));
+  open_list_ = OpenList(std::greater<OpenEntry>(), entries);
+
+  //The cells on the edges the grid moved away from lost the neighbors that left:
+  int edge_x = shift_x > 0 ? size_x_ - 1 : 0;
+  int edge_y = shift_y > 0 ? size_y_ - 1 : 0;
+  for(int x = 0; x < size_x_ && shift_y != 0; x++)
+    if(!new_cell_[edge_y*size_x_ + x])
+      updateCell(edge_y*size_x_ + x);
+  for(int y = 0; y < size_y_ && shift_x != 0; y++)
+    if(!new_cell_[y*size_x_ + edge_x])
+      updateCell(y*size_x_ + edge_x);
+
+  return true;
+}
+
+
+
+//
+// Update the cells around the costs that changed
+//
+int IncrementalPlanner::updateCosts(const costmap_2d::Costmap2D &costmap)
+{
+  const unsigned char *costs = costmap.getCharMap();
+  changed_.clear();
+  for(int cell = 0; cell < size_x_*size_y_; cell++)
+  {
+    if(new_cell_[cell] || costs[cell] != cost_seen_[cell])
+    {
+      cost_seen_[cell] = costs[cell];
+      new_cell_[cell] = false;
+      changed_.push_back(cell);
+    }
+  }
+
+  //The cost of a cell is the cost of stepping into it, so the cells next to it change (and a new cell needs its rhs):
+  for(int i = 0; i < (int)changed_.size(); i++)
+  {
+    int cell = changed_[i];
+    updateCell(cell);
+    for(int n = 0; n < 8; n++)
+    {
+      int nx = cell % size_x_ + NEIGHBOR_X[n];
+      int ny = cell / size_x_ + NEIGHBOR_Y[n];
+      if(nx >= 0 && ny >= 0 && nx < size_x_ && ny < size_y_)
+        updateCell(ny*size_x_ + nx);
+    }
+  }
+
+  return (int)changed_.size();
+}
+
+
+
+//
+// Repair the search until the start is consistent (D* Lite ComputeShortestPath)
+//
+void IncrementalPlanner::computeShortestPath()
+{
+  while(true)
+  {
+    //The entries that no longer match their cell are skipped:
+    while(!open_list_.empty() && (!open_[open_list_.top().cell] || open_key_[open_list_.top().cell] != open_list_.top().key))
+      open_list_.pop();
+
+    if(open_list_.empty() || (!(open_list_.top().key < calculateKey(start_)) && rhs_[start_] <= g_[start_]))
+      break;
+
+    OpenEntry top = open_list_.top();
+    open_list_.pop();
+    int cell = top.cell;
+    Key key = calculateKey(cell);
+    statistics_.expanded_cells++;
+
+    if(top.key < key)
+    {
+      //The start moved since the cell was put on the open list:
+      open_key_[cell] = key;
+      open_list_.push(OpenEntry(key, cell));
+      continue;
+    }
+
+    open_[cell] = false;
+    double step_cost = cell_costs_[cost_seen_[cell]];
+    if(g_[cell] > rhs_[cell])
+    {
+      //Overconsistent, the cost to the goal went down, lower its neighbors:
+      g_[cell] = rhs_[cell];
+      for(int n = 0; n < 8; n++)
+      {
+        int nx = cell % size_x_ + NEIGHBOR_X[n];
+        int ny = cell / size_x_ + NEIGHBOR_Y[n];
+        if(nx < 0 || ny < 0 || nx >= size_x_ || ny >= size_y_)
+          continue;
+
+        int neighbor = ny*size_x_ + nx;
+        if(neighbor != goal_ && NEIGHBOR_STEP[n]*step_cost + g_[cell] < rhs_[neighbor])
+        {
+          rhs_[neighbor] = NEIGHBOR_STEP[n]*step_cost + g_[cell];
+          updateOpen(neighbor);
+        }
+      }
+    }
+    else
+    {
+      //Underconsistent, the cost to the goal went up, the neighbors that went through the cell look again:
+      double g_old = g_[cell];
+      g_[cell] = INFINITE_COST;
+      updateCell(cell);
+      for(int n = 0; n < 8; n++)
+      {
+        int nx = cell % size_x_ + NEIGHBOR_X[n];
+        int ny = cell / size_x_ + NEIGHBOR_Y[n];
+        if(nx < 0 || ny < 0 || nx >= size_x_ || ny >= size_y_)
+          continue;
+
+        int neighbor = ny*size_x_ + nx;
+        if(rhs_[neighbor] == NEIGHBOR_STEP[n]*step_cost + g_old)
+          updateCell(neighbor);
+      }
+    }
+  }
+}
+
+
+
+//
+// Update the rhs of a cell (D* Lite UpdateVertex)
+//
+void IncrementalPlanner::updateCell(int cell)
+{
+  if(cell != goal_)
+    rhs_[cell] = lookahead(cell);
+  updateOpen(cell);
+}
+
+
+
+//
+// Put the inconsistent cells on the open list
+//
+void IncrementalPlanner::updateOpen(int cell)
+{
+  if(g_[cell] != rhs_[cell])
+  {
+    Key key = calculateKey(cell);
+    if(!open_[cell] || open_key_[cell] != key)
+    {
+      open_[cell] = true;
+      open_key_[cell] = key;
+      open_list_.push(OpenEntry(key, cell));
+    }
+  }
+  else
+  {
+    open_[cell] = false;
+  }
+}
+
+
+
+//
+// The least cost to the goal through the neighbors
+//
+double IncrementalPlanner::lookahead(int cell) const
+{
+  double least = INFINITE_COST;
+  int x = cell % size_x_, y = cell / size_x_;
+  for(int n = 0; n < 8; n++)
+  {
+    int nx = x + NEIGHBOR_X[n];
+    int ny = y + NEIGHBOR_Y[n];
+    if(nx < 0 || ny < 0 || nx >= size_x_ || ny >= size_y_)
+      continue;
+
+    int neighbor = ny*size_x_ + nx;
+    double cost = NEIGHBOR_STEP[n]*cell_costs_[cost_seen_[neighbor]] + g_[neighbor];
+    if(cost < least)
+      least = cost;
+  }
+  return least;
+}
+
+
+
+//
+// Find the free cell nearest to the goal
+//
+int IncrementalPlanner::freeCellNear(const costmap_2d::Costmap2D &costmap, int cell) const
+{
+  int size_x = costmap.getSizeInCellsX(), size_y = costmap.getSizeInCellsY();
+  int radius = (int)(tolerance_/costmap.getResolution());
+  int x = cell % size_x, y = cell / size_x;
+  int nearest = -1;
+  int least = radius*radius + 1;
+  for(int ny = std::max(0, y - radius); ny <= std::min(size_y - 1, y + radius); ny++)
+  {
+    for(int nx = std::max(0, x - radius); nx <= std::min(size_x - 1, x + radius); nx++)
+    {
+      int distance = (nx - x)*(nx - x) + (ny - y)*(ny - y);
+      if(distance < least && cell_costs_[costmap.getCharMap()[ny*size_x + nx]] != INFINITE_COST)
+      {
+        least = distance;
+        nearest = ny*size_x + nx;
+      }
+    }
+  }
+  return nearest;
+}
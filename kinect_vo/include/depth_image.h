@@ -0,0 +1,86 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \package kinect_visual_odometry
+ *  \file depth_image.h
+ *  \author agent
+ *  \date October 2026
+ *
+ *  \brief Conversions for the depth images.  The visual odometry works on 16 bit depth images in millimeters (CV_16UC1,
+ *  zero where there is no depth), which is what the openni driver publishes on the image_raw topics.  These functions
+ *  bring the older float images (CV_32FC1 in meters, NaN where there is no depth) into that format, make the mask used
+ *  by the feature detector, and convert back to float for anything that still expects it.
+*/
+
+#ifndef DEPTH_IMAGE_H
+#define DEPTH_IMAGE_H
+
+#include <stdint.h>
+#include <limits>
+#include <opencv2/core/core.hpp>
+
+static const double DEPTH_MM_TO_M = 0.001; //!< scale from the 16 bit depth values to meters
+
+
+/*!
+ *  \brief Quantizes a float depth image (meters) to 16 bit millimeters.  NaN, negative, and out of range depths become
+ *  zero (no depth).
+ *
+ *  \param float_img is the CV_32FC1 depth image in meters
+ *  \param mm_img is the returned CV_16UC1 image (it is only reallocated if the size changes)
+*/
+inline void depthFloatToMillimeters(const cv::Mat &float_img, cv::Mat &mm_img)
+{
+  mm_img.create(float_img.size(), CV_16UC1);
+  for(int r = 0; r < float_img.rows; r++)
+  {
+    const float *src = float_img.ptr<float>(r);
+    uint16_t *dst = mm_img.ptr<uint16_t>(r);
+    for(int c = 0; c < float_img.cols; c++)
+    {
+      //comparisons with NaN are false, so NaN ends up as zero too:
+      float d = src[c];
+      dst[c] = (d > 0.f && d < 65.535f) ? (uint16_t)(d*1000.f + 0.5f) : 0;
+    }
+  }
+}
+
+
+/*!
+ *  \brief Converts a 16 bit millimeter depth image back to float meters (zero becomes NaN), like the openni driver's
+ *  float topics.  This is the shim for consumers of the keyframes that still expect float depth.
+ *
+ *  \param mm_img is the CV_16UC1 depth image in millimeters
+ *  \param float_img is the returned CV_32FC1 image in meters
+*/
+inline void depthMillimetersToFloat(const cv::Mat &mm_img, cv::Mat &float_img)
+{
+  const float bad_point = std::numeric_limits<float>::quiet_NaN();
+  float_img.create(mm_img.size(), CV_32FC1);
+  for(int r = 0; r < mm_img.rows; r++)
+  {
+    const uint16_t *src = mm_img.ptr<uint16_t>(r);
+    float *dst = float_img.ptr<float>(r);
+    for(int c = 0; c < mm_img.cols; c++)
+    {
+      dst[c] = (src[c] == 0) ? bad_point : (float)src[c]*(float)DEPTH_MM_TO_M;
+    }
+  }
+}
+
+
+/*!
+ *  \brief Makes the mask for the feature detector from the 16 bit depth image: 255 where there is depth, 0 elsewhere.
+ *
+ *  \param mm_img is the CV_16UC1 depth image in millimeters
+ *  \param mono8_img is the returned CV_8UC1 mask (it is only reallocated if the size changes)
+*/
+inline void depthMillimetersToMask(const cv::Mat &mm_img, cv::Mat &mono8_img)
+{
+  cv::compare(mm_img, cv::Scalar(0), mono8_img, cv::CMP_NE);
+}
+
+#endif
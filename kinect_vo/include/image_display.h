@@ -19,6 +19,8 @@
 #include <opencv2/features2d/features2d.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+namespace kinect_vo
+{
 
 class ImageDisplay
 {
@@ -36,5 +38,7 @@ protected:
 
 };
 
+}
+
 
 #endif
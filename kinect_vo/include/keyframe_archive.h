@@ -0,0 +1,272 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \package kinect_visual_odometry
+ *  \file keyframe_archive.h
+ *  \author agent
+ *  \date October 2026
+ *
+ *  \brief Provides the KeyframeArchive class, which compresses the keyframes on a worker thread, publishes them and
+ *  stores them on disk, and the KeyframeStore class, which reads the stored keyframes back by run and node ID.
+*/
+
+#ifndef KEYFRAME_ARCHIVE_H
+#define KEYFRAME_ARCHIVE_H
+
+#include "ros/ros.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/CompressedImage.h>
+
+namespace kinect_vo
+{
+
+/*!
+ *  \struct KeyframeIndexRecord
+ *  \brief One keyframe in the index file (keyframes.idx) of the on-disk store.  The offsets are into keyframes.dat.
+*/
+struct KeyframeIndexRecord
+{
+  uint32_t node_id; //!< the keyframe number (the header.seq of the keyframe messages, which starts over each run)
+  uint32_t run; //!< the run that stored the keyframe (0 for the first, zero in version 1 stores)
+  double stamp; //!< the timestamp of the keyframe (seconds)
+  uint64_t rgb_offset; //!< the position of the encoded color image in the data file
+  uint64_t depth_offset; //!< the position of the encoded depth image in the data file
+  uint32_t rgb_size; //!< the number of bytes in the encoded color image
+  uint32_t depth_size; //!< the number of bytes in the encoded depth image
+};
+
+
+/*!
+ *  \struct KeyframeIndexHeader
+ *  \brief The header at the start of keyframes.idx
+*/
+struct KeyframeIndexHeader
+{
+  char magic[4]; //!< "VOKF"
+  uint32_t version; //!< the version of the store format (2, 1 had no run numbers)
+  uint32_t record_size; //!< sizeof(KeyframeIndexRecord)
+  uint32_t reserved; //!< zero
+};
+
+
+/*!
+ *  \class KeyframeArchive keyframe_archive.h "include/keyframe_archive.h"
+ *  \brief The KeyframeArchive takes the keyframe images off the image callback, and on its own thread encodes the color
+ *  image as a JPEG and the depth image as a 16 bit PNG (lossless), publishes them as sensor_msgs::CompressedImage and
+ *  appends them to an on-disk store.
+ *
+ *  The store is a directory with three files:
+ *  - keyframes.dat has the encoded images, one after the other
+ *  - keyframes.idx has a KeyframeIndexHeader followed by a KeyframeIndexRecord for each keyframe
+ *  - camera_info.yml has the RGB calibration (K, D, P) in the same format used by vo_benchmark
+ *
+ *  The data is flushed and synced to the disk before the index record is appended, so a reader (KeyframeStore) never
+ *  finds a record for images that are not completely written, even after a crash.  Both files are only appended to, so a store can be extended by later runs.  Each run
+ *  stores its keyframes under the next run number, since the node IDs start over.
+ *
+ *  At most MAX_QUEUE_ keyframes wait for the worker, the keyframes added while the queue is full are dropped (and
+ *  counted) instead of piling up in memory.
+*/
+class KeyframeArchive
+{
+
+public:
+
+  /*!
+   *  \brief The constructor starts the worker thread.
+   *  \param jpeg_quality is the quality (0-100) used for the color images
+  */
+  KeyframeArchive(int jpeg_quality = 90);
+
+
+  /*!
+   *  \brief The destructor finishes the keyframes in the queue, stops the thread and closes the store.
+  */
+  ~KeyframeArchive();
+
+
+  /*!
+   *  \brief Opens (or creates) the on-disk store in a directory.  Without a store the keyframes are only published.
+   *  \param directory is the directory for the store (it is created if needed)
+   *  \returns true if the store was opened
+  */
+  bool openStore(const std::string &directory);
+
+
+  /*!
+   *  \brief Sets the publishers for the compressed images (sensor_msgs::CompressedImage).  Publishers that are not set
+   *  (default constructed) are skipped.
+  */
+  void setPublishers(const ros::Publisher &rgb_publisher, const ros::Publisher &depth_publisher);
+
+
+  /*!
+   *  \brief Queues a keyframe for compression.  This only copies the image headers (and the depth, if it is shared with
+   *  the message), the encoding happens on the worker thread.  The keyframe is dropped if MAX_QUEUE_ are waiting.
+   *
+   *  \param header is the header for the compressed messages (header.seq is used as the node ID in the store)
+   *  \param rgb_image is the color image (rgb8)
+   *  \param depth_mm is the 16 bit depth image in millimeters
+   *  \param rgb_info is the RGB calibration, written to the store with the first keyframe
+  */
+  void addKeyframe(const std_msgs::Header &header, const cv::Mat &rgb_image, const cv::Mat &depth_mm,
+                   const sensor_msgs::CameraInfo &rgb_info);
+
+
+  /// The number of keyframes waiting to be compressed
+  int queued();
+
+
+  /// The number of keyframes dropped because the queue was full
+  int dropped();
+
+
+protected:
+
+  /*!
+   *  \struct Job
+   *  \brief A keyframe waiting to be compressed
+  */
+  struct Job
+  {
+    std_msgs::Header header;
+    cv::Mat rgb;
+    cv::Mat depth_mm;
+    sensor_msgs::CameraInfo rgb_info;
+  };
+
+  /// The worker thread's entry point (calls run())
+  static void* threadEntry(void *archive);
+
+  /// The worker loop, waits for jobs and processes them until shutdown
+  void run();
+
+  /// Encode, publish, and store a keyframe
+  void process(Job &job);
+
+  /// Append the encoded images and the index record to the store
+  void appendToStore(const Job &job, const std::vector<uchar> &rgb_data, const std::vector<uchar> &depth_data);
+
+  int jpeg_quality_; //!< the JPEG quality for the color images
+  ros::Publisher rgb_publisher_; //!< publishes the compressed color keyframes
+  ros::Publisher depth_publisher_; //!< publishes the compressed depth keyframes
+
+  std::string directory_; //!< the directory of the store
+  FILE *data_file_; //!< keyframes.dat (NULL when there is no store)
+  FILE *index_file_; //!< keyframes.idx
+  uint32_t run_; //!< the run number of the keyframes stored since the store was opened
+  bool camera_info_written_; //!< true once camera_info.yml is written
+
+  static const int MAX_QUEUE_ = 10; //!< the most keyframes waiting to be compressed, more are dropped
+
+  std::deque<Job> queue_; //!< the keyframes waiting to be compressed
+  int dropped_; //!< the keyframes dropped because the queue was full
+  pthread_mutex_t queue_mutex_; //!< protects queue_, dropped_, shutdown_ and the publishers
+  pthread_mutex_t store_mutex_; //!< protects the store files (held while writing, so not by the image callback)
+  pthread_cond_t queue_cond_; //!< signals the worker when a job is added (or on shutdown)
+  pthread_t thread_; //!< the worker thread
+  bool shutdown_; //!< tells the worker thread to exit once the queue is empty
+};
+
+
+
+/*!
+ *  \class KeyframeStore keyframe_archive.h "include/keyframe_archive.h"
+ *  \brief Reads keyframes back out of a store written by KeyframeArchive, by run and node ID.
+ *
+ *  The index is read into memory when the store is opened, and refresh() picks up the keyframes appended since then, so
+ *  a node can read the store while the visual odometry is still writing it.  Reading a keyframe is one seek and read of
+ *  each image, followed by the decoding.
+*/
+class KeyframeStore
+{
+
+public:
+
+  KeyframeStore();
+
+  ~KeyframeStore();
+
+
+  /*!
+   *  \brief Opens a store and reads its index
+   *  \param directory is the directory of the store
+   *  \returns false if the store is missing or the index isn't a version this class reads
+  */
+  bool open(const std::string &directory);
+
+
+  /// Closes the store
+  void close();
+
+
+  /*!
+   *  \brief Reads the index records that were appended since the last refresh (or open)
+   *  \returns the number of new keyframes
+  */
+  int refresh();
+
+
+  /// True if the store has the keyframe
+  inline bool contains(uint32_t run, uint32_t node_id) const
+  {
+    return index_.find(KeyframeKey(run, node_id)) != index_.end();
+  }
+
+
+  /// The number of keyframes in the store
+  inline int size() const {return (int)index_.size();}
+
+
+  /// The number of runs in the store (the last run is runs() - 1)
+  inline uint32_t runs() const {return index_.empty() ? 0 : index_.rbegin()->first.first + 1;}
+
+
+  /*!
+   *  \brief Reads and decodes a keyframe
+   *  \param run is the run that stored the keyframe
+   *  \param node_id is the keyframe number
+   *  \param rgb_image returns the color image (rgb8), can be NULL to skip decoding it
+   *  \param depth_mm returns the 16 bit depth image (millimeters), can be NULL to skip decoding it
+   *  \param stamp returns the timestamp of the keyframe, can be NULL
+   *  \returns false if the keyframe isn't in the store or can't be read
+  */
+  bool read(uint32_t run, uint32_t node_id, cv::Mat *rgb_image, cv::Mat *depth_mm, double *stamp = NULL);
+
+
+  /*!
+   *  \brief Reads the RGB calibration saved with the store
+   *  \returns false if the store has no calibration yet
+  */
+  bool readCameraInfo(sensor_msgs::CameraInfo *rgb_info);
+
+
+protected:
+
+  typedef std::pair<uint32_t, uint32_t> KeyframeKey; //!< the run and node ID of a keyframe
+
+  /// Reads a block of the data file
+  bool readBlock(uint64_t offset, uint32_t size, std::vector<uchar> *data);
+
+  std::string directory_; //!< the directory of the store
+  FILE *data_file_; //!< keyframes.dat
+  FILE *index_file_; //!< keyframes.idx
+  std::map<KeyframeKey, KeyframeIndexRecord> index_; //!< the index, by run and node ID
+};
+
+}
+
+#endif
@@ -0,0 +1,105 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \package kinect_visual_odometry
+ *  \file latency_trace.h
+ *  \author agent
+ *  \date October 2026
+ *
+ *  \brief Provides the LatencyTrace class, which publishes the stages of the trace from a camera frame to the motor
+ *  command that reacts to it.  It is header only, so the estimator and the control use it without linking to the VO.
+*/
+
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <stdint.h>
+#include <string>
+#include <ros/ros.h>
+#include "kinect_vo/latency_stage.h"
+
+namespace kinect_vo
+{
+
+/*!
+ *  \class LatencyTrace latency_trace.h "include/latency_trace.h"
+ *  \brief The LatencyTrace class publishes one kinect_vo/latency_stage message each time a traced frame reaches a
+ *  stage (see latency_stage.msg for the stages).
+ *
+ *  The VO gives each frame it publishes a trace id (kinect_vo_message::trace_id), the estimator carries the id of the
+ *  latest frame in its state (relative_state::trace_id) and the control stamps the command that first uses it.  The
+ *  stages all go to one topic, so a bag of that topic is enough for the latency_collector tool to put each frame's
+ *  latency back together.  Until advertise() is called (or for trace id 0) stamp() does nothing.
+ *
+ *  \note The stages are stamped with ros::Time::now(), so the trace across nodes assumes the computers' clocks are
+ *  synchronized (they are all on the hex).
+*/
+class LatencyTrace
+{
+
+public:
+
+  /*!
+   *  \brief Constructor, the trace is disabled until advertise() is called
+  */
+  LatencyTrace() : enabled_(false)
+  {
+  }
+
+
+  /*!
+   *  \brief Starts publishing the stages
+   *  \param nh the node handle to advertise on
+   *  \param topic the topic for the stages (the same for every node in the trace)
+  */
+  void advertise(ros::NodeHandle &nh, const std::string &topic)
+  {
+    publisher_ = nh.advertise<kinect_vo::latency_stage>(topic, 50);
+    enabled_ = true;
+  }
+
+
+  /*!
+   *  \brief Publishes that a frame reached a stage
+   *  \param trace_id the id the VO gave the frame (0 is ignored)
+   *  \param frame_stamp the camera frame timestamp
+   *  \param stage one of the latency_stage constants
+   *  \param when the time the stage was reached
+  */
+  void stamp(uint32_t trace_id, const ros::Time &frame_stamp, uint8_t stage, const ros::Time &when)
+  {
+    if(!enabled_ || trace_id == 0)
+      return;
+
+    kinect_vo::latency_stagePtr message(new kinect_vo::latency_stage);
+    message->trace_id = trace_id;
+    message->frame_stamp = frame_stamp;
+    message->stage = stage;
+    message->stamp = when;
+    publisher_.publish(message);
+  }
+
+
+  /*!
+   *  \brief Publishes that a frame reached a stage now
+  */
+  void stamp(uint32_t trace_id, const ros::Time &frame_stamp, uint8_t stage)
+  {
+    stamp(trace_id, frame_stamp, stage, ros::Time::now());
+  }
+
+
+  bool enabled(){return enabled_;}
+
+
+protected:
+  bool enabled_; //!< true once the publisher is advertised
+  ros::Publisher publisher_; //!< the publisher for the stages
+};
+
+}
+
+#endif // LATENCY_TRACE_H
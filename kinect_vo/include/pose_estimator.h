@@ -43,6 +43,8 @@
 #include "ransac.h"
 #include "image_display.h"
 #include "lsh.h"
+#include "stage_timer.h"
+#include "depth_image.h"
 
 //#include "g2o/solvers/csparse/g2o_csparse_api.h"
 //#include "g2o/core/sparse_optimizer.h"
@@ -56,9 +58,8 @@
 ////#include "g2o/core/structure_only_solver.h"
 //#include "g2o/core/hyper_graph.h"
 
-
-
-
+namespace kinect_vo
+{
 
 /*!
  *  \class PoseEstimator pose_estimator.h "include/pose_estimator.h"
@@ -102,12 +103,12 @@ public:
    *  called, this method uses the default calibration.
    *
    *  \param visual_image is the color image provided by the kinect.
-   *  \param depth_image_float is the depth image off the kinect, that is parameterized using floats.  It is used to calculate
-   *  the 3D points.
+   *  \param depth_image_mm is the depth image off the kinect in millimeters (CV_16UC1, zero where there is no depth).  It
+   *  is used to calculate the 3D points.
    *  \param depth_image_CV8UC1 is the reformatted depth image, this is used as a mask in the feature detection algorithm,
    *  that way points without depth information are not found on the image.
   */
-  void setReferenceView(cv::Mat &visual_image, cv::Mat &depth_image_float, cv::Mat &depth_image_CV8UC1);
+  void setReferenceView(cv::Mat &visual_image, cv::Mat &depth_image_mm, cv::Mat &depth_image_CV8UC1);
 
 
 
@@ -120,7 +121,7 @@ public:
    *  estimate using g2o.
    *
    *  \param visual_cur_image is the color image provided by the kinect.
-   *  \param depth_curr_image_float is the float version of the depth image, used for calculating the 3D points
+   *  \param depth_curr_image_mm is the 16 bit depth image in millimeters, used for calculating the 3D points
    *  \param depth_curr_image_CV8UC1 is the depth image used as a mask in the feature detection
    *  \param rotation is the rotation part of the 6DOF transfromation returned by the algorithm in a quaternion
    *  \param translation is the 2nd part of the 6DOF transformation (returned) in a 3D vector
@@ -136,7 +137,7 @@ public:
    *  \param tran_opt is the translation found Matby the optimization
    *  \returns zero if not enough features correspond and the outputs should be ignored, one if everything functioned correctly
   */
-  int setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat &depth_curr_image_float, cv::Mat &depth_curr_image_CV8UC1,
+  int setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat &depth_curr_image_mm, cv::Mat &depth_curr_image_CV8UC1,
                                   Eigen::Quaterniond *rotation, Eigen::Vector3d *translation,
                                   Eigen::Matrix<double,7,7> *covariance, int *inliers, int *corresponding, int *total,
                                   bool setAsReference,Eigen::Quaterniond *rot_opt, Eigen::Vector3d *tran_opt,
@@ -161,6 +162,18 @@ public:
   /// Read access to "reference_set_":
   bool readReferenceSet(){return reference_set_;}
 
+  /*!
+   *  \brief Access to the timer for the processing stages.  The PoseEstimator times the stages it runs (detection through
+   *  covariance), the caller is responsible for beginFrame()/endFrame() and for timing anything else (e.g. publishing).
+  */
+  StageTimer& stageTimer(){return timer_;}
+
+  /*!
+   *  \brief Sets the seed used for the RANSAC samples, so that runs on recorded data can be repeated.
+   *  \param seed is the seed (it also restarts the RANSAC run counter)
+  */
+  void setRandomSeed(uint64_t seed){ransac_->setSeed(seed);}
+
   /*!
    *  \brief Temp function for when we publish two messages for comparing the vo covariance info.  This function
    *  reports what the calc_hess_covariance_ variable is.  If provided an argument, it will modify the variable.
@@ -202,7 +215,7 @@ protected:
   //reference image member variables
   cv::Mat reference_img_gray_; //!< the reference image, it is a class variable so it can be used over and over
   cv::Mat reference_img_RGB_; //!< the color version of the reference image (just in case)
-  cv::Mat reference_img_depth_; //!< the depth image (float)
+  cv::Mat reference_img_depth_; //!< the depth image (16 bit millimeters)
   std::vector<cv::KeyPoint> reference2D_features_; //!< the 2D features found on the image
   std::vector<cv::Point2f> reference2D_idealized_; //!< the idealized 2D feature locations on the image
   std::vector<cv::Point3d > reference3D_features_; //!< the 3D features for reference
@@ -241,6 +254,7 @@ protected:
 
   int num_features_; //!< number of max features
   int num_iterations_; //!< number of ransac interations
+  RANSAC *ransac_; //!< RANSAC, reused for every frame
 
   //Tunable Params:
   //Eigen::Matrix<double,7,7> image_noise_; //!< matrix of (inverse) noise that is multiplied by the Hessian to calc the covariance
@@ -254,6 +268,8 @@ protected:
   ImageDisplay *association_;
   int counter_; //for counting current images
 
+  StageTimer timer_; //!< times each stage of the processing (detection, description, matching, RANSAC, etc.)
+
   //Temp stuff for multiple covariances:
   bool calc_hess_covariance_; //enable calculation of hessian covariance
   Eigen::Matrix<double,7,7> hess_covariance_;
@@ -311,13 +327,13 @@ protected:
    *  X and Y portions of the 3D point.
    *  \todo Pass in the Descriptors, if features are deleted because of bad depth, delete the corresponding descriptor too!
    *
-   *  \param depth_float is the depth image from the kinect that has depth information on it.
+   *  \param depth_mm is the 16 bit depth image (millimeters, zero for no depth) from the kinect.
    *  \param kinect_calibration is the calibration of the RGB camera of the kinect sensor.
    *  \param features2D is a vector of 2D points that have the feature locations on the image plane, any unvalid points are removed.
    *  \param features2D_undistorted is the vector of 2D features that have been undistored using calibration info and OpenCV's undistortPoints
    *  \param features3D is the vector of 3D points extracted using the depth image, 2D feature locations, and calibration
   */
-  void calc3DPoints(cv::Mat &depth_float,
+  void calc3DPoints(cv::Mat &depth_mm,
                     sensor_msgs::CameraInfo &kinect_calibration,
                     std::vector<cv::Point2f> *features2D,
                     std::vector<cv::Point2f> *features2D_undistorted,
@@ -333,7 +349,7 @@ protected:
    *
    *  \param color_image is the current color image.
    *  \param mono_image is the gray version of the color image.
-   *  \param depth_image is the float version of the depth image.
+   *  \param depth_image is the 16 bit (millimeter) depth image.
    *  \param features2D are the FAST features extracted from mono_image
    *  \param idealized_pts are the 2D features at the ideal location assuming a pin-hole camera model and the camera parameters
    *  \param features3D are the 3D points of the 2D features
@@ -408,4 +424,6 @@ protected:
 
 };
 
+}
+
 #endif
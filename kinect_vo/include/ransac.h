@@ -25,13 +25,15 @@
 #include <complex>
 #include <stdlib.h>
 #include <stdint.h>
-#include <QList>
-#include <QSet>
-#include <QHash>
+#include <vector>
+#include <algorithm>
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/SVD>
 #include <ros/assert.h>
 #include <iostream>
 
-
+namespace kinect_vo
+{
 
 /*!
  *  \class RANSAC ransac.h "include\ransac.h"
@@ -43,6 +45,12 @@
  *  (IEEE Trans. on Pattern Analysis and Machine Intelligence Vol. PAMI-9 No. 5 Sept 1987).  The transformation estimate then
  *  is checked for inliers by reprojecting the reference features onto the current image plane and finding distance to
  *  the corresponding current image 2D feature locations.  The estimate with the most inliers over the iterations is selected
+ *
+ *  One instance is meant to be reused for every frame: the point storage (struct of arrays) and the table of sample
+ *  indices are kept between calls, so once they have grown to the size of the largest frame, runRANSAC doesn't allocate
+ *  in its main loop.  The samples come from a counter-based generator, i.e. the indices for iteration i of run r are a
+ *  pure function of (seed, r, i).  This means the threads in the OpenMP loop don't share any generator state, and the
+ *  result of a run only depends on the seed and the number of runs since the seed was set (not on the thread schedule).
 */
 class RANSAC
 {
@@ -52,22 +60,41 @@ public:
   /*!
    *  \brief The constructor for RANSAC
    *
+   *  \attention setCameraParameters() must be called before runRANSAC()
+   *
    *  \param iters is the number of iterations for the instance
    *  \param inlier_thres is the distance threshold for a feature to be declared an inlier
    *  \param consensus_thres is a percentage of inliers needed to break the iterations and declare a transformation
-   *  \param camera_params are the RGB camera parameters for bringing 3D points onto the image plane
    *  \param optimize_enabled tells RANSAC if the solution will be optimized or not afterward, if so, it reduces some steps
+   *  \param seed is the seed for the sample generator
   */
-  RANSAC(int iters, int inlier_thres, double consensus_thres, sensor_msgs::CameraInfo &camera_params, bool optimize_enabled);
+  RANSAC(int iters, int inlier_thres, double consensus_thres, bool optimize_enabled, uint64_t seed = 0xffffffff);
 
 
   /*!
    *  \brief The destructor
-   *  \todo document anything that ends up in here...
   */
   ~RANSAC();
 
 
+  /*!
+   *  \brief Sets the RGB camera parameters used to bring the 3D points onto the image plane
+   *  \param camera_params are the RGB camera parameters (K and the plumb bob distortion D)
+  */
+  void setCameraParameters(const sensor_msgs::CameraInfo &camera_params);
+
+
+  /*!
+   *  \brief Sets the seed for the sample generator and restarts the run counter, so a sequence of runs can be replayed
+   *  \param seed is the new seed
+  */
+  inline void setSeed(uint64_t seed)
+  {
+    seed_ = seed;
+    run_counter_ = 0;
+  }
+
+
 
   /*!
    *  \brief The method to run RANSAC and return the solution
@@ -118,28 +145,48 @@ protected:
   double consensus_threshold_; //!< for determining an exit criteria if a sufficient percentage of inliers are found
   cv::Mat rgb_camera_intrinsics; //!< for bringing the reference features onto the image plane (needs to be the RBG camera parameters)
   cv::Mat rgb_distortion; //!< copy the distortion parameters of the camera
-  cv::RNG *rnd_gen; //!< randomn number generator for sampling from a uniform distribution
+  double fx_, fy_, cx_, cy_; //!< the RGB camera intrinsics (copied out of rgb_camera_intrinsics for the error model)
+  double k1_, k2_, p1_, p2_, k3_; //!< the RGB camera distortion (copied out of rgb_distortion for the error model)
   bool optimizer_enabled_; //!< flag for when optimization is enabled and the solution will be optimized after RANSAC
 
+  uint64_t seed_; //!< the seed for the sample generator
+  uint64_t run_counter_; //!< the number of times runRANSAC has been called since the seed was set
+
+  //point storage (struct of arrays), reused from frame to frame:
+  std::vector<double> ref_x_, ref_y_, ref_z_; //!< the reference 3D points
+  std::vector<double> cur_x_, cur_y_, cur_z_; //!< the current 3D points
+  std::vector<double> cur_u_, cur_v_; //!< the current 2D points
+  std::vector<int> sample_table_; //!< the 3 indices sampled for each iteration (3*iterations_ long)
+
   //methods
   /*!
    *  \brief computeErrorModel projects the reference 3D points onto the current image frame to find inliers.
    *
-   *  \param reference3D are the 3D points from the reference image features
-   *  \param current2D are the 2D feature locations from the curreent image
+   *  This works on the point storage (ref_x_, cur_u_, etc.) filled by runRANSAC.  It uses the same camera model as
+   *  cv::projectPoints (pinhole with the 5 parameter plumb bob distortion), but doesn't allocate.
+   *
    *  \param rotation is the rotation matrix predicted from the random three points
    *  \param translation is the translation between the random three points.
-   *  \param error is the vector containing the reprojection error returned by the method (same length as feature vectors)
-   *  \param inliers is the vector containing the location of the inliers (the size of inliers is the number of inliers)
-   *         i.e. [1,5,8,17,24] gives 5 inliers at positions 1,5,8,etc. in reference3D and current2D. This is also returned.
+   *  \param inlier_count is the number of inliers, returned
+   *  \param inliers is optional, if it isn't NULL the location of the inliers are appended to it
+   *         i.e. [1,5,8,17,24] gives 5 inliers at positions 1,5,8,etc. in reference3D and current2D.
    *  \returns The method returns the sum of errors (these are squared errors)
   */
-  double computeErrorModel(std::vector<cv::Point3d> &reference3D,
-                           std::vector<cv::Point2f> &current2D,
-                           cv::Mat &rotation,
-                           cv::Mat &translation,
-                           std::vector<double> *error,
-                           std::vector<int> *inliers);
+  double computeErrorModel(const Eigen::Matrix3d &rotation,
+                           const Eigen::Vector3d &translation,
+                           int *inlier_count,
+                           std::vector<int> *inliers = NULL);
+
+
+  /*!
+   *  \brief computeMinimalTransformation is computeSampleTransformation for the three sampled points.  It uses fixed
+   *  size (stack) matrices and reads the points out of the point storage.
+   *
+   *  \param index are the three sampled indices
+   *  \param rotation is the rotation matrix returned by the method
+   *  \param translation is the translation returned by the method
+  */
+  void computeMinimalTransformation(const int *index, Eigen::Matrix3d *rotation, Eigen::Vector3d *translation);
 
 
 
@@ -209,75 +256,55 @@ protected:
   void solveQuartic(cv::Mat_<double> factors, cv::Mat_<double> real_roots);
 
 
-  /*!
-   *  \brief This method samples from the reference and current points and returns vector of 3 points for each
-   *
-   *  It is called within runRANSAC.
-   *
-   *  \param reference_points are the 3D points from the reference image
-   *  \param current_points are the 3D points from the current image
-   *  \param current2D_points are the 2D feature points on the current image
-   *  \param reference_sample are the 3 3D points from reference_points returned to be used the RANSAC iteration
-   *  \param current_sample are the 3 3D points from current_points returned for use in the RANSAC iteration
-   *  \param current2D_sample are the 3 2D feature points from the current image returned (for P3P)
-   *  \param list is the list of indicies used for the sample (to pass on for covariance estimation)
-  */
-  inline void sample(std::vector<cv::Point3d> &reference_points,
-              std::vector<cv::Point3d> &current_points,
-              std::vector<cv::Point2f> &current2D_points,
-              std::vector<cv::Point3d> *reference_sample,
-              std::vector<cv::Point3d> *current_sample,
-              std::vector<cv::Point2d> *current2D_sample,
-              std::vector<int> *list)
+  /// The SplitMix64 finalizer, which is used as a counter-based generator (the output only depends on the input)
+  static inline uint64_t mix64(uint64_t z)
   {
-    //obtain samples for the indicies
-    QList<int> sample_set;
-    sample_set = uniformSampler(3, 0, reference_points.size()); // 3 is the minimal model parameterization.
-
-    //make sure samples are empty
-    if(!reference_sample->empty())
-      reference_sample->clear();
-
-    if(!current_sample->empty())
-      current_sample->clear();
-
-    //load the samples in
-    for(int i = 0; i< sample_set.count(); i++)
-    {
-      reference_sample->push_back(reference_points[sample_set[i]]);
-      current_sample->push_back(current_points[sample_set[i]]);
-      current2D_sample->push_back(current2D_points[sample_set[i]]);
-      list->push_back(sample_set[i]);
-    }
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
   }
 
 
+  /// Maps a 32 bit random number onto [0, n) with a multiply and shift (no division, no branches)
+  static inline uint32_t reduce(uint32_t random, uint32_t n)
+  {
+    return (uint32_t)(((uint64_t)random * (uint64_t)n) >> 32);
+  }
+
 
   /*!
-   *  \brief Used by sample to find # indicies for the # samples.
+   *  \brief Finds 3 distinct indices in [0, n) for an iteration of RANSAC, without branches or rejection.
    *
-   *  This uses a hash set for speed.  OpenCV's RNG class is used to provide the uniform distribution.
+   *  The second index is drawn from n - 1 values and the third from n - 2 values, and they are shifted up past the
+   *  indices already taken.  Comparisons produce 0 or 1, so the shifts are just additions.
    *
-   *  \param number_samples is the number of samples needed (3) is the minimum
-   *  \param min is the minimum value to sample from  (0);
-   *  \param max is the maximum value to sample from (the length of the 3D features)
-   *  \returns Qlist with the indicies of the samples
+   *  \param stream is the per-run key (from the seed and the run counter)
+   *  \param iteration is the RANSAC iteration
+   *  \param n is the number of points (must be more than 3)
+   *  \param index is where the 3 indices are returned
   */
-  inline QList<int> uniformSampler(int number_samples, int min, int max)
+  static inline void sampleIndices(uint64_t stream, uint64_t iteration, uint32_t n, int *index)
   {
-    QSet<int> sample;
-    int value;
-    while(sample.count() < number_samples)
-    {
-      value = 0;
-      value = rnd_gen->uniform(min, max);
-      if(!sample.contains(value))
-        sample.insert(value);
-    }
-    return sample.toList();
+    uint64_t r1 = mix64(stream + (2*iteration + 1)*0x9e3779b97f4a7c15ULL);
+    uint64_t r2 = mix64(stream + (2*iteration + 2)*0x9e3779b97f4a7c15ULL);
+
+    uint32_t i0 = reduce((uint32_t)r1, n);
+    uint32_t i1 = reduce((uint32_t)(r1 >> 32), n - 1);
+    i1 += (i1 >= i0);
+    uint32_t lo = std::min(i0, i1);
+    uint32_t hi = std::max(i0, i1);
+    uint32_t i2 = reduce((uint32_t)r2, n - 2);
+    i2 += (i2 >= lo);
+    i2 += (i2 >= hi);
+
+    index[0] = (int)i0;
+    index[1] = (int)i1;
+    index[2] = (int)i2;
   }
 
 
 };
 
+}
+
 #endif
@@ -27,10 +27,12 @@
 #include <message_filters/sync_policies/approximate_time.h>
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/image_encodings.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <cv_bridge/cv_bridge.h>
 #include <geometry_msgs/TransformStamped.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include <fstream>
 #include <iostream>
 #include <stdio.h>
@@ -43,12 +45,16 @@
 #include <boost/array.hpp>
 
 #include "pose_estimator.h"
+#include "depth_image.h"
+#include "keyframe_archive.h"
+#include "latency_trace.h"
 //#include "image_display.h"
 #include "kinect_vo/kinect_vo_message.h"
 #include "kinect_vo/request_new_reference.h"
 #include "evart_bridge/transform_plus.h"
 
-
+namespace kinect_vo
+{
 
 extern pthread_mutex_t mutex_; //!< mutex to change "set_next_as_ref_"
 
@@ -82,9 +88,10 @@ public:
    *  The relavent topics are advertised and subscribed to and
    *  \todo the processing class is instatiated!
    *
-   *  \param nh the handle for the ROS node started by main
+   *  \param nh the handle for the ROS node started by main (or the nodelet), topics are relative to it
+   *  \param private_nh the private handle, the parameters are read from it
   */
-  ROSRelay(ros::NodeHandle &nh);
+  ROSRelay(ros::NodeHandle &nh, ros::NodeHandle &private_nh);
 
   /*!
    *  \brief The destructor, it destroys things...
@@ -160,6 +167,7 @@ protected:
   ros::Publisher rgb_keyframe_pub_; //!< publish keyframe RGB images
   ros::Publisher depth_keyframe_pub_; //!< publishe the keyframe depth images
   ros::Publisher rgb_camera_info_pub_; //!< republishes the RGB camera info
+  ros::Publisher timing_publisher_; //!< publishes the stage timing summaries (diagnostic_msgs/DiagnosticArray)
   ros::Subscriber mocap_subscribe_; //!< ROS subscriber for bringing in motion capture data.
   ros::Subscriber rotation_subscriber_; //!< ROS subscriber for bringing in an estimate of the rotation and translation
   //! between images.
@@ -171,18 +179,26 @@ protected:
   bool save_show_images_; //!< flag for enabling the display and saving of images
   bool enable_logging_; //!< flag for enabling logs (truth expressed in relative sense and VO logs)
   bool publish_keyframes_; //!< flag for enabling republishing keyframe images
+  bool keyframe_depth_float_; //!< republish the keyframe depth as float meters (for older consumers) instead of 16 bit
+  bool compress_keyframes_; //!< publish the keyframes compressed (by keyframe_archive_) instead of raw
   bool set_next_as_ref_; //!< this bool sets the next current image as the reference image.
   bool set_as_reference_; //!< if the current is set as reference
   bool set_mocap_as_ref_; //!< to tell the motion capture function to set the next value as reference
+  bool enable_timing_; //!< flag for enabling the stage timing (and publishing it)
+  int timing_window_; //!< the number of frames summarized in each timing message
+  LatencyTrace latency_trace_; //!< publishes the VO stages of the camera frame to motor command trace
+  uint32_t trace_id_; //!< the trace id given to the last published frame (0 until one is published)
 
   evart_bridge::transform_plus ref_pose_; //!< the reference pose using motion capture data
 
   cv::Mat depth_mono8_image_; //!< the depth image 8 bit image for masking
+  cv::Mat depth_mm_buffer_; //!< the depth image quantized to 16 bit millimeters (only used when it arrives as float)
   cv::Mat visual_image_; //!< the color image
 
   bool process_images_; //!< flag for whether or not the images should be processed             (NECESSARY????)
 
   PoseEstimator *pose_estimator_; //!< instance of the pose estimator to calculate the change in pose between two images
+  KeyframeArchive *keyframe_archive_; //!< compresses, publishes, and stores the keyframes (NULL when not used)
 
   cv::Mat rotation_estimate_; //!< The current rotation estimate between the reference camera and the current camera
 
@@ -207,21 +223,32 @@ protected:
 
   //Methods:
   /*!
-   *  \brief This function, taken from the RGBDSLAM package, makes the depth image into a mono,
-   *  so that it can be used as a mask.
+   *  \brief Brings the depth image into the 16 bit millimeter format used by the visual odometry.  16UC1 images are used
+   *  in place (no copy), float images (meters) are quantized into depth_mm_buffer_.
    *
-   *  \param float_img is the float version of the depth image (recieved over ROS)
-   *  \param mono8_img is an image of type CV_8UC1
-   *  \returns the mono8_img by reference
+   *  \param depth_image is the depth image message
+   *  \param depth_mm is the returned CV_16UC1 image (it may share the data of the message, so it is read only)
+   *  \returns false if the encoding of the depth image is not supported
   */
-  inline void depthToCV8UC1(const cv::Mat& float_img, cv::Mat& mono8_img)
-  {
-    if(mono8_img.rows != float_img.rows || mono8_img.cols != float_img.cols)
-    {
-      mono8_img = cv::Mat(float_img.size(), CV_8UC1);
-    }
-    cv::convertScaleAbs(float_img, mono8_img, 100, 0.0);
-  }
+  bool depthToMillimeters(const sensor_msgs::ImageConstPtr &depth_image, cv::Mat &depth_mm);
+
+
+  /*!
+   *  \brief Republishes the keyframe: the color image, the depth image (16 bit, or float if keyframe_depth_float_ is set)
+   *  and the RGB camera info, all with keyframe_index_ as the sequence number.  When the keyframe archive is enabled the
+   *  images are handed to it to be compressed and stored (and the raw images are only published if compress_keyframes_
+   *  is false).
+   *
+   *  \param rbg_image is the color image from the kinect
+   *  \param depth_image is the depth image message (its header is used)
+   *  \param depth_mm is the 16 bit depth image in millimeters
+   *  \param rgb_info is the RGB camera info
+  */
+  void publishKeyframe(const sensor_msgs::ImageConstPtr &rbg_image,
+                       const sensor_msgs::ImageConstPtr &depth_image,
+                       const cv::Mat &depth_mm,
+                       const sensor_msgs::CameraInfoConstPtr &rgb_info);
+
 
 
 
@@ -234,6 +261,15 @@ protected:
   std::string timeStructFilename(struct tm *time_struct);
 
 
+  /*!
+   *  \brief Publishes the p50/p95/p99/max of each processing stage (over the last timing_window_ frames) on the
+   *  timing topic, as a diagnostic_msgs::DiagnosticArray with one status per stage.  The histograms are then cleared.
+   *
+   *  \param stamp is the timestamp for the message
+  */
+  void publishTiming(ros::Time stamp);
+
+
   /*!
    * \brief Quick conversion between an Eigen Matrix and a Boost::array (and ensures positive covariance)
    * \param matrix is the Eigen matrix (comes in full)
@@ -270,4 +306,6 @@ protected:
 
 
 };
+
+}
 #endif
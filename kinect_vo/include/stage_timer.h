@@ -0,0 +1,250 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \package kinect_visual_odometry
+ *  \file stage_timer.h
+ *  \author agent
+ *  \date October 2026
+ *
+ *  \brief Provides the header for the StageTimer class, which times the individual stages of the visual odometry.
+*/
+
+#ifndef STAGE_TIMER_H
+#define STAGE_TIMER_H
+
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+namespace kinect_vo
+{
+
+/*!
+ *  \enum VOStage
+ *  \brief The processing stages of a visual odometry frame that are timed by the StageTimer.  STAGE_TOTAL covers
+ *  the whole frame (from the start of the kinect callback to the end of publishing).
+*/
+enum VOStage
+{
+  STAGE_DETECT = 0,   //!< FAST feature detection (grid adapted)
+  STAGE_DESCRIBE,     //!< smoothing and BRIEF descriptor extraction
+  STAGE_UNDISTORT,    //!< undistortPoints on the feature locations
+  STAGE_BACKPROJECT,  //!< calc3DPoints (depth lookup and back-projection)
+  STAGE_MATCH,        //!< the windowed masks and the forward/reverse matching
+  STAGE_RANSAC,       //!< runRANSAC
+  STAGE_COVARIANCE,   //!< the covariance of the transformation
+  STAGE_PUBLISH,      //!< filling and publishing the ROS messages (and the logs)
+  STAGE_TOTAL,        //!< the whole frame
+  NUM_STAGES
+};
+
+
+/*!
+ *  \struct StageStats
+ *  \brief The summary of the timing histogram for one stage.  All times are in microseconds.
+*/
+struct StageStats
+{
+  uint32_t count; //!< the number of samples in the histogram
+  double mean; //!< the mean time
+  double p50; //!< the median
+  double p95; //!< the 95th percentile
+  double p99; //!< the 99th percentile
+  double max; //!< the largest time recorded
+};
+
+
+/*!
+ *  \class StageTimer stage_timer.h "include/stage_timer.h"
+ *  \brief The StageTimer class provides low-overhead timing of each stage of the visual odometry.
+ *
+ *  The times are taken with the monotonic clock (not the ROS clock, which jumps when playing back bags) and they are
+ *  accumulated into a fixed-size log-linear histogram for each stage, so recording a time is a few integer operations and
+ *  never allocates.  The bins have 16 sub-bins per power of two, so the percentiles have a relative error of about 6%.
+ *
+ *  Optionally, a record for every frame (the time of each stage) is appended to a binary trace file, which can be
+ *  read back to compare runs.  The file starts with a TraceHeader and is followed by a TraceRecord for each frame.
+ *
+ *  \attention This class is not thread safe.  It is meant to be used from the thread that processes the images.
+*/
+class StageTimer
+{
+
+public:
+
+  static const int NUM_BINS = 480; //!< enough bins to cover any 32 bit time in microseconds
+
+  /*!
+   *  \struct TraceHeader
+   *  \brief The header at the start of the binary trace file
+  */
+  struct TraceHeader
+  {
+    char magic[4]; //!< "VOTR"
+    uint32_t version; //!< the version of the trace format (1)
+    uint32_t num_stages; //!< the number of stages in each record (NUM_STAGES)
+    uint32_t record_size; //!< sizeof(TraceRecord), to make reading easier
+  };
+
+  /*!
+   *  \struct TraceRecord
+   *  \brief One frame in the binary trace file
+  */
+  struct TraceRecord
+  {
+    double stamp; //!< the timestamp of the image (seconds)
+    uint32_t seq; //!< the sequence number of the image
+    uint32_t flags; //!< bit 0: the frame was used as a reference, bit 1: the frame was dropped
+    uint32_t stage_us[NUM_STAGES]; //!< the time spent in each stage (zero if the stage did not run)
+  };
+
+  static const uint32_t FLAG_REFERENCE = 0x1; //!< TraceRecord flag for a reference (key) frame
+  static const uint32_t FLAG_DROPPED = 0x2; //!< TraceRecord flag for a dropped frame
+
+
+  /*!
+   *  \brief The constructor clears the histograms.  The trace file is not opened until openTraceFile() is called.
+  */
+  StageTimer();
+
+
+  /*!
+   *  \brief The destructor flushes and closes the trace file (if open)
+  */
+  ~StageTimer();
+
+
+  /*!
+   *  \brief Opens a binary trace file, when it is open a record of every frame is appended in endFrame()
+   *  \param filename is the name of the file (it is truncated)
+   *  \returns true if the file was opened
+  */
+  bool openTraceFile(const std::string &filename);
+
+
+  /*!
+   *  \brief Closes the trace file
+  */
+  void closeTraceFile();
+
+
+  /// Read access to the monotonic clock in nanoseconds
+  static inline uint64_t now()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ULL + (uint64_t)ts.tv_nsec;
+  }
+
+
+  /*!
+   *  \brief Begin a new frame: clears the times for the current frame and starts the STAGE_TOTAL timer.
+   *  \param stamp is the image timestamp (seconds)
+   *  \param seq is the image sequence number
+  */
+  inline void beginFrame(double stamp, uint32_t seq)
+  {
+    memset(frame_.stage_us, 0, sizeof(frame_.stage_us));
+    frame_.stamp = stamp;
+    frame_.seq = seq;
+    frame_.flags = 0;
+    start(STAGE_TOTAL);
+  }
+
+
+  /*!
+   *  \brief End the frame: stops the STAGE_TOTAL timer, adds the frame to the histograms and writes the trace record.
+   *  \param flags are the TraceRecord flags for the frame
+  */
+  void endFrame(uint32_t flags = 0);
+
+
+  /// Start timing a stage
+  inline void start(int stage)
+  {
+    start_ns_[stage] = now();
+  }
+
+
+  /// Stop timing a stage, the time is added to the current frame (a stage can be started and stopped more than once)
+  inline void stop(int stage)
+  {
+    frame_.stage_us[stage] += (uint32_t)((now() - start_ns_[stage])/1000ULL);
+  }
+
+
+  /*!
+   *  \brief Computes the summary of the histogram for a stage
+   *  \param stage is the VOStage
+   *  \param stats is the returned summary
+  */
+  void summarize(int stage, StageStats *stats) const;
+
+
+  /// Clears the histograms (e.g. after the stats have been published, to get stats over a window)
+  void reset();
+
+
+  /// The number of frames in the histograms
+  inline uint32_t frames() const {return frames_;}
+
+
+  /// The name of a stage, for printing or publishing
+  static const char* stageName(int stage);
+
+
+  /*!
+   *  \class Scope
+   *  \brief Times a stage for the life of the object, i.e. StageTimer::Scope s(timer, STAGE_DETECT);
+  */
+  class Scope
+  {
+  public:
+    Scope(StageTimer &timer, int stage):timer_(timer),stage_(stage){timer_.start(stage_);}
+    ~Scope(){timer_.stop(stage_);}
+  private:
+    StageTimer &timer_;
+    int stage_;
+  };
+
+
+protected:
+
+  /// Map a time in microseconds to a histogram bin (16 linear sub-bins for each power of two)
+  static inline int binIndex(uint32_t us)
+  {
+    if(us < 16)
+      return (int)us;
+    int msb = 31 - __builtin_clz(us);
+    return (msb - 3)*16 + (int)((us >> (msb - 4)) & 15);
+  }
+
+  /// The smallest time (microseconds) that falls in a bin, the inverse of binIndex
+  static inline double binLowerBound(int bin)
+  {
+    if(bin < 16)
+      return (double)bin;
+    int msb = bin/16 + 3;
+    return (double)((uint64_t)(16 + bin%16) << (msb - 4));
+  }
+
+  uint32_t histogram_[NUM_STAGES][NUM_BINS]; //!< the histogram for each stage
+  uint64_t sum_us_[NUM_STAGES]; //!< the sum of the times (for the mean)
+  uint32_t max_us_[NUM_STAGES]; //!< the largest time for each stage
+  uint32_t count_[NUM_STAGES]; //!< the number of frames each stage ran in
+  uint32_t frames_; //!< the number of frames since the last reset
+
+  uint64_t start_ns_[NUM_STAGES]; //!< the start times of the running stages
+  TraceRecord frame_; //!< the times of the current frame
+
+  FILE *trace_file_; //!< the binary trace file (NULL when not tracing)
+};
+
+}
+
+#endif
@@ -0,0 +1,81 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \package kinect_visual_odometry
+ *  \file timing_table.h
+ *  \author agent
+ *  \date October 2026
+ *
+ *  \brief Provides the table of times (count, mean, percentiles and max) that the benchmark and replay tools print.
+ *  It is header only (in the kinect_vo namespace), so the estimator and the control tools use it without linking to
+ *  the VO.
+*/
+
+#ifndef TIMING_TABLE_H
+#define TIMING_TABLE_H
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+namespace kinect_vo
+{
+
+/*!
+ *  \brief Returns the p-th percentile (0-100) of sorted values (nearest rank)
+*/
+inline double percentile(const std::vector<double> &sorted, double p)
+{
+  int rank = (int)std::ceil(p/100.0*sorted.size()) - 1;
+  rank = std::max(0, std::min((int)sorted.size() - 1, rank));
+  return sorted[rank];
+}
+
+
+/*!
+ *  \brief Prints the heading of a table of times
+ *
+ *  \param title is the heading of the name column (e.g. "Part (us)")
+ *  \param name_width is the width of the name column
+*/
+inline void printTimesHeader(const std::string &title, int name_width)
+{
+  std::cout << std::left << std::setw(name_width) << title << std::right << std::setw(8) << "count"
+            << std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+            << std::setw(10) << "max" << std::endl;
+}
+
+
+/*!
+ *  \brief Prints one line of a table of times (or of any other values), in the precision set on std::cout
+ *
+ *  \param name is the name of the line
+ *  \param times are the values, in any order
+ *  \param name_width is the width of the name column
+*/
+inline void printTimes(const std::string &name, std::vector<double> times, int name_width)
+{
+  std::cout << std::left << std::setw(name_width) << name << std::right << std::setw(8) << times.size();
+  if(times.empty())
+  {
+    std::cout << std::endl;
+    return;
+  }
+  std::sort(times.begin(), times.end());
+  double sum = 0.0;
+  for(int i = 0; i < (int)times.size(); i++)
+    sum += times[i];
+  std::cout << std::setw(10) << sum/times.size() << std::setw(10) << percentile(times, 50.0)
+            << std::setw(10) << percentile(times, 90.0) << std::setw(10) << percentile(times, 99.0)
+            << std::setw(10) << times.back() << std::endl;
+}
+
+}
+
+#endif
@@ -0,0 +1,499 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*! \file benchmark.cpp
+  * \author agent
+  * \date October 2026
+  * \brief benchmark.cpp runs the PoseEstimator offline on a recorded RGB-D sequence and reports the speed (frames per
+  * second and the time of each stage) and the accuracy (drift against the motion capture truth).
+  *
+  * Usage:
+  * \code
+  *   vo_benchmark <sequence_dir> [--truth cortex.txt] [--seed N] [--threads N] [--trace file] [--optimize] [--max N]
+  * \endcode
+  *
+  * The sequence directory contains:
+  *  - frames.txt, one frame per line: "<stamp> <rgb_file> <depth_file>" (paths are relative to the directory, lines
+  *    starting with # are skipped)
+  *  - camera_info.yml, an OpenCV FileStorage file with the RGB calibration: the matrices "K" (3x3), "D" (1x5), "P" (3x4)
+  *
+  * Depth images can be 16 bit PNGs in millimeters (zero is no depth) or float images in meters, saved with
+  * cv::FileStorage under the name "depth" (.yml, .xml, or .yml.gz).
+  *
+  * The truth is a cortex log written by ROSRelay when logging is enabled (vo_logs/cortex_*.txt).  Columns 9-15 of that
+  * file hold the inertial pose of the body, which is used to build the truth trajectory of the camera.  When a
+  * reference frame is replaced without an estimate (after dropped frames) the chain of VO estimates is broken, so it is
+  * started again from the truth at the new reference.  The final drift is then since the last of these re-anchors.
+  *
+  * The RANSAC sample generator is seeded (--seed, default 1) so runs can be compared.  The samples don't depend on the
+  * number of threads (--threads sets the OpenMP thread count).
+*/
+
+#include <ros/ros.h>
+#include <omp.h>
+#include <algorithm>
+#include "pose_estimator.h"
+
+using namespace Eigen;
+using namespace kinect_vo;
+
+
+/*!
+ *  \struct BenchFrame
+ *  \brief One entry from frames.txt
+*/
+struct BenchFrame
+{
+  double stamp;
+  std::string rgb_file;
+  std::string depth_file;
+};
+
+
+/*!
+ *  \struct TruthPose
+ *  \brief One line of the cortex log: the inertial pose of the body
+*/
+struct TruthPose
+{
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  double stamp;
+  Quaterniond q_i_b;
+  Vector3d t_i_b;
+};
+
+
+/*!
+ *  \brief Reads frames.txt
+ *  \returns false if the file couldn't be opened
+*/
+bool readFrameList(const std::string &directory, std::vector<BenchFrame> *frames)
+{
+  std::ifstream file((directory + "/frames.txt").c_str());
+  if(!file.is_open())
+    return false;
+
+  std::string line;
+  while(std::getline(file, line))
+  {
+    if(line.empty() || line[0] == '#')
+      continue;
+    std::istringstream in(line);
+    BenchFrame frame;
+    if(in >> frame.stamp >> frame.rgb_file >> frame.depth_file)
+    {
+      frame.rgb_file = directory + "/" + frame.rgb_file;
+      frame.depth_file = directory + "/" + frame.depth_file;
+      frames->push_back(frame);
+    }
+  }
+  return true;
+}
+
+
+/*!
+ *  \brief Reads camera_info.yml into a CameraInfo message, so it can be handed to PoseEstimator::setKinectCalibration
+ *  \returns false if the file couldn't be opened or is missing K
+*/
+bool readCameraInfo(const std::string &directory, sensor_msgs::CameraInfo *info)
+{
+  cv::FileStorage fs(directory + "/camera_info.yml", cv::FileStorage::READ);
+  if(!fs.isOpened())
+    return false;
+
+  cv::Mat K, D, P;
+  fs["K"] >> K;
+  fs["D"] >> D;
+  fs["P"] >> P;
+  if(K.empty())
+    return false;
+
+  K.convertTo(K, CV_64F);
+  for(int i = 0; i < 9; i++)
+    info->K[i] = K.at<double>(i/3, i%3);
+
+  info->D.clear();
+  if(!D.empty())
+  {
+    D.convertTo(D, CV_64F);
+    D = D.reshape(1, 1);
+    for(int i = 0; i < D.cols; i++)
+      info->D.push_back(D.at<double>(0,i));
+  }
+  while(info->D.size() < 5)
+    info->D.push_back(0.0); //RANSAC expects five coefficients
+
+  if(P.empty())
+  {
+    //no rectification, use K
+    P = cv::Mat::zeros(3,4,CV_64F);
+    K.copyTo(P(cv::Rect(0,0,3,3)));
+  }
+  P.convertTo(P, CV_64F);
+  for(int i = 0; i < 12; i++)
+    info->P[i] = P.at<double>(i/4, i%4);
+
+  info->width = (int)fs["width"];
+  info->height = (int)fs["height"];
+  info->distortion_model = "plumb_bob";
+  return true;
+}
+
+
+/*!
+ *  \brief Loads a depth image and returns it in millimeters (CV_16UC1, zero where there is no depth) like ROSRelay
+*/
+bool loadDepth(const std::string &filename, cv::Mat *depth_mm)
+{
+  if(filename.size() > 4 && filename.substr(filename.size() - 4) == ".png")
+  {
+    *depth_mm = cv::imread(filename, CV_LOAD_IMAGE_ANYDEPTH);
+    return !depth_mm->empty() && depth_mm->type() == CV_16UC1;
+  }
+
+  cv::FileStorage fs(filename, cv::FileStorage::READ);
+  if(!fs.isOpened())
+    return false;
+  cv::Mat depth_float;
+  fs["depth"] >> depth_float;
+  if(depth_float.empty() || depth_float.type() != CV_32FC1)
+    return false;
+  depthFloatToMillimeters(depth_float, *depth_mm);
+  return true;
+}
+
+
+/*!
+ *  \brief Reads the cortex log that ROSRelay writes (vo_logs/cortex_*.txt)
+*/
+bool readTruth(const std::string &filename, std::vector<TruthPose, aligned_allocator<TruthPose> > *truth)
+{
+  std::ifstream file(filename.c_str());
+  if(!file.is_open())
+    return false;
+
+  std::string line;
+  while(std::getline(file, line))
+  {
+    std::istringstream in(line);
+    double v[15];
+    int n = 0;
+    while(n < 15 && in >> v[n])
+      n++;
+    if(n < 15)
+      continue;
+
+    TruthPose pose;
+    pose.stamp = v[0];
+    pose.q_i_b = Quaterniond(v[8], v[9], v[10], v[11]);
+    pose.t_i_b = Vector3d(v[12], v[13], v[14]);
+    truth->push_back(pose);
+  }
+  return !truth->empty();
+}
+
+
+/// Compare by timestamp for the truth lookup
+inline bool truthBefore(const TruthPose &pose, double stamp){return pose.stamp < stamp;}
+
+
+/*!
+ *  \brief Finds the truth pose closest in time to stamp
+ *  \returns NULL if there isn't one within 20 ms
+*/
+const TruthPose* findTruth(const std::vector<TruthPose, aligned_allocator<TruthPose> > &truth, double stamp)
+{
+  std::vector<TruthPose, aligned_allocator<TruthPose> >::const_iterator it;
+  it = std::lower_bound(truth.begin(), truth.end(), stamp, truthBefore);
+
+  const TruthPose *best = NULL;
+  if(it != truth.end())
+    best = &(*it);
+  if(it != truth.begin() && (best == NULL || fabs((it - 1)->stamp - stamp) < fabs(best->stamp - stamp)))
+    best = &(*(it - 1));
+
+  if(best == NULL || fabs(best->stamp - stamp) > 0.02)
+    return NULL;
+  return best;
+}
+
+
+/*!
+ *  \brief Uses the same math as ROSRelay::motionCaptureCallback to express the truth as a transformation from the first
+ *  camera frame to the current camera frame (p^c = R p^r + T)
+*/
+void truthCameraTransform(const TruthPose &first, const TruthPose &current, Matrix3d *R, Vector3d *T)
+{
+  Matrix3d R_c_b;
+  R_c_b << 0,0,1,1,0,0,0,1,0;
+  Quaterniond q_c_b(R_c_b);
+  q_c_b = q_c_b.conjugate();
+
+  Quaterniond q_cr_cc = q_c_b * first.q_i_b.conjugate() * current.q_i_b * q_c_b.conjugate();
+  Quaterniond q_i_cc = current.q_i_b * q_c_b.conjugate();
+  *R = q_cr_cc.toRotationMatrix();
+  *T = q_i_cc.conjugate() * (first.t_i_b - current.t_i_b);
+}
+
+
+/*!
+ *  \brief The truth camera position in the first camera frame (see truthCameraTransform())
+*/
+Vector3d truthCameraPosition(const TruthPose &first, const TruthPose &current)
+{
+  Matrix3d R;
+  Vector3d T;
+  truthCameraTransform(first, current, &R, &T);
+  return -(R.transpose() * T);
+}
+
+
+/*!
+ *  \brief Runs the PoseEstimator over a recorded sequence, with the same keyframe logic as ROSRelay::kinectCallback.
+*/
+int main(int argc, char **argv)
+{
+  if(argc < 2)
+  {
+    std::cout << "Usage: vo_benchmark <sequence_dir> [--truth cortex.txt] [--seed N] [--threads N] [--trace file]"
+              << " [--optimize] [--max N]" << std::endl;
+    return 1;
+  }
+
+  std::string directory = argv[1];
+  std::string truth_file, trace_file;
+  uint64_t seed = 1;
+  int threads = 0;
+  bool optimize = false;
+  int max_frames = -1;
+
+  for(int i = 2; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if(arg == "--truth" && i + 1 < argc)
+      truth_file = argv[++i];
+    else if(arg == "--seed" && i + 1 < argc)
+      seed = strtoull(argv[++i], NULL, 10);
+    else if(arg == "--threads" && i + 1 < argc)
+      threads = atoi(argv[++i]);
+    else if(arg == "--trace" && i + 1 < argc)
+      trace_file = argv[++i];
+    else if(arg == "--max" && i + 1 < argc)
+      max_frames = atoi(argv[++i]);
+    else if(arg == "--optimize")
+      optimize = true;
+    else
+    {
+      std::cout << "Unknown argument: " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  //The ROS console macros need the clock, but there is no node:
+  ros::Time::init();
+
+  if(threads > 0)
+    omp_set_num_threads(threads);
+
+  std::vector<BenchFrame> frames;
+  if(!readFrameList(directory, &frames) || frames.empty())
+  {
+    std::cout << "Unable to read " << directory << "/frames.txt" << std::endl;
+    return 1;
+  }
+
+  sensor_msgs::CameraInfoPtr rgb_info(new sensor_msgs::CameraInfo);
+  if(!readCameraInfo(directory, rgb_info.get()))
+  {
+    std::cout << "Unable to read " << directory << "/camera_info.yml" << std::endl;
+    return 1;
+  }
+
+  std::vector<TruthPose, aligned_allocator<TruthPose> > truth;
+  if(!truth_file.empty() && !readTruth(truth_file, &truth))
+  {
+    std::cout << "Unable to read the truth file " << truth_file << std::endl;
+    return 1;
+  }
+
+  if(max_frames > 0 && (int)frames.size() > max_frames)
+    frames.resize(max_frames);
+
+  PoseEstimator estimator(optimize, false);
+  estimator.setRandomSeed(seed);
+  estimator.setKinectCalibration(rgb_info, rgb_info);
+  StageTimer &timer = estimator.stageTimer();
+  if(!trace_file.empty() && !timer.openTraceFile(trace_file))
+    std::cout << "Unable to open the trace file " << trace_file << std::endl;
+
+  //the chained VO estimate: transformation from the first camera frame to the reference camera frame
+  Matrix3d R_w_ref = Matrix3d::Identity();
+  Vector3d T_w_ref = Vector3d::Zero();
+
+  const TruthPose *first_truth = truth.empty() ? NULL : findTruth(truth, frames[0].stamp);
+  double error_sq_sum = 0.0, final_error = 0.0, truth_path = 0.0;
+  int error_count = 0, anchors = 0;
+  bool chain_valid = true; //false from a reference replaced without an estimate or truth, until the next re-anchor
+  Vector3d last_truth_position = Vector3d::Zero();
+
+  int processed = 0, dropped = 0, keyframes = 0, skipped = 0;
+  bool set_next_as_ref = false;
+  int dropped_frames = 0;
+  cv::Mat rotation_guess = cv::Mat::zeros(3,3,CV_64FC1);
+
+  uint64_t load_ns = 0;
+  uint64_t run_start = StageTimer::now();
+
+  for(size_t f = 0; f < frames.size(); f++)
+  {
+    uint64_t load_start = StageTimer::now();
+    cv::Mat bgr = cv::imread(frames[f].rgb_file, CV_LOAD_IMAGE_COLOR);
+    cv::Mat depth_mm, depth_mono8;
+    if(bgr.empty() || !loadDepth(frames[f].depth_file, &depth_mm))
+    {
+      std::cout << "Skipping frame " << f << ", unable to load the images" << std::endl;
+      skipped++;
+      continue;
+    }
+    cv::Mat rgb;
+    cv::cvtColor(bgr, rgb, CV_BGR2RGB); //the kinect driver publishes rgb8
+    depthMillimetersToMask(depth_mm, depth_mono8); //same as ROSRelay
+    load_ns += StageTimer::now() - load_start;
+
+    timer.beginFrame(frames[f].stamp, (uint32_t)f);
+    uint32_t flags = 0;
+
+    if(!estimator.readReferenceSet())
+    {
+      estimator.setReferenceView(rgb, depth_mm, depth_mono8);
+      flags = StageTimer::FLAG_REFERENCE;
+      keyframes++;
+    }
+    else
+    {
+      bool set_as_reference = set_next_as_ref;
+      set_next_as_ref = false;
+
+      Quaterniond rotation, rot_optimized;
+      Vector3d translation, tran_optimized;
+      Matrix<double,7,7> covariance;
+      int inliers = 0, corresponding = 0, total = 0;
+      int result = estimator.setCurrentAndFindTransform(rgb, depth_mm, depth_mono8, &rotation, &translation,
+                                                        &covariance, &inliers, &corresponding, &total,
+                                                        set_as_reference, &rot_optimized, &tran_optimized,
+                                                        rotation_guess);
+      if(set_as_reference)
+        flags |= StageTimer::FLAG_REFERENCE;
+
+      if(result != 0)
+      {
+        Matrix3d R_ref_cur = rotation.toRotationMatrix();
+        Matrix3d R_w_cur = R_ref_cur * R_w_ref;
+        Vector3d T_w_cur = R_ref_cur * T_w_ref + translation;
+
+        //same keyframe rule as ROSRelay:
+        Vector3d euler = R_ref_cur.eulerAngles(2,1,0);
+        if(total > 200 && (euler(1) > 0.15 || translation.norm() >= 0.25) && !set_as_reference)
+          set_next_as_ref = true;
+
+        if(set_as_reference)
+        {
+          R_w_ref = R_w_cur;
+          T_w_ref = T_w_cur;
+          keyframes++;
+        }
+
+        if(dropped_frames > 0)
+          dropped_frames--;
+
+        //compare the camera position to the truth:
+        if(!truth.empty() && chain_valid)
+        {
+          const TruthPose *current = findTruth(truth, frames[f].stamp);
+          if(current != NULL && first_truth != NULL)
+          {
+            Vector3d vo_position = -(R_w_cur.transpose() * T_w_cur);
+            Vector3d truth_position = truthCameraPosition(*first_truth, *current);
+            double error = (vo_position - truth_position).norm();
+            error_sq_sum += error*error;
+            error_count++;
+            final_error = error;
+            truth_path += (truth_position - last_truth_position).norm();
+            last_truth_position = truth_position;
+          }
+        }
+        processed++;
+      }
+      else
+      {
+        flags |= StageTimer::FLAG_DROPPED;
+        dropped++;
+        dropped_frames++;
+        if(dropped_frames > 1)
+        {
+          set_next_as_ref = true;
+          dropped_frames = 0;
+        }
+        if(set_as_reference)
+        {
+          //the reference was replaced without an estimate, so the chain has to start again from the truth there:
+          keyframes++;
+          const TruthPose *current = truth.empty() ? NULL : findTruth(truth, frames[f].stamp);
+          chain_valid = (current != NULL && first_truth != NULL);
+          if(chain_valid)
+          {
+            truthCameraTransform(*first_truth, *current, &R_w_ref, &T_w_ref);
+            anchors++;
+          }
+        }
+      }
+    }
+
+    timer.endFrame(flags);
+  }
+
+  double run_seconds = (double)(StageTimer::now() - run_start)*1e-9;
+  double process_seconds = run_seconds - (double)load_ns*1e-9;
+
+  //Report:
+  std::cout.precision(4);
+  std::cout << std::fixed;
+  //the frames that couldn't be loaded never reached the estimator, so they don't count in the rate
+  std::cout << "Frames: " << frames.size() << "  skipped: " << skipped << "  estimated: " << processed
+            << "  dropped: " << dropped << "  keyframes: " << keyframes << "  seed: " << seed << std::endl;
+  std::cout << "Processing: " << (double)(frames.size() - skipped)/process_seconds << " frames/s (" << process_seconds
+            << " s, excluding " << (double)load_ns*1e-9 << " s of image loading)" << std::endl;
+
+  std::cout << std::endl << "Stage           count     mean      p50      p95      p99      max  (microseconds)"
+            << std::endl;
+  for(int i = 0; i < NUM_STAGES; i++)
+  {
+    StageStats stats;
+    timer.summarize(i, &stats);
+    printf("%-12s %8u %8.0f %8.0f %8.0f %8.0f %8.0f\n", StageTimer::stageName(i), stats.count, stats.mean,
+           stats.p50, stats.p95, stats.p99, stats.max);
+  }
+
+  if(!truth.empty())
+  {
+    std::cout << std::endl;
+    if(error_count > 0)
+    {
+      std::cout << "Position RMS error: " << sqrt(error_sq_sum/error_count) << " m over " << error_count
+                << " frames" << std::endl;
+      std::cout << "Final drift: " << final_error << " m over " << truth_path << " m of travel";
+      if(truth_path > 0.0)
+        std::cout << " (" << 100.0*final_error/truth_path << "%)";
+      std::cout << std::endl;
+      if(anchors > 0)
+        std::cout << "Re-anchored on the truth " << anchors << " times after dropped references (the drift is since"
+                  << " the last)" << std::endl;
+    }
+    else
+      std::cout << "No frames matched the truth timestamps" << std::endl;
+  }
+
+  return 0;
+}
@@ -5,6 +5,8 @@
   */
 #include "image_display.h"
 
+namespace kinect_vo
+{
 
 ImageDisplay::ImageDisplay(std::string window_name):name(window_name)
 {
@@ -25,3 +27,5 @@ ImageDisplay::~ImageDisplay()
 {
   cv::destroyAllWindows();
 }
+
+}
@@ -0,0 +1,522 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file keyframe_archive.cpp
+ *  \author agent
+ *  \date October 2026
+ *
+ *  \brief This implements the methods outlined in keyframe_archive.h
+*/
+
+#include "keyframe_archive.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace kinect_vo
+{
+
+//
+// Constructor: start the worker thread
+//
+KeyframeArchive::KeyframeArchive(int jpeg_quality)
+  : jpeg_quality_(jpeg_quality),
+    data_file_(NULL),
+    index_file_(NULL),
+    run_(0),
+    camera_info_written_(false),
+    dropped_(0),
+    shutdown_(false)
+{
+  pthread_mutex_init(&queue_mutex_, NULL);
+  pthread_mutex_init(&store_mutex_, NULL);
+  pthread_cond_init(&queue_cond_, NULL);
+  pthread_create(&thread_, NULL, &KeyframeArchive::threadEntry, this);
+}
+
+
+//
+// Destructor: finish the queue, stop the thread, close the files
+//
+KeyframeArchive::~KeyframeArchive()
+{
+  pthread_mutex_lock(&queue_mutex_);
+    shutdown_ = true;
+    pthread_cond_signal(&queue_cond_);
+  pthread_mutex_unlock(&queue_mutex_);
+  pthread_join(thread_, NULL);
+
+  if(data_file_ != NULL)
+    fclose(data_file_);
+  if(index_file_ != NULL)
+    fclose(index_file_);
+
+  pthread_cond_destroy(&queue_cond_);
+  pthread_mutex_destroy(&store_mutex_);
+  pthread_mutex_destroy(&queue_mutex_);
+}
+
+
+//
+// Open (or create) the store, new keyframes are appended to it
+//
+bool KeyframeArchive::openStore(const std::string &directory)
+{
+  int error = mkdir(directory.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+  if(error && errno != EEXIST)
+    return false;
+
+  pthread_mutex_lock(&store_mutex_);
+  directory_ = directory;
+
+  if(data_file_ != NULL)
+    fclose(data_file_);
+  if(index_file_ != NULL)
+    fclose(index_file_);
+
+  //the node IDs start over each run, so this run stores its keyframes under the run after the last one in the index:
+  run_ = 0;
+  FILE *existing = fopen((directory_ + "/keyframes.idx").c_str(), "rb");
+  if(existing != NULL)
+  {
+    KeyframeIndexRecord last;
+    fseeko(existing, 0, SEEK_END);
+    off_t records = (ftello(existing) - (off_t)sizeof(KeyframeIndexHeader))/(off_t)sizeof(KeyframeIndexRecord);
+    if(records > 0 && fseeko(existing, sizeof(KeyframeIndexHeader) + (records - 1)*sizeof(last), SEEK_SET) == 0 &&
+       fread(&last, sizeof(last), 1, existing) == 1)
+      run_ = last.run + 1;
+    fclose(existing);
+  }
+
+  data_file_ = fopen((directory_ + "/keyframes.dat").c_str(), "ab");
+  index_file_ = fopen((directory_ + "/keyframes.idx").c_str(), "ab");
+  bool opened = (data_file_ != NULL && index_file_ != NULL);
+
+  if(opened)
+  {
+    //a new index starts with the header:
+    fseeko(index_file_, 0, SEEK_END);
+    if(ftello(index_file_) == 0)
+    {
+      KeyframeIndexHeader header;
+      memcpy(header.magic, "VOKF", 4);
+      header.version = 2;
+      header.record_size = sizeof(KeyframeIndexRecord);
+      header.reserved = 0;
+      fwrite(&header, sizeof(header), 1, index_file_);
+      fflush(index_file_);
+    }
+  }
+  else
+  {
+    if(data_file_ != NULL)
+      fclose(data_file_);
+    if(index_file_ != NULL)
+      fclose(index_file_);
+    data_file_ = NULL;
+    index_file_ = NULL;
+  }
+  camera_info_written_ = false;
+  pthread_mutex_unlock(&store_mutex_);
+
+  return opened;
+}
+
+
+//
+// Set the publishers for the compressed images
+//
+void KeyframeArchive::setPublishers(const ros::Publisher &rgb_publisher, const ros::Publisher &depth_publisher)
+{
+  pthread_mutex_lock(&queue_mutex_);
+    rgb_publisher_ = rgb_publisher;
+    depth_publisher_ = depth_publisher;
+  pthread_mutex_unlock(&queue_mutex_);
+}
+
+
+//
+// Queue up a keyframe
+//
+void KeyframeArchive::addKeyframe(const std_msgs::Header &header, const cv::Mat &rgb_image, const cv::Mat &depth_mm,
+                                  const sensor_msgs::CameraInfo &rgb_info)
+{
+  Job job;
+  job.header = header;
+  job.rgb = rgb_image; //ROSRelay makes a new color image every frame, so sharing it is fine
+  job.depth_mm = depth_mm.clone(); //the depth can point into the message, which won't be around for the worker
+  job.rgb_info = rgb_info;
+
+  pthread_mutex_lock(&queue_mutex_);
+    bool full = ((int)queue_.size() >= MAX_QUEUE_);
+    if(full)
+    {
+      dropped_++;
+    }
+    else
+    {
+      queue_.push_back(job);
+      pthread_cond_signal(&queue_cond_);
+    }
+    int dropped = dropped_;
+  pthread_mutex_unlock(&queue_mutex_);
+
+  if(full)
+    ROS_WARN("VO: The keyframe archive is %d keyframes behind, keyframe %d is not compressed or stored (%d dropped)",
+             MAX_QUEUE_, header.seq, dropped);
+}
+
+
+//
+// The number of keyframes waiting
+//
+int KeyframeArchive::queued()
+{
+  pthread_mutex_lock(&queue_mutex_);
+    int size = (int)queue_.size();
+  pthread_mutex_unlock(&queue_mutex_);
+  return size;
+}
+
+
+//
+// The number of keyframes dropped
+//
+int KeyframeArchive::dropped()
+{
+  pthread_mutex_lock(&queue_mutex_);
+    int dropped = dropped_;
+  pthread_mutex_unlock(&queue_mutex_);
+  return dropped;
+}
+
+
+//
+// Start the thread
+//
+void* KeyframeArchive::threadEntry(void *archive)
+{
+  static_cast<KeyframeArchive*>(archive)->run();
+  return NULL;
+}
+
+
+//
+// The worker thread: wait for a keyframe, compress it and store it
+//
+void KeyframeArchive::run()
+{
+  while(true)
+  {
+    pthread_mutex_lock(&queue_mutex_);
+    while(queue_.empty() && !shutdown_)
+      pthread_cond_wait(&queue_cond_, &queue_mutex_);
+
+    if(queue_.empty())
+    {
+      //shutdown, and everything has been written:
+      pthread_mutex_unlock(&queue_mutex_);
+      return;
+    }
+
+    Job job = queue_.front();
+    queue_.pop_front();
+    pthread_mutex_unlock(&queue_mutex_);
+
+    process(job);
+  }
+}
+
+
+//
+// Encode the keyframe, publish it, and put it in the store
+//
+void KeyframeArchive::process(Job &job)
+{
+  std::vector<uchar> rgb_data, depth_data;
+
+  //the color image comes in as rgb8, imencode expects bgr:
+  cv::Mat bgr;
+  cv::cvtColor(job.rgb, bgr, CV_RGB2BGR);
+  std::vector<int> jpeg_params(2);
+  jpeg_params[0] = CV_IMWRITE_JPEG_QUALITY;
+  jpeg_params[1] = jpeg_quality_;
+  if(!cv::imencode(".jpg", bgr, rgb_data, jpeg_params))
+  {
+    ROS_WARN("VO: Unable to encode keyframe %d (color)", job.header.seq);
+    return;
+  }
+
+  //PNG keeps all 16 bits of the depth (lossless), and the large areas of zero depth compress well:
+  std::vector<int> png_params(2);
+  png_params[0] = CV_IMWRITE_PNG_COMPRESSION;
+  png_params[1] = 1; //fast, the higher levels cost a lot of time for little gain on depth images
+  if(!cv::imencode(".png", job.depth_mm, depth_data, png_params))
+  {
+    ROS_WARN("VO: Unable to encode keyframe %d (depth)", job.header.seq);
+    return;
+  }
+
+  pthread_mutex_lock(&queue_mutex_);
+    ros::Publisher rgb_publisher = rgb_publisher_;
+    ros::Publisher depth_publisher = depth_publisher_;
+  pthread_mutex_unlock(&queue_mutex_);
+
+  if(rgb_publisher)
+  {
+    sensor_msgs::CompressedImage rgb_msg;
+    rgb_msg.header = job.header;
+    rgb_msg.format = "jpeg";
+    rgb_msg.data = rgb_data;
+    rgb_publisher.publish(rgb_msg);
+  }
+  if(depth_publisher)
+  {
+    sensor_msgs::CompressedImage depth_msg;
+    depth_msg.header = job.header;
+    depth_msg.format = "png";
+    depth_msg.data = depth_data;
+    depth_publisher.publish(depth_msg);
+  }
+
+  appendToStore(job, rgb_data, depth_data);
+}
+
+
+//
+// Append the images and then the index record
+//
+void KeyframeArchive::appendToStore(const Job &job, const std::vector<uchar> &rgb_data,
+                                    const std::vector<uchar> &depth_data)
+{
+  pthread_mutex_lock(&store_mutex_);
+  if(data_file_ == NULL)
+  {
+    pthread_mutex_unlock(&store_mutex_);
+    return;
+  }
+
+  if(!camera_info_written_)
+  {
+    const sensor_msgs::CameraInfo &info = job.rgb_info;
+    cv::Mat K = (cv::Mat_<double>(3,3) << info.K[0], info.K[1], info.K[2],
+                                          info.K[3], info.K[4], info.K[5],
+                                          info.K[6], info.K[7], info.K[8]);
+    cv::Mat P = (cv::Mat_<double>(3,4) << info.P[0], info.P[1], info.P[2], info.P[3],
+                                          info.P[4], info.P[5], info.P[6], info.P[7],
+                                          info.P[8], info.P[9], info.P[10], info.P[11]);
+    cv::Mat D(1, (int)info.D.size(), CV_64FC1);
+    for(int i = 0; i < (int)info.D.size(); i++)
+      D.at<double>(0,i) = info.D[i];
+
+    cv::FileStorage fs(directory_ + "/camera_info.yml", cv::FileStorage::WRITE);
+    fs << "width" << (int)info.width << "height" << (int)info.height << "K" << K << "D" << D << "P" << P;
+    camera_info_written_ = true;
+  }
+
+  KeyframeIndexRecord record;
+  memset(&record, 0, sizeof(record));
+  record.node_id = job.header.seq;
+  record.run = run_;
+  record.stamp = job.header.stamp.toSec();
+
+  fseeko(data_file_, 0, SEEK_END);
+  record.rgb_offset = (uint64_t)ftello(data_file_);
+  record.rgb_size = (uint32_t)rgb_data.size();
+  record.depth_offset = record.rgb_offset + record.rgb_size;
+  record.depth_size = (uint32_t)depth_data.size();
+
+  bool written = (fwrite(&rgb_data[0], 1, rgb_data.size(), data_file_) == rgb_data.size() &&
+                  fwrite(&depth_data[0], 1, depth_data.size(), data_file_) == depth_data.size());
+
+  //the data has to be on disk before the index points at it (synced, so a crash can't leave a record without it):
+  if(written && fflush(data_file_) == 0 && fsync(fileno(data_file_)) == 0)
+  {
+    fwrite(&record, sizeof(record), 1, index_file_);
+    fflush(index_file_);
+  }
+  else
+  {
+    ROS_WARN("VO: Unable to write keyframe %d to the store in %s", job.header.seq, directory_.c_str());
+  }
+  pthread_mutex_unlock(&store_mutex_);
+}
+
+
+
+//
+// KeyframeStore constructor
+//
+KeyframeStore::KeyframeStore():data_file_(NULL),index_file_(NULL)
+{
+}
+
+
+//
+// KeyframeStore destructor
+//
+KeyframeStore::~KeyframeStore()
+{
+  close();
+}
+
+
+//
+// Open the store and read the index
+//
+bool KeyframeStore::open(const std::string &directory)
+{
+  close();
+  directory_ = directory;
+
+  index_file_ = fopen((directory_ + "/keyframes.idx").c_str(), "rb");
+  data_file_ = fopen((directory_ + "/keyframes.dat").c_str(), "rb");
+  if(index_file_ == NULL || data_file_ == NULL)
+  {
+    close();
+    return false;
+  }
+
+  KeyframeIndexHeader header;
+  if(fread(&header, sizeof(header), 1, index_file_) != 1 || memcmp(header.magic, "VOKF", 4) != 0 ||
+     (header.version != 1 && header.version != 2) || header.record_size != sizeof(KeyframeIndexRecord))
+  {
+    close();
+    return false;
+  }
+
+  refresh();
+  return true;
+}
+
+
+//
+// Close the files and clear the index
+//
+void KeyframeStore::close()
+{
+  if(data_file_ != NULL)
+    fclose(data_file_);
+  if(index_file_ != NULL)
+    fclose(index_file_);
+  data_file_ = NULL;
+  index_file_ = NULL;
+  index_.clear();
+}
+
+
+//
+// Read the index records added since the last time
+//
+int KeyframeStore::refresh()
+{
+  if(index_file_ == NULL)
+    return 0;
+
+  int added = 0;
+  KeyframeIndexRecord record;
+  while(true)
+  {
+    off_t position = ftello(index_file_);
+    if(fread(&record, sizeof(record), 1, index_file_) != 1)
+    {
+      //partial (still being written) or no record, go back and try again next time:
+      clearerr(index_file_);
+      fseeko(index_file_, position, SEEK_SET);
+      break;
+    }
+    index_[KeyframeKey(record.run, record.node_id)] = record;
+    added++;
+  }
+  return added;
+}
+
+
+//
+// Read a keyframe
+//
+bool KeyframeStore::read(uint32_t run, uint32_t node_id, cv::Mat *rgb_image, cv::Mat *depth_mm, double *stamp)
+{
+  std::map<KeyframeKey, KeyframeIndexRecord>::const_iterator itr = index_.find(KeyframeKey(run, node_id));
+  if(itr == index_.end())
+    return false;
+  const KeyframeIndexRecord &record = itr->second;
+
+  std::vector<uchar> data;
+  if(rgb_image != NULL)
+  {
+    if(!readBlock(record.rgb_offset, record.rgb_size, &data))
+      return false;
+    cv::Mat bgr = cv::imdecode(cv::Mat(data), CV_LOAD_IMAGE_COLOR);
+    if(bgr.empty())
+      return false;
+    cv::cvtColor(bgr, *rgb_image, CV_BGR2RGB);
+  }
+
+  if(depth_mm != NULL)
+  {
+    if(!readBlock(record.depth_offset, record.depth_size, &data))
+      return false;
+    *depth_mm = cv::imdecode(cv::Mat(data), CV_LOAD_IMAGE_ANYDEPTH);
+    if(depth_mm->empty() || depth_mm->type() != CV_16UC1)
+      return false;
+  }
+
+  if(stamp != NULL)
+    *stamp = record.stamp;
+
+  return true;
+}
+
+
+//
+// Read the calibration
+//
+bool KeyframeStore::readCameraInfo(sensor_msgs::CameraInfo *rgb_info)
+{
+  cv::FileStorage fs(directory_ + "/camera_info.yml", cv::FileStorage::READ);
+  if(!fs.isOpened())
+    return false;
+
+  cv::Mat K, D, P;
+  int width = 0, height = 0;
+  fs["width"] >> width;
+  fs["height"] >> height;
+  fs["K"] >> K;
+  fs["D"] >> D;
+  fs["P"] >> P;
+  if(K.rows != 3 || K.cols != 3 || P.rows != 3 || P.cols != 4)
+    return false;
+
+  rgb_info->width = width;
+  rgb_info->height = height;
+  for(int i = 0; i < 9; i++)
+    rgb_info->K[i] = K.at<double>(i/3, i%3);
+  for(int i = 0; i < 12; i++)
+    rgb_info->P[i] = P.at<double>(i/4, i%4);
+  rgb_info->D.resize(D.total());
+  for(int i = 0; i < (int)D.total(); i++)
+    rgb_info->D[i] = D.at<double>(0,i);
+
+  return true;
+}
+
+
+//
+// Read a block of the data file
+//
+bool KeyframeStore::readBlock(uint64_t offset, uint32_t size, std::vector<uchar> *data)
+{
+  data->resize(size);
+  if(size == 0)
+    return false;
+  if(fseeko(data_file_, (off_t)offset, SEEK_SET) != 0)
+    return false;
+  return fread(&(*data)[0], 1, size, data_file_) == size;
+}
+
+}
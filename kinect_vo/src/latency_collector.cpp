@@ -0,0 +1,227 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*! \file latency_collector.cpp
+  * \author agent
+  * \date October 2026
+  * \brief latency_collector.cpp reads the latency trace (kinect_vo/latency_stage messages) from a recorded run and
+  * reports how long it takes from a camera frame to the motor command that reacts to it, stage by stage.
+  *
+  * Usage:
+  * \code
+  *   latency_collector <bag> [<bag> ...] [--topic /latency_trace] [--csv frames.csv]
+  * \endcode
+  *
+  * The stages of each frame are put back together by the trace id and the frame timestamp (the id starts over when the
+  * VO is restarted).  For each step of the chain (and the totals) the count, mean, 50th, 90th, 99th percentile and the
+  * max are printed in milliseconds, only over the frames that have both ends of the step.  Frames that never reach the
+  * control (e.g. while the estimator is initializing) still count in the earlier steps.
+  *
+  * With --csv, a line for every frame is written: the trace id, the frame timestamp, and the time of each stage after
+  * the frame timestamp in milliseconds (empty when the frame did not reach the stage).
+*/
+
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <boost/foreach.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <vector>
+#include "kinect_vo/latency_stage.h"
+#include "timing_table.h"
+
+using kinect_vo::printTimes;
+using kinect_vo::printTimesHeader;
+
+
+static const int NUM_TRACE_STAGES = kinect_vo::latency_stage::COMMAND_PUBLISHED + 1;
+
+/// names of the stages, in the order of the latency_stage constants
+static const char *STAGE_NAMES[NUM_TRACE_STAGES] = {"vo_received", "vo_published", "est_received", "est_updated",
+                                                    "state_published", "control_started", "command_published"};
+
+/*!
+ *  \struct FrameTrace
+ *  \brief The stages that one frame reached
+*/
+struct FrameTrace
+{
+  FrameTrace()
+  {
+    for(int i = 0; i < NUM_TRACE_STAGES; i++)
+      have[i] = false;
+  }
+
+  ros::Time stamp[NUM_TRACE_STAGES]; //!< when each stage was reached
+  bool have[NUM_TRACE_STAGES]; //!< if the stage was reached
+};
+
+
+/*!
+ *  \struct Step
+ *  \brief A step of the chain that is reported: from stage "from" (-1 is the frame timestamp) to stage "to"
+*/
+struct Step
+{
+  const char *name;
+  int from;
+  int to;
+};
+
+static const Step STEPS[] = {
+  {"camera -> VO callback", -1, kinect_vo::latency_stage::VO_RECEIVED},
+  {"VO processing", kinect_vo::latency_stage::VO_RECEIVED, kinect_vo::latency_stage::VO_PUBLISHED},
+  {"VO -> estimator", kinect_vo::latency_stage::VO_PUBLISHED, kinect_vo::latency_stage::EST_RECEIVED},
+  {"vision queue + update", kinect_vo::latency_stage::EST_RECEIVED, kinect_vo::latency_stage::EST_UPDATED},
+  {"update -> state published", kinect_vo::latency_stage::EST_UPDATED, kinect_vo::latency_stage::STATE_PUBLISHED},
+  {"state -> control", kinect_vo::latency_stage::STATE_PUBLISHED, kinect_vo::latency_stage::CONTROL_STARTED},
+  {"control", kinect_vo::latency_stage::CONTROL_STARTED, kinect_vo::latency_stage::COMMAND_PUBLISHED},
+  {"TOTAL camera -> state", -1, kinect_vo::latency_stage::STATE_PUBLISHED},
+  {"TOTAL camera -> command", -1, kinect_vo::latency_stage::COMMAND_PUBLISHED}
+};
+static const int NUM_STEPS = sizeof(STEPS)/sizeof(STEPS[0]);
+
+
+/*!
+ *  \brief Reads the latency trace from the bags and prints the latency of each step of the chain.
+*/
+int main(int argc, char **argv)
+{
+  if(argc < 2)
+  {
+    std::cout << "Usage: latency_collector <bag> [<bag> ...] [--topic /latency_trace] [--csv frames.csv]" << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> bag_files;
+  std::string topic = "/latency_trace";
+  std::string csv_file;
+
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if(arg == "--topic" && i + 1 < argc)
+      topic = argv[++i];
+    else if(arg == "--csv" && i + 1 < argc)
+      csv_file = argv[++i];
+    else if(arg.compare(0, 2, "--") == 0)
+    {
+      std::cout << "Unknown argument: " << arg << std::endl;
+      return 1;
+    }
+    else
+      bag_files.push_back(arg);
+  }
+
+  ros::Time::init();
+
+  //put the stages of each frame together, the key is (trace id, frame timestamp):
+  typedef std::map<std::pair<uint32_t, ros::Time>, FrameTrace> TraceMap;
+  TraceMap traces;
+  int stage_count = 0, bad_count = 0;
+
+  for(int b = 0; b < (int)bag_files.size(); b++)
+  {
+    rosbag::Bag bag;
+    try
+    {
+      bag.open(bag_files[b], rosbag::bagmode::Read);
+    }
+    catch(rosbag::BagException &e)
+    {
+      std::cout << "Unable to open " << bag_files[b] << ": " << e.what() << std::endl;
+      return 1;
+    }
+
+    rosbag::View view(bag, rosbag::TopicQuery(topic));
+    BOOST_FOREACH(rosbag::MessageInstance const m, view)
+    {
+      kinect_vo::latency_stage::ConstPtr stage = m.instantiate<kinect_vo::latency_stage>();
+      if(!stage)
+        continue;
+      if(stage->stage >= NUM_TRACE_STAGES || stage->trace_id == 0)
+      {
+        bad_count++;
+        continue;
+      }
+      FrameTrace &trace = traces[std::make_pair(stage->trace_id, stage->frame_stamp)];
+      trace.stamp[stage->stage] = stage->stamp;
+      trace.have[stage->stage] = true;
+      stage_count++;
+    }
+    bag.close();
+  }
+
+  std::cout << "Read " << stage_count << " stages of " << traces.size() << " frames from " << bag_files.size()
+            << " bag(s) on " << topic << std::endl;
+  if(bad_count > 0)
+    std::cout << "Skipped " << bad_count << " stages with an unknown stage or no trace id" << std::endl;
+  if(traces.empty())
+    return 1;
+
+  //how far the frames got:
+  std::cout << std::endl << "Frames reaching each stage:" << std::endl;
+  for(int s = 0; s < NUM_TRACE_STAGES; s++)
+  {
+    int count = 0;
+    for(TraceMap::iterator it = traces.begin(); it != traces.end(); ++it)
+      count += it->second.have[s] ? 1 : 0;
+    std::cout << "  " << std::left << std::setw(20) << STAGE_NAMES[s] << std::right << std::setw(8) << count << std::endl;
+  }
+
+  //the latency of each step:
+  std::cout << std::endl;
+  printTimesHeader("Step (ms)", 28);
+  std::cout << std::fixed << std::setprecision(2);
+  for(int k = 0; k < NUM_STEPS; k++)
+  {
+    std::vector<double> times;
+    for(TraceMap::iterator it = traces.begin(); it != traces.end(); ++it)
+    {
+      const FrameTrace &trace = it->second;
+      if(!trace.have[STEPS[k].to] || (STEPS[k].from >= 0 && !trace.have[STEPS[k].from]))
+        continue;
+      ros::Time start = STEPS[k].from >= 0 ? trace.stamp[STEPS[k].from] : it->first.second;
+      times.push_back((trace.stamp[STEPS[k].to] - start).toSec()*1000.0);
+    }
+    printTimes(STEPS[k].name, times, 28);
+  }
+
+  //the breakdown of every frame:
+  if(!csv_file.empty())
+  {
+    std::ofstream csv(csv_file.c_str());
+    if(!csv.is_open())
+    {
+      std::cout << "Unable to open " << csv_file << std::endl;
+      return 1;
+    }
+    csv << "trace_id,frame_stamp";
+    for(int s = 0; s < NUM_TRACE_STAGES; s++)
+      csv << "," << STAGE_NAMES[s];
+    csv << std::endl;
+
+    csv << std::fixed;
+    for(TraceMap::iterator it = traces.begin(); it != traces.end(); ++it)
+    {
+      csv << it->first.first << "," << std::setprecision(6) << it->first.second.toSec() << std::setprecision(3);
+      for(int s = 0; s < NUM_TRACE_STAGES; s++)
+      {
+        csv << ",";
+        if(it->second.have[s])
+          csv << (it->second.stamp[s] - it->first.second).toSec()*1000.0;
+      }
+      csv << std::endl;
+    }
+    std::cout << std::endl << "Wrote the breakdown of each frame to " << csv_file << std::endl;
+  }
+
+  return 0;
+}
@@ -17,6 +17,8 @@
 #include <ros/ros.h>
 #include "ros_relay.h"
 
+using namespace kinect_vo;
+
 
 
 
@@ -32,8 +34,9 @@ int main(int argc, char **argv)
   //start the ROS node
   ros::init( argc, argv, "kinect_visual_odometry"); //!< start the node
   ros::NodeHandle nh("kinect_visual_odometry");
+  ros::NodeHandle private_nh("~");
 
-  ROSRelay rly(nh);
+  ROSRelay rly(nh, private_nh);
 
   ros::Rate r(60); // (x) is the run-rate in Hz
 
@@ -45,6 +48,5 @@ int main(int argc, char **argv)
   }
 
   pthread_mutex_destroy(&mutex_);
-  rly.~ROSRelay();
 
 }
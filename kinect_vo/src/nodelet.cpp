@@ -0,0 +1,52 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*! \file nodelet.cpp
+  * \brief A nodelet version of the kinect_visual_odometry node.  It runs ROSRelay inside a nodelet manager, so the
+  * VO messages can be passed to the estimator (and on to the control) without being serialized or copied.
+  *
+*/
+
+#include <ros/ros.h>
+#include <boost/shared_ptr.hpp>
+#include "pluginlib/class_list_macros.h"
+#include "nodelet/nodelet.h"
+#include "ros_relay.h"
+
+
+namespace kinect_vo
+{
+
+/*!
+ *  \class VONodelet nodelet.cpp "src/nodelet.cpp"
+ *  \brief Nodelet wrapper for ROSRelay.  The topics are in the same namespace as the standalone node
+ *  ("kinect_visual_odometry") and the parameters are read from the nodelet's private namespace.
+*/
+class VONodelet : public nodelet::Nodelet
+{
+public:
+  //Constructor
+  VONodelet()
+  {
+  }
+
+private:
+
+  virtual void onInit()
+  {
+    /// \note getNodeHandle() uses the single threaded callback queue, the ROSRelay callbacks are not written to
+    /// run concurrently
+    ros::NodeHandle nh(getNodeHandle(), "kinect_visual_odometry");
+    ros::NodeHandle& private_nh = getPrivateNodeHandle();
+
+    relay_.reset(new ROSRelay(nh, private_nh));
+  }
+
+  boost::shared_ptr<ROSRelay> relay_; //!< the VO, destroyed with the nodelet
+};
+
+//This code is essential for making the nodelet
+PLUGINLIB_DECLARE_CLASS(kinect_vo, VONodelet, kinect_vo::VONodelet, nodelet::Nodelet);
+}
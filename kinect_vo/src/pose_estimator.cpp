@@ -15,6 +15,10 @@
 
 
 #include "pose_estimator.h"
+
+namespace kinect_vo
+{
+
 using namespace Eigen;
 using namespace std;
 //using namespace cv; //Can't use this because of Conflicts with names
@@ -92,6 +96,9 @@ PoseEstimator::PoseEstimator(bool optimize, bool display):enable_optimizer_(opti
   hess_covariance_.setZero();
   
   pose_vertex_id_ = 0; //set to zero
+
+  //RANSAC is reused for every frame (the camera parameters are set in setKinectCalibration):
+  ransac_ = new RANSAC(num_iterations_, 20, 0.95, enable_optimizer_); //20 is the inlier threshold (squared pixels)
 }
 
 
@@ -108,6 +115,7 @@ PoseEstimator::~PoseEstimator()
   delete descriptor_extractor_;
   delete grid_detector_;
   delete association_;
+  delete ransac_;
 }
 
 
@@ -115,14 +123,14 @@ PoseEstimator::~PoseEstimator()
 //
 //This method sets the reference information
 //
-void PoseEstimator::setReferenceView(cv::Mat &visual_image, cv::Mat &depth_image_float, cv::Mat &depth_image_CV8UC1)
+void PoseEstimator::setReferenceView(cv::Mat &visual_image, cv::Mat &depth_image_mm, cv::Mat &depth_image_CV8UC1)
 {
   cv::Mat gray_image, smooth_gray; //temp images
   //convert the image to gray:
   cv::cvtColor(visual_image, gray_image, CV_RGB2GRAY);
   reference_img_RGB_ = visual_image.clone(); //set the color to the reference color, for later use
   reference_img_gray_ = gray_image.clone(); //set the gray to the reference image, for later use
-  reference_img_depth_ = depth_image_float.clone();
+  reference_img_depth_ = depth_image_mm.clone();
 
 //  ImageDisplay temp("Unitary_Depth");
 //  temp.displayImage(depth_image_CV8UC1);
@@ -130,7 +138,9 @@ void PoseEstimator::setReferenceView(cv::Mat &visual_image, cv::Mat &depth_image
 
   //Vision processing:
   //cv::ORB orb_detector;
+  timer_.start(STAGE_DETECT);
   grid_detector_->detect(gray_image,reference2D_features_,depth_image_CV8UC1);  //the depth image is the mask, only find features w/ valid 3D
+  timer_.stop(STAGE_DETECT);
   //orb_detector(gray_image,depth_image_CV8UC1,reference2D_features_,reference_descriptors_,true);
 
   if(reference2D_features_.empty() || (int)reference2D_features_.size() < 200)
@@ -143,14 +153,17 @@ void PoseEstimator::setReferenceView(cv::Mat &visual_image, cv::Mat &depth_image
 
   //smooth the image before extracting descriptors:
   cv::Size kernal(9,9);
+  timer_.start(STAGE_DESCRIBE);
   cv::GaussianBlur(gray_image, smooth_gray, kernal, 2, 2);
   descriptor_extractor_->compute(smooth_gray,reference2D_features_,reference_descriptors_);
+  timer_.stop(STAGE_DESCRIBE);
 
   vector<cv::Point2f> feature_points;  //to convert Keypoints to 2D points  
   cv::KeyPoint::convert(reference2D_features_, feature_points);
 
   //Using the camera calibration, undistort the 2D feature points before you extract the 3D points
   vector<cv::Point2f> idealized_pts;
+  timer_.start(STAGE_UNDISTORT);
   try
   {
     cv::undistortPoints(feature_points, idealized_pts, rgb_camera_matrix_,rgb_camera_distortion_,cv::noArray(), rgb_camera_P_ );
@@ -161,13 +174,17 @@ void PoseEstimator::setReferenceView(cv::Mat &visual_image, cv::Mat &depth_image
   catch(cv::Exception e)
   {
     ROS_ERROR("OpenCV Exception caught while using undistortPoints: %s",e.what());
+    timer_.stop(STAGE_UNDISTORT);
     return; //No points detected
   }
+  timer_.stop(STAGE_UNDISTORT);
 
   reference2D_idealized_ = idealized_pts;
 
   //calc 3D points:
-  calc3DPoints(depth_image_float, rgb_info_, &feature_points, &idealized_pts, &reference3D_features_);
+  timer_.start(STAGE_BACKPROJECT);
+  calc3DPoints(depth_image_mm, rgb_info_, &feature_points, &idealized_pts, &reference3D_features_);
+  timer_.stop(STAGE_BACKPROJECT);
 
   reference_set_ = true;
   vector<cv::Mat> temp_descriptors;
@@ -228,7 +245,7 @@ void PoseEstimator::setReferenceView(cv::Mat &visual_image, cv::Mat &depth_image
 //
 //The method that sets the current view information and then proceeds forward with the estimating the pose transformation
 //
-int PoseEstimator::setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat &depth_curr_image_float,
+int PoseEstimator::setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat &depth_curr_image_mm,
                                                cv::Mat &depth_curr_image_CV8UC1, Quaterniond *rotation,
                                                Vector3d *translation,Matrix<double,7,7> *covariance,
                                                int *inliers, int *corresponding, int *total,
@@ -255,7 +272,9 @@ int PoseEstimator::setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat
 
   //Vision processing:
   //cv::ORB orb_detect;
+  timer_.start(STAGE_DETECT);
   grid_detector_->detect(gray_image,current2D_features,depth_curr_image_CV8UC1);  //the depth image is the mask, only find features w/ valid 3D
+  timer_.stop(STAGE_DETECT);
   //orb_detect(gray_image,depth_curr_image_CV8UC1,current2D_features,current_descriptors,true);
   //smooth the image before extracting descriptors:
   if(current2D_features.empty())
@@ -277,13 +296,16 @@ int PoseEstimator::setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat
   }
 
   cv::Size kernal(9,9);
+  timer_.start(STAGE_DESCRIBE);
   cv::GaussianBlur(gray_image, smooth_gray, kernal, 2, 2);
   descriptor_extractor_->compute(smooth_gray,current2D_features,current_descriptors);
+  timer_.stop(STAGE_DESCRIBE);
 
   //Using the camera calibration, undistort the 2D feature points before you extract the 3D points
   vector<cv::Point2f> feature_points_cur;  //to convert Keypoints to 2D points
   cv::KeyPoint::convert(current2D_features,feature_points_cur);
   vector<cv::Point2f> idealized_curr_pts;
+  timer_.start(STAGE_UNDISTORT);
   try
   {
     cv::undistortPoints(feature_points_cur, idealized_curr_pts, rgb_camera_matrix_,rgb_camera_distortion_,cv::noArray(), rgb_camera_P_ );
@@ -292,9 +314,12 @@ int PoseEstimator::setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat
   {
     ROS_ERROR("OpenCV Exception caught while using undistortPoints: %s",e.what());
   }
+  timer_.stop(STAGE_UNDISTORT);
 
   //calc 3D points:
-  calc3DPoints(depth_curr_image_float, rgb_info_, &feature_points_cur ,&idealized_curr_pts, &current3D_features);
+  timer_.start(STAGE_BACKPROJECT);
+  calc3DPoints(depth_curr_image_mm, rgb_info_, &feature_points_cur ,&idealized_curr_pts, &current3D_features);
+  timer_.stop(STAGE_BACKPROJECT);
 
   //! \note beginning of transformation estimation
   /*!
@@ -303,6 +328,7 @@ int PoseEstimator::setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat
   */
 
   //create a mask for matching (TUNE THESE!!!)
+  timer_.start(STAGE_MATCH);
   cv::Mat mask, mask_r;
   int wx = 300;//140; //horizontal element
   int wy = 200;//80; //vertical element
@@ -357,6 +383,7 @@ int PoseEstimator::setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat
       final_matches.push_back(cv::DMatch(i,forward_matches[i].trainIdx,0.f));
     }
   }
+  timer_.stop(STAGE_MATCH);
 
   cv::Mat reference_out, current_out;
   if(enable_display_)
@@ -385,7 +412,7 @@ int PoseEstimator::setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat
     if(setAsReference)
     {
       //Rewrite the reference material:
-      setCurrentAsReference(visual_cur_image,gray_image,depth_curr_image_float,current2D_features,idealized_curr_pts,
+      setCurrentAsReference(visual_cur_image,gray_image,depth_curr_image_mm,current2D_features,idealized_curr_pts,
                             current3D_features,current_descriptors);
 
       ROS_WARN("Current image set as reference without a good transformation between the last reference and this image!!");
@@ -438,31 +465,9 @@ int PoseEstimator::setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat
   *total = (int)idealized_curr_pts.size(); //int)reference2D_idealized_.size();
   //ROS_INFO_THROTTLE(1,"Corresponding matches = %d out of %d features.", (int)final_matches.size(),(int)reference2D_idealized_.size());
 
-  int iterations;
-  int inlier_error;
-
-//  if(enable_optimizer_)
-//  {
-//    //open things up a bit if will optimize afterwards
-//    iterations = 150;//100;
-    inlier_error = 20;//18;
-//  }
-//  else
-//  {
-//    //if no optimization after, close it up a little to improve accuracy
-//    iterations = 100;
-//    inlier_error = 18;//9;
-//  }
-
-
-
-//  struct timeval  tim;
-//  gettimeofday(&tim,NULL);
-//  double t1 = tim.tv_sec+(tim.tv_usec/1000000.0);
-
 
   //Compute the transformation using RANSAC:
-  RANSAC *ransac = new RANSAC(num_iterations_, inlier_error, 0.95, rgb_info_,enable_optimizer_);
+  timer_.start(STAGE_RANSAC);
 
   vector<int> inlier_list;
   cv::Mat rotation_matrix, translation_matrix;
@@ -474,12 +479,9 @@ int PoseEstimator::setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat
 
   //******************************************************************
   /// Run RANSAC on the ordered features:
-  ransac->runRANSAC(ordered_reference3D, ordered_current3D, ordered_current2D,
+  ransac_->runRANSAC(ordered_reference3D, ordered_current3D, ordered_current2D,
                     &rotation_matrix, &translation_matrix,inliers, &inlier_list,&solution_list,&svd_D,&svd_U,&svd_V);
-
-//  gettimeofday(&tim,NULL);
-//  double t2=tim.tv_sec+(tim.tv_usec/1000000.0);
-//  printf("%.10lf seconds elapsed\n", t2-t1);
+  timer_.stop(STAGE_RANSAC);
 
   Quaterniond rot_guess;
 
@@ -491,7 +493,7 @@ int PoseEstimator::setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat
     if(setAsReference)
     {
       //Rewrite the reference material:
-      setCurrentAsReference(visual_cur_image,gray_image,depth_curr_image_float,current2D_features,idealized_curr_pts,
+      setCurrentAsReference(visual_cur_image,gray_image,depth_curr_image_mm,current2D_features,idealized_curr_pts,
                             current3D_features,current_descriptors);
 
       ROS_WARN("Current image set as reference without a good transformation between the last reference and this image!!");
@@ -615,6 +617,7 @@ int PoseEstimator::setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat
     tran_opt->setZero();
   }
 
+  timer_.start(STAGE_COVARIANCE);
 //  std::vector<cv::Point2f> reference_image_pts;
 //  std::vector<cv::Point2f> current_image_pts;
 //  std::vector<cv::Point3d> reference_3D_pts;
@@ -663,18 +666,16 @@ int PoseEstimator::setCurrentAndFindTransform(cv::Mat &visual_cur_image, cv::Mat
                  0,0,0,0,4.4e-4,0,0,
                  0,0,0,0,0,3.2e-5,0,
                  0,0,0,0,0,0,7.1e-8;
+  timer_.stop(STAGE_COVARIANCE);
 
   //! \attention Setting the current as the reference must occur at the end of the function!
   if(setAsReference)
   {
     //Rewrite the reference material:
-    setCurrentAsReference(visual_cur_image,gray_image,depth_curr_image_float,current2D_features,idealized_curr_pts,
+    setCurrentAsReference(visual_cur_image,gray_image,depth_curr_image_mm,current2D_features,idealized_curr_pts,
                           current3D_features,current_descriptors);
   }
 
-
-
-  delete ransac;
   return 1;
 }
 
@@ -1197,14 +1198,15 @@ Matrix<double,7,7> PoseEstimator::calculateNewCovariance(std::vector<cv::Point2f
 //
 //This method calculates the 3D points from the features, depth, and calibration
 //
-void PoseEstimator::calc3DPoints(cv::Mat &depth_float,
+void PoseEstimator::calc3DPoints(cv::Mat &depth_mm,
                                  sensor_msgs::CameraInfo &kinect_calibration,
                                  std::vector<cv::Point2f> *features2D,
                                  std::vector<cv::Point2f> *features2D_undistored,
                                  std::vector<cv::Point3d> *features3D)
 {
-  //Check calibration info:
+  //Check calibration info and the depth format:
   ROS_ASSERT(kinect_calibration.K[0] != 0.0);
+  ROS_ASSERT(depth_mm.type() == CV_16UC1);
 
   double x,y;//temp point,
   //principal point and focal lengths:
@@ -1226,10 +1228,11 @@ void PoseEstimator::calc3DPoints(cv::Mat &depth_float,
     /// \todo Apply the calibration transformation to the depth points to place them in the RGB image frame (i.e. perform
     /// depth registration, as they call it on the tutorials!)
     /// \todo Apply the transformation on the mask that I am using for feature locations as well!!!
-    double z = depth_float.at<float>(features2D->at(i).y, features2D->at(i).x);
+    uint16_t z_mm = depth_mm.at<uint16_t>(features2D->at(i).y, features2D->at(i).x);
+    double z = (double)z_mm*DEPTH_MM_TO_M;
 
     // Check for invalid measurements (shouldn't happen because we used the depth image to mask finding features...)
-    if (std::isnan (z))
+    if (z_mm == 0)
     {
       ROS_WARN_STREAM("Bad depth on Keypoint, setting depth to 8m: " << features2D_undistored->at(i));
       //Set the z to something far out:
@@ -1270,6 +1273,8 @@ void PoseEstimator::setKinectCalibration(const sensor_msgs::CameraInfoConstPtr &
     }
 
     ROS_ASSERT((int)rgb_camera_distortion_.size() > 0);
+
+    ransac_->setCameraParameters(rgb_info_);
 }
 
 
@@ -1417,5 +1422,7 @@ void PoseEstimator::extractAngles(cv::Mat &rotation_matrix, double *roll, double
   }
 }
 
+}
+
 
 
@@ -14,6 +14,9 @@
 
 #include "ransac.h"
 
+namespace kinect_vo
+{
+
 using namespace cv;
 
 //
@@ -22,36 +25,53 @@ using namespace cv;
 RANSAC::RANSAC(int iters,
                int inlier_thres,
                double consensus_thres,
-               sensor_msgs::CameraInfo &camera_params,
-               bool optimize
+               bool optimize,
+               uint64_t seed
   ): iterations_(iters),
   inlier_threshold_(inlier_thres),
   consensus_threshold_(consensus_thres),
-  optimizer_enabled_(optimize)
+  fx_(0.d), fy_(0.d), cx_(0.d), cy_(0.d),
+  k1_(0.d), k2_(0.d), p1_(0.d), p2_(0.d), k3_(0.d),
+  optimizer_enabled_(optimize),
+  seed_(seed),
+  run_counter_(0)
 {
-  //initialize the camera intrinisics: (These are the intrinsics for the RBG camera)
-  //camera_intrinsics = Mat::zeros(3,4, DataType<float>::type);
-//  rgb_camera_intrinsics = (Mat_<double>(3,3) <<  camera_params.P[0], 0, camera_params.P[2],
-//                                              0, camera_params.P[5], camera_params.P[6],
-//                                              0, 0, 1);
-  rgb_camera_intrinsics = (Mat_<double>(3,3) <<  camera_params.K[0], 0, camera_params.K[2],
-                                                 0, camera_params.K[4], camera_params.K[5],
-                                                 0, 0, 1);
+  sample_table_.resize(3*iterations_);
+}
 
-  rgb_distortion = (Mat_<double>(5,1) << camera_params.D[0], camera_params.D[1], camera_params.D[2],
-                camera_params.D[3], camera_params.D[4]);
 
-  rnd_gen = new RNG();  //instatiate the random number generator
+//
+//put stuff here when it should be destroyed!
+//
+RANSAC::~RANSAC()
+{
 
 }
 
 
 //
-//put stuff here when it should be destroyed!
+// Set the camera intrinsics and distortion (These are the intrinsics for the RBG camera)
 //
-RANSAC::~RANSAC()
+void RANSAC::setCameraParameters(const sensor_msgs::CameraInfo &camera_params)
 {
+  ROS_ASSERT(camera_params.D.size() >= 5);
+
+  rgb_camera_intrinsics = (Mat_<double>(3,3) <<  camera_params.K[0], 0, camera_params.K[2],
+                                                 0, camera_params.K[4], camera_params.K[5],
+                                                 0, 0, 1);
 
+  rgb_distortion = (Mat_<double>(5,1) << camera_params.D[0], camera_params.D[1], camera_params.D[2],
+                camera_params.D[3], camera_params.D[4]);
+
+  fx_ = camera_params.K[0];
+  fy_ = camera_params.K[4];
+  cx_ = camera_params.K[2];
+  cy_ = camera_params.K[5];
+  k1_ = camera_params.D[0];
+  k2_ = camera_params.D[1];
+  p1_ = camera_params.D[2];
+  p2_ = camera_params.D[3];
+  k3_ = camera_params.D[4];
 }
 
 
@@ -74,123 +94,96 @@ void RANSAC::runRANSAC(std::vector<Point3d> &reference3D,
   ROS_ASSERT(reference3D.size() == current3D.size());
   ROS_ASSERT(current3D.size() == current2D.size());
   ROS_ASSERT(reference3D.size() > 3);  //need more than three matching features
+  ROS_ASSERT(fx_ != 0.d); //setCameraParameters must be called first
+
+  int n = (int)reference3D.size();
+
+  //Copy the points into the storage (resize only allocates when this frame has more points than any before):
+  ref_x_.resize(n); ref_y_.resize(n); ref_z_.resize(n);
+  cur_x_.resize(n); cur_y_.resize(n); cur_z_.resize(n);
+  cur_u_.resize(n); cur_v_.resize(n);
+  for(int i = 0; i < n; i++)
+  {
+    ref_x_[i] = reference3D[i].x;
+    ref_y_[i] = reference3D[i].y;
+    ref_z_[i] = reference3D[i].z;
+    cur_x_[i] = current3D[i].x;
+    cur_y_[i] = current3D[i].y;
+    cur_z_[i] = current3D[i].z;
+    cur_u_[i] = current2D[i].x;
+    cur_v_[i] = current2D[i].y;
+  }
+
+  //Fill the table of samples for every iteration:
+  uint64_t stream = mix64(seed_ ^ mix64(run_counter_));
+  run_counter_++;
+  for(int i = 0; i < iterations_; i++)
+  {
+    sampleIndices(stream, (uint64_t)i, (uint32_t)n, &sample_table_[3*i]);
+  }
 
   double best_total_error = 99999999999999999999.9; //something high...
   int best_size = 3; //keeping track of most inliers
-  std::vector<double> best_errors; //best vector showing the error
-  std::vector<int> best_inliers; //initialize to three numbers...
-  best_inliers.push_back(1);
-  best_inliers.push_back(2);
-  best_inliers.push_back(3);
-  std::vector<int> best_solution_list; //list of indicies of the pts used in the best solution
-//  Mat D_best,U_best,V_best; //SVD matricies from best solution
+  int best_iteration = -1; //the iteration with the best solution (-1 if none)
 
   //containers for the best solution:
-  Mat best_rotation;
-  Mat best_translation;
+  Eigen::Matrix3d best_rotation;
+  Eigen::Vector3d best_translation;
 
 
   //main loop for RANSAC:
-  #pragma omp parallel for shared( best_total_error, best_size,best_solution_list)
+  #pragma omp parallel for
   for(int i = 0; i < iterations_; i++)
   {
     //containers for the solution at each iteration
-    Mat rotation;
-    Mat translation;
-//    Mat D,V,U; //matricies from the SVD
-    std::vector<double> error_temp;  //container for the error
-    std::vector<int> inliers_temp;   //container for the inliers
-    double temp_err; //sum of the error at each iteration    
-    std::vector<Point3d> reference_sample; //the container for the sample of the reference
-    std::vector<Point3d> current_sample; //the container for the sample of the current
-
-    //Containers for the P3P solution
-    std::vector<Point2d> current2D_sample; //the container for the sample of the current 2D
-    //std::vector<Mat> rotation_P3P, translation_P3P;
-
-    std::vector<int> list; //the container for the indicies (to be passed on for covariance estimation)
-
-    //sample
-    sample(reference3D, current3D, current2D, &reference_sample, &current_sample, &current2D_sample, &list);
+    Eigen::Matrix3d rotation;
+    Eigen::Vector3d translation;
+    int inlier_count;
 
     //find a solution using the 3 sampled points
-    computeSampleTransformation(reference_sample, current_sample, &rotation, &translation);
-
-    //P3P Method:
-    //computeKneipP3P( reference_sample,current2D_sample,&rotation_P3P,&translation_P3P);
-    //temp_err = computeErrorModelP3P(reference3D, current2D, &rotation_P3P, &translation_P3P, &error_temp, &inliers_temp);    
+    computeMinimalTransformation(&sample_table_[3*i], &rotation, &translation);
 
     //check the error against all the points
-    temp_err = computeErrorModel(reference3D, current2D, rotation, translation, &error_temp, &inliers_temp);    
+    double temp_err = computeErrorModel(rotation, translation, &inlier_count);
 
     //check to see if it is the best so far or better than our minimum threshold
-    //two conditions, (better error and same or greater # inliers) OR (greater # inliers)
+    //two conditions, (better error and same or greater # inliers) OR (greater # inliers).  Exact ties go to the lower
+    //iteration, so the answer doesn't depend on the order the threads finish in.
     #pragma omp critical
-    if((temp_err < best_total_error && (int)inliers_temp.size() >= best_size) || (int)inliers_temp.size() > best_size)
+    if((temp_err < best_total_error && inlier_count >= best_size) || inlier_count > best_size ||
+       (temp_err == best_total_error && inlier_count == best_size && i < best_iteration))
     {
       //Have an improved guess, replace with new information:
-      best_size = (int)inliers_temp.size();
+      best_size = inlier_count;
       best_total_error = temp_err;
-      best_errors = error_temp;
-      best_inliers = inliers_temp;
-      best_rotation = rotation.clone();
-      best_translation = translation.clone();
-      best_solution_list = list;
-//      D_best = D;
-//      U_best = U;
-//      V_best = V;
+      best_rotation = rotation;
+      best_translation = translation;
+      best_iteration = i;
     }
   }
   //End of main loop
 
-//  *svd_D = D_best;
-//  *svd_U = U_best;
-//  *svd_V = V_best;
-
-//  //
-//  //Find the inlier that is furthest from the plane defined from the 3 points, and return that least-squares solution
-
-//  Vec3d A(reference3D[best_solution_list[0]].x,reference3D[best_solution_list[0]].y,reference3D[best_solution_list[0]].z);
-//  Vec3d B(reference3D[best_solution_list[1]].x,reference3D[best_solution_list[1]].y,reference3D[best_solution_list[1]].z);
-//  Vec3d C(reference3D[best_solution_list[2]].x,reference3D[best_solution_list[2]].y,reference3D[best_solution_list[2]].z);
-
-//  Vec3d N,n;
-//  N = (A-B).cross(A-C); //plane normal eqn.
-//  n = N*(1.0/(double)norm(N));
-//  double biggest = 0.0;
-//  int inlierpick = 0;
-
-//  for(int i = 0; i<(int)best_inliers.size(); i++)
-//  {
-//    Vec3d D(reference3D[best_inliers[i]].x,reference3D[best_inliers[i]].y,reference3D[best_inliers[i]].z);
-//    double d = fabs(n.dot(A-D));
-//    if(d > biggest)
-//    {
-//      biggest = d;
-//      inlierpick = i;
-//    }
-//  }
-//  best_solution_list.push_back(inlierpick);
-
-//  //Use these 4 (non-planar) pts to create a least-squares solution to return:
-//  std::vector<Point3d> best_reference;
-//  std::vector<Point3d> best_current;
-//  for(int i = 0; i < (int)best_solution_list.size(); i++)
-//  {
-//    best_reference.push_back(reference3D[best_solution_list[i]]);
-//    best_current.push_back(current3D[best_solution_list[i]]);
-//  }
-
-//  Mat final_rot, final_trans, D1,V1,U1; //matricies from the SVD;
-
-//  computeSampleTransformation(best_reference, best_current, &final_rot, &final_trans,&D1,&U1,&V1);
-
-//  std::cout << D << std::endl;
+  //Recover the inliers and the sample for the best solution:
+  std::vector<int> best_inliers;
+  std::vector<int> best_solution_list;
+  if(best_iteration >= 0)
+  {
+    int count;
+    computeErrorModel(best_rotation, best_translation, &count, &best_inliers);
+    best_solution_list.assign(&sample_table_[3*best_iteration], &sample_table_[3*best_iteration] + 3);
+  }
+  else
+  {
+    //no solution, initialize to three numbers...
+    best_inliers.push_back(1);
+    best_inliers.push_back(2);
+    best_inliers.push_back(3);
+  }
 
   //
   //Use all the inliers to generate the SVD terms (for the uncertainty):
-    std::vector<Point3d> best_reference;
-    std::vector<Point3d> best_current;
+  std::vector<Point3d> best_reference;
+  std::vector<Point3d> best_current;
   for(int i = 0; i < (int)best_inliers.size(); i++)
   {
     best_reference.push_back(reference3D[best_inliers[i]]);
@@ -205,47 +198,19 @@ void RANSAC::runRANSAC(std::vector<Point3d> &reference3D,
   *svd_U = U;
   *svd_V = V;
 
-//  std::cout << D1 << " " << D << std::endl;
-
-  //copy over the solution from least-squares solution using all inliers
-//  final_rot.copyTo(*final_rotation);
-//  final_trans.copyTo(*final_translation);
-
-//  //use the 3pt solution:
-  best_rotation.copyTo(*final_rotation);
-  best_translation.copyTo(*final_translation);
-
-//  if(!optimizer_enabled_)
-//  {
-//    //Use all the inliers to create a least-squares solution to return:
-//    std::vector<Point3d> best_reference;
-//    std::vector<Point3d> best_current;
-//    for(int i = 0; i < (int)best_inliers.size(); i++)
-//    {
-//      best_reference.push_back(reference3D[best_inliers[i]]);
-//      best_current.push_back(current3D[best_inliers[i]]);
-//    }
-
-//    Mat final_rot, final_trans, D,V,U; //matricies from the SVD;
-
-//    computeSampleTransformation(best_reference, best_current, &final_rot, &final_trans,&D,&U,&V);
-
-//    *svd_D = D;
-//    *svd_U = U;
-//    *svd_V = V;
-
-//    //copy over the solution
-//    final_rot.copyTo(*final_rotation);
-//    final_trans.copyTo(*final_translation);
-
-//    best_rotation.copyTo(*final_rotation);
-//    best_translation.copyTo(*final_translation);
-//  }
-//  else
-//  {
-//    best_rotation.copyTo(*final_rotation);
-//    best_translation.copyTo(*final_translation);
-//  }
+  //use the 3pt solution (an empty matrix tells the caller there is no solution):
+  if(best_iteration >= 0)
+  {
+    *final_rotation = (Mat_<double>(3,3) << best_rotation(0,0), best_rotation(0,1), best_rotation(0,2),
+                                            best_rotation(1,0), best_rotation(1,1), best_rotation(1,2),
+                                            best_rotation(2,0), best_rotation(2,1), best_rotation(2,2));
+    *final_translation = (Mat_<double>(3,1) << best_translation(0), best_translation(1), best_translation(2));
+  }
+  else
+  {
+    *final_rotation = Mat();
+    *final_translation = Mat();
+  }
 
   *solution_list = best_solution_list;
   *inliers = (int)best_inliers.size(); //report # inliers
@@ -259,42 +224,96 @@ void RANSAC::runRANSAC(std::vector<Point3d> &reference3D,
 //
 //For computing the inliers and the error from the proposed model (called within runRANSAC)
 //
-double RANSAC::computeErrorModel(std::vector<Point3d> &reference3D,
-                                  std::vector<cv::Point2f> &current2D,
-                                  Mat &rotation,
-                                  Mat &translation,
-                                  std::vector<double> *error,
-                                  std::vector<int> *inliers)
+double RANSAC::computeErrorModel(const Eigen::Matrix3d &rotation,
+                                 const Eigen::Vector3d &translation,
+                                 int *inlier_count,
+                                 std::vector<int> *inliers)
 {
-  Mat rodrigues_rotation;
-  Rodrigues(rotation,rodrigues_rotation); //change the rotation to a Rodrigues rotation (3 parameters)
-  std::vector<Point2d> predicted_pts;
-  double err;  //error  //temp points px, py,
   double error_total = 0;
+  int count = 0;
+  int n = (int)ref_x_.size();
 
-  //This function projects the reference 3D points onto the current image plane
-  projectPoints(reference3D,rodrigues_rotation,translation,rgb_camera_intrinsics,rgb_distortion,predicted_pts);
+  const double r00 = rotation(0,0), r01 = rotation(0,1), r02 = rotation(0,2);
+  const double r10 = rotation(1,0), r11 = rotation(1,1), r12 = rotation(1,2);
+  const double r20 = rotation(2,0), r21 = rotation(2,1), r22 = rotation(2,2);
+  const double tx = translation(0), ty = translation(1), tz = translation(2);
 
-  //go through each element and compute the error
-  for(int i = 0; i < (int)predicted_pts.size(); i++)
+  //go through each element, project the reference point onto the current image plane and compute the error
+  for(int i = 0; i < n; i++)
   {
-    err = (current2D[i].x - predicted_pts[i].x)*(current2D[i].x - predicted_pts[i].x) +
-          (current2D[i].y - predicted_pts[i].y)*(current2D[i].y - predicted_pts[i].y);
+    double X = r00*ref_x_[i] + r01*ref_y_[i] + r02*ref_z_[i] + tx;
+    double Y = r10*ref_x_[i] + r11*ref_y_[i] + r12*ref_z_[i] + ty;
+    double Z = r20*ref_x_[i] + r21*ref_y_[i] + r22*ref_z_[i] + tz;
+    double iz = (Z != 0.d) ? 1.d/Z : 1.d; //same as projectPoints
+    double x = X*iz, y = Y*iz;
+
+    //plumb bob distortion:
+    double r2 = x*x + y*y;
+    double radial = 1.d + r2*(k1_ + r2*(k2_ + r2*k3_));
+    double xd = x*radial + 2.d*p1_*x*y + p2_*(r2 + 2.d*x*x);
+    double yd = y*radial + p1_*(r2 + 2.d*y*y) + 2.d*p2_*x*y;
+
+    double du = cur_u_[i] - (fx_*xd + cx_);
+    double dv = cur_v_[i] - (fy_*yd + cy_);
+    double err = du*du + dv*dv;  //!< \note The error is squared, not square-rooted!
 
-    error->push_back(err);  //!< \note The error is squared, not square-rooted!
     error_total += err; //sum up the error for all the points, not just the inliers!
+    count += (err <= inlier_threshold_);
 
-    if (err <= inlier_threshold_)
+    if(inliers != NULL && err <= inlier_threshold_)
     {
       //we have an inlier!
       inliers->push_back(i);
     }
   }
 
+  *inlier_count = count;
   return error_total;
 }
 
 
+//
+//given the three sampled points, computes the sample solution using the SVD technique (fixed size, no allocation)
+//
+void RANSAC::computeMinimalTransformation(const int *index, Eigen::Matrix3d *rotation, Eigen::Vector3d *translation)
+{
+  Eigen::Vector3d ref[3], cur[3];
+  Eigen::Vector3d centroid_reference(0.d, 0.d, 0.d), centroid_current(0.d, 0.d, 0.d);
+  for(int k = 0; k < 3; k++)
+  {
+    ref[k] << ref_x_[index[k]], ref_y_[index[k]], ref_z_[index[k]];
+    cur[k] << cur_x_[index[k]], cur_y_[index[k]], cur_z_[index[k]];
+    centroid_reference += ref[k];
+    centroid_current += cur[k];
+  }
+  centroid_reference /= 3.d;
+  centroid_current /= 3.d;
+
+  //calculate the 3x3 matrix H, the sum of the outer products of the centered points
+  Eigen::Matrix3d H = Eigen::Matrix3d::Zero();
+  for(int k = 0; k < 3; k++)
+  {
+    H += (ref[k] - centroid_reference)*(cur[k] - centroid_current).transpose();
+  }
+
+  //compute the SVD:
+  Eigen::JacobiSVD<Eigen::Matrix3d> svd(H, Eigen::ComputeFullU | Eigen::ComputeFullV);
+  Eigen::Matrix3d V = svd.matrixV();
+  Eigen::Matrix3d R = V*svd.matrixU().transpose();
+
+  //check determinate and find the rotation
+  if(R.determinant() < 0)
+  {
+    //sign of last column of V needs to be switched:
+    V.col(2) *= -1.0;
+    R = V*svd.matrixU().transpose();
+  }
+
+  *rotation = R;
+  *translation = centroid_current - R*centroid_reference;
+}
+
+
 //
 //given a sample, computes the sample solution using the SVD technique
 //
@@ -763,6 +782,8 @@ void RANSAC::findCentroid(std::vector<Point3d> &inpoints3D,
   *centroid_final = temp_cent;
 }
 
+}
+
 
 
 
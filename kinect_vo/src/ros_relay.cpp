@@ -13,6 +13,9 @@
 
 #include "ros_relay.h"
 
+namespace kinect_vo
+{
+
 using namespace Eigen;
 
 pthread_mutex_t mutex_ = PTHREAD_MUTEX_INITIALIZER; //!< mutex to change "set_next_as_ref_"
@@ -32,13 +35,14 @@ typedef message_filters::Subscriber<sensor_msgs::CameraInfo> cam_info_sub_type;
 //
 //Constructor: initializes ROS, begins the publishers and subscribers
 //
-ROSRelay::ROSRelay(ros::NodeHandle &nh)
+ROSRelay::ROSRelay(ros::NodeHandle &nh, ros::NodeHandle &private_nh)
   : kinect_sync_(NULL),
     visual_sub_(NULL),
     depth_sub_(NULL),
     depth_mono8_image_(cv::Mat()),
     visual_image_(cv::Mat()),
     process_images_(false),
+    keyframe_archive_(NULL),
     VISUAL_WINDOW("Visual Window"),
     DEPTH_WINDOW("Depth Window")
 {
@@ -49,38 +53,68 @@ ROSRelay::ROSRelay(ros::NodeHandle &nh)
   std::string transform_topic; //!< the topic this program publishes the transformations to
   int queue_size = 2;   //!< number of images/calibration messages to keep in the queue
   std::string rgb_keyframe_topic, depth_keyframe_topic, rgb_info_topic;
+  std::string timing_topic, timing_trace_file;
+  std::string latency_trace_topic;
+  bool latency_trace;
+  std::string keyframe_archive_dir;
+  int keyframe_jpeg_quality;
 
   //private variables on the parameter server, can be used to bring in initializations:
   // see: http://ros.org/wiki/Remapping%20Arguments
-  ros::param::param<std::string>("~mocap_topic_name", mocap_topic_,"/evart/heavy_ros/base"); //"/evart/ros_kinect/base_virtual"
-  ros::param::param<std::string>("~rotation_name", rotation_topic_,"/estimated_transform");
-  ros::param::param<bool>("~enable_optimization",optimize_,false);
-  ros::param::param<bool>("~display_save_images",save_show_images_, false);
-  ros::param::param<bool>("~enable_logging",enable_logging_, true); //!< creates log files for comparing VO to relative truth
-  ros::param::param<std::string>("~rbg_topic",visual_topic,"/camera/rgb/image_color");
-  ros::param::param<std::string>("~depth_topic",depth_topic,"/camera/depth_registered/image");///camera/depth/image
-  ros::param::param<std::string>("~rbg_calibration_topic",camera_topic,"/camera/rgb/camera_info");
-  ros::param::param<std::string>("~depth_calibration_topic",depth_cam_topic,"/camera/depth_registered/camera_info");///camera/depth/camera_info
-  ros::param::param<std::string>("~transform_topic",transform_topic,"vo_transformation");
+  private_nh.param<std::string>("mocap_topic_name", mocap_topic_,"/evart/heavy_ros/base"); //"/evart/ros_kinect/base_virtual"
+  private_nh.param<std::string>("rotation_name", rotation_topic_,"/estimated_transform");
+  private_nh.param<bool>("enable_optimization",optimize_,false);
+  private_nh.param<bool>("display_save_images",save_show_images_, false);
+  private_nh.param<bool>("enable_logging",enable_logging_, true); //!< creates log files for comparing VO to relative truth
+  private_nh.param<std::string>("rbg_topic",visual_topic,"/camera/rgb/image_color");
+  private_nh.param<std::string>("depth_topic",depth_topic,"/camera/depth_registered/image_raw");///camera/depth/image_raw
+  private_nh.param<std::string>("rbg_calibration_topic",camera_topic,"/camera/rgb/camera_info");
+  private_nh.param<std::string>("depth_calibration_topic",depth_cam_topic,"/camera/depth_registered/camera_info");///camera/depth/camera_info
+  private_nh.param<std::string>("transform_topic",transform_topic,"vo_transformation");
+  private_nh.param<bool>("publish_keyframes",publish_keyframes_,true);
+  private_nh.param<std::string>("rgb_keyframe_topic",rgb_keyframe_topic,"/keyframe/rgb_image");
+  private_nh.param<std::string>("depth_keyframe_topic",depth_keyframe_topic,"/keyframe/depth_image");
+  private_nh.param<std::string>("rgb_info_topic",rgb_info_topic,"/keyframe/rgb_camera_info");
+  private_nh.param<bool>("keyframe_depth_float",keyframe_depth_float_,false);
+  private_nh.param<bool>("compress_keyframes",compress_keyframes_,false);
+  private_nh.param<std::string>("keyframe_archive_dir",keyframe_archive_dir,"");
+  private_nh.param<int>("keyframe_jpeg_quality",keyframe_jpeg_quality,90);
+  private_nh.param<bool>("enable_timing",enable_timing_,true);
+  private_nh.param<std::string>("timing_topic",timing_topic,"vo_timing");
+  private_nh.param<std::string>("timing_trace_file",timing_trace_file,"");
+  private_nh.param<int>("timing_window",timing_window_,30);
+  private_nh.param<bool>("latency_trace",latency_trace,true);
+  private_nh.param<std::string>("latency_trace_topic",latency_trace_topic,"/latency_trace");
 
   /*!
     \note Below are the private parameters that are available to change through the param server:
       Private variables on the parameter server, can be used to bring in initializations:
       see: http://ros.org/wiki/Remapping%20Arguments
      \code{.cpp}
-  ros::param::param<std::string>("~mocap_topic_name", mocap_topic_,"/evart/heavy_ros/base"); //"/evart/ros_kinect/base_virtual"
-  ros::param::param<std::string>("~rotation_name", rotation_topic_,"/estimated_transform");
-  ros::param::param<bool>("~enable_optimization",optimize_,false);
-  ros::param::param<bool>("~display_save_images",save_show_images_, false);
-  ros::param::param<bool>("~enable_logging",enable_logging_, true); //!< creates log files for comparing VO to relative truth
-  ros::param::param<std::string>("~rbg_topic",visual_topic,"/camera/rgb/image_color");
-  ros::param::param<std::string>("~depth_topic",depth_topic,"/camera/depth_registered/image");///camera/depth/image
-  ros::param::param<std::string>("~rbg_calibration_topic",camera_topic,"/camera/rgb/camera_info");
-  ros::param::param<std::string>("~depth_calibration_topic",depth_cam_topic,"/camera/depth_registered/camera_info");///camera/depth/camera_info
-  ros::param::param<std::string>("~transform_topic",transform_topic,"vo_transformation"); //!< topic name for the output transformation message
-  ros::param::param<bool>("~publish_keyframes",publish_keyframes_,true);
-  ros::param::param<std::string>("~rgb_keyframe_topic",rgb_keyframe_topic,"/keyframe/rgb_image"); /// topic for the rgb keyframes
-  ros::param::param<std::string>("~depth_keyframe_topic",depth_keyframe_topic,"/keyframe/depth_image"); /// topic for depth keyframes
+  private_nh.param<std::string>("mocap_topic_name", mocap_topic_,"/evart/heavy_ros/base"); //"/evart/ros_kinect/base_virtual"
+  private_nh.param<std::string>("rotation_name", rotation_topic_,"/estimated_transform");
+  private_nh.param<bool>("enable_optimization",optimize_,false);
+  private_nh.param<bool>("display_save_images",save_show_images_, false);
+  private_nh.param<bool>("enable_logging",enable_logging_, true); //!< creates log files for comparing VO to relative truth
+  private_nh.param<std::string>("rbg_topic",visual_topic,"/camera/rgb/image_color");
+  private_nh.param<std::string>("depth_topic",depth_topic,"/camera/depth_registered/image_raw");///camera/depth/image_raw
+  private_nh.param<std::string>("rbg_calibration_topic",camera_topic,"/camera/rgb/camera_info");
+  private_nh.param<std::string>("depth_calibration_topic",depth_cam_topic,"/camera/depth_registered/camera_info");///camera/depth/camera_info
+  private_nh.param<std::string>("transform_topic",transform_topic,"vo_transformation"); //!< topic name for the output transformation message
+  private_nh.param<bool>("publish_keyframes",publish_keyframes_,true);
+  private_nh.param<std::string>("rgb_keyframe_topic",rgb_keyframe_topic,"/keyframe/rgb_image"); /// topic for the rgb keyframes
+  private_nh.param<std::string>("depth_keyframe_topic",depth_keyframe_topic,"/keyframe/depth_image"); /// topic for depth keyframes
+  private_nh.param<std::string>("rgb_info_topic",rgb_info_topic,"/keyframe/rgb_camera_info"); /// topic for the keyframe camera info
+  private_nh.param<bool>("keyframe_depth_float",keyframe_depth_float_,false); //!< keyframe depth as float meters, not 16 bit mm
+  private_nh.param<bool>("compress_keyframes",compress_keyframes_,false); //!< publish JPEG/PNG keyframes on <topic>/compressed
+  private_nh.param<std::string>("keyframe_archive_dir",keyframe_archive_dir,""); //!< on-disk keyframe store (empty = none)
+  private_nh.param<int>("keyframe_jpeg_quality",keyframe_jpeg_quality,90); //!< JPEG quality of the compressed color keyframes
+  private_nh.param<bool>("enable_timing",enable_timing_,true); //!< time each stage of the processing
+  private_nh.param<std::string>("timing_topic",timing_topic,"vo_timing"); //!< topic for the stage timing diagnostics
+  private_nh.param<std::string>("timing_trace_file",timing_trace_file,""); //!< binary per-frame trace (empty = none)
+  private_nh.param<int>("timing_window",timing_window_,30); //!< number of frames in each published timing summary
+  private_nh.param<bool>("latency_trace",latency_trace,true); //!< give each frame a trace id and publish its stages
+  private_nh.param<std::string>("latency_trace_topic",latency_trace_topic,"/latency_trace"); //!< topic for the stages (same in every node)
      \endcode
   */
 
@@ -108,8 +142,23 @@ ROSRelay::ROSRelay(ros::NodeHandle &nh)
     rgb_keyframe_pub_ = nh.advertise<sensor_msgs::Image>(rgb_keyframe_topic,5);
     depth_keyframe_pub_ = nh.advertise<sensor_msgs::Image>(depth_keyframe_topic,5);
     rgb_camera_info_pub_ = nh.advertise<sensor_msgs::CameraInfo>(rgb_info_topic,5);
-    keyframe_index_ = 1;
+
+    //the keyframes are compressed and/or stored on a worker thread, so the image callback isn't held up:
+    if(compress_keyframes_ || !keyframe_archive_dir.empty())
+    {
+      keyframe_archive_ = new KeyframeArchive(keyframe_jpeg_quality);
+      if(compress_keyframes_)
+      {
+        keyframe_archive_->setPublishers(nh.advertise<sensor_msgs::CompressedImage>(rgb_keyframe_topic + "/compressed",5),
+                                         nh.advertise<sensor_msgs::CompressedImage>(depth_keyframe_topic + "/compressed",5));
+      }
+      if(!keyframe_archive_dir.empty() && !keyframe_archive_->openStore(keyframe_archive_dir))
+      {
+        ROS_WARN("VO: Unable to open the keyframe archive in %s", keyframe_archive_dir.c_str());
+      }
+    }
   }
+  keyframe_index_ = 1;
 
 
   //subscriber for Motion Capture info (if logging is enabled)
@@ -126,6 +175,21 @@ ROSRelay::ROSRelay(ros::NodeHandle &nh)
   //start the service server:
   newReferenceServer_ = nh.advertiseService("newRefRequest",&ROSRelay::newReferenceCallback, this);
 
+  //stage timing diagnostics:
+  if(enable_timing_)
+  {
+    timing_publisher_ = nh.advertise<diagnostic_msgs::DiagnosticArray>(timing_topic, 2);
+    if(!timing_trace_file.empty() && !pose_estimator_->stageTimer().openTraceFile(timing_trace_file))
+    {
+      ROS_WARN("VO: Unable to open the timing trace file %s", timing_trace_file.c_str());
+    }
+  }
+
+  //camera frame to motor command latency trace:
+  trace_id_ = 0;
+  if(latency_trace)
+    latency_trace_.advertise(nh, latency_trace_topic);
+
   //initialize the rotation estimate to zeros
   rotation_estimate_ = cv::Mat::zeros(3,3,CV_64FC1);
 
@@ -197,9 +261,10 @@ ROSRelay::ROSRelay(ros::NodeHandle &nh)
 ROSRelay::~ROSRelay()
 {
   cv::destroyAllWindows();
+  delete keyframe_archive_; //finishes writing the queued keyframes
+  keyframe_archive_ = NULL;
   log_file_.close();
   cortex_file_.close();
-  pose_estimator_->~PoseEstimator();
   delete pose_estimator_;
 }
 
@@ -219,10 +284,25 @@ void ROSRelay::kinectCallback(const sensor_msgs::ImageConstPtr &rbg_image,
 //  ros_time = ros::Time::now();
 
   ROS_INFO_ONCE("VO: First Kinect Data Received!");  
+  ros::Time received_time = ros::Time::now(); //the first stage of the latency trace
+  uint32_t timing_flags = 0;
+  if(enable_timing_)
+    pose_estimator_->stageTimer().beginFrame(rbg_image->header.stamp.toSec(), rbg_image->header.seq);
+
   visual_image_ = cv_bridge::toCvCopy(rbg_image)->image;
-  cv::Mat depth_float = cv_bridge::toCvCopy(depth_image)->image;
 
-  depthToCV8UC1(depth_float, depth_mono8_image_);
+  //the depth is used as 16 bit millimeters (shared with the message when it comes in that way):
+  cv::Mat depth_mm;
+  if(!depthToMillimeters(depth_image, depth_mm))
+  {
+    ROS_WARN_THROTTLE(5, "VO: Unsupported depth encoding %s, expected 16UC1 (mm) or 32FC1 (m)",
+                      depth_image->encoding.c_str());
+    if(enable_timing_)
+      pose_estimator_->stageTimer().endFrame(StageTimer::FLAG_DROPPED);
+    return;
+  }
+
+  depthMillimetersToMask(depth_mm, depth_mono8_image_);
 
 
 //  ImageDisplay mono_depth_diplay("Mono_Depth");
@@ -243,35 +323,16 @@ void ROSRelay::kinectCallback(const sensor_msgs::ImageConstPtr &rbg_image,
     //send in camera calibration info:
     pose_estimator_->setKinectCalibration(depth_info, rgb_info);
 
-    pose_estimator_->setReferenceView(visual_image_, depth_float, depth_mono8_image_);
+    pose_estimator_->setReferenceView(visual_image_, depth_mm, depth_mono8_image_);
+    timing_flags = StageTimer::FLAG_REFERENCE;
 
     //publish the keyframe as a new message
-    sensor_msgs::Image rbg,depth;
-    rbg.header = rbg_image->header;
-    rbg.encoding = rbg_image->encoding;
-    rbg.data = rbg_image->data;
-    rbg.height = rbg_image->height;
-    rbg.is_bigendian = rbg_image->is_bigendian;
-    rbg.step = rbg_image->step;
-    rbg.width = rbg_image->width;
-    rbg.header.seq = keyframe_index_;
-
-    depth.header = depth_image->header;
-    depth.encoding = depth_image->encoding;
-    depth.data = depth_image->data;
-    depth.height = depth_image->height;
-    depth.is_bigendian = depth_image->is_bigendian;
-    depth.step = depth_image->step;
-    depth.width = depth_image->width;
-    depth.header.seq = keyframe_index_;
-
-    sensor_msgs::CameraInfo r_info;
-    r_info = *rgb_info;
-    r_info.header.seq = keyframe_index_;
-
-    rgb_keyframe_pub_.publish(rbg);
-    depth_keyframe_pub_.publish(depth);
-    rgb_camera_info_pub_.publish(r_info);
+    if(enable_timing_)
+      pose_estimator_->stageTimer().start(STAGE_PUBLISH);
+    if(publish_keyframes_)
+      publishKeyframe(rbg_image, depth_image, depth_mm, rgb_info);
+    if(enable_timing_)
+      pose_estimator_->stageTimer().stop(STAGE_PUBLISH);
   }
   else
   {       
@@ -288,7 +349,7 @@ void ROSRelay::kinectCallback(const sensor_msgs::ImageConstPtr &rbg_image,
         set_as_reference_ = false;
       }
     pthread_mutex_unlock(&mutex_);
-    int result =  pose_estimator_->setCurrentAndFindTransform(visual_image_, depth_float, depth_mono8_image_,
+    int result =  pose_estimator_->setCurrentAndFindTransform(visual_image_, depth_mm, depth_mono8_image_,
                                                               &rotation, &translation, &covariance,
                                                               &inliers, &corresponding,&total,
                                                               set_as_reference_,&rot_optimized,
@@ -298,6 +359,9 @@ void ROSRelay::kinectCallback(const sensor_msgs::ImageConstPtr &rbg_image,
 //    std::cout << "Ungained covariance:" << std::endl;
 //    std::cout << covariance << std::endl;
 
+    if(set_as_reference_)
+      timing_flags |= StageTimer::FLAG_REFERENCE;
+
     //result is zero if frame was dropped:
     if(result != 0)
     {
@@ -327,7 +391,11 @@ void ROSRelay::kinectCallback(const sensor_msgs::ImageConstPtr &rbg_image,
 
 
       //Publish the results in a ROS message:
-      kinect_vo::kinect_vo_message pose_message;
+      if(enable_timing_)
+        pose_estimator_->stageTimer().start(STAGE_PUBLISH);
+      //published as a shared pointer, so a subscriber in the same process (nodelet) gets it without a copy
+      kinect_vo::kinect_vo_messagePtr pose_message_ptr(new kinect_vo::kinect_vo_message);
+      kinect_vo::kinect_vo_message &pose_message = *pose_message_ptr;
 
       pose_message.header.stamp = rgb_info->header.stamp; //Timestamp the pose with the image timestamp
       pose_message.header.frame_id = "reference_camera"; //The parent (the coordinate frame the transformation is expressed in)
@@ -356,7 +424,11 @@ void ROSRelay::kinectCallback(const sensor_msgs::ImageConstPtr &rbg_image,
       pose_message.corresponding = corresponding;
       pose_message.inliers = inliers;      
       eigenToMatrixPtr(covariance,pose_message.covariance);
-      pose_publisher_.publish(pose_message);
+      pose_message.trace_id = latency_trace_.enabled() ? ++trace_id_ : 0;
+      pose_publisher_.publish(pose_message_ptr);
+      latency_trace_.stamp(pose_message.trace_id, pose_message.header.stamp, kinect_vo::latency_stage::VO_RECEIVED,
+                           received_time);
+      latency_trace_.stamp(pose_message.trace_id, pose_message.header.stamp, kinect_vo::latency_stage::VO_PUBLISHED);
 
 
 //      /// \attention THIS IS TEMPORARY TO PUBLISH TWO MESSAGES FOR A COMPARISION!
@@ -391,32 +463,7 @@ void ROSRelay::kinectCallback(const sensor_msgs::ImageConstPtr &rbg_image,
 
       if(set_as_reference_ && publish_keyframes_)
       {
-        sensor_msgs::Image rbg,depth;
-        rbg.header = rbg_image->header;
-        rbg.encoding = rbg_image->encoding;
-        rbg.data = rbg_image->data;
-        rbg.height = rbg_image->height;
-        rbg.is_bigendian = rbg_image->is_bigendian;
-        rbg.step = rbg_image->step;
-        rbg.width = rbg_image->width;
-        rbg.header.seq = keyframe_index_;
-
-        depth.header = depth_image->header;
-        depth.encoding = depth_image->encoding;
-        depth.data = depth_image->data;
-        depth.height = depth_image->height;
-        depth.is_bigendian = depth_image->is_bigendian;
-        depth.step = depth_image->step;
-        depth.width = depth_image->width;
-        depth.header.seq = keyframe_index_;
-
-        sensor_msgs::CameraInfo r_info;
-        r_info = *rgb_info;
-        r_info.header.seq = keyframe_index_;
-
-        rgb_keyframe_pub_.publish(rbg);
-        depth_keyframe_pub_.publish(depth);
-        rgb_camera_info_pub_.publish(r_info);
+        publishKeyframe(rbg_image, depth_image, depth_mm, rgb_info);
       }
 
       if(enable_logging_)
@@ -440,10 +487,13 @@ void ROSRelay::kinectCallback(const sensor_msgs::ImageConstPtr &rbg_image,
                   <<" "<<covariance(6,4)<<" "<<covariance(6,5)<<" "<<covariance(6,6)<<std::endl;
         log_file_.flush();
       }
+      if(enable_timing_)
+        pose_estimator_->stageTimer().stop(STAGE_PUBLISH);
     }
     else
     {     
       //dropped a frame:
+      timing_flags |= StageTimer::FLAG_DROPPED;
       dropped_frames_++;
       ROS_WARN("Frame was dropped.  Total Dropped Frames = %d", dropped_frames_);
 
@@ -478,6 +528,135 @@ void ROSRelay::kinectCallback(const sensor_msgs::ImageConstPtr &rbg_image,
       }
     }
   }
+
+  if(enable_timing_)
+  {
+    pose_estimator_->stageTimer().endFrame(timing_flags);
+    if((int)pose_estimator_->stageTimer().frames() >= timing_window_)
+      publishTiming(rgb_info->header.stamp);
+  }
+}
+
+
+
+//
+// Bring the depth image into 16 bit millimeters
+//
+bool ROSRelay::depthToMillimeters(const sensor_msgs::ImageConstPtr &depth_image, cv::Mat &depth_mm)
+{
+  namespace enc = sensor_msgs::image_encodings;
+
+  if(depth_image->encoding == enc::TYPE_16UC1 || depth_image->encoding == enc::MONO16)
+  {
+    //already millimeters, no need to copy it:
+    depth_mm = cv_bridge::toCvShare(depth_image)->image;
+    return true;
+  }
+  else if(depth_image->encoding == enc::TYPE_32FC1)
+  {
+    //quantize the float (meters) image into the reused buffer:
+    depthFloatToMillimeters(cv_bridge::toCvShare(depth_image)->image, depth_mm_buffer_);
+    depth_mm = depth_mm_buffer_;
+    return true;
+  }
+
+  return false;
+}
+
+
+
+//
+// Republish the keyframe images and calibration
+//
+void ROSRelay::publishKeyframe(const sensor_msgs::ImageConstPtr &rbg_image,
+                               const sensor_msgs::ImageConstPtr &depth_image,
+                               const cv::Mat &depth_mm,
+                               const sensor_msgs::CameraInfoConstPtr &rgb_info)
+{
+  sensor_msgs::CameraInfo r_info;
+  r_info = *rgb_info;
+  r_info.header.seq = keyframe_index_;
+
+  if(keyframe_archive_ != NULL)
+  {
+    std_msgs::Header header = rbg_image->header;
+    header.seq = keyframe_index_;
+    keyframe_archive_->addKeyframe(header, visual_image_, depth_mm, r_info);
+  }
+
+  if(!compress_keyframes_)
+  {
+    sensor_msgs::Image rbg;
+    rbg.header = rbg_image->header;
+    rbg.encoding = rbg_image->encoding;
+    rbg.data = rbg_image->data;
+    rbg.height = rbg_image->height;
+    rbg.is_bigendian = rbg_image->is_bigendian;
+    rbg.step = rbg_image->step;
+    rbg.width = rbg_image->width;
+    rbg.header.seq = keyframe_index_;
+
+    //the depth goes out as 16 bit millimeters (half the size of float), unless a consumer still needs float:
+    cv_bridge::CvImage depth;
+    depth.header = depth_image->header;
+    depth.header.seq = keyframe_index_;
+    if(keyframe_depth_float_)
+    {
+      depth.encoding = sensor_msgs::image_encodings::TYPE_32FC1;
+      depthMillimetersToFloat(depth_mm, depth.image);
+    }
+    else
+    {
+      depth.encoding = sensor_msgs::image_encodings::TYPE_16UC1;
+      depth.image = depth_mm;
+    }
+
+    rgb_keyframe_pub_.publish(rbg);
+    depth_keyframe_pub_.publish(depth.toImageMsg());
+  }
+  rgb_camera_info_pub_.publish(r_info);
+}
+
+
+
+//
+// Publish the summary of the stage timing histograms, then clear them for the next window
+//
+void ROSRelay::publishTiming(ros::Time stamp)
+{
+  StageTimer &timer = pose_estimator_->stageTimer();
+
+  diagnostic_msgs::DiagnosticArray array;
+  array.header.stamp = stamp;
+  array.status.resize(NUM_STAGES);
+
+  for(int i = 0; i < NUM_STAGES; i++)
+  {
+    StageStats stats;
+    timer.summarize(i, &stats);
+
+    diagnostic_msgs::DiagnosticStatus &status = array.status[i];
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = std::string("kinect_vo/") + StageTimer::stageName(i);
+    status.hardware_id = "kinect_vo";
+    status.message = "microseconds";
+    status.values.resize(6);
+    status.values[0].key = "count";
+    status.values[0].value = boost::lexical_cast<std::string>(stats.count);
+    status.values[1].key = "mean";
+    status.values[1].value = boost::lexical_cast<std::string>(stats.mean);
+    status.values[2].key = "p50";
+    status.values[2].value = boost::lexical_cast<std::string>(stats.p50);
+    status.values[3].key = "p95";
+    status.values[3].value = boost::lexical_cast<std::string>(stats.p95);
+    status.values[4].key = "p99";
+    status.values[4].value = boost::lexical_cast<std::string>(stats.p99);
+    status.values[5].key = "max";
+    status.values[5].value = boost::lexical_cast<std::string>(stats.max);
+  }
+
+  timing_publisher_.publish(array);
+  timer.reset();
 }
 
 
@@ -661,6 +840,8 @@ std::string ROSRelay::timeStructFilename(tm *time_struct)
 //  R->at<double>(2,2) = 2*q0*q0 - 1 + 2*q3*q3;
 //}
 
+}
+
 
 
 
@@ -0,0 +1,162 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file stage_timer.cpp
+ *  \author agent
+ *  \date October 2026
+ *
+ *  \brief This implements the methods outlined in stage_timer.h
+*/
+
+#include "stage_timer.h"
+
+namespace kinect_vo
+{
+
+//
+// Constructor
+//
+StageTimer::StageTimer():trace_file_(NULL)
+{
+  reset();
+  memset(start_ns_, 0, sizeof(start_ns_));
+  memset(&frame_, 0, sizeof(frame_));
+}
+
+
+//
+// Destructor
+//
+StageTimer::~StageTimer()
+{
+  closeTraceFile();
+}
+
+
+//
+// Open the binary trace file and write the header
+//
+bool StageTimer::openTraceFile(const std::string &filename)
+{
+  closeTraceFile();
+
+  trace_file_ = fopen(filename.c_str(), "wb");
+  if(trace_file_ == NULL)
+    return false;
+
+  TraceHeader header;
+  memcpy(header.magic, "VOTR", 4);
+  header.version = 1;
+  header.num_stages = NUM_STAGES;
+  header.record_size = sizeof(TraceRecord);
+  fwrite(&header, sizeof(header), 1, trace_file_);
+
+  return true;
+}
+
+
+//
+// Close the trace file
+//
+void StageTimer::closeTraceFile()
+{
+  if(trace_file_ != NULL)
+  {
+    fclose(trace_file_);
+    trace_file_ = NULL;
+  }
+}
+
+
+//
+// Finish a frame: add each stage that ran to the histograms, write out the record
+//
+void StageTimer::endFrame(uint32_t flags)
+{
+  stop(STAGE_TOTAL);
+  frame_.flags = flags;
+
+  for(int i = 0; i < NUM_STAGES; i++)
+  {
+    uint32_t us = frame_.stage_us[i];
+    if(us == 0 && i != STAGE_TOTAL)
+      continue; //the stage didn't run this frame (sub-microsecond stages are lost, which is fine)
+
+    histogram_[i][binIndex(us)]++;
+    sum_us_[i] += us;
+    count_[i]++;
+    if(us > max_us_[i])
+      max_us_[i] = us;
+  }
+  frames_++;
+
+  if(trace_file_ != NULL)
+  {
+    //the FILE buffer batches these up, so this doesn't cost a syscall per frame
+    fwrite(&frame_, sizeof(frame_), 1, trace_file_);
+  }
+}
+
+
+//
+// Find the mean, percentiles, and max for a stage
+//
+void StageTimer::summarize(int stage, StageStats *stats) const
+{
+  memset(stats, 0, sizeof(StageStats));
+  stats->count = count_[stage];
+  if(count_[stage] == 0)
+    return;
+
+  stats->mean = (double)sum_us_[stage]/(double)count_[stage];
+  stats->max = (double)max_us_[stage];
+
+  //walk the bins until the cumulative count passes each percentile:
+  const double fractions[3] = {0.50, 0.95, 0.99};
+  double *outputs[3] = {&stats->p50, &stats->p95, &stats->p99};
+  int next = 0;
+  uint64_t cumulative = 0;
+
+  for(int bin = 0; bin < NUM_BINS && next < 3; bin++)
+  {
+    cumulative += histogram_[stage][bin];
+    while(next < 3 && (double)cumulative >= fractions[next]*(double)count_[stage])
+    {
+      //report the lower edge of the bin, but never more than the max
+      double value = binLowerBound(bin);
+      *outputs[next] = (value > stats->max) ? stats->max : value;
+      next++;
+    }
+  }
+}
+
+
+//
+// Clear the histograms
+//
+void StageTimer::reset()
+{
+  memset(histogram_, 0, sizeof(histogram_));
+  memset(sum_us_, 0, sizeof(sum_us_));
+  memset(max_us_, 0, sizeof(max_us_));
+  memset(count_, 0, sizeof(count_));
+  frames_ = 0;
+}
+
+
+//
+// Names for the stages
+//
+const char* StageTimer::stageName(int stage)
+{
+  static const char* names[NUM_STAGES] = {"detect", "describe", "undistort", "backproject", "match", "ransac",
+                                          "covariance", "publish", "total"};
+  if(stage < 0 || stage >= NUM_STAGES)
+    return "unknown";
+  return names[stage];
+}
+
+}
@@ -65,6 +65,28 @@ static inline unsigned int bswap_32(unsigned int x) {
 
 
 //! Code to extract a floating point number from the IMU
+// The baud rate of a termios speed, 0 if it isn't one the IMU supports
+static int baud_rate(speed_t speed)
+{
+  switch (speed)
+  {
+    case B9600:   return 9600;
+    case B19200:  return 19200;
+    case B38400:  return 38400;
+    case B57600:  return 57600;
+    case B115200: return 115200;
+    case B230400: return 230400;
+#ifdef B460800
+    case B460800: return 460800;
+#endif
+#ifdef B921600
+    case B921600: return 921600;
+#endif
+    default:      return 0;
+  }
+}
+
+
 static float extract_float(uint8_t* addr) {
 
   float tmp;
@@ -95,8 +117,10 @@ static unsigned long long time_helper()
 
 ////////////////////////////////////////////////////////////////////////////////
 // Constructor
-microstrain_3dmgx2_imu::IMU::IMU() : fd(-1), continuous(false), is_gx3(false)
-{ }
+microstrain_3dmgx2_imu::IMU::IMU() : fd(-1), continuous(false), is_gx3(false), rx_start(0), rx_end(0), rx_time(0), ns_per_byte(0), skipped(0)
+{
+  memset(&stream_stats, 0, sizeof(stream_stats));
+}
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -155,12 +179,22 @@ microstrain_3dmgx2_imu::IMU::openPort(const char *port_name)
   if (tcsetattr(fd, TCSAFLUSH, &term) < 0 )
     IMU_EXCEPT(microstrain_3dmgx2_imu::Exception, "Unable to set serial port attributes. The port you specified (%s) may not be a serial port.", port_name); /// @todo tcsetattr returns true if at least one attribute was set. Hence, we might not have set everything on success.
 
+  // The messages are back-dated from the end of each read by the time the bytes take at the speed the port ended up
+  // with (8N1 is 10 bits a byte)
+  int baud = 0;
+  if (tcgetattr(fd, &term) == 0)
+    baud = baud_rate(cfgetispeed(&term));
+  if (baud == 0)
+    IMU_EXCEPT(microstrain_3dmgx2_imu::Exception, "Unable to read back the baud rate of the serial port (%s).", port_name);
+  ns_per_byte = 10ULL * 1000000000ULL / baud;
+
   // Stop continuous mode
   stopContinuous();
 
   // Make sure queues are empty before we begin
   if (tcflush(fd, TCIOFLUSH) != 0)
     IMU_EXCEPT(microstrain_3dmgx2_imu::Exception, "Tcflush failed. Please report this error if you see it.");
+  clearBuffer();
 }
 
 
@@ -292,6 +326,7 @@ microstrain_3dmgx2_imu::IMU::stopContinuous()
 
   if (tcflush(fd, TCIOFLUSH) != 0)
     IMU_EXCEPT(microstrain_3dmgx2_imu::Exception, "Tcflush failed");
+  clearBuffer();
 
   continuous = false;
 }
@@ -345,41 +380,66 @@ microstrain_3dmgx2_imu::IMU::receiveAccelAngrateMag(uint64_t *time, double accel
 void
 microstrain_3dmgx2_imu::IMU::receiveAccelAngrateOrientation(uint64_t *time, double accel[3], double angrate[3], double orientation[9])
 {
-  int i, k;
-  uint8_t rep[67];
+  AccelAngrateOrientation sample;
 
-  uint64_t sys_time;
-  uint64_t imu_time;
+  receiveAccelAngrateOrientation(&sample, 1);
 
-  //ROS_DEBUG("About to do receive.");
-  receive(CMD_ACCEL_ANGRATE_ORIENT, rep, sizeof(rep), 1000, &sys_time);
-  //ROS_DEBUG("Finished receive.");
+  *time = sample.time;
+  memcpy(accel, sample.accel, sizeof(sample.accel));
+  memcpy(angrate, sample.angrate, sizeof(sample.angrate));
+  memcpy(orientation, sample.orientation, sizeof(sample.orientation));
+}
 
-  // Read the acceleration:
-  k = 1;
-  for (i = 0; i < 3; i++)
-  {
-    accel[i] = extract_float(rep + k) * G;
-    k += 4;
-  }
 
-  // Read the angular rates
-  k = 13;
-  for (i = 0; i < 3; i++)
+#define CMD_ACCEL_ANGRATE_ORIENT_REP_LEN 67
+#define MAX_BATCH 64
+////////////////////////////////////////////////////////////////////////////////
+// Receive all the ACCEL_ANGRATE_ORIENTATION messages that have arrived
+int
+microstrain_3dmgx2_imu::IMU::receiveAccelAngrateOrientation(AccelAngrateOrientation *samples, int max_samples)
+{
+  uint8_t reps[MAX_BATCH][CMD_ACCEL_ANGRATE_ORIENT_REP_LEN];
+  uint64_t sys_times[MAX_BATCH];
+
+  if (max_samples > MAX_BATCH)
+    max_samples = MAX_BATCH;
+
+  int count = receiveBatch(CMD_ACCEL_ANGRATE_ORIENT, &reps[0][0], CMD_ACCEL_ANGRATE_ORIENT_REP_LEN, sys_times, max_samples, 1000);
+
+  for (int n = 0; n < count; n++)
   {
-    angrate[i] = extract_float(rep + k);
-    k += 4;
-  }
+    uint8_t *rep = reps[n];
+    AccelAngrateOrientation &sample = samples[n];
+    int i, k;
 
-  // Read the orientation matrix
-  k = 25;
-  for (i = 0; i < 9; i++) {
-    orientation[i] = extract_float(rep + k);
-    k += 4;
+    // Read the acceleration:
+    k = 1;
+    for (i = 0; i < 3; i++)
+    {
+      sample.accel[i] = extract_float(rep + k) * G;
+      k += 4;
+    }
+
+    // Read the angular rates
+    k = 13;
+    for (i = 0; i < 3; i++)
+    {
+      sample.angrate[i] = extract_float(rep + k);
+      k += 4;
+    }
+
+    // Read the orientation matrix
+    k = 25;
+    for (i = 0; i < 9; i++) {
+      sample.orientation[i] = extract_float(rep + k);
+      k += 4;
+    }
+
+    uint64_t imu_time = extractTime(rep+61);
+    sample.time = filterTime(imu_time, sys_times[n]);
   }
 
-  imu_time = extractTime(rep+61);
-  *time = filterTime(imu_time, sys_time);
+  return count;
 }
 
 
@@ -638,85 +698,185 @@ microstrain_3dmgx2_imu::IMU::send(void *cmd, int cmd_len)
 }
 
 
-static int read_with_timeout(int fd, void *buff, size_t count, int timeout)
+//! Sum of the bytes modulo 2^16 (the IMU checksum), eight bytes per step
+/*!
+ * The 64 bit accumulator holds four 16 bit partial sums, each step adds the
+ * even and the odd bytes of a word to them.  A lane gains at most 510 per
+ * step, so the lanes are folded into the total every 64 steps, before one
+ * could carry into the next.
+ */
+static uint16_t checksum16(const uint8_t *data, int len)
+{
+  const uint64_t low_bytes = 0x00ff00ff00ff00ffULL;
+  uint32_t sum = 0;
+  int i = 0;
+
+  while (len - i >= 8)
+  {
+    uint64_t lanes = 0;
+    for (int steps = 0; steps < 64 && len - i >= 8; steps++, i += 8)
+    {
+      uint64_t word;
+      memcpy(&word, data + i, sizeof(word));
+      lanes += (word & low_bytes) + ((word >> 8) & low_bytes);
+    }
+    sum += (lanes & 0xffff) + ((lanes >> 16) & 0xffff) + ((lanes >> 32) & 0xffff) + (lanes >> 48);
+  }
+
+  for (; i < len; i++)
+    sum += data[i];
+
+  return (uint16_t)sum;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Read whatever is waiting on the port into the receive buffer.
+// Waits up to timeout ms (0 means forever) for the first byte.
+void
+microstrain_3dmgx2_imu::IMU::fillBuffer(int timeout)
 {
-  ssize_t nbytes;
   int retval;
 
+  // Keep the unused bytes at the front so a message is always contiguous
+  if (rx_start == rx_end)
+  {
+    rx_start = rx_end = 0;
+  }
+  else if (rx_start > 0 && rx_end > RX_BUFFER_LEN / 2)
+  {
+    memmove(rx_buffer, rx_buffer + rx_start, rx_end - rx_start);
+    rx_end -= rx_start;
+    rx_start = 0;
+  }
+
   struct pollfd ufd[1];
   ufd[0].fd = fd;
   ufd[0].events = POLLIN;
 
   if (timeout == 0)
     timeout = -1; // For compatibility with former behavior, 0 means no timeout. For poll, negative means no timeout.
-  
+
   if ( (retval = poll(ufd, 1, timeout)) < 0 )
     IMU_EXCEPT(microstrain_3dmgx2_imu::Exception, "poll failed  [%s]", strerror(errno));
 
   if (retval == 0)
     IMU_EXCEPT(microstrain_3dmgx2_imu::TimeoutException, "timeout reached");
-	
-  nbytes = read(fd, (uint8_t *) buff, count);
+
+  ssize_t nbytes = read(fd, rx_buffer + rx_end, RX_BUFFER_LEN - rx_end);
+  rx_time = time_helper();
 
   if (nbytes < 0)
     IMU_EXCEPT(microstrain_3dmgx2_imu::Exception, "read failed  [%s]", strerror(errno));
 
-  return nbytes;
+  rx_end += nbytes;
+  stream_stats.reads++;
 }
 
+
 ////////////////////////////////////////////////////////////////////////////////
-// Receive a reply from the IMU.
-// Returns the number of bytes read.
-int
-microstrain_3dmgx2_imu::IMU::receive(uint8_t command, void *rep, int rep_len, int timeout, uint64_t* sys_time)
+// Find the next message of one type in the receive buffer.
+// Returns false (having dropped the bytes that can't start one) if there is
+// no complete message yet.
+bool
+microstrain_3dmgx2_imu::IMU::extractMessage(uint8_t command, uint8_t *rep, int rep_len, uint64_t *sys_time)
 {
-  int nbytes, bytes, skippedbytes;
+  while (rx_end - rx_start >= rep_len)
+  {
+    uint8_t *start = rx_buffer + rx_start;
+    uint8_t *header = (uint8_t *)memchr(start, command, rx_end - rx_start - rep_len + 1);
 
-  skippedbytes = 0;
+    if (header == NULL)
+    {
+      // Only the last rep_len - 1 bytes could still be the start of a message
+      int dropped = rx_end - rx_start - rep_len + 1;
+      skipped += dropped;
+      stream_stats.bytes_skipped += dropped;
+      rx_start += dropped;
+      break;
+    }
 
-  struct pollfd ufd[1];
-  ufd[0].fd = fd;
-  ufd[0].events = POLLIN;
-  
-  // Skip everything until we find our "header"
-  *(uint8_t*)(rep) = 0;
-  
-  while (*(uint8_t*)(rep) != command && skippedbytes < MAX_BYTES_SKIPPED)
-  {
-    read_with_timeout(fd, rep, 1, timeout);
+    skipped += header - start;
+    stream_stats.bytes_skipped += header - start;
+    rx_start += header - start;
 
-    skippedbytes++;
-  }
+    // Checksum is always final 2 bytes of transaction
+    uint16_t checksum = (header[rep_len - 2] << 8) | header[rep_len - 1];
+    if (checksum16(header, rep_len - 2) == checksum)
+    {
+      memcpy(rep, header, rep_len);
+      rx_start += rep_len;
+      skipped = 0;
+      stream_stats.messages++;
+
+      // The message ended (rx_end - rx_start) bytes before the end of the last read
+      if (sys_time != NULL)
+        *sys_time = rx_time - (uint64_t)(rx_end - rx_start) * ns_per_byte;
+      return true;
+    }
 
-  if (sys_time != NULL)
-    *sys_time = time_helper();
-  
-  // We now have 1 byte
-  bytes = 1;
+    // A data byte that looked like a header, or a corrupted message: search again from the next byte
+    stream_stats.checksum_errors++;
+    skipped++;
+    rx_start++;
+  }
 
-  // Read the rest of the message:
-  while (bytes < rep_len)
+  if (skipped > MAX_BYTES_SKIPPED)
   {
-    nbytes = read_with_timeout(fd, (uint8_t *)rep + bytes, rep_len - bytes, timeout);
-    
-    if (nbytes < 0)
-      IMU_EXCEPT(microstrain_3dmgx2_imu::Exception, "read failed  [%s]", strerror(errno));
-    
-    bytes += nbytes;
+    skipped = 0;
+    IMU_EXCEPT(microstrain_3dmgx2_imu::CorruptedDataException, "no valid message found.\n Make sure the IMU sensor is connected to this computer.");
   }
 
-  // Checksum is always final 2 bytes of transaction
+  return false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Receive every complete message of one type from the IMU, waiting for the
+// first.  Messages already in the buffer are returned without reading again.
+// Returns the number of messages.
+int
+microstrain_3dmgx2_imu::IMU::receiveBatch(uint8_t command, uint8_t *reps, int rep_len, uint64_t *sys_times, int max_count, int timeout)
+{
+  int count = 0;
 
-  uint16_t checksum = 0;
-  for (int i = 0; i < rep_len - 2; i++) {
-    checksum += ((uint8_t*)rep)[i];
+  skipped = 0;
+
+  while (count < max_count)
+  {
+    if (extractMessage(command, reps + count * rep_len, rep_len, sys_times ? sys_times + count : NULL))
+      count++;
+    else if (count > 0)
+      break; // Everything that was complete has been taken
+    else
+      fillBuffer(timeout);
   }
 
-  // If wrong throw Exception
-  if (checksum != bswap_16(*(uint16_t*)((uint8_t*)rep+rep_len-2)))
-    IMU_EXCEPT(microstrain_3dmgx2_imu::CorruptedDataException, "invalid checksum.\n Make sure the IMU sensor is connected to this computer.");
-  
-  return bytes;
+  return count;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Receive a reply from the IMU.
+// Returns the number of bytes read.
+int
+microstrain_3dmgx2_imu::IMU::receive(uint8_t command, void *rep, int rep_len, int timeout, uint64_t* sys_time)
+{
+  receiveBatch(command, (uint8_t *)rep, rep_len, sys_time, 1, timeout);
+
+  return rep_len;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Get the receive counters
+void
+microstrain_3dmgx2_imu::IMU::getStreamStats(StreamStats *stats, bool reset)
+{
+  *stats = stream_stats;
+
+  if (reset)
+    memset(&stream_stats, 0, sizeof(stream_stats));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
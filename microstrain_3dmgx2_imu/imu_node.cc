@@ -53,11 +53,15 @@
 
 #include "tf/transform_datatypes.h"
 #include "microstrain_3dmgx2_imu/AddOffset.h"
+#include "microstrain_3dmgx2_imu/ImuBatch.h"
 
 #include "std_msgs/Bool.h"
 
 using namespace std;
 
+//! The most samples taken from the IMU driver in one call (the buffer holds about 60)
+#define MAX_SAMPLES_PER_READ 64
+
 class ImuNode 
 {
 public:
@@ -74,12 +78,16 @@ public:
   ros::NodeHandle node_handle_;
   ros::NodeHandle private_node_handle_;
   ros::Publisher imu_data_pub_;
+  ros::Publisher imu_batch_pub_;
   ros::ServiceServer add_offset_serv_;
   ros::ServiceServer calibrate_serv_;
   ros::Publisher is_calibrated_pub_;
 
   bool running;
 
+  bool batch_output_;
+  microstrain_3dmgx2_imu::ImuBatch batch_;
+
   bool autocalibrate_;
   bool calibrate_requested_;
   bool calibrated_;
@@ -122,6 +130,11 @@ public:
 
 
     imu_data_pub_ = imu_node_handle.advertise<sensor_msgs::Imu>("data", 100);
+
+    // Optionally publish the samples from each read together, for consumers that can't afford a message per sample
+    private_node_handle_.param("batch_output", batch_output_, false);
+    if (batch_output_)
+      imu_batch_pub_ = imu_node_handle.advertise<microstrain_3dmgx2_imu::ImuBatch>("data_batch", 10);
     add_offset_serv_ = private_node_handle_.advertiseService("add_offset", &ImuNode::addOffset, this);
     calibrate_serv_ = imu_node_handle.advertiseService("calibrate", &ImuNode::calibrate, this);
     is_calibrated_pub_ = imu_node_handle.advertise<std_msgs::Bool>("is_calibrated", 1, true);
@@ -158,6 +171,11 @@ public:
     reading.orientation_covariance[0] = orientation_covariance;
     reading.orientation_covariance[4] = orientation_covariance;
     reading.orientation_covariance[8] = orientation_covariance;
+
+    batch_.header.frame_id = frameid_;
+    batch_.orientation_covariance = reading.orientation_covariance;
+    batch_.angular_velocity_covariance = reading.angular_velocity_covariance;
+    batch_.linear_acceleration_covariance = reading.linear_acceleration_covariance;
     
     self_test_.add("Close Test", this, &ImuNode::pretest);
     self_test_.add("Interruption Test", this, &ImuNode::InterruptionTest);
@@ -318,7 +336,9 @@ public:
         was_slow_ = "Full IMU loop was slow.";
         slow_count_++;
       }
-      getData(reading);
+      // Everything that arrived since the last call is decoded from one read
+      microstrain_3dmgx2_imu::IMU::AccelAngrateOrientation samples[MAX_SAMPLES_PER_READ];
+      int count = imu.receiveAccelAngrateOrientation(samples, MAX_SAMPLES_PER_READ);
       double endtime = ros::Time::now().toSec();
       if (endtime - starttime > 0.05)
       {
@@ -328,7 +348,34 @@ public:
       }
       prevtime = starttime;
       starttime = ros::Time::now().toSec();
-      imu_data_pub_.publish(reading);
+      // In batch mode the single samples are only published if someone listens to them
+      bool publish_single = !batch_output_ || imu_data_pub_.getNumSubscribers() > 0;
+      if (batch_output_)
+      {
+        batch_.stamps.resize(count);
+        batch_.orientation.resize(count);
+        batch_.angular_velocity.resize(count);
+        batch_.linear_acceleration.resize(count);
+      }
+      for (int i = 0; i < count; i++)
+      {
+        fillReading(samples[i], reading);
+        if (publish_single)
+          imu_data_pub_.publish(reading);
+        if (batch_output_)
+        {
+          batch_.stamps[i] = reading.header.stamp;
+          batch_.orientation[i] = reading.orientation;
+          batch_.angular_velocity[i] = reading.angular_velocity;
+          batch_.linear_acceleration[i] = reading.linear_acceleration;
+        }
+        freq_diag_.tick();
+      }
+      if (batch_output_)
+      {
+        batch_.header.stamp = reading.header.stamp;
+        imu_batch_pub_.publish(batch_);
+      }
       endtime = ros::Time::now().toSec();
       if (endtime - starttime > 0.05)
       {
@@ -336,8 +383,7 @@ public:
         was_slow_ = "Full IMU loop was slow.";
         slow_count_++;
       }
-        
-      freq_diag_.tick();
+
       clearErrorStatus(); // If we got here, then the IMU really is working. Next time an error occurs, we want to print it.
     } catch (microstrain_3dmgx2_imu::Exception& e) {
       error_count_++;
@@ -432,19 +478,24 @@ public:
 
   void getData(sensor_msgs::Imu& data)
   {
-    uint64_t time;
-    double accel[3];
-    double angrate[3];
-    double orientation[9];
+    microstrain_3dmgx2_imu::IMU::AccelAngrateOrientation sample;
 
-    imu.receiveAccelAngrateOrientation(&time, accel, angrate, orientation);
-    data.linear_acceleration.x = accel[0];
-    data.linear_acceleration.y = accel[1];
-    data.linear_acceleration.z = accel[2];
+    imu.receiveAccelAngrateOrientation(&sample, 1);
+    fillReading(sample, data);
+  }
+
+
+  void fillReading(const microstrain_3dmgx2_imu::IMU::AccelAngrateOrientation& sample, sensor_msgs::Imu& data)
+  {
+    const double *orientation = sample.orientation;
+
+    data.linear_acceleration.x = sample.accel[0];
+    data.linear_acceleration.y = sample.accel[1];
+    data.linear_acceleration.z = sample.accel[2];
  
-    data.angular_velocity.x = angrate[0];
-    data.angular_velocity.y = angrate[1];
-    data.angular_velocity.z = angrate[2];
+    data.angular_velocity.x = sample.angrate[0];
+    data.angular_velocity.y = sample.angrate[1];
+    data.angular_velocity.z = sample.angrate[2];
       
     tf::Quaternion quat;
     (tf::Matrix3x3(-1,0,0,
@@ -456,7 +507,7 @@ public:
     
     tf::quaternionTFToMsg(quat, data.orientation);
       
-    data.header.stamp = ros::Time::now().fromNSec(time);
+    data.header.stamp = ros::Time::now().fromNSec(sample.time);
   }
 
 
@@ -573,6 +624,14 @@ public:
     status.add("TF frame", frameid_);
     status.add("Error count", error_count_);
     status.add("Excessive delay", slow_count_);
+
+    microstrain_3dmgx2_imu::IMU::StreamStats stats;
+    imu.getStreamStats(&stats, true);
+    status.add("Messages", stats.messages);
+    status.add("Reads", stats.reads);
+    status.add("Messages per read", stats.reads ? (double)stats.messages / stats.reads : 0.0);
+    status.add("Checksum errors", stats.checksum_errors);
+    status.add("Bytes skipped", stats.bytes_skipped);
   }
 
   void calibrationStatus(diagnostic_updater::DiagnosticStatusWrapper& status)
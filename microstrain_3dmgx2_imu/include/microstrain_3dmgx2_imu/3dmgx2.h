@@ -95,6 +95,8 @@ namespace microstrain_3dmgx2_imu
     static const int TICKS_PER_SEC_GX3  = 62500;
     //! Maximum bytes allowed to be skipped when seeking a message
     static const int MAX_BYTES_SKIPPED  = 1000;
+    //! Size of the receive buffer (many of the largest messages)
+    static const int RX_BUFFER_LEN      = 4096;
     //! Number of KF samples to sum over
     static const unsigned int KF_NUM_SUM= 100;
     //! First KF term
@@ -131,6 +133,24 @@ namespace microstrain_3dmgx2_imu
       CMD_STOP_CONTINUOUS          =  0xFA
     };
 
+    //! One "ACCEL_ANGRATE_ORIENTATION" message
+    struct AccelAngrateOrientation
+    {
+      uint64_t time;
+      double accel[3];
+      double angrate[3];
+      double orientation[9];
+    };
+
+    //! Counters for the continuous mode receive path
+    struct StreamStats
+    {
+      unsigned int reads;            //!< read() calls on the port
+      unsigned int messages;         //!< messages with a valid checksum
+      unsigned int checksum_errors;  //!< headers whose checksum failed (the stream is searched again from the next byte)
+      unsigned int bytes_skipped;    //!< bytes discarded while looking for a header
+    };
+
     //! Enumeration of possible identifier strings for the getDeviceIdentifierString command.
 
     enum id_string {
@@ -237,6 +257,19 @@ namespace microstrain_3dmgx2_imu
      */
     void receiveAccelAngrateOrientation(uint64_t *time, double accel[3], double angrate[3], double orientation[9]);
 
+    //! Read all the "ACCEL_ANGRATE_ORIENTATION" messages that have arrived
+    /*!
+     * Waits for the first message, then returns every complete message
+     * already received without making another system call.  Use this in
+     * continuous mode to keep up with the full output rate of the IMU.
+     *
+     * \param samples     array which will be filled with the messages, oldest first
+     * \param max_samples size of the samples array
+     *
+     * \return The number of messages (at least 1)
+     */
+    int receiveAccelAngrateOrientation(AccelAngrateOrientation *samples, int max_samples);
+
 	//! Read a message of type "ACCEL_ANGRATE_MAG_ORIENT"
 	/*! 
 	 * \param time    Pointer to uint64_t which will receive time
@@ -269,6 +302,13 @@ namespace microstrain_3dmgx2_imu
      */
     bool getDeviceIdentifierString(id_string type, char id[17]);
 
+    //! Get the receive counters
+    /*!
+     * \param stats  Filled with the counters
+     * \param reset  Zero the counters afterwards
+     */
+    void getStreamStats(StreamStats *stats, bool reset = false);
+
   private:
     //! Send a command to the IMU and wait for a reply
     int transact(void *cmd, int cmd_len, void *rep, int rep_len, int timeout = 0);
@@ -279,6 +319,18 @@ namespace microstrain_3dmgx2_imu
     //! Receive a particular message from the IMU
     int receive(uint8_t command, void *rep, int rep_len, int timeout = 0, uint64_t* sys_time = NULL);
 
+    //! Receive every message of one type that is complete in the buffer (waits for the first)
+    int receiveBatch(uint8_t command, uint8_t *reps, int rep_len, uint64_t *sys_times, int max_count, int timeout = 0);
+
+    //! Take the next message of one type out of the receive buffer
+    bool extractMessage(uint8_t command, uint8_t *rep, int rep_len, uint64_t *sys_time);
+
+    //! Read whatever the port has into the receive buffer (one poll and one read)
+    void fillBuffer(int timeout);
+
+    //! Drop everything in the receive buffer
+    void clearBuffer() {rx_start = rx_end = 0;}
+
     //! Extract time from a pointer into an imu buffer
     uint64_t extractTime(uint8_t* addr);
 
@@ -327,6 +379,24 @@ namespace microstrain_3dmgx2_imu
     //! Is the IMU a GX3?
     bool is_gx3;
 
+    //! Bytes received from the port and not yet used
+    uint8_t rx_buffer[RX_BUFFER_LEN];
+
+    //! The unused bytes are rx_buffer[rx_start] to rx_buffer[rx_end - 1]
+    int rx_start, rx_end;
+
+    //! System time of the last read
+    uint64_t rx_time;
+
+    //! Time to receive one byte at the baud rate of the port, 8N1 (nanoseconds)
+    uint64_t ns_per_byte;
+
+    //! Bytes skipped since the last message was found
+    int skipped;
+
+    //! Receive counters
+    StreamStats stream_stats;
+
   };
 
 }
@@ -42,8 +42,10 @@
 #include <std_msgs/Float32.h>
 #include <std_msgs/UInt8MultiArray.h>
 #include <sys/time.h>
+#include "mikro_protocol.h"
 #include "serialinterface.h"
 #include "sensor_msgs/Imu.h"  //For height
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include "mikro_serial/mikoImu.h"
 #include "mikro_serial/mikoCmd.h"
 
@@ -134,19 +136,6 @@ typedef struct
 } Velocity_t;
 
 
-struct str_Data3D
-{
-   signed int  angle[3]; // pitch, roll, yaw in 0,1
-   signed char Centroid[3];
-   signed char reserve[5];
-};
-
-typedef struct
-{
-	uint8_t Digital[2];
-	int16_t Analog[32];    // Debugvalues
-} __attribute__((packed)) DebugOut_t;
-
 namespace miko
 {
 	class FlightControl
@@ -197,6 +186,7 @@ namespace miko
 
 		ros::Publisher pub;
 		ros::Publisher pub_pose2D;
+		ros::Publisher stats_pub_; //!< the serial link statistics (diagnostic_msgs/DiagnosticArray)
 
 		uint64_t time;
 
@@ -217,12 +207,15 @@ namespace miko
     void AddCRC(unsigned char *bffer, uint16_t datelen);
 		void SendOutData(uint8_t cmd, uint8_t addr, uint8_t numofbuffers, ...);
 		void enablePolling (uint16_t request, uint16_t interval);
-		void spin (const ros::TimerEvent & e);
+		void requestDebug (const ros::TimerEvent & e);
+		void debugFrameCallback (const Frame &frame, const ros::Time &stamp);
+		void publishStats ();
     void mikoCmdCallback (const mikro_serial::mikoCmd& msg);
 
 		unsigned long long time_helper(void);
 
     int data_rate_; //!< allows selectable data rate for debug data on parameter server
+    double debug_refresh_period_; //!< how often (s) the debug request is renewed, the FC drops it after a few seconds
 	}; // end class FlightControl
 } //end namespace miko
 
@@ -0,0 +1,117 @@
+/*
+ *  Mikrokopter FlightControl Serial Interface
+ *  Copyright (C) 2010, Cyphy Lab.
+ *  Inkyu Sa <i.sa@qut.edu.au>
+ *  Copyright (C) 2026, agent <agent@local> (FrameParser)
+ *
+ *  https://wiki.qut.edu.au/display/cyphy
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIKO_FLIGHTCONTROL_MIKRO_PROTOCOL_H
+#define MIKO_FLIGHTCONTROL_MIKRO_PROTOCOL_H
+
+#include <stdint.h>
+#include <cstring>
+
+// The MikroKopter serial frame is:
+//   '#' <address 'a'+addr> <command> <payload, 3 bytes in every 4 characters '='+6 bits> <crc1> <crc2> '\r'
+// where the crc is the sum of every character before it, modulo 4096, sent as two '='+6 bit characters.  The payload
+// characters are never '#' or '\r', so a '#' always starts a new frame.
+
+#define MIKO_MAX_PAYLOAD 256 // decoded bytes, the largest frame the FC sends is well under this
+
+struct str_Data3D
+{
+   signed int  angle[3]; // pitch, roll, yaw in 0,1 deg
+   signed char Centroid[3];
+   signed char reserve[5];
+};
+
+typedef struct
+{
+	uint8_t Digital[2];
+	int16_t Analog[32];    // Debugvalues
+} __attribute__((packed)) DebugOut_t;
+
+namespace miko
+{
+	// A frame with a valid checksum.  The payload points into the parser and is only valid during the callback.
+	struct Frame
+	{
+		uint8_t address;          // 0 = 'a', FC_ADDRESS = 1, ...
+		uint8_t command;          // e.g. 'D' for debug data
+		const uint8_t *payload;   // the decoded payload
+		int length;               // the number of decoded bytes
+
+		// Copy the payload into a typed struct, false if the frame is too short for it
+		template <typename T> bool decode (T *out) const
+		{
+			if (length < (int)sizeof(T))
+				return false;
+			memcpy (out, payload, sizeof(T));
+			return true;
+		}
+	};
+
+	// The streaming frame parser.  All the state is in the instance, so several ports (or a test harness) can each
+	// have their own.  Bytes can be fed in any sized pieces: frames split across reads are put back together, several
+	// frames in one read are all returned, the payload is decoded as it arrives (no second pass), and a bad checksum
+	// only loses that one frame.
+	class FrameParser
+	{
+		public:
+		FrameParser ();
+
+		// Called once for every valid frame found by feed()
+		class Handler
+		{
+			public:
+			virtual ~Handler () {}
+			virtual void frame (const Frame &frame) = 0;
+		};
+
+		// Parse a block of received bytes, returns the number of valid frames
+		int feed (const uint8_t *data, int len, Handler &handler);
+
+		// Forget any partial frame
+		void reset ();
+
+		uint32_t frames_;       // valid frames
+		uint32_t crc_errors_;   // frames dropped for a bad checksum
+		uint32_t malformed_;    // frames dropped for a bad length or an overrun
+		uint64_t bytes_;        // bytes fed in
+
+		private:
+		enum State {WAIT_START, ADDRESS, COMMAND, BODY};
+
+		State state_;
+		uint16_t crc_;                      // sum of the characters so far
+		uint8_t address_;
+		uint8_t command_;
+		uint8_t quad_[4];                   // encoded characters waiting to be decoded
+		int quad_count_;
+		uint8_t payload_[MIKO_MAX_PAYLOAD];
+		int length_;
+	};
+
+	// Build a frame, returns its length (0 if it doesn't fit in out_len)
+	int encodeFrame (uint8_t address, uint8_t command, const uint8_t *data, int len, uint8_t *out, int out_len);
+
+	// The largest encoded frame for a payload of len bytes
+	inline int encodedFrameLength (int len) {return 3 + ((len + 2) / 3) * 4 + 3;}
+}
+
+#endif
@@ -36,9 +36,13 @@
 #include <errno.h>
 #include <bitset>
 #include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <boost/function.hpp>
 
 #include <ros/ros.h>
 #include "flightcontrol.h"
+#include "mikro_protocol.h"
 
 #define TXD_BUFFER_LEN  300
 #define RXD_BUFFER_LEN  300
@@ -47,25 +51,63 @@
 #define MAX_YAW_THRESHOLD 360
 #define MAX_HEIGHT_THRESHOLD 200
 #define MAX_ACC_THRESHOLD 400
+#define RX_RING_LEN 4096 // must be a power of two
+#define RX_POLL_TIMEOUT_MS 100
+#define TX_MAX_COMMANDS 8 // the number of different frame types that can be waiting at once
+#define TX_POLL_TIMEOUT_MS 100
 
 extern pthread_mutex_t mutex_; //!< mutex to change "set_next_as_ref_"
 
 namespace miko
 {
-	class SerialInterface
+	// Transmit statistics, the latency is from output() until the last byte was accepted by the port
+	struct TxStats
+	{
+		uint32_t sent;              // frames written
+		uint32_t coalesced;         // frames replaced by a newer frame of the same type before they went out
+		uint32_t errors;            // frames dropped on a write error
+		uint64_t bytes;             // bytes written
+		int depth;                  // frames waiting now
+		int max_depth;              // most frames waiting at once
+		double latency_mean_us;
+		double latency_max_us;
+	};
+
+	// Receive statistics since the port was opened, copied from the reader thread's parser
+	struct RxStats
+	{
+		uint32_t frames;            // valid frames
+		uint32_t crc_errors;        // frames dropped for a bad checksum
+		uint32_t malformed;         // frames dropped for a bad length or an overrun
+		uint64_t bytes;             // bytes read
+	};
+
+	class SerialInterface : public FrameParser::Handler
 	{
 		public:
 		SerialInterface (std::string port, uint32_t speed);
 		~SerialInterface ();
 
+		// Queue a complete frame for the writer thread, this never waits on the port.  Only the newest frame of each
+		// command type is kept, so a burst of commands sends the latest one instead of backing up.
 		void output (char *output, int len);
 		void output (unsigned char *output, int len);
-		void Decode64(void);
-		void ParsingData(void);
-		void dumpDebug (void);
-		int getdata (unsigned char *buf, int len);
-		uint32_t serialport_bytes_rx_;
-		uint32_t serialport_bytes_tx_;
+
+		// Copy the transmit statistics, and optionally start a new window
+		void txStats (TxStats *stats, bool reset);
+
+		// Copy the receive statistics
+		void rxStats (RxStats *stats);
+
+		// Called from the reader thread for every frame with a valid CRC, stamped with the time its bytes arrived
+		typedef boost::function<void (const Frame &frame, const ros::Time &stamp)> FrameCallback;
+
+		// Start/stop the thread that streams from the port (poll on the tty -> ring buffer -> frame parser)
+		bool startReader (const FrameCallback &callback);
+		void stopReader ();
+
+		// FrameParser::Handler, passes the frame on to the callback
+		void frame (const Frame &frame);
 		bool status;
 		int pt[800];
 		int counter;
@@ -81,6 +123,46 @@ namespace miko
 		void stall (bool);
 		int wait (int);
 
+		static void *readerEntry (void *serial);
+		void readerLoop ();
+
+		static void *writerEntry (void *serial);
+		void writerLoop ();
+		bool writeAll (const unsigned char *data, int len, int *written);
+
+		// The newest frame of one command type
+		struct TxSlot
+		{
+			uint8_t command;
+			bool pending;
+			unsigned char data[TXD_BUFFER_LEN];
+			int len;
+			uint64_t queued_ns;     // when it was queued (monotonic clock)
+			uint64_t order;         // first come, first served between the types
+		};
+
+		TxSlot tx_slots_[TX_MAX_COMMANDS];
+		int tx_num_slots_;
+		uint64_t tx_order_;
+		TxStats tx_stats_;
+		double tx_latency_sum_us_;
+		RxStats rx_stats_;                  // the reader's counters, copied after each read
+		pthread_mutex_t tx_mutex_;          // protects the slots and both stats (never held while writing)
+		pthread_cond_t tx_cond_;
+		pthread_t writer_thread_;
+		volatile bool writer_running_;
+
+		pthread_t reader_thread_;
+		volatile bool reader_running_;
+		int wake_pipe_[2];                  // written to wake the reader's poll() on shutdown
+		FrameCallback frame_callback_;
+
+		unsigned char rx_ring_[RX_RING_LEN];
+		uint32_t ring_head_;                // next byte to write (free running, masked on use)
+		uint32_t ring_tail_;                // next byte to parse
+		FrameParser parser_;
+		ros::Time rx_stamp_;                // when the bytes being parsed arrived
+
 		int dev_;
 		std::string serialport_name_;
 		uint32_t serialport_speed_;
@@ -29,13 +29,6 @@ ros::WallTimer walltimer;
 unsigned char th_cnt=0;
 
 
-unsigned char g_buf[300];
-unsigned char g_buf_debug[300];
-//unsigned char g_txd_buffer[TXD_BUFFER_LEN];
-unsigned char g_rxd_buffer[RXD_BUFFER_LEN];
-unsigned char g_ReceivedBytes;
-unsigned char *g_pRxData;
-unsigned char g_RxDataLen;
 long g_nCounter=0;
 long g_nCounter1=0;
 double g_pitch_temp;
@@ -56,8 +49,6 @@ long counter1=0;
 
 using namespace miko;
 
-struct str_Data3D g_Data3D,g_Data3D_Temp;
-DebugOut_t g_DebugData,g_DebugData_Temp;
 Position_t g_PositionFromAcc,g_PostPosition,g_EstimatePosition,g_CurPosition,g_GoalPosition,g_GoalVel,g_errorPos;
 Control_t g_StickControl,g_PostStickControl;
 Velocity_t g_W_Vel,g_B_Vel,g_B_ACC,g_B_esti_Vel,g_B_predic_esti_Vel,g_B_goal_Vel;
@@ -88,10 +79,13 @@ FlightControl::FlightControl()
   //the debug data rate sent to request how fast debug data will be sent over serial
   ros::param::param<int>("~debug_data_rate", data_rate_, 50);
   //This number is multiplied by 10 and then used as milliseconds for a rate at which to send debug data
+  ros::param::param<double>("~debug_refresh_period", debug_refresh_period_, 2.0);
+  //The FC only keeps sending debug data for a few seconds after each request, so the request is renewed at this period
 
 //  std::cout << "(1/10th) Data rate is now: " << data_rate_ << std::endl;
 
   pub = nh.advertise<mikro_serial::mikoImu>("mikoImu", 1);
+  stats_pub_ = nh.advertise<diagnostic_msgs::DiagnosticArray>("mikro_serial_stats", 1);
 
   /// Only allow 1 message to be waiting on the ROS queue - I don't want to process control commands late.  If we skip
   /// one, that is better than applying them late
@@ -120,17 +114,6 @@ FlightControl::FlightControl()
 //	ExternControl.Config =1;
 	Throttle_Direction=true;
 
-        //Initialize the entries of the MK Debug Data Digital Array to 0
-	g_DebugData.Digital[0]=0;
-	g_DebugData.Digital[1]=0;
-
-        //Initialize all the entries of the MK Debug Data Analog Array to 0
-        for(int i=0;i<32;i++) g_DebugData.Analog[i]=0;
-
-	g_ReceivedBytes=0;
-	g_pRxData=0;
-	g_RxDataLen=0;
-
 	g_height=0;
 	g_throttle_cmd=0;
 	g_goal_height=1.0; // 1m
@@ -138,13 +121,17 @@ FlightControl::FlightControl()
 
   // **** set up interfaces
   serialInterface_ = new SerialInterface (port_, speed_);
-	serialInterface_->serialport_bytes_rx_ = 0;
-	serialInterface_->serialport_bytes_tx_ = 0;
 
   double rate;
   rate = (double)data_rate_/100.0;
   std::cout << "the rate is (in seconds): " << rate << std::endl;
-  timer= nh.createTimer(ros::Duration(rate), &FlightControl::spin,this);
+
+  // The reader thread streams from the port and publishes each debug frame as soon as its CRC checks out, so the
+  // timer only has to keep the FC's debug output going.
+  serialInterface_->startReader(boost::bind(&FlightControl::debugFrameCallback, this, _1, _2));
+  uint8_t interval = (uint8_t)data_rate_;
+  SendOutData('d', FC_ADDRESS, 1, &interval, sizeof(interval)); // Request debug data from FC
+  timer= nh.createTimer(ros::Duration(debug_refresh_period_), &FlightControl::requestDebug,this);
   ROS_INFO ("Mikrokopter Serial setup completed Successfully!");
 
 //  std::string file_name = "recieved_commands";
@@ -157,146 +144,124 @@ FlightControl::~FlightControl()
 {
 //	fclose(fd);
 //	fclose(fd_h);
+  serialInterface_->stopReader();
   delete serialInterface_;
   //std::cout << "Destroying FlightControl Interface" << std::endl;
 }
 
 
-void FlightControl::spin(const ros::TimerEvent & e)
+void FlightControl::requestDebug(const ros::TimerEvent & e)
 {
-	int nLength=0;
   uint8_t interval= (uint8_t)data_rate_;
+	SendOutData('d', FC_ADDRESS, 1,&interval,sizeof(interval)); // Renew the debug data request
+  publishStats();
+}
 
 
-	#ifdef CHECK_DURA
-	struct timeval start, end , total_start,total_end,acc_start,acc_end;
-	gettimeofday(&start, NULL);
-	gettimeofday(&total_start, NULL);
-	gettimeofday(&acc_start, NULL);
-	#endif
-
-	SendOutData('d', FC_ADDRESS, 1,&interval,sizeof(interval)); // Request debug data from FC
-
-	#ifdef CHECK_DURA
-	gettimeofday(&end, NULL);
-	double dur = ((end.tv_sec   * 1000000 + end.tv_usec  ) - 
-		(start.tv_sec * 1000000 + start.tv_usec)) / 1000.0;
-
-	ROS_INFO("Request debug data dur:\t %.3f ms", dur);
-	#endif
-
-
-	mikoImu.header.stamp = ros::Time::now();
-
-
-	#ifdef CHECK_DURA
-	gettimeofday(&start, NULL);
-	#endif
-
-  ros::WallDuration(0.1).sleep(); // delay
-
-	#ifdef CHECK_DURA
-	gettimeofday(&end, NULL);
-		dur = ((end.tv_sec   * 1000000 + end.tv_usec  ) - 
-		(start.tv_sec * 1000000 + start.tv_usec)) / 1000.0;
-
-	ROS_INFO("Check delay dur:\t %.3f ms", dur);
-	#endif
-
-
-
-	#ifdef CHECK_DURA
-	gettimeofday(&start, NULL);
-	#endif
-
-	nLength=serialInterface_->getdata(g_rxd_buffer, 255);
-
-
-	#ifdef CHECK_DURA
-	gettimeofday(&end, NULL);
-	dur = ((end.tv_sec   * 1000000 + end.tv_usec  ) - 
-		(start.tv_sec * 1000000 + start.tv_usec)) / 1000.0;
-	ROS_INFO("getdata dur:\t %.3f ms", dur);
-	#endif
-
-
-	if(nLength>0)
-	{
-
-		#ifdef CHECK_DURA
-		gettimeofday(&start, NULL);
-		#endif
-
-
-		serialInterface_->Decode64();
-
-
-		#ifdef CHECK_DURA
-		gettimeofday(&end, NULL);
-		dur = ((end.tv_sec   * 1000000 + end.tv_usec  ) - 
-			(start.tv_sec * 1000000 + start.tv_usec)) / 1000.0;
-		ROS_INFO("Decode64 dur:\t %.3f ms", dur);
-		#endif
-
+//
+// Publish the serial link statistics gathered since the last call
+//
+void FlightControl::publishStats()
+{
+  if (stats_pub_.getNumSubscribers() == 0)
+    return;
+
+  TxStats tx;
+  RxStats rx;
+  serialInterface_->txStats(&tx, true);
+  serialInterface_->rxStats(&rx);
+
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = "mikro_serial";
+  status.hardware_id = port_;
+  status.level = (tx.errors > 0) ? diagnostic_msgs::DiagnosticStatus::WARN : diagnostic_msgs::DiagnosticStatus::OK;
+  status.message = (tx.errors > 0) ? "write errors" : "OK";
+
+  char value[32];
+#define ADD_STAT(name, format, x) \
+  { snprintf(value, sizeof(value), format, x); diagnostic_msgs::KeyValue kv; kv.key = name; kv.value = value; \
+    status.values.push_back(kv); }
+  ADD_STAT("tx_frames", "%u", tx.sent);
+  ADD_STAT("tx_coalesced", "%u", tx.coalesced);
+  ADD_STAT("tx_errors", "%u", tx.errors);
+  ADD_STAT("tx_queue_depth", "%d", tx.depth);
+  ADD_STAT("tx_queue_max_depth", "%d", tx.max_depth);
+  ADD_STAT("tx_latency_mean_us", "%.1f", tx.latency_mean_us);
+  ADD_STAT("tx_latency_max_us", "%.1f", tx.latency_max_us);
+  ADD_STAT("tx_bytes", "%llu", (unsigned long long)tx.bytes);
+  ADD_STAT("rx_frames", "%u", rx.frames);
+  ADD_STAT("rx_crc_errors", "%u", rx.crc_errors);
+  ADD_STAT("rx_malformed", "%u", rx.malformed);
+  ADD_STAT("rx_bytes", "%llu", (unsigned long long)rx.bytes);
+#undef ADD_STAT
+
+  diagnostic_msgs::DiagnosticArray array;
+  array.header.stamp = ros::Time::now();
+  array.status.push_back(status);
+  stats_pub_.publish(array);
+}
 
-		#ifdef CHECK_DURA
-		gettimeofday(&start, NULL);
-		#endif
 
-		serialInterface_->ParsingData();
+// Called by the serial reader thread for each frame with a valid CRC
+void FlightControl::debugFrameCallback(const Frame &frame, const ros::Time &stamp)
+{
+	DebugOut_t debug_data;
+	if(frame.address != FC_ADDRESS || frame.command != 'D' || !frame.decode(&debug_data))
+		return; // only the debug frames are published
 
+	// Throw out packets with values that can't be right (I have changed some of these values (BC))
+	if(( abs(debug_data.Analog[ANGLE_PITCH])>1000) ||
+	   ( abs(debug_data.Analog[ANGLE_ROLL])>1000) ||
+	   ( abs(debug_data.Analog[ANGLE_YAW])>3600) ||
+	   ( abs(debug_data.Analog[ACCEL_X])>700) ||
+	   ( abs(debug_data.Analog[ACCEL_Y])>700) ||
+	   ( abs(debug_data.Analog[ACCEL_Z])>900) )
+		return;
 
-		#ifdef CHECK_DURA
-		gettimeofday(&end, NULL);
-		dur = ((end.tv_sec   * 1000000 + end.tv_usec  ) - 
-			(start.tv_sec * 1000000 + start.tv_usec)) / 1000.0;
-		ROS_INFO("ParsingData dur:\t %.3f ms", dur);
-		#endif
+	mikoImu.header.stamp = stamp;
 
 		//=================================================================
 		// Coordinate and unit conversion from Mikrokopter to Cyphy model.
 		//=================================================================
 
     // Put negative(minus) all angles to covert all axes into a right hand coordinate.
-    MyAttitude.AnglePitch = -POINT_ONE_G_RADS_TO_RADS(g_DebugData.Analog[ANGLE_PITCH]); //This will display pitch in radians
-    MyAttitude.AngleRoll = -POINT_ONE_G_RADS_TO_RADS(g_DebugData.Analog[ANGLE_ROLL]); //This will display roll in radians
-    MyAttitude.AngleYaw = CONVERT_YAW(g_DebugData.Analog[ANGLE_YAW]); //This will display yaw in radians
+    MyAttitude.AnglePitch = -POINT_ONE_G_RADS_TO_RADS(debug_data.Analog[ANGLE_PITCH]); //This will display pitch in radians
+    MyAttitude.AngleRoll = -POINT_ONE_G_RADS_TO_RADS(debug_data.Analog[ANGLE_ROLL]); //This will display roll in radians
+    MyAttitude.AngleYaw = CONVERT_YAW(debug_data.Analog[ANGLE_YAW]); //This will display yaw in radians
 
     // Normalize Acceleration data as 1G.  //### Not sure if this is correct or not.  Our firmware may be different.
-    MyAttitude.ACCX = -(g_DebugData.Analog[ACCEL_X]/ACCEL_X_FAKTOR); // m/s^2
-    MyAttitude.ACCY = (g_DebugData.Analog[ACCEL_Y]/ACCEL_Y_FAKTOR); // m/s^2
-    MyAttitude.ACCZ = -(g_DebugData.Analog[ACCEL_Z]/ACCEL_Z_FAKTOR); // m/s^2
+    MyAttitude.ACCX = -(debug_data.Analog[ACCEL_X]/ACCEL_X_FAKTOR); // m/s^2
+    MyAttitude.ACCY = (debug_data.Analog[ACCEL_Y]/ACCEL_Y_FAKTOR); // m/s^2
+    MyAttitude.ACCZ = -(debug_data.Analog[ACCEL_Z]/ACCEL_Z_FAKTOR); // m/s^2
 
                 //Fill the fields of the message with the appropriate output
 		mikoImu.anglePitch = MyAttitude.AnglePitch; 
 		mikoImu.angleRoll = MyAttitude.AngleRoll;
 		mikoImu.angleYaw = MyAttitude.AngleYaw;
-    mikoImu.gyroPitch = 0;//-g_DebugData.Analog[GYRO_PITCH]/150.0;
-    mikoImu.gyroRoll = 0;//-g_DebugData.Analog[GYRO_ROLL]/150.0;
-    mikoImu.gyroYaw = g_DebugData.Analog[GYRO_YAW]/150.0;
-    mikoImu.accelX = -(g_DebugData.Analog[ACCEL_X]/ACCEL_X_FAKTOR); // m/s^2
-    mikoImu.accelY = (g_DebugData.Analog[ACCEL_Y]/ACCEL_Y_FAKTOR); // m/s^2
-    mikoImu.accelZ = -(g_DebugData.Analog[ACCEL_Z]/ACCEL_Z_FAKTOR); // m/s^2
-    mikoImu.motor1 = g_DebugData.Analog[MOTOR1];
-    mikoImu.motor2 = g_DebugData.Analog[MOTOR2];
-    mikoImu.motor3 = g_DebugData.Analog[MOTOR3];
-    mikoImu.motor4 = g_DebugData.Analog[MOTOR4];
-    mikoImu.motor5 = 0;//g_DebugData.Analog[MOTOR5];
-    mikoImu.motor6 = 0;//g_DebugData.Analog[MOTOR6];
+    mikoImu.gyroPitch = 0;//-debug_data.Analog[GYRO_PITCH]/150.0;
+    mikoImu.gyroRoll = 0;//-debug_data.Analog[GYRO_ROLL]/150.0;
+    mikoImu.gyroYaw = debug_data.Analog[GYRO_YAW]/150.0;
+    mikoImu.accelX = -(debug_data.Analog[ACCEL_X]/ACCEL_X_FAKTOR); // m/s^2
+    mikoImu.accelY = (debug_data.Analog[ACCEL_Y]/ACCEL_Y_FAKTOR); // m/s^2
+    mikoImu.accelZ = -(debug_data.Analog[ACCEL_Z]/ACCEL_Z_FAKTOR); // m/s^2
+    mikoImu.motor1 = debug_data.Analog[MOTOR1];
+    mikoImu.motor2 = debug_data.Analog[MOTOR2];
+    mikoImu.motor3 = debug_data.Analog[MOTOR3];
+    mikoImu.motor4 = debug_data.Analog[MOTOR4];
+    mikoImu.motor5 = 0;//debug_data.Analog[MOTOR5];
+    mikoImu.motor6 = 0;//debug_data.Analog[MOTOR6];
 		mikoImu.linear_acceleration.x = MyAttitude.ACCX;
 		mikoImu.linear_acceleration.y = MyAttitude.ACCY;
 		mikoImu.linear_acceleration.z = MyAttitude.ACCZ;
-    mikoImu.baromHeight = g_DebugData.Analog[BAROMHEIGHT];
+    mikoImu.baromHeight = debug_data.Analog[BAROMHEIGHT];
 
-    if(g_DebugData.Analog[BATT]<BATT_MAX)
-        mikoImu.batt = g_DebugData.Analog[BATT];
+    if(debug_data.Analog[BATT]<BATT_MAX)
+        mikoImu.batt = debug_data.Analog[BATT];
     else
         mikoImu.batt = 255;
 
 		pub.publish(mikoImu);
 		counter++;
-	
-		}
 }
 
 void FlightControl::SendOutData(uint8_t cmd, uint8_t addr, uint8_t numofbuffers, ...) // uint8_t *pdata, uint8_t len, ...
@@ -0,0 +1,166 @@
+/*
+ *  Mikrokopter FlightControl Serial Interface
+ *  Copyright (C) 2010, Cyphy Lab.
+ *  Inkyu Sa <i.sa@qut.edu.au>
+ *  Copyright (C) 2026, agent <agent@local> (FrameParser)
+ *
+ *  https://wiki.qut.edu.au/display/cyphy
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mikro_protocol.h"
+
+namespace miko
+{
+  FrameParser::FrameParser ()
+  {
+    frames_ = 0;
+    crc_errors_ = 0;
+    malformed_ = 0;
+    bytes_ = 0;
+    reset ();
+  }
+
+  void FrameParser::reset ()
+  {
+    state_ = WAIT_START;
+    crc_ = 0;
+    address_ = 0;
+    command_ = 0;
+    quad_count_ = 0;
+    length_ = 0;
+  }
+
+  int FrameParser::feed (const uint8_t *data, int len, Handler &handler)
+  {
+    int found = 0;
+    bytes_ += len;
+
+    for (int i = 0; i < len; i++)
+    {
+      uint8_t c = data[i];
+
+      if (c == '#')
+      {
+        // a start character always starts a new frame (anything partial before it was lost)
+        if (state_ != WAIT_START)
+          malformed_++;
+        state_ = ADDRESS;
+        crc_ = c;
+        quad_count_ = 0;
+        length_ = 0;
+        continue;
+      }
+
+      switch (state_)
+      {
+        case WAIT_START:
+          break;
+
+        case ADDRESS:
+          address_ = c - 'a';
+          crc_ += c;
+          state_ = COMMAND;
+          break;
+
+        case COMMAND:
+          command_ = c;
+          crc_ += c;
+          state_ = BODY;
+          break;
+
+        case BODY:
+          if (c != '\r')
+          {
+            crc_ += c;
+            quad_[quad_count_++] = c;
+            if (quad_count_ == 4)
+            {
+              // decode the 4 characters into 3 bytes straight into the payload:
+              if (length_ + 3 > MIKO_MAX_PAYLOAD)
+              {
+                malformed_++;
+                state_ = WAIT_START;
+                break;
+              }
+              uint8_t a = quad_[0] - '=', b = quad_[1] - '=', cc = quad_[2] - '=', d = quad_[3] - '=';
+              payload_[length_++] = (a << 2) | (b >> 4);
+              payload_[length_++] = ((b & 0x0f) << 4) | (cc >> 2);
+              payload_[length_++] = ((cc & 0x03) << 6) | d;
+              quad_count_ = 0;
+            }
+          }
+          else
+          {
+            // the payload is whole groups of 4, so the two checksum characters are the ones left over
+            state_ = WAIT_START;
+            if (quad_count_ != 2)
+            {
+              malformed_++;
+              break;
+            }
+            uint16_t crc = (crc_ - quad_[0] - quad_[1]) % 4096;
+            if (quad_[0] != '=' + crc / 64 || quad_[1] != '=' + crc % 64)
+            {
+              crc_errors_++;
+              break;
+            }
+
+            Frame frame;
+            frame.address = address_;
+            frame.command = command_;
+            frame.payload = payload_;
+            frame.length = length_;
+            frames_++;
+            found++;
+            handler.frame (frame);
+          }
+          break;
+      }
+    }
+    return found;
+  }
+
+  int encodeFrame (uint8_t address, uint8_t command, const uint8_t *data, int len, uint8_t *out, int out_len)
+  {
+    if (encodedFrameLength (len) > out_len)
+      return 0;
+
+    int pt = 0;
+    out[pt++] = '#';
+    out[pt++] = 'a' + address;
+    out[pt++] = command;
+
+    for (int i = 0; i < len; i += 3)
+    {
+      uint8_t a = data[i];
+      uint8_t b = (i + 1 < len) ? data[i + 1] : 0;
+      uint8_t c = (i + 2 < len) ? data[i + 2] : 0;
+      out[pt++] = '=' + (a >> 2);
+      out[pt++] = '=' + (((a & 0x03) << 4) | ((b & 0xf0) >> 4));
+      out[pt++] = '=' + (((b & 0x0f) << 2) | ((c & 0xc0) >> 6));
+      out[pt++] = '=' + (c & 0x3f);
+    }
+
+    uint16_t crc = 0;
+    for (int i = 0; i < pt; i++)
+      crc += out[i];
+    crc %= 4096;
+    out[pt++] = '=' + crc / 64;
+    out[pt++] = '=' + crc % 64;
+    out[pt++] = '\r';
+    return pt;
+  }
+}
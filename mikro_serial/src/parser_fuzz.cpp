@@ -0,0 +1,209 @@
+/*
+ *  Mikrokopter FlightControl Serial Interface
+ *  Copyright (C) 2026, agent <agent@local>
+ *
+ *  https://wiki.qut.edu.au/display/cyphy
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Fuzz and throughput check for miko::FrameParser (no ROS or serial port needed).
+//
+//   parser_fuzz                  synthetic stream: random debug/3D frames with line noise, fed in random read sizes
+//   parser_fuzz <capture.bin>    a byte stream captured from the port (e.g. cat /dev/ttyUSB0 > capture.bin), fed
+//                                whole and then in random read sizes; the frame counts have to agree
+//
+// Exits non-zero if a frame is lost, corrupted, or made up.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+#include "mikro_protocol.h"
+
+using namespace miko;
+
+static double now ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Collects what the parser finds
+class Collector : public FrameParser::Handler
+{
+  public:
+  std::vector<std::vector<uint8_t> > payloads;
+  std::vector<uint8_t> commands;
+  void frame (const Frame &frame)
+  {
+    payloads.push_back (std::vector<uint8_t> (frame.payload, frame.payload + frame.length));
+    commands.push_back (frame.command);
+  }
+};
+
+// Feed a stream in random sized pieces (1 to max_read bytes, like reads from a tty)
+static void feedInPieces (FrameParser &parser, const std::vector<uint8_t> &stream, int max_read, Collector &out)
+{
+  size_t pos = 0;
+  while (pos < stream.size ())
+  {
+    size_t n = 1 + rand () % max_read;
+    if (pos + n > stream.size ())
+      n = stream.size () - pos;
+    parser.feed (&stream[pos], (int)n, out);
+    pos += n;
+  }
+}
+
+static int syntheticTest (int num_frames)
+{
+  std::vector<uint8_t> stream;
+  std::vector<std::vector<uint8_t> > sent; // the frames that should come out
+  uint8_t frame[512];
+  int corrupted = 0, noise = 0;
+
+  for (int f = 0; f < num_frames; f++)
+  {
+    // a debug frame (66 bytes) most of the time, some 3D frames:
+    int len = (rand () % 4) ? (int)sizeof(DebugOut_t) : (int)sizeof(str_Data3D);
+    uint8_t command = (len == (int)sizeof(DebugOut_t)) ? 'D' : 'C';
+    std::vector<uint8_t> payload (len);
+    for (int i = 0; i < len; i++)
+      payload[i] = rand () & 0xff;
+
+    int n = encodeFrame (1, command, &payload[0], len, frame, sizeof(frame));
+
+    int fault = rand () % 50;
+    if (fault == 0)
+    {
+      // flip a payload character (the checksum has to catch it)
+      int at = 3 + rand () % (n - 6);
+      frame[at] = (frame[at] == '=') ? '>' : '=';
+      corrupted++;
+    }
+    else if (fault == 1)
+    {
+      // truncate the frame (lost bytes), the next '#' has to resynchronize
+      n = 3 + rand () % (n - 3);
+      corrupted++;
+    }
+    else
+    {
+      // the payload is padded up to whole groups of 3 bytes
+      payload.resize (((len + 2) / 3) * 3, 0);
+      sent.push_back (payload);
+    }
+    stream.insert (stream.end (), frame, frame + n);
+
+    if (rand () % 20 == 0)
+    {
+      // line noise between frames (anything but '#', which would look like a start)
+      int junk = 1 + rand () % 16;
+      for (int i = 0; i < junk; i++)
+      {
+        uint8_t c = rand () & 0xff;
+        stream.push_back (c == '#' ? 0 : c);
+      }
+      noise++;
+    }
+  }
+
+  FrameParser parser;
+  Collector out;
+  double start = now ();
+  feedInPieces (parser, stream, 64, out);
+  double elapsed = now () - start;
+
+  int errors = 0;
+  if (out.payloads.size () != sent.size ())
+  {
+    printf ("FAIL: sent %d good frames, parsed %d\n", (int)sent.size (), (int)out.payloads.size ());
+    errors++;
+  }
+  for (size_t i = 0; i < sent.size () && i < out.payloads.size (); i++)
+  {
+    if (out.payloads[i] != sent[i])
+    {
+      printf ("FAIL: frame %d doesn't match\n", (int)i);
+      errors++;
+      break;
+    }
+  }
+
+  printf ("synthetic: %d frames (%d corrupted, %d noise bursts), %d parsed, %u crc errors, %u malformed\n",
+          num_frames, corrupted, noise, (int)out.payloads.size (), parser.crc_errors_, parser.malformed_);
+  printf ("           %.1f MB/s, %.0f frames/s (115200 baud is 0.0115 MB/s)\n",
+          stream.size () / elapsed / 1e6, out.payloads.size () / elapsed);
+  return errors;
+}
+
+static int captureTest (const char *filename)
+{
+  FILE *file = fopen (filename, "rb");
+  if (file == NULL)
+  {
+    printf ("Unable to open %s\n", filename);
+    return 1;
+  }
+  std::vector<uint8_t> stream;
+  uint8_t buffer[4096];
+  size_t n;
+  while ((n = fread (buffer, 1, sizeof(buffer), file)) > 0)
+    stream.insert (stream.end (), buffer, buffer + n);
+  fclose (file);
+
+  FrameParser whole_parser;
+  Collector whole;
+  double start = now ();
+  whole_parser.feed (&stream[0], (int)stream.size (), whole);
+  double elapsed = now () - start;
+
+  FrameParser pieces_parser;
+  Collector pieces;
+  feedInPieces (pieces_parser, stream, 32, pieces);
+
+  int debug_frames = 0;
+  for (size_t i = 0; i < whole.commands.size (); i++)
+    if (whole.commands[i] == 'D')
+      debug_frames++;
+
+  printf ("capture: %d bytes, %d frames (%d debug), %u crc errors, %u malformed, %.1f MB/s\n",
+          (int)stream.size (), (int)whole.payloads.size (), debug_frames, whole_parser.crc_errors_,
+          whole_parser.malformed_, stream.size () / elapsed / 1e6);
+
+  if (pieces.payloads != whole.payloads)
+  {
+    printf ("FAIL: feeding in pieces found %d frames, feeding whole found %d\n", (int)pieces.payloads.size (),
+            (int)whole.payloads.size ());
+    return 1;
+  }
+  return 0;
+}
+
+int main (int argc, char **argv)
+{
+  srand (1);
+
+  int errors = 0;
+  if (argc > 1)
+    errors = captureTest (argv[1]);
+  else
+    errors = syntheticTest (200000);
+
+  printf (errors ? "FAILED\n" : "PASSED\n");
+  return errors ? 1 : 0;
+}
@@ -27,6 +27,7 @@
 #include <time.h>
 #include <errno.h>
 #include <bitset>
+#include <algorithm>
 
 #include <ros/ros.h>
 
@@ -39,19 +40,15 @@ extern "C" {
   #include <fcntl.h>
 }
 
-#if 1
-extern unsigned char g_ReceivedBytes;
-extern unsigned char *g_pRxData;
-extern unsigned char g_RxDataLen;
-extern unsigned char g_rxd_buffer[RXD_BUFFER_LEN];
-extern unsigned char g_buf[300];
-extern unsigned char g_buf_debug[300];
-extern struct str_Data3D g_Data3D,g_Data3D_Temp;
-extern DebugOut_t g_DebugData,g_DebugData_Temp;
-#endif
-
 pthread_mutex_t mutex_ = PTHREAD_MUTEX_INITIALIZER; //!< mutex to change "set_next_as_ref_"
 
+static inline uint64_t monotonicNs ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
 namespace miko
 {
   SerialInterface::SerialInterface (std::string port, uint32_t speed):serialport_name_ (port), serialport_speed_ (speed)
@@ -93,6 +90,27 @@ namespace miko
 
 	  Initialized=false;
 
+      reader_running_ = false;
+      wake_pipe_[0] = wake_pipe_[1] = -1;
+      ring_head_ = ring_tail_ = 0;
+
+      // start the writer, everything sent goes through its queue:
+      tx_num_slots_ = 0;
+      tx_order_ = 0;
+      tx_latency_sum_us_ = 0;
+      memset (&tx_stats_, 0, sizeof(tx_stats_));
+      memset (&rx_stats_, 0, sizeof(rx_stats_));
+      pthread_mutex_init (&tx_mutex_, NULL);
+      pthread_cond_init (&tx_cond_, NULL);
+      writer_running_ = true;
+      // not in a ROS_ASSERT, those compile out with NDEBUG and nothing would ever be sent:
+      int error = pthread_create (&writer_thread_, NULL, &SerialInterface::writerEntry, this);
+      if (error != 0)
+      {
+        ROS_FATAL ("Unable to start the serial writer thread: %s", strerror (error));
+        ROS_BREAK ();
+      }
+
 //      ROS_ASSERT_MSG (dev_ != NULL, "Could not open serial port %s", serialport_name_.c_str ());
       ROS_INFO ("MIKRO_SERIAL: Successfully connected to %s, Baudrate %d\n", serialport_name_.c_str (), serialport_speed_);
   }
@@ -100,6 +118,16 @@ namespace miko
   SerialInterface::~SerialInterface ()
   {
     //std::cout << "Destroying Serial Interface" << std::endl;
+    stopReader ();
+
+    pthread_mutex_lock (&tx_mutex_);
+    writer_running_ = false;
+    pthread_cond_signal (&tx_cond_);
+    pthread_mutex_unlock (&tx_mutex_);
+    pthread_join (writer_thread_, NULL);
+    pthread_cond_destroy (&tx_cond_);
+    pthread_mutex_destroy (&tx_mutex_);
+
     flush ();
     close (dev_);
   }
@@ -157,175 +185,288 @@ namespace miko
   }
   void SerialInterface::output (char *output, int len)
   {
-    pthread_mutex_lock(&mutex_);
-    int i;
+    this->output ((unsigned char *)output, len);
+  }
+
+  void SerialInterface::output (unsigned char *output, int len)
+  {
     ROS_DEBUG ("SerialInterface::output()");
-    serialport_bytes_tx_ += len;
+    if (len <= 0 || len > TXD_BUFFER_LEN)
+    {
+      ROS_ERROR ("Frame of %d bytes can't be sent", len);
+      return;
+    }
+    uint8_t command = (len > 2) ? output[2] : 0; // '#', address, command, ...
+
+    pthread_mutex_lock (&tx_mutex_);
+    int slot;
+    for (slot = 0; slot < tx_num_slots_; slot++)
+      if (tx_slots_[slot].command == command)
+        break;
+    if (slot == tx_num_slots_)
+    {
+      if (tx_num_slots_ == TX_MAX_COMMANDS)
+      {
+        pthread_mutex_unlock (&tx_mutex_);
+        ROS_ERROR ("Too many frame types to queue, dropped a '%c' frame", command);
+        return;
+      }
+      tx_slots_[slot].command = command;
+      tx_slots_[slot].pending = false;
+      tx_num_slots_++;
+    }
+
+    TxSlot &tx = tx_slots_[slot];
+    if (tx.pending)
+    {
+      tx_stats_.coalesced++; // the older frame never went out, this one replaces it (and keeps its place in line)
+    }
+    else
+    {
+      tx.pending = true;
+      tx.order = tx_order_++;
+      tx.queued_ns = monotonicNs ();
+      tx_stats_.depth++;
+      tx_stats_.max_depth = std::max (tx_stats_.max_depth, tx_stats_.depth);
+    }
+    memcpy (tx.data, output, len);
+    tx.len = len;
 
-    i = write (dev_, output, len);
+    pthread_cond_signal (&tx_cond_);
+    pthread_mutex_unlock (&tx_mutex_);
+  }
 
-    if (i != len)
+  void SerialInterface::txStats (TxStats *stats, bool reset)
+  {
+    pthread_mutex_lock (&tx_mutex_);
+    *stats = tx_stats_;
+    stats->latency_mean_us = (tx_stats_.sent > 0) ? tx_latency_sum_us_ / tx_stats_.sent : 0.0;
+    if (reset)
     {
-      ROS_ERROR ("Error wrote %d out of %d element(s): %s", i, len, strerror (errno));
-      ROS_BREAK ();
+      int depth = tx_stats_.depth;
+      memset (&tx_stats_, 0, sizeof(tx_stats_));
+      tx_stats_.depth = depth;
+      tx_stats_.max_depth = depth;
+      tx_latency_sum_us_ = 0;
     }
-    ROS_DEBUG ("Write completed");
-    pthread_mutex_unlock(&mutex_);
+    pthread_mutex_unlock (&tx_mutex_);
   }
 
-  void SerialInterface::output (unsigned char *output, int len)
+  void SerialInterface::rxStats (RxStats *stats)
   {
-    pthread_mutex_lock(&mutex_);
-    int i;
-    ROS_DEBUG ("SerialInterface::output()");
-    serialport_bytes_tx_ += len;
+    pthread_mutex_lock (&tx_mutex_);
+    *stats = rx_stats_;
+    pthread_mutex_unlock (&tx_mutex_);
+  }
 
-    i = write (dev_, output, len);
+  void *SerialInterface::writerEntry (void *serial)
+  {
+    static_cast<SerialInterface*>(serial)->writerLoop ();
+    return NULL;
+  }
 
-    if (i != len)
+  // Send the waiting frames, oldest first.  The frame is copied out so output() is never held up by the port.
+  void SerialInterface::writerLoop ()
+  {
+    unsigned char frame[TXD_BUFFER_LEN];
+
+    pthread_mutex_lock (&tx_mutex_);
+    while (writer_running_)
     {
-      ROS_ERROR ("Error wrote %d out of %d element(s): %s", i, len, strerror (errno));
-      ROS_BREAK ();
+      int next = -1;
+      for (int slot = 0; slot < tx_num_slots_; slot++)
+        if (tx_slots_[slot].pending && (next < 0 || tx_slots_[slot].order < tx_slots_[next].order))
+          next = slot;
+
+      if (next < 0)
+      {
+        pthread_cond_wait (&tx_cond_, &tx_mutex_);
+        continue;
+      }
+
+      TxSlot &tx = tx_slots_[next];
+      int len = tx.len;
+      uint64_t queued_ns = tx.queued_ns;
+      memcpy (frame, tx.data, len);
+      tx.pending = false;
+      tx_stats_.depth--;
+      pthread_mutex_unlock (&tx_mutex_);
+
+      int bytes = 0;
+      bool written = writeAll (frame, len, &bytes);
+      double latency_us = (monotonicNs () - queued_ns) / 1000.0;
+
+      pthread_mutex_lock (&tx_mutex_);
+      tx_stats_.bytes += bytes;
+      if (written)
+      {
+        tx_stats_.sent++;
+        tx_latency_sum_us_ += latency_us;
+        tx_stats_.latency_max_us = std::max (tx_stats_.latency_max_us, latency_us);
+      }
+      else
+      {
+        tx_stats_.errors++;
+      }
     }
-    pthread_mutex_unlock(&mutex_);
+    pthread_mutex_unlock (&tx_mutex_);
   }
 
-  int SerialInterface::getdata (unsigned char *buf, int len)
+  // Write a whole frame to the (non-blocking) port, waiting in poll() when its buffer is full.  written returns the
+  // number of bytes that went out, even on a failure.
+  bool SerialInterface::writeAll (const unsigned char *data, int len, int *written)
   {
-  #if 1
-    int i,nLength;
-    int ReceivedBytes=0;
-    ROS_DEBUG ("SerialInterface::output()");
-    pthread_mutex_lock(&mutex_);
-    nLength = read(dev_,g_buf,len);
-    pthread_mutex_unlock(&mutex_);
+    int &done = *written;
+    done = 0;
+    while (done < len)
+    {
+      int n = write (dev_, data + done, len - done);
+      if (n > 0)
+      {
+        done += n;
+        continue;
+      }
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+        ROS_ERROR ("Error wrote %d out of %d element(s): %s", done, len, strerror (errno));
+        return false;
+      }
+
+      struct pollfd fd;
+      fd.fd = dev_;
+      fd.events = POLLOUT;
+      int ready = poll (&fd, 1, TX_POLL_TIMEOUT_MS);
+      if (ready < 0 && errno != EINTR)
+      {
+        ROS_ERROR ("Serial poll failed: %s", strerror (errno));
+        return false;
+      }
+      if (ready == 0 && !writer_running_)
+        return false; // shutting down and the port isn't taking data
+    }
+    return true;
+  }
 
-    #ifdef FC_DEBUG
-	//FC debug code
-	printf("%s\n",g_buf);
-	return
-	#endif
-		
-    ReceivedBytes = nLength;
-	#if 1
-	static uint16_t crc;
-	static uint8_t ptr_rxd_buffer = 0;
-	uint8_t crc1, crc2;
-	uint8_t c;
-
-    for(i=0;i<nLength;i++)
+  bool SerialInterface::startReader (const FrameCallback &callback)
+  {
+    if (reader_running_)
+      return true;
+
+    if (pipe (wake_pipe_) != 0)
+    {
+      ROS_ERROR ("Unable to create the reader wake pipe: %s", strerror (errno));
+      return false;
+    }
+
+    frame_callback_ = callback;
+    reader_running_ = true;
+    if (pthread_create (&reader_thread_, NULL, &SerialInterface::readerEntry, this) != 0)
     {
-		c = g_buf[i];  // catch the received byte
-
-		// the rxd buffer is unlocked
-		if((ptr_rxd_buffer == 0) && (c == '#')) // if rxd buffer is empty and syncronisation character is received
-		{
-			g_rxd_buffer[ptr_rxd_buffer++] = c; // copy 1st byte to buffer
-			crc = c; // init crc
-		}
-		else if (ptr_rxd_buffer < RXD_BUFFER_LEN) // collect incomming bytes
-		{
-			if(c != '\r') // no termination character
-			{
-				g_rxd_buffer[ptr_rxd_buffer++] = c; // copy byte to rxd buffer
-				crc += c; // update crc
-			}
-			else // termination character was received
-			{
-				// the last 2 bytes are no subject for checksum calculation
-				// they are the checksum itself
-				crc -= g_rxd_buffer[ptr_rxd_buffer-2];
-				crc -= g_rxd_buffer[ptr_rxd_buffer-1];
-				// calculate checksum from transmitted data
-				crc %= 4096;
-				crc1 = '=' + crc / 64;
-				crc2 = '=' + crc % 64;
-				// compare checksum to transmitted checksum bytes
-				if((crc1 == g_rxd_buffer[ptr_rxd_buffer-2]) && (crc2 == g_rxd_buffer[ptr_rxd_buffer-1]))
-				{   // checksum valid
-					g_rxd_buffer[ptr_rxd_buffer] = '\r'; // set termination character
-					ReceivedBytes = ptr_rxd_buffer + 1;// store number of received bytes
-					// if 2nd byte is an 'R' enable watchdog that will result in an reset
-				}
-				else
-				{	// checksum invalid
-					//rxd_buffer_locked = FALSE; // unlock rxd buffer
-					ptr_rxd_buffer = 0; // reset rxd buffer pointer
-					return -1;
-				}
-				ptr_rxd_buffer = 0; // reset rxd buffer pointer
-			}
-		}
-		else // rxd buffer overrun
-		{
-			ptr_rxd_buffer = 0; // reset rxd buffer
-		}
-    }// for
-	#endif
-
-    return ReceivedBytes;
-  #endif
+      ROS_ERROR ("Unable to start the serial reader thread");
+      reader_running_ = false;
+      close (wake_pipe_[0]);
+      close (wake_pipe_[1]);
+      wake_pipe_[0] = wake_pipe_[1] = -1;
+      return false;
+    }
+    return true;
   }
 
-void SerialInterface::ParsingData(void)
-{
-	switch(g_rxd_buffer[1] - 'a')
-	{
-		case FC_ADDRESS:
-		switch(g_rxd_buffer[2])
-		{
-			case 'C':
-				memcpy(&g_Data3D,(uint8_t*)g_pRxData,sizeof(g_Data3D));
-				break;
-			case 'D':
-			    memcpy(&g_DebugData_Temp,(uint8_t*)g_pRxData,sizeof(g_DebugData));
-				if(( abs(g_DebugData_Temp.Analog[ANGLE_PITCH])>1000) ||
-						 ( abs(g_DebugData_Temp.Analog[ANGLE_ROLL])>1000) ||
-                                                 ( abs(g_DebugData_Temp.Analog[ANGLE_YAW])>3600) ||
-                                                 ( abs(g_DebugData_Temp.Analog[ACCEL_X])>700) ||
-                                                 ( abs(g_DebugData_Temp.Analog[ACCEL_Y])>700) ||
-                                                 ( abs(g_DebugData_Temp.Analog[ACCEL_Z])>900) )
-				 		 {
-                                                         //printf(" Wrong packet received\n");//I have changed some of these values (BC)
-					 	 }
-				else g_DebugData = g_DebugData_Temp;
-				break;
-
-		}
-	}
-	g_pRxData = 0;
-	g_RxDataLen = 0;
-}
+  void SerialInterface::stopReader ()
+  {
+    if (!reader_running_)
+      return;
+
+    reader_running_ = false;
+    char c = 0;
+    if (write (wake_pipe_[1], &c, 1) != 1)
+      ROS_WARN ("Unable to wake the serial reader thread, it will stop at the next poll timeout");
+    pthread_join (reader_thread_, NULL);
+
+    close (wake_pipe_[0]);
+    close (wake_pipe_[1]);
+    wake_pipe_[0] = wake_pipe_[1] = -1;
+  }
+
+  void *SerialInterface::readerEntry (void *serial)
+  {
+    static_cast<SerialInterface*>(serial)->readerLoop ();
+    return NULL;
+  }
 
+  // Sleep in poll() until the tty has data, read everything that is there into the ring buffer, and hand every
+  // complete frame to the callback right away.  Reads don't need mutex_: this is the only thread reading the port.
+  // The parser's counters are only touched here, and are copied to rx_stats_ under tx_mutex_ after each read (the
+  // lock isn't held while parsing, since the frame callback can queue a command).
+  void SerialInterface::readerLoop ()
+  {
+    struct pollfd fds[2];
+    fds[0].fd = dev_;
+    fds[0].events = POLLIN;
+    fds[1].fd = wake_pipe_[0];
+    fds[1].events = POLLIN;
 
- void SerialInterface::Decode64(void)
-{
-	uint8_t a,b,c,d;
-	uint8_t x,y,z;
-	uint8_t ptrIn = 3;
-	uint8_t ptrOut = 3;
-	uint8_t len = g_ReceivedBytes - 6;
-
-	while(len)
-	{
-		a = g_rxd_buffer[ptrIn++] - '=';
-		b = g_rxd_buffer[ptrIn++] - '=';
-		c = g_rxd_buffer[ptrIn++] - '=';
-		d = g_rxd_buffer[ptrIn++] - '=';
-
-		x = (a << 2) | (b >> 4);
-		y = ((b & 0x0f) << 4) | (c >> 2);
-		z = ((c & 0x03) << 6) | d;
-
-		if(len--) g_rxd_buffer[ptrOut++] = x; else break;
-		if(len--) g_rxd_buffer[ptrOut++] = y; else break;
-		if(len--) g_rxd_buffer[ptrOut++] = z; else break;
-	}
-	g_pRxData = &g_rxd_buffer[3];
-	g_RxDataLen = ptrOut - 3;
-}
- 
-}
+    while (reader_running_)
+    {
+      int ready = poll (fds, 2, RX_POLL_TIMEOUT_MS);
+      if (ready < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        ROS_ERROR ("Serial poll failed: %s", strerror (errno));
+        break;
+      }
+      if (ready == 0 || fds[1].revents)
+        continue; // timeout, or woken up to check reader_running_
 
+      if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+      {
+        ROS_ERROR ("Serial port %s was closed or failed", serialport_name_.c_str ());
+        break;
+      }
 
+      rx_stamp_ = ros::Time::now (); // when the bytes arrived, not when the request went out
 
+      // read straight into the free part of the ring (at most two pieces when it wraps):
+      while (true)
+      {
+        uint32_t free_bytes = RX_RING_LEN - (ring_head_ - ring_tail_);
+        uint32_t head = ring_head_ & (RX_RING_LEN - 1);
+        uint32_t contiguous = std::min (free_bytes, (uint32_t)RX_RING_LEN - head);
+        if (contiguous == 0)
+          break;
+
+        int n = read (dev_, &rx_ring_[head], contiguous);
+        if (n <= 0)
+          break; // EAGAIN, the port is drained
+        ring_head_ += n;
+        if ((uint32_t)n < contiguous)
+          break;
+      }
+
+      // parse the ring in place (two pieces when it wraps), the parser keeps any partial frame for the next read:
+      while (ring_tail_ != ring_head_)
+      {
+        uint32_t tail = ring_tail_ & (RX_RING_LEN - 1);
+        uint32_t contiguous = std::min (ring_head_ - ring_tail_, (uint32_t)RX_RING_LEN - tail);
+        parser_.feed (&rx_ring_[tail], contiguous, *this);
+        ring_tail_ += contiguous;
+      }
+
+      pthread_mutex_lock (&tx_mutex_);
+      rx_stats_.frames = parser_.frames_;
+      rx_stats_.crc_errors = parser_.crc_errors_;
+      rx_stats_.malformed = parser_.malformed_;
+      rx_stats_.bytes = parser_.bytes_;
+      pthread_mutex_unlock (&tx_mutex_);
+    }
+  }
+
+  void SerialInterface::frame (const Frame &frame)
+  {
+    if (frame_callback_)
+      frame_callback_ (frame, rx_stamp_);
+  }
+}
@@ -20,6 +20,9 @@
 
 
 #include <math.h>
+#include <deque>
+#include <string>
+#include <ros/ros.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <geometry_msgs/TransformStamped.h>
@@ -31,6 +34,8 @@
 #include "evart_bridge/transform_plus.h"
 #include <visualization_msgs/Marker.h>
 
+namespace rel_MEKF
+{
 
 //
 /// Decide whether or not to include the calibration parameters in the state, if not, the defaults below will be used
@@ -64,6 +69,9 @@ typedef kinect_vo::kinect_vo_message k_message;
 /// \typedef VOData is replaced with VO_message
 typedef VOData VO_message;
 
+/// \typedef The VO messages applied in one delayed update (see Estimator::delayedVisionUpdate())
+typedef std::deque<VO_message, Eigen::aligned_allocator<VO_message> > VO_batch;
+
 
 /*!
  *  \typedef A switch for the Truth Data:
@@ -99,6 +107,10 @@ typedef visualization_msgs::Marker Status_message;
  *  \brief The constants class provides many constants to the whole project.  These constants are declared here and
  *  defined in the .cpp file.  These constants are used in many different places in the code, so placing them in one
  *  class enables changing the value one time and not all over the code.
+ *
+ *  Apart from pi and g, they are plain members: the constructor sets the defaults (of the altimeter or the LASER
+ *  build) and load() or loadFile() can change any of them by name at startup, so tuning needs no rebuild.  The
+ *  Estimator builds its noise matrices from them once, when it is constructed.
 */
 class Constants
 {
@@ -106,77 +118,81 @@ public:
 
   const static double pi = 3.1415926535897932384626;
 
-#ifndef LASER // THE ALTIMETER IS BEING USED
   // ESTIMATOR CONSTANTS:
-  const static double acc_z_switch = -8.8; // -9.7;/// -8.90665;    //!< Once acc_z drops below this level, the estimator is turned on
-  const static double acc_y_inflate = 15.0;//8.0;// 15.0;//   //!< Use this to inflate the R for acc_y, to smooth estimates
-  const static double acc_x_inflate = 15.0;// 15.0;//   //!< for smoothing, inflate the R for x accelerometer
-  const static double alt_inflate = 1.5; //!< for smoothing the altimeter measurements
-  const static double camera_x_inflate = 1.0; //1.255;////!< inflate the camera x portion of R
-  const static double camera_qx_inflate = 5000.0;//10.0; //!< and for camera qx
-  const static double gamma = 1.0;//0.8; //!< Constant for tuning filter - between 0 and 1, used for scaling the input  //0.5;
+  double acc_z_switch; //!< Once acc_z drops below this level, the estimator is turned on
+  double acc_y_inflate; //!< Use this to inflate the R for acc_y, to smooth estimates
+  double acc_x_inflate; //!< for smoothing, inflate the R for x accelerometer
+  double alt_inflate; //!< for smoothing the altimeter measurements
+  double camera_x_inflate; //!< inflate the camera x portion of R
+  double camera_qx_inflate; //!< and for camera qx
+  double gamma; //!< Constant for tuning filter - between 0 and 1, used for scaling the input  //0.5;
                   //!< covariance B*G*B' in prediction, - decreasing the weight (trusting more) the inputs in prediction
 //  const static double phi_bias = 0.0; /// -2.1 * 3.14159265358 / 180.0;    //!< There is a bias in the hardware platform in phi
 //  const static double Q_w = 0.00250; //!< for setting the Q (process noise) for w (down velocity)
-  const static double lambda = 100.d; //!< postitive gain used in the prediction step for the quaterion, to keep the magnitude = 1 //10.d; ///
+  double lambda; //!< postitive gain used in the prediction step for the quaterion, to keep the magnitude = 1 //10.d; ///
 
   // Hardware parameters:
-  const static double mass = 3.65;//4.05;//3.95; //!< mass of aircraft (kg); //2.66
-  const static double lam1x = 0.0015;//0.0015;// 0.0036;//0.0036;//0.0025; //0.002; //!< body x-axis coefficient for force/(forward velocity*angular velocity of motor)
-  const static double kF = 0.00033; //!< coefficient for thrust/(angular velocity motor)^2  0.000175;
+  double mass; //!< mass of aircraft (kg); //2.66
+  double lam1x; //!< body x-axis coefficient for force/(forward velocity*angular velocity of motor)
+  double kF; //!< coefficient for thrust/(angular velocity motor)^2  0.000175;
   const static double g = 9.80665; //!< Gravity (m/s^2)
-  const static double yaw_camera_body = 0.d; //!< the yaw angle difference between the body-fixed coord. frame and the camera coord frame
+  double yaw_camera_body; //!< the yaw angle difference between the body-fixed coord. frame and the camera coord frame
 
   // Calibration Constants: the static transformation from the camera coordinate frame to the body-fixed coordinate frame.
   Eigen::Quaterniond q_camera_to_body; //!< Rotation portion of the calibration (initialized with the below parameters)
-  const static double qx = -0.558;//-0.5;
-  const static double qy = -0.5239;//-0.5;
-  const static double qz = -0.4736;//-0.5;
-  const static double qw = 0.435;//0.5;
+  double qx;
+  double qy;
+  double qz;
+  double qw;
   Eigen::Vector3d T_camera_to_body; //!< the translation portion of the calibration (initialized with the below paramters)
-  const static double cx =  0.1346;// 0.091;////!< body x axis coordinate of the left camera focal point
-  const static double cy =  -0.0417;// 0.002;// //!< body y axis coordinate
-  const static double cz =  0.08898;// 0.1161;// //!< body z axis
+  double cx; //!< body x axis coordinate of the left camera focal point
+  double cy; //!< body y axis coordinate
+  double cz; //!< body z axis
 
   // Noise Parameters:
-  const static double accelx_bias = 0.23; //!< initial bias in body x accelerometer
-  const static double accely_bias = -0.015; //!< bias for body y accel
-  const static double accel_x_std = 0.32; //!< x accelerometer standard deviation
-  const static double accel_y_std = 0.30; //!< y accel std. dev.
-  //const double accel_z_std = .33; //1.0;//  //z accel variance
+  double accelx_bias; //!< initial bias in body x accelerometer
+  double accely_bias; //!< bias for body y accel
+  double accel_x_std; //!< x accelerometer standard deviation
+  double accel_y_std; //!< y accel std. dev.
+  double accel_z_std; //!< z accel std. dev. (only used by the IMU preintegration)
   /// The following values were estimated from data
   /// taken from the hexakopter while it was hovering in the air
-  const static double gyrox_bias = 0.0005;//0.00000305;  //!< initial gyro bias
-  const static double gyroy_bias = 8.82e-5;//0.0005;//0.00000305;
-  const static double gyroz_bias = 0.00000305;
-  const static double gyrox_std = 0.030;   //!< measured body x gyro noise standard deviation
-  const static double gyroy_std = 0.033;
-  const static double gyroz_std = 0.030;
+  double gyrox_bias; //!< initial gyro bias
+  double gyroy_bias;
+  double gyroz_bias;
+  double gyrox_std; //!< measured body x gyro noise standard deviation
+  double gyroy_std;
+  double gyroz_std;
 
 
   //General Estimator Constants:
   // Number of "babysteps" for Prediction step: - not really used with quaternions...
-  const static int normal_steps = 1;     //!< number of steps used when doing normal prediction (not processing delayed updates)
-  const static int catchup_steps = 1;     //!< number of steps used when doing the repropogation (processing delayed updates)
+  int normal_steps; //!< number of steps used when doing normal prediction (not processing delayed updates)
+  int catchup_steps; //!< number of steps used when doing the repropogation (processing delayed updates)
 
   /// Constants for Initializing P, the covariance
-  const static double P_5mm = 0.000025;     // 0.000025 represents 5mm of uncertainty
-  const static double P_05ms = 0.0025;       // 0.0025 represents 0.05 m/s of uncertainty
-  const static double P_1deg = 0.0003;       // 0.0003 represents about 1 degree of uncertainty
-  const static double P_001 = 0.000001;     // 0.000001 represents a std of 100% of the initialized value, 0.001;
-  const static double P_1 = 0.01;      // .1*.1 = .01
+  double P_5mm; // represents 5mm of uncertainty
+  double P_05ms; // represents 0.05 m/s of uncertainty
+  double P_1deg; // represents about 1 degree of uncertainty
+  double P_001; // represents a std of 100% of the initialized value
+  double P_1; // represents a std of 0.1
 
   /// Altitude Noise Characteristics
-  const static double alt_std = 0.03;  //!< st. dev. for the altimeter
-  const static double alt_w_std = 0.20; //!< st. dev. for the altimeter w measurement
+  double alt_std; //!< st. dev. for the altimeter
+  double alt_w_std; //!< st. dev. for the altimeter w measurement
 
   /// Laser Specific Constants
-  const static double delta_x_las = 0.315; //!< x offset of laser from frontmost Cortex dot (abs. val.)
-  const static double delta_z_las = 0.1500; //!< z offset of laser from frontmost Cortex dot (abs. val.)
-  const static double las_bias = 0.0950; //!< bias in the laser range measurements
-  const static double failed_return_distance = 4.0; //!< distance returned by laser for a failed return (needs verification)
-  const static double prob_false_allow = 0.05; //!< Allowed missed detection rate for faults in the laser rangefinder
-  const static int window_size = 5; //!< number of measurements to consider when performing fault detection for laser
+  double delta_x_las; //!< x offset of laser from frontmost Cortex dot (abs. val.)
+  double delta_z_las; //!< z offset of laser from frontmost Cortex dot (abs. val.)
+  double las_bias; //!< bias in the laser range measurements
+  double failed_return_distance; //!< distance returned by laser for a failed return (needs verification)
+  double prob_false_allow; //!< Allowed missed detection rate for faults in the laser rangefinder
+  int window_size; //!< number of measurements to consider when performing fault detection for laser
+#ifdef LASER
+  int window_failure_count; //!< faulty measurements in a full window that mean the laser has failed
+  double threshold_covariance_inflate; //!< multiplies the covariance thresholds of the laser fault detection
+  double threshold_mean_inflate; //!< multiplies its mean thresholds
+#endif
 
 //  /// Quaternion Noise
 //  const static double quat_std = 0.001; //!< st. dev. for the quaternion psuedo-measurement
@@ -192,86 +208,82 @@ public:
 //  const static double trans_y_std = 0.01;
 //  const static double trans_z_std = 0.01;
 
-#else  // THE LASER IS BEING USED
-  // ESTIMATOR CONSTANTS:
-  const static double acc_z_switch = -8.8; // -9.7;/// -8.90665;    //!< Once acc_z drops below this level, the estimator is turned on
-  const static double acc_y_inflate = 8.0;// 15.0;//   //!< Use this to inflate the R for acc_y, to smooth estimates
-  const static double acc_x_inflate = 10.0;// 15.0;//   //!< for smoothing, inflate the R for x accelerometer
-  const static double alt_inflate = 2.5; //!< for smoothing the altimeter measurements
-  const static double camera_x_inflate = 1.0; //1.255;////!< inflate the camera x portion of R
-  const static double camera_qx_inflate = 1000.0;//10.0; //!< and for camera qx
-  const static double gamma = 1.0;//0.8; //!< Constant for tuning filter - between 0 and 1, used for scaling the input  //0.5;
-                  //!< covariance B*G*B' in prediction, - decreasing the weight (trusting more) the inputs in prediction
-//  const static double phi_bias = 0.0; /// -2.1 * 3.14159265358 / 180.0;    //!< There is a bias in the hardware platform in phi
-//  const static double Q_w = 0.00250; //!< for setting the Q (process noise) for w (down velocity)
-  const static double lambda = 100.d; //!< postitive gain used in the prediction step for the quaterion, to keep the magnitude = 1 //10.d; ///
 
-  // Hardware parameters:
-  const static double mass = 4.05;//3.95; //!< mass of aircraft (kg); //2.66
-  const static double lam1x = 0.0015;//0.0015;// 0.0036;//0.0036;//0.0025; //0.002; //!< body x-axis coefficient for force/(forward velocity*angular velocity of motor)
-  const static double kF = 0.00033; //!< coefficient for thrust/(angular velocity motor)^2  0.000175;
-  const static double g = 9.80665; //!< Gravity (m/s^2)
-  const static double yaw_camera_body = 0.d; //!< the yaw angle difference between the body-fixed coord. frame and the camera coord frame
+  /// Estimator Bank Constants (the windowed tests of the excluded sensor's innovations, see EstimatorBank)
+  double bank_prob_false_allow; //!< allowed false alarm rate of the tests
+  int bank_window_size; //!< number of innovations in the window of each test
+  int bank_failure_count; //!< faulty innovations in a full window that isolate the sensor
+
+  /// Fixed-Lag Smoother Constants (see FixedLagSmoother)
+  int smoother_window; //!< number of states (VO images) in the window
+  int smoother_iterations; //!< Gauss-Newton iterations of each solve
+  double smoother_relinearize; //!< error state change that relinearizes an IMU factor
+
+  /// Process Noise: the diagonal of the Estimator's Q, in the order of the error state (the calibration terms are used
+  /// when COVAR_LENGTH is 20).  Increase Q on a parameter for faster response.
+  double Q_f; //!< north position
+  double Q_r; //!< east position
+  double Q_d; //!< down position
+  double Q_qx; //!< attitude (small angle about body x)
+  double Q_qy;
+  double Q_qz;
+  double Q_u; //!< body x velocity
+  double Q_v;
+  double Q_w;
+  double Q_bp; //!< gyro biases
+  double Q_bq;
+  double Q_br;
+  double Q_ax; //!< accelerometer biases
+  double Q_ay;
+  double Q_cqx; //!< calibration rotation
+  double Q_cqy;
+  double Q_cqz;
+  double Q_cx; //!< calibration translation
+  double Q_cy;
+  double Q_cz;
 
-  // Calibration Constants: the static transformation from the camera coordinate frame to the body-fixed coordinate frame.
-  Eigen::Quaterniond q_camera_to_body; //!< Rotation portion of the calibration (initialized with the below parameters)
-  const static double qx = -0.5;
-  const static double qy = -0.5;
-  const static double qz = -0.5;
-  const static double qw = 0.5;
-  Eigen::Vector3d T_camera_to_body; //!< the translation portion of the calibration (initialized with the below paramters)
-  const static double cx =  0.114;// 0.091;////!< body x axis coordinate of the left camera focal point
-  const static double cy =  -0.019;// 0.002;// //!< body y axis coordinate
-  const static double cz =  0.089;// 0.1161;// //!< body z axis
+  Constants();
 
-  // Noise Parameters:
-  const static double accelx_bias = 0.23; //!< initial bias in body x accelerometer
-  const static double accely_bias = -0.015; //!< bias for body y accel
-  const static double accel_x_std = 0.32; //!< x accelerometer standard deviation
-  const static double accel_y_std = 0.30; //!< y accel std. dev.
-  //const double accel_z_std = .33; //1.0;//  //z accel variance
-  /// The following values were estimated from data
-  /// taken from the hexakopter while it was hovering in the air
-  const static double gyrox_bias = 0.0005;//0.00000305;  //!< initial gyro bias
-  const static double gyroy_bias = 8.82e-5;//0.0005;//0.00000305;
-  const static double gyroz_bias = 0.00000305;
-  const static double gyrox_std = 0.030;   //!< measured body x gyro noise standard deviation
-  const static double gyroy_std = 0.033;
-  const static double gyroz_std = 0.030;
 
+  /*!
+   *  \brief Reads the constants from the parameter server, each by its member name (e.g. acc_x_inflate) in the
+   *  namespace of the node handle.  A YAML file of them can be loaded there by rosparam (in a launch file).  The
+   *  constants that aren't on the server keep their values.  Every parameter in the namespace has to be a constant
+   *  and a number, the others are reported and ignored.
+   *
+   *  \param nh is the node handle of the namespace (e.g. ~constants)
+   *  \returns false if a parameter in the namespace isn't a constant or a number (the constants are still read)
+  */
+  bool load(const ros::NodeHandle &nh);
 
-  //General Estimator Constants:
-  // Number of "babysteps" for Prediction step: - not really used with quaternions...
-  const static int normal_steps = 1;     //!< number of steps used when doing normal prediction (not processing delayed updates)
-  const static int catchup_steps = 1;     //!< number of steps used when doing the repropogation (processing delayed updates)
 
-  /// Constants for Initializing P, the covariance
-  const static double P_5mm = 0.000025;     // 0.000025 represents 5mm of uncertainty
-  const static double P_05ms = 0.0025;       // 0.0025 represents 0.05 m/s of uncertainty
-  const static double P_1deg = 0.0003;       // 0.0003 represents about 1 degree of uncertainty
-  const static double P_001 = 0.000001;     // 0.000001 represents a std of 100% of the initialized value, 0.001;
-  const static double P_1 = 0.01;      // .1*.1 = .01
+  /*!
+   *  \brief Reads the constants from a flat YAML file of "name: value" lines (the same names as load(), # starts a
+   *  comment).  For the tools that run without the parameter server.
+   *
+   *  \param file_name is the file
+   *  \returns false if the file can't be read or a line isn't a constant and a number (the lines before are kept)
+  */
+  bool loadFile(const std::string &file_name);
 
-  /// Altitude Noise Characteristics
-  const static double alt_std = 0.04;//!< st. dev. for the altimeter
-  const static double alt_w_std = 0.20; //!< st. dev. for the altimeter w measurement
+//  Eigen::Matrix3d cameraToBodyFixedRotation(double yaw);
 
-  /// Laser Specific Constants
-  const static double delta_x_las = 0.20;//0.315; //!< x offset of laser from frontmost Cortex dot (abs. val.)
-  const static double delta_z_las = 0.075;//0.1500; //!< z offset of laser from frontmost Cortex dot (abs. val.)
-  const static double las_bias = 0.029;//0.0950; //!< bias in the laser range measurements
-  const static double failed_return_distance = 4.0; //!< distance returned by laser for a failed return (needs verification)
-  const static double prob_false_allow = 0.05; //!< Allowed missed detection rate for faults in the laser rangefinder
-  const static int window_size = 8; //!< number of measurements to consider when performing fault detection for laser
-  const static double threshold_covariance_inflate = 0.115;
-  const static double threshold_mean_inflate = 1.20;
+private:
 
-#endif
+  /*!
+   *  \brief Sets one constant by name
+   *  \returns false if there isn't one
+  */
+  bool set(const std::string &name, double value);
 
-  Constants();
 
-//  Eigen::Matrix3d cameraToBodyFixedRotation(double yaw);
+  /*!
+   *  \brief Rebuilds q_camera_to_body and T_camera_to_body from the calibration constants
+  */
+  void updateCalibration();
 
 };
 
+}
+
 #endif // CONSTANTS_H
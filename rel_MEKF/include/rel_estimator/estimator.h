@@ -26,6 +26,7 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <Eigen/LU>
+#include <Eigen/Cholesky>
 #include <boost/math/special_functions/fpclassify.hpp>
 #include <geometry_msgs/TransformStamped.h>
 #include <sensor_msgs/Range.h>
@@ -33,11 +34,14 @@
 #include "rel_estimator/navnode.h"
 #include "rel_estimator/navedge.h"
 #include "rel_estimator/statepacket.h"
+#include "rel_estimator/fault_detector.h"
+#include "rel_estimator/imu_preintegration.h"
 #include "rel_MEKF/relative_state.h"
 #include "rel_MEKF/edge.h"
 #include <visualization_msgs/Marker.h>
 
-
+namespace rel_MEKF
+{
 
 /*!
  *  \class Estimator estimator.h "include/rel_estimator/estimtor.h"
@@ -79,13 +83,20 @@ public:
   /// class.  (See: http://eigen.tuxfamily.org/dox/TopicStructHavingEigenMembers.html)
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
+  /// The sensors whose measurement updates can be left out of the state with excludeSensor()
+  static const int ACCEL_SENSOR = 0; //!< the accelerometer (x and y) update
+  static const int ALTITUDE_SENSOR = 1; //!< the altimeter or laser update (which one is decided by LASER)
+  static const int VISION_SENSOR = 2; //!< the visual odometry update
+  static const int SENSOR_COUNT = 3; //!< the number of sensors above
+
 
   /*!
    *  \brief Estimator is the constructor. It initializes the class variables (there are a lot in this class)
    *
-   *  \param mk_const provides the common constants used througout the program
+   *  \param mk_const provides the common constants used througout the program (deleted with the estimator)
+   *  \param log is false to not open a log file (for the hypotheses of the EstimatorBank, which are not logged)
   */
-  Estimator(Constants *mk_const);
+  Estimator(Constants *mk_const, bool log = true);
 
 
   /*!
@@ -137,6 +148,18 @@ public:
   void delayedVisionUpdate(VO_message &node_vo_data, TRUTH_message *truth_data = NULL);
 
 
+  /*!
+   *  \brief The delayed update of several vision messages at once (e.g. when the VO queue backed up).  The state is
+   *  rolled back once, to the oldest image (prepareQueuedItems() is called with its timestamp), and each message is
+   *  applied at the time its image was taken while the IMU and altitude are repropagated.  So the cost is one pass
+   *  over the queued IMU, however many messages there are.  New nodes are created in order, as in the single update.
+   *
+   *  \param vo_batch are the vision messages, in the order the images were taken
+   *  \param truth_data is optional, used when a new node is declared (see above)
+  */
+  void delayedVisionUpdate(VO_batch &vo_batch, TRUTH_message *truth_data = NULL);
+
+
   /*!
    *  \brief prediction takes the gyro measurement and predicts the state and covariance forward a timestep.  Actually,
    *  it brings the state and covariance from the previous timestep up to the current one.  It uses saved gyro values
@@ -150,6 +173,31 @@ public:
   void prediction(int N, double dt,IMU_message &imu_data);
 
 
+  /*!
+   *  \brief Predicts the state and covariance across a whole preintegrated interval at once, instead of one prediction
+   *  per IMU sample.  The deltas are corrected for the current bias estimates, and the covariance is propagated with the
+   *  Jacobians of the jump (w.r.t. the error state and the noise of the deltas) plus Q_ over the interval.
+   *
+   *  Unlike prediction(), the accelerometer x and y are used as the specific force of the interval (the drag model is
+   *  not integrated), so it is meant for intervals without vision, between keyframes or IMU batches.
+   *
+   *  \param preintegration is the interval, integrated from the time of the state
+  */
+  void preintegratedPrediction(const ImuPreintegration &preintegration);
+
+
+  /*!
+   *  \brief Preintegrates IMU samples from the time of the state and applies them with preintegratedPrediction().  As
+   *  in prediction(), each step uses the gyros of the sample before it (the saved gyros, for the first) and the
+   *  accelerometers of its own sample.  The gyros of the last sample are saved for the next prediction.
+   *
+   *  \param samples are the IMU samples, oldest first
+   *  \param old_time is the time of the state, set to the time of the last sample
+   *  \param preintegration is filled with the interval (to save it with saveData())
+  */
+  void batchPrediction(std::vector<IMU_message> &samples, double &old_time, ImuPreintegration &preintegration);
+
+
   /*!
    *  \brief The imuMeasurementUpdate function updates the state and covariance using accelerometer measurements.  The
    *  gyro values are saved here for the next predition() call.
@@ -195,8 +243,11 @@ public:
    *
    *  \param imu_data is the most recently recieved IMU
    *  \param alt_data is the most recently recieved altitude data, when available
+   *  \param preintegration is the interval that brought the state to the IMU time, when it was predicted with
+   *  batchPrediction() (the delayed updates reapply it in one prediction)
   */
-  void saveData(IMU_message &imu_data, sensor_msgs::Range *alt_data = NULL);
+  void saveData(IMU_message &imu_data, sensor_msgs::Range *alt_data = NULL,
+                const ImuPreintegration *preintegration = NULL);
 
 
   /*!
@@ -220,6 +271,95 @@ public:
   geometry_msgs::TransformStamped computeGlobalPoseEstimate(ros::Time stamp, std::string &global_name, std::string &body_name);
 
 
+  /*!
+   *  \brief The true position relative to the current node (in the node frame), as it is written to the log.
+   *
+   *  \param truth_data is the truth packet
+   *  \param position is filled with the relative true position
+   *  \returns false if the truth of the current node isn't set
+  */
+  bool relativeTruePosition(TRUTH_message &truth_data, Eigen::Vector3d &position);
+
+
+  /*!
+   *  \brief Keeps the measurement updates of one sensor out of the state.  The innovations of that sensor are still
+   *  computed, but only to be tested.  Used by the hypotheses of the EstimatorBank, which also keep the innovations of
+   *  every sensor (see innovation()).  (Keyframes are still declared when the vision is excluded, so the node frames
+   *  are the same as the other filters')
+   *
+   *  \param sensor is ACCEL_SENSOR, ALTITUDE_SENSOR or VISION_SENSOR, or -1 to use every sensor (the default)
+  */
+  void excludeSensor(int sensor){excluded_sensor_ = sensor;}
+
+
+  /*!
+   *  \brief Keeps the innovations of every sensor (see innovation()) without excluding one.  Used by the consistency
+   *  statistics (NIS) of estimator_montecarlo.
+   *
+   *  \param keep is true to keep them
+  */
+  void keepInnovations(bool keep){keep_innovations_ = keep;}
+
+
+  /*!
+   *  \brief Switches the delayed vision update to an out-of-sequence measurement (OOSM) update.  The error state
+   *  transition of every IMU step (the predictions, the (I - L*C) of every update, the OOSM ones included, and any
+   *  keyframe reset) is saved in the state queue, so a delayed VO message is fused once, at the current time, through
+   *  the cumulative transition from the image time.  Nothing is repropagated.  Messages from a new keyframe image still
+   *  roll back and repropagate, since the reset has to happen at the image time.  The updates after the image keep the
+   *  gains and linearization they had, so it is an approximation of the rollback (see estimator_replay --compare_oosm
+   *  and estimator_montecarlo --oosm).
+   *
+   *  \param retrodict is true for the OOSM update, false (the default) to roll back and repropagate every message
+  */
+  void useRetrodiction(bool retrodict){retrodict_ = retrodict; transition_.setIdentity();}
+
+
+  /*!
+   *  \brief Returns the oldest innovation of a sensor that hasn't been read, once.  Call it until it returns 0 to get
+   *  all of them (a batch of VO messages gives one for each message).  Only kept when a sensor is excluded (or
+   *  keepInnovations() is set).
+   *  Updates during the repropagation of a delayed vision update are not innovations (the measurements were already
+   *  tested) and are skipped.
+   *
+   *  \param sensor is ACCEL_SENSOR, ALTITUDE_SENSOR or VISION_SENSOR
+   *  \param whitened is filled with the innovation multiplied by the inverse Cholesky factor of its covariance
+   *  \returns the length of the innovation (2 accel, 1 altitude, 6 vision), or 0 if there wasn't a new one
+  */
+  int innovation(int sensor, Eigen::Matrix<double,6,1> &whitened);
+
+
+  /*!
+   *  \brief The non-zero block of the Jacobian of the keyframe reset (see augmentMarginalize()).  The reset zeroes the
+   *  positions and the yaw, so only the error quaternion (dqx dqy dqz) depends on the old dqx and dqy.
+   *
+   *  \param delta_quat is the delta quaternion calculated by the VO
+   *  \returns the 3x2 Jacobian of the new dqx, dqy, dqz (rows) w.r.t. the old dqx, dqy (columns)
+  */
+  static Eigen::Matrix<double,3,2> resetJacobian(const Eigen::Vector3d &delta_quat);
+
+
+  /*!
+   *  \brief Applies the keyframe reset A*P*A' to a covariance, in place.  Only the first 6 rows and columns change, and
+   *  only the attitude rows need products (with J), so the full A is never formed.
+   *
+   *  \param P is the covariance, replaced by the reset covariance
+   *  \param J is the Jacobian block from resetJacobian()
+  */
+  static void resetCovariance(Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &P, const Eigen::Matrix<double,3,2> &J);
+
+
+  /*!
+   *  \brief The keyframe reset with the full 6xCOVAR_LENGTH Jacobian (the original form).  Not used by the filter, it
+   *  is kept to check resetCovariance() against (see reset_check, and the reset times of estimator_replay).
+   *
+   *  \param P is the covariance, replaced by the reset covariance
+   *  \param J is the Jacobian block from resetJacobian()
+  */
+  static void resetCovarianceDense(Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &P,
+                                   const Eigen::Matrix<double,3,2> &J);
+
+
   /*!
    *  \brief The current relative pose is returned
    *
@@ -284,16 +424,19 @@ public:
    *
    *  \param global_name is the name for the global coordinate frame that the system is using for global visualization
    *  \param base_name holds the name that you attach the node number to for publishing what frame it is.  (so we can map the nodes in the global frame)
+   *  \param previous is the number of nodes before the current one (a batched vision update can create several)
   */
-  geometry_msgs::TransformStamped packageCurrentNode(ros::Time timestamp, std::string &global_name, std::string &base_name);
+  geometry_msgs::TransformStamped packageCurrentNode(ros::Time timestamp, std::string &global_name, std::string &base_name,
+                                                     int previous = 0);
 
 
   /*!
    *  \brief Pack up the current edge into a message.  Each edge is defined in the node coordinate system where it orginates.
    *  These are the relative transformations from node to node.  Only yaw is included as the node coordinate frames are aligned with global down
    *  So the coordinates are [f_j, r_j, d_j], with the yaw defined as the angle between f_j and f_{j+1}, positive about the d_j axis
+   *  \param previous is the number of edges before the current one (a batched vision update can create several)
   */
-  rel_MEKF::edge packageCurrentEdge(ros::Time timestamp);
+  rel_MEKF::edge packageCurrentEdge(ros::Time timestamp, int previous = 0);
 
 //  /*!
 //   *  \brief This function takes in a quaternion, verifies it is a unit quat. and converts it to a rotation matrix
@@ -311,6 +454,17 @@ public:
 
 protected:
 
+  /*!
+   *  \brief Builds everything that only depends on the constants: the process noise Q_, the gyro noise G_, the IMU and
+   *  altimeter measurement noise R_i_ and R_a_, the hover speed and drag parameters omega_h_ and mu_, and the values
+   *  the prediction and the IMU and altitude updates use (drag_, gravity_, G_gamma_, accel_covariance_, R_a_inflated_,
+   *  laser_offset_ and failed_return_distance_).  Called once by the constructor.  After it, only the vision update
+   *  (the camera calibration and inflation) and the repropagation (catchup_steps) read the constants, once per VO
+   *  message.
+  */
+  void buildNoise();
+
+
   /*!
    *  \brief directVisionUpdate contains the actual vision update code.  It is called by the delayedVisionUpdate funtion
    *  in two scenarios, if the vision update time is such that it doesn't need a delayed update, the vision update is
@@ -327,6 +481,123 @@ protected:
   void directVisionUpdate(VO_message &node_vo_data, bool override_keyframe, TRUTH_message *truth_data = NULL);
 
 
+  /*!
+   *  \brief The vision measurement model at the current state, for directVisionUpdate() and retrodictedVisionUpdate().
+   *  The translation takes the first 3 rows and the rotation the last 3.
+   *
+   *  \param node_vo_data is vision (or truth) data expressed in the node frame
+   *  \param truth_data is optional, it fills the truth of the current node if it wasn't set yet
+   *  \param residual is filled with the measurement minus the predicted measurement
+   *  \param C_v is filled with the Jacobian of the measurement w.r.t. the error state
+   *  \param R_v is filled with the (inflated) measurement noise
+  */
+  void visionMeasurement(VO_message &node_vo_data, TRUTH_message *truth_data, Eigen::Matrix<double,6,1> &residual,
+                         Eigen::Matrix<double,6,COVAR_LENGTH> &C_v, Eigen::Matrix<double,6,6> &R_v);
+
+
+  /*!
+   *  \brief The OOSM update of a delayed vision message (see useRetrodiction()).  The saved state before the image is
+   *  predicted to the image time for the residual, and the gain comes from its cross covariance with the current state
+   *  (the product of the saved transitions since).  The current state and covariance are corrected, and the saved
+   *  packets from the image on (see smoothPacket()).
+   *
+   *  \param node_vo_data is vision (or truth) data expressed in the node frame, not from a new keyframe
+   *  \param truth_data is optional, see visionMeasurement()
+  */
+  void retrodictedVisionUpdate(VO_message &node_vo_data, TRUTH_message *truth_data = NULL);
+
+
+  /*!
+   *  \brief Applies a retrodicted vision measurement to a saved packet (after the image, or the last one before it), so
+   *  the delayed messages that follow are predicted from the corrected state.
+   *
+   *  \param packet is the saved state and covariance, corrected in place
+   *  \param PC is the covariance of the packet's error state with the one at the image time, times C_v'
+   *  \param S_inverse is the inverse of the covariance of the residual
+   *  \param weighted is S_inverse times the residual
+  */
+  void smoothPacket(StatePacket &packet, const Eigen::Matrix<double,COVAR_LENGTH,6> &PC,
+                    const Eigen::Matrix<double,6,6> &S_inverse, const Eigen::Matrix<double,6,1> &weighted);
+
+
+  /*!
+   *  \brief Reapplies a queued IMU and altitude packet (prediction and measurement updates) during a delayed update and
+   *  saves the new state and covariance in its place in the state queue.
+   *
+   *  \param i is the index of the packet in the queues
+   *  \param old_time is the time of the state, set to the time of the packet
+  */
+  void repropagateStep(int i, double &old_time);
+
+
+  /*!
+   *  \brief Declares a new node at the current state: the edge and node are saved, the global estimates are updated,
+   *  and the state and covariance are augmented and marginalized (see augmentMarginalize()).
+   *
+   *  \param truth_data is optional, the truth of the new node
+  */
+  void declareNode(TRUTH_message *truth_data = NULL);
+
+
+  /*!
+   *  \brief A new preintegrated interval, with the accelerometer and gyro noise and the biases of a state
+   *
+   *  \param x is the state at the start of the interval
+  */
+  ImuPreintegration startPreintegration(const Eigen::Matrix<double,STATE_LENGTH,1> &x);
+
+
+  /*!
+   *  \brief The state at the end of a preintegrated interval and the (numerical) Jacobians of the jump, used by
+   *  preintegratedPrediction() and the FixedLagSmoother.
+   *
+   *  \param x is the state at the start of the interval
+   *  \param preintegration is the interval
+   *  \param x_end is filled with the state at the end of the interval
+   *  \param F is filled with the Jacobian w.r.t. the error state at the start
+   *  \param G_delta is filled with the Jacobian w.r.t. the noise of the deltas [dphi dv dp]
+  */
+  void preintegratedJacobians(const Eigen::Matrix<double,STATE_LENGTH,1> &x, const ImuPreintegration &preintegration,
+                              Eigen::Matrix<double,STATE_LENGTH,1> &x_end,
+                              Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &F,
+                              Eigen::Matrix<double,COVAR_LENGTH,9> &G_delta);
+
+
+  /*!
+   *  \brief The altitude measurement model of a state (the models of altitudeMeasurementUpdate(), w.r.t. the current
+   *  node).  The altitude is linear in the state, so the Jacobian doesn't depend on it.
+   *
+   *  \param alt_data is the altimeter or laser packet
+   *  \param x is the state
+   *  \param residual is filled with the measurement minus the predicted measurement
+   *  \param C_a is filled with the Jacobian w.r.t. the error state
+   *  \param variance is filled with the (inflated) measurement noise
+   *  \returns false if the packet has no measurement
+  */
+  bool altitudeMeasurement(const sensor_msgs::Range &alt_data, const Eigen::Matrix<double,STATE_LENGTH,1> &x,
+                           double &residual, Eigen::Matrix<double,1,COVAR_LENGTH> &C_a, double &variance);
+
+
+  /*!
+   *  \brief The state at the end of a preintegrated interval (see ImuPreintegration), used by preintegratedPrediction()
+   *
+   *  \param x is the state at the start of the interval
+   *  \param preintegration is the interval
+   *  \param noise is added to the deltas [dphi dv dp] (zero, except for the noise Jacobian)
+   *  \returns the state at the end of the interval
+  */
+  Eigen::Matrix<double,STATE_LENGTH,1> preintegratedState(const Eigen::Matrix<double,STATE_LENGTH,1> &x,
+                                                          const ImuPreintegration &preintegration,
+                                                          const Eigen::Matrix<double,9,1> &noise);
+
+
+  /*!
+   *  \brief The error state between two states, the inverse of applyCorrection() (x1 = x0 + difference)
+  */
+  static Eigen::Matrix<double,COVAR_LENGTH,1> stateDifference(const Eigen::Matrix<double,STATE_LENGTH,1> &x1,
+                                                             const Eigen::Matrix<double,STATE_LENGTH,1> &x0);
+
+
 //  /*!
 //   *  \brief This version of the above function applies the position and rotation measurements separetly.
 //  */
@@ -340,6 +611,48 @@ protected:
   void augmentMarginalize(Eigen::Vector3d &delta_quat);
 
 
+  /*!
+   *  \brief Saves the whitened innovation of a sensor (see innovation())
+   *
+   *  \param sensor is the sensor that was measured
+   *  \param offset is where the residual goes in the innovation (the vision rotation follows the position)
+   *  \param residual is the measurement minus the predicted measurement
+   *  \param covariance is the covariance of the residual (C*P*C' + R)
+  */
+  template<int N>
+  void recordInnovation(int sensor, int offset, const Eigen::Matrix<double,N,1> &residual,
+                        const Eigen::Matrix<double,N,N> &covariance)
+  {
+    if((excluded_sensor_ < 0 && !keep_innovations_) || repropagating_)
+      return; //not a hypothesis of the bank, or the measurement was already tested when it was new
+
+    //a new measurement starts at 0 (the vision rotation is added to the position of the same image)
+    if(offset == 0 || innovations_[sensor].empty())
+    {
+      innovations_[sensor].push_back(Eigen::Matrix<double,6,1>::Zero());
+      innovation_lengths_[sensor].push_back(0);
+    }
+
+    //whitened with the Cholesky factor L of the covariance (L*L' = covariance), so each term is N(0,1) when consistent
+    innovations_[sensor].back().template segment<N>(offset) = covariance.llt().matrixL().solve(residual);
+    innovation_lengths_[sensor].back() = offset + N;
+  }
+
+  /// \brief Adds a measurement update (I - L*C) to the error state transition, when it is kept (see useRetrodiction())
+  template<int N>
+  void trackUpdate(const Eigen::Matrix<double,COVAR_LENGTH,N> &gain, const Eigen::Matrix<double,N,COVAR_LENGTH> &jacobian)
+  {
+    if(retrodict_)
+      transition_ -= gain * (jacobian * transition_);
+  }
+
+  /// \brief recordInnovation() for a scalar measurement
+  void recordInnovation(int sensor, double residual, double variance)
+  {
+    recordInnovation<1>(sensor, 0, Eigen::Matrix<double,1,1>::Constant(residual),
+                        Eigen::Matrix<double,1,1>::Constant(variance));
+  }
+
   /*!
    *  \brief Provides a unique filename based on the time
    *
@@ -416,11 +729,20 @@ protected:
   //Constants computed at runtime:
   double omega_h_; //!< the average motorspeed for hover
   double mu_; //!< the parameter for the drag, in the improved model
+  double drag_; //!< mu_/mass, the drag acceleration per unit of body velocity
+  Eigen::Vector3d gravity_; //!< (0, 0, g)
+  Eigen::Matrix3d G_gamma_; //!< G_ times the gyro noise gain gamma, for the prediction
+  Eigen::Matrix3d accel_covariance_; //!< the accelerometer noise (x, y, z), for the preintegration
+  double R_a_inflated_; //!< R_a_ times alt_inflate, the altitude noise of the updates
+  double laser_offset_; //!< las_bias - delta_z_las, added to the predicted laser range
+  double failed_return_distance_; //!< the laser range of a failed return (m)
 
   //Queues for saving info:
   // I am using a deque instead of a regular queue, this allows me to iterate over the elements
   std::deque<IMU_message> i_queue_; //!< the IMU queue for delayed updates
   std::deque<sensor_msgs::Range> a_queue_; //!< the altitude queue for delayed updates
+  /// \brief the preintegrated intervals of the IMU queue (zero length for the packets predicted one sample at a time)
+  std::deque<ImuPreintegration, Eigen::aligned_allocator<ImuPreintegration> > p_queue_;
   /// \todo Probably need to find a better container for NavNode and NavEdge than a queue...
   /// \note When a class has fixed-size Eigen members, you must use an aligned allocator for standard containers:
   /// See: http://eigen.tuxfamily.org/dox/TopicStlContainers.html
@@ -450,15 +772,16 @@ protected:
   double residual_normalized_; //!< used for storing the normalized residual for the laser measurement
   double d_apriori_; //!< used for storing x_(2) before a laser measurement update takes place
   double d_aposteriori_; //!< used for storing x_(2) after a laser measurement update takes place
-  std::deque<double> residual_queue_; //!< used to store the last n normalized residuals, where n is defined by window_size in constants.h
-  std::deque<int> flag_queue_; //!< used to store the last n fault flags for determination of sensor failure
+#ifdef DETECT
+  FaultDetector *laser_detector_; //!< the windowed tests on the laser residuals (window_size in constants.h)
+#endif
   double num_window_faults_; //!< counts the number of faults in the current window
   bool sensor_failure_; //!< decision variable about the health of the sensor (not the individual measurements)
   bool faulty_data_yet_; //!< will be used to tell if there is faulty data being injected yet (for analysis of delay to detection only)
 
-  double window_mean_; //!< the mean of the normalized residuals in residual_queue_
+  double window_mean_; //!< the mean of the normalized residuals in the window
   double mean_statistic_; //!< the statistic used for comparing to the mean threshold
-  double window_covariance_; //!< the covariance of the normalized residuals in residual_queue_
+  double window_covariance_; //!< the covariance of the normalized residuals in the window
   double covariance_statistic_; //!< the statistic used for comparing to the covariance threshold
   double threshold_outlier_; //!< stores the threshold for the outlier test
   double threshold_mean_; //!< stores the threshold for the test of mean
@@ -467,6 +790,19 @@ protected:
   int num_laser_updates_;
   bool normal_update_; //!< keeps track of when there is a normal update and when it is a repropagation
 
+  //Estimator Bank Variables
+  int excluded_sensor_; //!< the sensor whose updates are tested but not applied (-1 for none)
+  bool keep_innovations_; //!< true to keep the innovations when no sensor is excluded
+  bool repropagating_; //!< true while delayedVisionUpdate reapplies the saved IMU and altitude data
+  /// the whitened innovations of each sensor that haven't been read, oldest first
+  std::deque<Eigen::Matrix<double,6,1>,
+             Eigen::aligned_allocator<Eigen::Matrix<double,6,1> > > innovations_[SENSOR_COUNT];
+  std::deque<int> innovation_lengths_[SENSOR_COUNT]; //!< the lengths of innovations_
+
+  //Retrodiction (OOSM) Variables
+  bool retrodict_; //!< true when delayed vision messages are fused with retrodictedVisionUpdate()
+  Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> transition_; //!< the error state transition since the last saveData()
+
 
   //std::ofstream residual_file_; //
 
@@ -477,5 +813,7 @@ protected:
   */
 };
 
+}
+
 
 #endif
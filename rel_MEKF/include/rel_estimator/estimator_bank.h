@@ -0,0 +1,181 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file estimator_bank.h
+ *  \brief Contains the class EstimatorBank, the filters that each leave out one sensor to isolate sensor faults.
+ *  \author agent
+ *  \date October 2026
+*/
+
+#ifndef ESTIMATOR_BANK_H
+#define ESTIMATOR_BANK_H
+
+#include <deque>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <Eigen/Core>
+#include <sensor_msgs/Range.h>
+#include "rel_estimator/constants.h"
+#include "rel_estimator/estimator.h"
+#include "rel_estimator/fault_detector.h"
+#include "rel_MEKF/relative_state.h"
+
+namespace rel_MEKF
+{
+
+/*!
+ *  \struct BankStep estimator_bank.h "include/rel_estimator/estimator_bank.h"
+ *  \brief The data of one loop of ROSServer::Run().  One copy is shared (read only) by every hypothesis of the bank
+ *  (and the FixedLagSmoother), with the timesteps and the altitude/IMU pairing already worked out by the server.
+*/
+struct BankStep
+{
+  /// VO_message has fixed-size Eigen members
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /*!
+   *  \brief Copies the data of the loop, the pointers are NULL (and vo_batch empty) when there wasn't any.
+  */
+  BankStep(const std::vector<IMU_message> &imu_samples, sensor_msgs::Range *alt_data, const VO_batch &vo_batch,
+           TRUTH_message *truth_data, Hex_message *hex_data);
+
+  std::vector<IMU_message> imu; //!< the IMU samples of the loop, oldest first
+  std::vector<double> dt; //!< the timestep before each sample (empty while starting up)
+  sensor_msgs::Range alt; //!< the altitude measurement
+  int alt_index; //!< the sample the altitude is applied with (-1 for no altitude)
+  VO_batch vo; //!< the vision measurements (applied in one delayed update)
+  TRUTH_message truth; //!< the truth
+  bool has_truth; //!< true if truth is valid
+  Hex_message hex; //!< the hexacopter debug data
+  bool has_hex; //!< true if hex is valid
+  bool startup; //!< the main filter's startup_flag_ at the start of the loop
+  bool just_landed; //!< the main filter's just_landed_ flag
+};
+
+
+/*!
+ *  \class EstimatorBank estimator_bank.h "include/rel_estimator/estimator_bank.h"
+ *  \brief The EstimatorBank runs one Estimator for each sensor (see Estimator::SENSOR_COUNT), each on its own thread
+ *  and each leaving its sensor out of the state.
+ *
+ *  The main filter (in ROSServer) uses every sensor, so a fault in any of them contaminates it.  Each hypothesis tests
+ *  the whitened innovations of every sensor (a FaultDetector for each), including the one it excludes, which is
+ *  predicted by a state that the sensor hasn't touched.  A faulty sensor fails the test in the hypothesis without it,
+ *  and that hypothesis stays consistent with the other sensors, while the hypotheses that use the faulty sensor are
+ *  pulled away from the good ones and fail on them.  So a sensor is isolated when its test fails in the hypothesis
+ *  that excludes it, the other tests of that hypothesis pass, and every other hypothesis fails a test.  The state of
+ *  that hypothesis should then be published instead of the main filter's.  If more than one sensor fits (a bias
+ *  between the altitude sensor and the VO height looks the same either way), none is isolated.  The isolation holds
+ *  until the estimator starts up again (on landing).
+ *
+ *  The server only copies its data into a BankStep and wakes the threads, so the latency of the main filter is not
+ *  changed.  The states of the hypotheses are a loop or so behind the main filter's.  A hypothesis that falls
+ *  MAX_QUEUE_ steps behind drops its queue and sits out until the estimator starts up again, and no sensor is isolated
+ *  meanwhile.
+*/
+class EstimatorBank
+{
+public:
+
+  /*!
+   *  \brief The constructor starts the hypotheses and their threads.
+   *
+   *  \param mk_const provides the constants (each hypothesis gets its own copy)
+  */
+  EstimatorBank(Constants *mk_const);
+
+
+  /*!
+   *  \brief The destructor stops the threads and deletes the hypotheses
+  */
+  ~EstimatorBank();
+
+
+  /*!
+   *  \brief Queues a loop of data for every hypothesis.  Called by the server, from its Run() thread.
+   *
+   *  \param step is the loop's data, it is not changed after being posted
+  */
+  void post(const boost::shared_ptr<const BankStep> &step);
+
+
+  /*!
+   *  \returns the isolated sensor (an Estimator::*_SENSOR), or -1 while every sensor is consistent
+  */
+  int isolatedSensor();
+
+
+  /*!
+   *  \brief Gives the state of the hypothesis that doesn't use the isolated sensor.
+   *
+   *  \param state is replaced with the latest state of that hypothesis, when a sensor is isolated
+   *  \returns true if a sensor is isolated (and state was replaced)
+  */
+  bool isolatedState(rel_MEKF::relative_state &state);
+
+
+  /*!
+   *  \param sensor is an Estimator::*_SENSOR
+   *  \returns the name of the sensor, for the messages
+  */
+  static const char* sensorName(int sensor);
+
+
+  /*!
+   *  \param sensor is an Estimator::*_SENSOR
+   *  \returns the length of that sensor's innovations
+  */
+  static int innovationLength(int sensor);
+
+
+protected:
+
+  /*!
+   *  \brief The loop of the thread for a hypothesis: waits for steps and processes them.
+   *  \param sensor is the sensor the hypothesis excludes
+  */
+  void work(int sensor);
+
+
+  /*!
+   *  \brief Runs a hypothesis through a step, as ROSServer::Run() does for the main filter.
+   *  \param sensor is the sensor the hypothesis excludes
+   *  \param step is the data
+  */
+  void process(int sensor, const BankStep &step);
+
+
+  /*!
+   *  \brief Tests the new innovations of a hypothesis.
+   *  \param sensor is the sensor the hypothesis excludes
+  */
+  void testInnovations(int sensor);
+
+
+  /// a hypothesis that falls this many steps behind drops them and is stopped until the next startup
+  static const int MAX_QUEUE_ = 200;
+
+  Estimator *estimators_[Estimator::SENSOR_COUNT]; //!< the hypotheses, indexed by the sensor they exclude
+  /// the tests of each hypothesis' innovations, [excluded sensor][tested sensor] (only used by the threads)
+  FaultDetector *detectors_[Estimator::SENSOR_COUNT][Estimator::SENSOR_COUNT];
+  boost::thread threads_[Estimator::SENSOR_COUNT]; //!< a thread for each hypothesis
+
+  boost::mutex mutex_; //!< guards everything below
+  boost::condition_variable posted_; //!< notified when a step is posted (or the bank is stopping)
+  std::deque<boost::shared_ptr<const BankStep> > queues_[Estimator::SENSOR_COUNT]; //!< the steps to process
+  rel_MEKF::relative_state states_[Estimator::SENSOR_COUNT]; //!< the latest state of each hypothesis
+  bool failed_[Estimator::SENSOR_COUNT][Estimator::SENSOR_COUNT]; //!< the failures of the tests in detectors_
+  int isolated_; //!< the isolated sensor, -1 for none
+  bool stalled_[Estimator::SENSOR_COUNT]; //!< true for the hypotheses that fell MAX_QUEUE_ steps behind
+  int dropped_steps_; //!< the steps dropped by the stalled hypotheses
+  int normal_steps_; //!< the integration steps per IMU sample (Constants::normal_steps)
+  bool running_; //!< false to stop the threads
+};
+
+}
+
+#endif
@@ -0,0 +1,135 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file fault_detector.h
+ *  \brief Contains the class FaultDetector, the windowed residual tests used to detect sensor faults.
+ *  \author agent
+ *  \date October 2026
+*/
+
+#ifndef FAULT_DETECTOR_H
+#define FAULT_DETECTOR_H
+
+#include <vector>
+
+namespace rel_MEKF
+{
+
+/*!
+ *  \class FaultDetector fault_detector.h "include/rel_estimator/fault_detector.h"
+ *  \brief The FaultDetector class runs the fault tests on the normalized residuals of one sensor (laser, sonar, VO...)
+ *
+ *  Each update is flagged by three tests (the flag is the sum of the bits):
+ *    - 1: test of mean, N*|mean|^2 over the window against the chi-square quantile with dim degrees of freedom
+ *    - 2: test of covariance, (N-1)*trace(S) over the window against the chi-square quantile with (N-1)*dim
+ *    - 4: outlier, decided by the caller (e.g. a failed laser return)
+ *
+ *  and the sensor is declared failed when the window of flags is full and at least failure_count of them are set.
+ *
+ *  All the chi-square quantiles that can be needed (every window length up to window_size) are computed in the
+ *  constructor, and the window mean and covariance are kept with a sliding Welford update over a fixed ring, so an
+ *  update costs O(dim) no matter how big the window is.
+*/
+class FaultDetector
+{
+public:
+
+  static const int MEAN_FAULT = 1; //!< flag bit for the test of mean
+  static const int COVARIANCE_FAULT = 2; //!< flag bit for the test of covariance
+  static const int OUTLIER_FAULT = 4; //!< flag bit for an outlier
+
+  /*!
+   *  \brief The constructor computes the threshold tables.
+   *
+   *  \param dimension is the length of the residual vector (1 for a range sensor)
+   *  \param window_size is the number of residuals (and flags) in the window
+   *  \param prob_false_allow is the allowed false alarm probability of the tests
+   *  \param mean_inflate multiplies the mean thresholds
+   *  \param covariance_inflate multiplies the covariance thresholds
+   *  \param failure_count is the number of flagged updates in a full window that means the sensor has failed
+  */
+  FaultDetector(int dimension, int window_size, double prob_false_allow, double mean_inflate,
+                double covariance_inflate, int failure_count);
+
+
+  /*!
+   *  \brief Adds a normalized residual to the window and runs the tests.
+   *
+   *  \param normalized_residual points to dimension values, the residual scaled by the inverse square root of its
+   *  covariance
+   *  \param outlier is true if the caller found the measurement to be an outlier
+   *  \returns the fault flag of this update
+  */
+  int update(const double *normalized_residual, bool outlier);
+
+  /// \brief The update for a scalar residual
+  int update(double normalized_residual, bool outlier)
+  {
+    return update(&normalized_residual, outlier);
+  }
+
+
+  /// \brief Empties the windows
+  void reset();
+
+  /// \returns the mean of the first residual component over the window
+  double mean() const {return count_ > 0 ? mean_[0] : 0.0;}
+
+  /// \returns the sample variance summed over the components (trace(S)) of the window
+  double covariance() const {return count_ > 1 ? m2_total_/(count_ - 1) : 0.0;}
+
+  /// \returns the statistic of the last test of mean
+  double meanStatistic() const {return mean_statistic_;}
+
+  /// \returns the statistic of the last test of covariance
+  double covarianceStatistic() const {return covariance_statistic_;}
+
+  /// \returns the threshold of the last test of mean
+  double meanThreshold() const {return mean_threshold_;}
+
+  /// \returns the threshold of the last test of covariance
+  double covarianceThreshold() const {return covariance_threshold_;}
+
+  /// \returns the number of flagged updates in the window
+  int windowFaults() const {return window_faults_;}
+
+  /// \returns true if the sensor is declared failed
+  bool sensorFailure() const {return sensor_failure_;}
+
+
+protected:
+
+  /*!
+   *  \brief Removes the oldest residual from the running statistics (Welford in reverse)
+  */
+  void removeOldest();
+
+  int dimension_; //!< length of the residual vector
+  int window_size_; //!< residuals in the window
+  int failure_count_; //!< flagged updates in a full window for a sensor failure
+
+  double mean_quantile_; //!< mean threshold (the same for every window length)
+  std::vector<double> covariance_threshold_table_; //!< covariance threshold, indexed by the window length
+
+  std::vector<double> residuals_; //!< ring of the residuals (dimension_ values each)
+  std::vector<int> flags_; //!< ring of the flags
+  int head_; //!< ring index of the oldest entry
+  int count_; //!< entries in the rings
+  std::vector<double> mean_; //!< running mean of each component
+  std::vector<double> m2_; //!< running sum of squared deviations of each component
+  double m2_total_; //!< sum of m2_
+  int window_faults_; //!< flags in the ring that are set
+
+  double mean_statistic_; //!< last statistic of the test of mean
+  double covariance_statistic_; //!< last statistic of the test of covariance
+  double mean_threshold_; //!< last threshold of the test of mean
+  double covariance_threshold_; //!< last threshold of the test of covariance
+  bool sensor_failure_; //!< decision about the health of the sensor
+};
+
+}
+
+#endif
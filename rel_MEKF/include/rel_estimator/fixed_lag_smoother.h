@@ -0,0 +1,261 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file fixed_lag_smoother.h
+ *  \brief Contains the class FixedLagSmoother, a sliding window optimization of the relative state next to the MEKF.
+ *  \author agent
+ *  \date October 2026
+*/
+
+#ifndef FIXED_LAG_SMOOTHER_H
+#define FIXED_LAG_SMOOTHER_H
+
+#include <deque>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+#include <Eigen/StdDeque>
+#include <sensor_msgs/Range.h>
+#include "rel_estimator/constants.h"
+#include "rel_estimator/estimator.h"
+#include "rel_estimator/estimator_bank.h"
+#include "rel_estimator/imu_preintegration.h"
+#include "rel_MEKF/relative_state.h"
+
+namespace rel_MEKF
+{
+
+/*!
+ *  \struct SmootherState fixed_lag_smoother.h "include/rel_estimator/fixed_lag_smoother.h"
+ *  \brief A state of the window of the FixedLagSmoother (at the time of a VO image) and the factors that touch it.
+*/
+struct SmootherState
+{
+  /// Eigen macro for the fixed-sized members (see http://eigen.tuxfamily.org/dox/TopicStructHavingEigenMembers.html)
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /// \brief The constructor: no measurements and no IMU factor
+  SmootherState();
+
+  double time; //!< the time of the state (the last IMU sample before the image)
+  Eigen::Matrix<double,STATE_LENGTH,1> x; //!< the estimate
+  ImuPreintegration preintegration; //!< the IMU from the previous state (not used by the first state)
+  Eigen::Matrix<double,STATE_LENGTH,1> linearization; //!< the previous state where F was taken
+  Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> F; //!< the Jacobian of the IMU factor w.r.t. the previous state
+  Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> information; //!< the information of the IMU factor
+  bool linearized; //!< false until F and information are taken
+  IMU_message imu; //!< the IMU sample at the state (for the accelerometer factor)
+  bool has_imu; //!< true if imu is used
+  VO_message vo; //!< the VO image
+  bool has_vo; //!< true if vo is used
+  sensor_msgs::Range alt; //!< the latest altitude measurement before the state
+  bool has_alt; //!< true if alt is used
+};
+
+
+/*!
+ *  \class FixedLagSmoother fixed_lag_smoother.h "include/rel_estimator/fixed_lag_smoother.h"
+ *  \brief The FixedLagSmoother estimates the relative state by optimizing the last few states (one for each VO image)
+ *  together, on its own thread, next to the main filter.
+ *
+ *  The MEKF linearizes each measurement once, at the state when it is applied.  The smoother keeps a window of states
+ *  (Constants::smoother_window) with the factors between them: the IMU between two images as one preintegrated
+ *  factor (see ImuPreintegration), and the VO, altitude and accelerometer measurements at each state (with the
+ *  measurement models of the Estimator).  The window is solved with a few Gauss-Newton iterations, so every factor is
+ *  relinearized at the better estimate.  The states are only linked to their neighbours, so the normal equations are
+ *  block tridiagonal and are solved with a block Cholesky factorization (linear in the window).  The solve starts from
+ *  the last estimates, and the Jacobians of an IMU factor (the expensive part) are only taken again when its first
+ *  state moves by more than Constants::smoother_relinearize.
+ *
+ *  When the window is full, the oldest state is marginalized into a prior on the next (Schur complement).  A VO
+ *  image of a new node collapses the window: the states are marginalized down to the last one, the node is declared
+ *  with that estimate (Estimator::declareNode()) and the window starts again from the reset state, since every state
+ *  is relative to the current node.
+ *
+ *  The server posts the same BankStep as it does to the EstimatorBank, so the latency of the main filter is not
+ *  changed.  After each solve the state of the last image is predicted to the latest IMU sample and kept for
+ *  smoothedState(), so it comes at the rate of the VO, while the MEKF still gives the state at the rate of the IMU.
+*/
+class FixedLagSmoother : public Estimator
+{
+public:
+
+  /// Eigen macro for the fixed-sized members (see http://eigen.tuxfamily.org/dox/TopicStructHavingEigenMembers.html)
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /*!
+   *  \brief The constructor starts the thread.
+   *
+   *  \param mk_const provides the constants (the smoother gets its own copy)
+   *  \param threaded is false to process the steps in post() instead of on a thread (for the replay)
+  */
+  FixedLagSmoother(Constants *mk_const, bool threaded = true);
+
+
+  /*!
+   *  \brief The destructor stops the thread
+  */
+  ~FixedLagSmoother();
+
+
+  /*!
+   *  \brief Queues a loop of data.  Called by the server, from its Run() thread.
+   *
+   *  \param step is the loop's data, it is not changed after being posted
+  */
+  void post(const boost::shared_ptr<const BankStep> &step);
+
+
+  /*!
+   *  \brief Gives the latest smoothed state, once.
+   *
+   *  \param state is replaced with the state of the last solve (predicted to the latest IMU sample then)
+   *  \returns true if there was a new one (and state was replaced)
+  */
+  bool smoothedState(rel_MEKF::relative_state &state);
+
+
+  /*!
+   *  \brief Gives the times of the solves since the last call.
+   *
+   *  \param times has the times (in microseconds) appended
+  */
+  void solveTimes(std::vector<double> &times);
+
+
+protected:
+
+  /*!
+   *  \brief The loop of the thread: waits for steps and processes them.
+  */
+  void work();
+
+
+  /*!
+   *  \brief Runs the smoother through a step: the IMU samples are buffered, and each VO image adds a state to the
+   *  window and solves it.
+   *  \param step is the data
+  */
+  void process(const BankStep &step);
+
+
+  /*!
+   *  \brief Starts the window with the state and covariance of the Estimator, as the prior of its only state.
+   *
+   *  \param time is the time of the state
+  */
+  void startWindow(double time);
+
+
+  /*!
+   *  \brief Adds a state at a VO image: the buffered IMU samples up to the image are preintegrated from the last state.
+   *
+   *  \param vo_data is the image
+   *  \returns false if there are no IMU samples between the last state and the image (it isn't used)
+  */
+  bool addState(VO_message &vo_data);
+
+
+  /*!
+   *  \brief The Gauss-Newton iterations on the window, the estimates are replaced.
+   *
+   *  \param covariance is filled with the marginal covariance of the last state
+  */
+  void solve(Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &covariance);
+
+
+  /*!
+   *  \brief Marginalizes the oldest state into the prior on the next one.
+  */
+  void marginalizeOldest();
+
+
+  /*!
+   *  \brief Collapses the window at a new node: the last state is declared as a node and becomes the only state.
+   *
+   *  \param truth_data is optional, the truth of the new node
+  */
+  void declareSmoothedNode(TRUTH_message *truth_data);
+
+
+  /*!
+   *  \brief Predicts the last state to the latest IMU sample and keeps it for smoothedState().
+   *
+   *  \param covariance is the covariance of the last state
+   *  \param elapsed is the time of the solve (microseconds)
+  */
+  void publishState(const Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &covariance, double elapsed);
+
+
+  /*!
+   *  \brief Adds the prior to the normal equations of the first state
+  */
+  void addPrior(const SmootherState &state, Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &H,
+                Eigen::Matrix<double,COVAR_LENGTH,1> &b);
+
+
+  /*!
+   *  \brief Adds the VO, altitude and accelerometer factors of a state to its normal equations
+  */
+  void addMeasurements(SmootherState &state, Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &H,
+                       Eigen::Matrix<double,COVAR_LENGTH,1> &b);
+
+
+  /*!
+   *  \brief Adds the IMU factor between two states to the normal equations, relinearizing it if the previous state has
+   *  moved too much
+   *
+   *  \param previous is the earlier state
+   *  \param state is the later state (with the factor)
+   *  \param H_pp, H_ps, H_ss are the blocks of the normal equations (previous, cross, state)
+   *  \param b_p, b_s are the right hand sides
+  */
+  void addImuFactor(const SmootherState &previous, SmootherState &state,
+                    Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &H_pp,
+                    Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &H_ps,
+                    Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &H_ss,
+                    Eigen::Matrix<double,COVAR_LENGTH,1> &b_p, Eigen::Matrix<double,COVAR_LENGTH,1> &b_s);
+
+
+  /*!
+   *  \brief The state x moved by the error state delta_x (applyCorrection() on a copy)
+  */
+  Eigen::Matrix<double,STATE_LENGTH,1> correctedState(const Eigen::Matrix<double,STATE_LENGTH,1> &x,
+                                                      Eigen::Matrix<double,COVAR_LENGTH,1> delta_x);
+
+
+  static const int MAX_QUEUE_ = 200; //!< a warning is given if the smoother falls this many steps behind
+  static const int MAX_PENDING_VO_ = 20; //!< VO images waiting for their IMU samples before the oldest is dropped
+
+  /// the states of the window, oldest first
+  std::deque<SmootherState, Eigen::aligned_allocator<SmootherState> > window_;
+  Eigen::Matrix<double,STATE_LENGTH,1> prior_state_; //!< the mean of the prior on the first state
+  Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> prior_information_; //!< the information of the prior
+  std::deque<IMU_message> samples_; //!< the IMU samples after the last state
+  Eigen::Vector3d previous_gyro_; //!< the gyro of the last sample before samples_ (held over its interval)
+  double sample_time_; //!< the time of the last sample before samples_
+  VO_batch pending_vo_; //!< the VO images newer than the IMU samples
+  sensor_msgs::Range alt_; //!< the latest altitude measurement not in the window
+  double alt_time_; //!< the time of its IMU sample
+  bool alt_pending_; //!< true if alt_ is waiting for a state
+
+  bool threaded_; //!< false if the steps are processed in post()
+  boost::thread thread_; //!< the smoother's thread
+
+  boost::mutex mutex_; //!< guards everything below
+  boost::condition_variable posted_; //!< notified when a step is posted (or the smoother is stopping)
+  std::deque<boost::shared_ptr<const BankStep> > queue_; //!< the steps to process
+  rel_MEKF::relative_state state_; //!< the latest smoothed state
+  bool fresh_; //!< true if state_ hasn't been taken
+  std::vector<double> solve_times_; //!< the times of the solves (microseconds) not taken yet
+  bool running_; //!< false to stop the thread
+};
+
+}
+
+#endif
@@ -0,0 +1,147 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file imu_preintegration.h
+ *  \brief Contains the class ImuPreintegration, the IMU samples between two times summarized as one relative motion.
+ *  \author agent
+ *  \date October 2026
+*/
+
+#ifndef IMU_PREINTEGRATION_H
+#define IMU_PREINTEGRATION_H
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace rel_MEKF
+{
+
+/*!
+ *  \class ImuPreintegration imu_preintegration.h "include/rel_estimator/imu_preintegration.h"
+ *  \brief The ImuPreintegration class accumulates the IMU samples between two times into a delta rotation, velocity
+ *  and position, in the body frame at the first time, so that the state can be moved across the whole interval at once.
+ *
+ *  With R the body to node rotation and v_n the node frame velocity at the first time, the deltas give the state at
+ *  the second time (T = deltaTime()):
+ *    - R' = R*dR
+ *    - v_n' = v_n + g*T + R*dv
+ *    - p' = p + v_n*T + 0.5*g*T^2 + R*dp
+ *
+ *  The deltas do not depend on the state, only on the biases they were integrated with.  A different bias estimate
+ *  (after a VO update, say) is applied with the first order bias Jacobians through correctedDeltaR() and friends
+ *  instead of integrating the samples again.  The 9x9 covariance of the deltas [dphi dv dp] comes from the gyro and
+ *  accelerometer noise, with the rotation error on the right (dR_true = dR*exp(dphi)).
+ *
+ *  The recursions are the ones from Forster et al, "On-Manifold Preintegration for Real-Time Visual-Inertial
+ *  Odometry" (IEEE Trans. Robotics, 2017).
+*/
+class ImuPreintegration
+{
+public:
+  /// Eigen macro for the fixed-sized members (see http://eigen.tuxfamily.org/dox/TopicStructHavingEigenMembers.html)
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /// \brief The default constructor, no noise (used by the containers)
+  ImuPreintegration();
+
+  /*!
+   *  \brief The constructor takes the sensor noise.
+   *
+   *  \param gyro_covariance is the covariance of a gyro sample (rad/s)^2
+   *  \param accel_covariance is the covariance of an accelerometer sample (m/s^2)^2
+  */
+  ImuPreintegration(const Eigen::Matrix3d &gyro_covariance, const Eigen::Matrix3d &accel_covariance);
+
+
+  /*!
+   *  \brief Starts a new interval, integrated with the given biases
+   *
+   *  \param gyro_bias is the gyro bias estimate at the start of the interval
+   *  \param accel_bias is the accelerometer bias estimate at the start of the interval
+  */
+  void reset(const Eigen::Vector3d &gyro_bias, const Eigen::Vector3d &accel_bias);
+
+
+  /*!
+   *  \brief Adds one IMU sample to the interval.
+   *
+   *  \param gyro is the angular rate, held over the step (the biases of reset() are subtracted)
+   *  \param accel is the specific force, held over the step
+   *  \param dt is the length of the step
+  */
+  void integrate(const Eigen::Vector3d &gyro, const Eigen::Vector3d &accel, double dt);
+
+
+  /// \returns the delta rotation for new bias estimates, to first order
+  Eigen::Matrix3d correctedDeltaR(const Eigen::Vector3d &gyro_bias) const;
+
+  /// \returns the delta velocity for new bias estimates, to first order
+  Eigen::Vector3d correctedDeltaV(const Eigen::Vector3d &gyro_bias, const Eigen::Vector3d &accel_bias) const;
+
+  /// \returns the delta position for new bias estimates, to first order
+  Eigen::Vector3d correctedDeltaP(const Eigen::Vector3d &gyro_bias, const Eigen::Vector3d &accel_bias) const;
+
+
+  /// \returns the delta rotation (body at the end to body at the start)
+  const Eigen::Matrix3d& deltaR() const {return delta_R_;}
+
+  /// \returns the delta velocity, in the body frame at the start
+  const Eigen::Vector3d& deltaV() const {return delta_v_;}
+
+  /// \returns the delta position, in the body frame at the start
+  const Eigen::Vector3d& deltaP() const {return delta_p_;}
+
+  /// \returns the length of the interval (zero before the first sample)
+  double deltaTime() const {return delta_t_;}
+
+  /// \returns the covariance of [dphi dv dp]
+  const Eigen::Matrix<double,9,9>& covariance() const {return covariance_;}
+
+  /// \returns the gyro bias the samples were integrated with
+  const Eigen::Vector3d& gyroBias() const {return gyro_bias_;}
+
+  /// \returns the accelerometer bias the samples were integrated with
+  const Eigen::Vector3d& accelBias() const {return accel_bias_;}
+
+  /// \returns the Jacobian of the rotation error with respect to the gyro bias
+  const Eigen::Matrix3d& dRdGyroBias() const {return dR_dbg_;}
+
+
+  /// \returns the rotation matrix of a rotation vector (Rodrigues' formula)
+  static Eigen::Matrix3d expMap(const Eigen::Vector3d &phi);
+
+  /// \returns the rotation vector of a rotation matrix (the inverse of expMap())
+  static Eigen::Vector3d logMap(const Eigen::Matrix3d &R);
+
+  /// \returns the right Jacobian of SO(3), exp(phi + dphi) = exp(phi)*exp(J_r(phi)*dphi) to first order
+  static Eigen::Matrix3d rightJacobian(const Eigen::Vector3d &phi);
+
+
+protected:
+
+  Eigen::Matrix3d gyro_covariance_; //!< covariance of a gyro sample
+  Eigen::Matrix3d accel_covariance_; //!< covariance of an accelerometer sample
+
+  Eigen::Vector3d gyro_bias_; //!< the gyro bias the samples are integrated with
+  Eigen::Vector3d accel_bias_; //!< the accelerometer bias the samples are integrated with
+
+  Eigen::Matrix3d delta_R_; //!< delta rotation
+  Eigen::Vector3d delta_v_; //!< delta velocity
+  Eigen::Vector3d delta_p_; //!< delta position
+  double delta_t_; //!< length of the interval
+
+  Eigen::Matrix<double,9,9> covariance_; //!< covariance of [dphi dv dp]
+
+  Eigen::Matrix3d dR_dbg_; //!< d(dphi)/d(gyro bias)
+  Eigen::Matrix3d dV_dbg_; //!< d(dv)/d(gyro bias)
+  Eigen::Matrix3d dV_dba_; //!< d(dv)/d(accel bias)
+  Eigen::Matrix3d dP_dbg_; //!< d(dp)/d(gyro bias)
+  Eigen::Matrix3d dP_dba_; //!< d(dp)/d(accel bias)
+};
+
+}
+
+#endif
@@ -20,6 +20,9 @@
 #include <geometry_msgs/TransformStamped.h>
 #include "rel_estimator/constants.h"
 
+namespace rel_MEKF
+{
+
 /*!
  *  \class NavEdge navedge.h "include/rel_estimator/navedge.h"
  *  \brief The NavEdge class provides edges between keyframe nodes.  It provdes the translation (and covariance) betweeen
@@ -137,4 +140,6 @@ protected:
 
 };
 
+}
+
 #endif // NAVEDGE_H
@@ -21,6 +21,9 @@
 #include "rel_estimator/navedge.h"
 #include "rel_estimator/constants.h"
 
+namespace rel_MEKF
+{
+
 /*!
  *  \class NavNode navnode.h "include/rel_estimator/navnode.h"
  *  \brief The NavNode class is the container for the nodes of the nodes and edges graph.  Each node is defined by
@@ -142,4 +145,6 @@ protected:
   //! the body-fixed frame when the keyframe image was taken
 };
 
+}
+
 #endif // NAVNODE_H
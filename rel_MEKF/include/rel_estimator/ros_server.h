@@ -18,6 +18,7 @@
 
 #include <queue>
 #include <deque>
+#include <vector>
 #include <pthread.h>
 #include <boost/thread.hpp>
 #include <Eigen/Core>
@@ -29,13 +30,20 @@
 #include <sensor_msgs/Imu.h>
 #include <sensor_msgs/Range.h>
 #include "mikro_serial/mikoImu.h"
+#include "microstrain_3dmgx2_imu/ImuBatch.h"
 #include "rel_estimator/estimator.h"
+#include "rel_estimator/estimator_bank.h"
+#include "rel_estimator/fixed_lag_smoother.h"
 #include "rel_estimator/constants.h"
 #include "rel_estimator/vodata.h"
+#include "latency_trace.h"
 #include "rel_MEKF/relative_state.h"
 #include "rel_MEKF/edge.h"
 #include <visualization_msgs/Marker.h>
 
+namespace rel_MEKF
+{
+
 /*! These mutex's allow the different measurements to be placed into the queues asynchronously.  I maybe could have done
      it all with only one, but I thought it would be better to cover each queue with a different mutex allowing more
      flexibility.
@@ -64,10 +72,11 @@ public:
   /*!
    *  \brief The constructor for the ROSServer class.
    *
-   *  \param nh is the node handle for the current ROS node
-   *  \param constants is a pointer to the Constants class.
+   *  \param nh is the node handle for the current ROS node (or nodelet), topics are relative to it
+   *  \param private_nh is the private node handle, the parameters are read from it
+   *  \param mk_const is a pointer to the Constants class, allocated with new (the Estimator deletes it)
   */
-  ROSServer(ros::NodeHandle &nh, Constants *mk_const);
+  ROSServer(ros::NodeHandle &nh, ros::NodeHandle &private_nh, Constants *mk_const);
 
 
   /*!
@@ -112,6 +121,17 @@ protected:
   void imuCallback(const IMU_message &imu_message);
 
 
+  /*!
+   *  \brief This function is called when ROS recieves a batch of IMU samples (the ~use_imu_batch parameter).
+   *
+   *  The samples are converted to IMU_messages here and handed to the Run thread as a whole, so the lock is taken once
+   *  per batch instead of once per sample.  Run then predicts and updates through every sample of the batch in one pass.
+   *
+   *  \param batch is the set of samples the IMU node read from the port together, oldest first.
+  */
+  void imuBatchCallback(const microstrain_3dmgx2_imu::ImuBatch &batch);
+
+
   /*!
    *  \brief This function is called when ROS recieves a visual odometry (view matching) message.
    *
@@ -156,9 +176,11 @@ protected:
 
   //variables:
   ros::Publisher rel_state_publisher_; //!< the publisher for the relative 6DoF state and covariance info
+  ros::Publisher smoothed_state_publisher_; //!< publishes the state of the smoother (when ~use_smoother is set)
   ros::Publisher global_pose_publisher_; //!< publishes the global pose estimate (TEMPORARY!!)
   ros::Publisher node_global_pub_; //!< publishes the current node's global pose
   ros::Publisher edge_pub_; //!< publishes the edge when a new node is created
+  kinect_vo::LatencyTrace latency_trace_; //!< publishes the estimator stages of the camera frame to motor command trace
 
 #ifdef LASER
 #ifdef DETECT
@@ -182,6 +204,7 @@ protected:
 
   /// Queues for collecting IMU, VO, Altitude, and Truth data: (These queues are accessed by two threads)
   std::queue<IMU_message> imu_queue_; //!< the IMU queue
+  std::deque<std::vector<IMU_message> > imu_batch_queue_; //!< the batches of IMU samples (when ~use_imu_batch is set)
   /// \note When a class has fixed-size Eigen members, you must use an aligned allocator for standard containers:
   /// See: http://eigen.tuxfamily.org/dox/TopicStlContainers.html
   std::deque<VO_message, Eigen::aligned_allocator<VO_message> > vo_queue_; //!< the queue holding all the vo messages
@@ -195,14 +218,19 @@ protected:
 
   double old_time_; //!< holder for the previous IMU packet time
   double dt_; //!< the delta between the past IMU timestep and the current
+  bool preintegrate_imu_batch_; //!< predict each IMU batch with one preintegrated interval (~preintegrate_imu_batch)
 
   Estimator *estimator_; //!< the instance of the estimator class that implements the EKF
+  EstimatorBank *bank_; //!< the filters that each leave out a sensor, to isolate faults (NULL unless ~use_estimator_bank)
+  FixedLagSmoother *smoother_; //!< the sliding window estimator next to the EKF (NULL unless ~use_smoother)
   Constants *mk_consts_; //!< the instance of the constants class that provides, you guessed it, constants
 
   volatile int while_true_; //!< the value to put low when the thread for the Run method should exit
 
 };
 
+}
+
 
 
 
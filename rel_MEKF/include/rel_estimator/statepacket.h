@@ -19,6 +19,9 @@
 #include <ros/time.h>
 #include "rel_estimator/constants.h"
 
+namespace rel_MEKF
+{
+
 /*!
  *  \class StatePacket statepacket.h "include/rel_estimator/statepacket.h"
  *  \brief This class is a container for the state and covariance.  To accomplish delayed updates for visual data
@@ -33,7 +36,7 @@ public:
   /*!
    *  \brief Constructor initializes the state and covariance to zeros
   */
-  StatePacket(){x_.setZero(); P_.setZero(); ros::Time temp(0.d); time_ = temp;}
+  StatePacket(){x_.setZero(); P_.setZero(); F_.setIdentity(); ros::Time temp(0.d); time_ = temp;}
 
   /*!
    *  \brief Constructor initializes the state and covariance
@@ -42,7 +45,7 @@ public:
    *  \param t is the timestamp of the state from ROS
   */
   StatePacket(Eigen::Matrix<double, STATE_LENGTH, 1> &x, Eigen::Matrix<double, COVAR_LENGTH, COVAR_LENGTH> &P, ros::Time &t)
-  {x_ = x; P_ = P; time_ = t;}
+  {x_ = x; P_ = P; F_.setIdentity(); time_ = t;}
 
   /*!
    *  \brief Returns the state vector
@@ -64,6 +67,16 @@ public:
   */
   void setCovariance(Eigen::Matrix<double, COVAR_LENGTH, COVAR_LENGTH> &covar){P_ = covar;}
 
+  /*!
+   *  \brief Return the error state transition from the previous packet to this one (see Estimator::useRetrodiction())
+  */
+  Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> getTransition(){return F_;}
+
+  /*!
+   *  \brief Replace the error state transition
+  */
+  void setTransition(Eigen::Matrix<double, COVAR_LENGTH, COVAR_LENGTH> &transition){F_ = transition;}
+
   /*!
    *  \brief Return the timestamp
   */
@@ -78,6 +91,9 @@ public:
 protected:
   Eigen::Matrix<double, STATE_LENGTH, 1> x_;  //!< the state
   Eigen::Matrix<double, COVAR_LENGTH, COVAR_LENGTH> P_; //!< the covariance
+  Eigen::Matrix<double, COVAR_LENGTH, COVAR_LENGTH> F_; //!< the error state transition from the previous packet (identity if not kept)
   ros::Time time_; //!< the timestamp
 };
+
+}
 #endif // STATEPACKET_H
@@ -21,6 +21,8 @@
 #include <ros/time.h>
 #include "kinect_vo/kinect_vo_message.h"
 
+namespace rel_MEKF
+{
 
 /*!
  *  \typedef kinect_visual_odometry::kinect_visual_odometry is replaced with k_message
@@ -78,6 +80,7 @@ public:
     this->inliers_ = other_vo_data->Inliers();
     this->corresponding_ = other_vo_data->Corresponding();
     this->image_number_ = other_vo_data->ImageNumber();
+    this->trace_id_ = other_vo_data->TraceID();
     this->total_covariance_ = other_vo_data->Covariance();
     this->translation_ = other_vo_data->Translation();
     this->rotation_ = other_vo_data->Rotation();
@@ -99,6 +102,8 @@ public:
 
   int ImageNumber(){return image_number_;}
 
+  uint32_t TraceID(){return trace_id_;}
+
   Eigen::Matrix<double,7,7> Covariance(){return total_covariance_;}
 
   Eigen::Vector3d Translation(){return translation_;}
@@ -124,6 +129,7 @@ protected:
   int inliers_; //!< the number of inliers for the particular vo message
   int corresponding_; //!< the number of corresponding features found
   int image_number_; //!< the image number (or sequence from the header)
+  uint32_t trace_id_; //!< the latency trace id the VO gave the image (0 if not traced)
   Eigen::Matrix<double,7,7> total_covariance_; //!< the covariance on the transformation
   Eigen::Vector3d translation_; //!< the translation portion of the transformation between images
   Eigen::Quaterniond rotation_; //!< the rotation portion of the transformation
@@ -131,4 +137,6 @@ protected:
   std::string parent_frame_id_; //!< the name of the reference frame that is the basis for the transformation
 };
 
+}
+
 #endif // VODATA_H
@@ -5,10 +5,373 @@
   */
 
 #include "rel_estimator/constants.h"
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace rel_MEKF
+{
 
 using namespace Eigen;
 
+
+/// The constants that load() and loadFile() set, by name (all but pi and g)
+struct DoubleConstant
+{
+  const char *name;
+  double Constants::*value;
+};
+
+struct IntConstant
+{
+  const char *name;
+  int Constants::*value;
+};
+
+#define CONSTANT(name) {#name, &Constants::name}
+
+static const DoubleConstant DOUBLE_CONSTANTS[] = {
+  CONSTANT(acc_z_switch), CONSTANT(acc_y_inflate), CONSTANT(acc_x_inflate), CONSTANT(alt_inflate),
+  CONSTANT(camera_x_inflate), CONSTANT(camera_qx_inflate), CONSTANT(gamma), CONSTANT(lambda), CONSTANT(mass),
+  CONSTANT(lam1x), CONSTANT(kF), CONSTANT(yaw_camera_body), CONSTANT(qx), CONSTANT(qy), CONSTANT(qz), CONSTANT(qw),
+  CONSTANT(cx), CONSTANT(cy), CONSTANT(cz), CONSTANT(accelx_bias), CONSTANT(accely_bias), CONSTANT(accel_x_std),
+  CONSTANT(accel_y_std), CONSTANT(accel_z_std), CONSTANT(gyrox_bias), CONSTANT(gyroy_bias), CONSTANT(gyroz_bias),
+  CONSTANT(gyrox_std), CONSTANT(gyroy_std), CONSTANT(gyroz_std), CONSTANT(P_5mm), CONSTANT(P_05ms), CONSTANT(P_1deg),
+  CONSTANT(P_001), CONSTANT(P_1), CONSTANT(alt_std), CONSTANT(alt_w_std), CONSTANT(delta_x_las), CONSTANT(delta_z_las),
+  CONSTANT(las_bias), CONSTANT(failed_return_distance), CONSTANT(prob_false_allow),
+#ifdef LASER
+  CONSTANT(threshold_covariance_inflate), CONSTANT(threshold_mean_inflate),
+#endif
+  CONSTANT(bank_prob_false_allow), CONSTANT(smoother_relinearize),
+  CONSTANT(Q_f), CONSTANT(Q_r), CONSTANT(Q_d), CONSTANT(Q_qx), CONSTANT(Q_qy), CONSTANT(Q_qz), CONSTANT(Q_u),
+  CONSTANT(Q_v), CONSTANT(Q_w), CONSTANT(Q_bp), CONSTANT(Q_bq), CONSTANT(Q_br), CONSTANT(Q_ax), CONSTANT(Q_ay),
+  CONSTANT(Q_cqx), CONSTANT(Q_cqy), CONSTANT(Q_cqz), CONSTANT(Q_cx), CONSTANT(Q_cy), CONSTANT(Q_cz)
+};
+
+static const IntConstant INT_CONSTANTS[] = {
+  CONSTANT(normal_steps), CONSTANT(catchup_steps), CONSTANT(window_size),
+#ifdef LASER
+  CONSTANT(window_failure_count),
+#endif
+  CONSTANT(bank_window_size), CONSTANT(bank_failure_count), CONSTANT(smoother_window), CONSTANT(smoother_iterations)
+};
+
+#undef CONSTANT
+
+static const int DOUBLE_COUNT = sizeof(DOUBLE_CONSTANTS)/sizeof(DOUBLE_CONSTANTS[0]);
+static const int INT_COUNT = sizeof(INT_CONSTANTS)/sizeof(INT_CONSTANTS[0]);
+
+
+
 Constants::Constants()
+{
+#ifndef LASER // THE ALTIMETER IS BEING USED
+  // ESTIMATOR CONSTANTS:
+  acc_z_switch = -8.8; // -9.7;/// -8.90665;
+  acc_y_inflate = 15.0;//8.0;// 15.0;//
+  acc_x_inflate = 15.0;// 15.0;//
+  alt_inflate = 1.5;
+  camera_x_inflate = 1.0; //1.255;//
+  camera_qx_inflate = 5000.0;//10.0;
+  gamma = 1.0;//0.8;
+  lambda = 100.d;
+
+  // Hardware parameters:
+  mass = 3.65;//4.05;//3.95;
+  lam1x = 0.0015;//0.0015;// 0.0036;//0.0036;//0.0025; //0.002;
+  kF = 0.00033;
+  yaw_camera_body = 0.d;
+
+  // Calibration Constants: the static transformation from the camera coordinate frame to the body-fixed coordinate frame.
+  qx = -0.558;//-0.5;
+  qy = -0.5239;//-0.5;
+  qz = -0.4736;//-0.5;
+  qw = 0.435;//0.5;
+  cx =  0.1346;// 0.091;//
+  cy =  -0.0417;// 0.002;//
+  cz =  0.08898;// 0.1161;//
+
+  // Noise Parameters:
+  accelx_bias = 0.23;
+  accely_bias = -0.015;
+  accel_x_std = 0.32;
+  accel_y_std = 0.30;
+  accel_z_std = 0.33;
+  gyrox_bias = 0.0005;//0.00000305;
+  gyroy_bias = 8.82e-5;//0.0005;//0.00000305;
+  gyroz_bias = 0.00000305;
+  gyrox_std = 0.030;
+  gyroy_std = 0.033;
+  gyroz_std = 0.030;
+
+  //General Estimator Constants:
+  // Number of "babysteps" for Prediction step: - not really used with quaternions...
+  normal_steps = 1;
+  catchup_steps = 1;
+
+  /// Constants for Initializing P, the covariance
+  P_5mm = 0.000025;     // 0.000025 represents 5mm of uncertainty
+  P_05ms = 0.0025;       // 0.0025 represents 0.05 m/s of uncertainty
+  P_1deg = 0.0003;       // 0.0003 represents about 1 degree of uncertainty
+  P_001 = 0.000001;     // 0.000001 represents a std of 100% of the initialized value, 0.001;
+  P_1 = 0.01;      // .1*.1 = .01
+
+  /// Altitude Noise Characteristics
+  alt_std = 0.03;
+  alt_w_std = 0.20;
+
+  /// Laser Specific Constants
+  delta_x_las = 0.315;
+  delta_z_las = 0.1500;
+  las_bias = 0.0950;
+  failed_return_distance = 4.0;
+  prob_false_allow = 0.05;
+  window_size = 5;
+
+  /// Process Noise (the diagonal of Q)
+  /// \note: Increase Q on a parameter for faster response. Increase R on a measurement for smoothing (more filtering)
+  /// I have noticed that position is good when Q_ for v is high and velocity is good when Q_ for v is low.  So then I
+  /// started adjusting the R values for the measurement updates...  I would set these and the R's back to bland values and start
+  /// from there, if I needed to tune again...
+  Q_f = 0.01;//0.001;//0.035;//I can have these two at zero, but this gives better position performance
+  Q_r = 0.01;//0.001;//0.06;//0.065
+  Q_d = 0.0001;//Don't really need faster response on down, it's already quite fast
+  Q_qx = 0.00025;//;//The IMU and enhanced model do a good job with attitude as is
+  Q_qy = 0.00025;//;
+  Q_qz = 0.0;
+  Q_u = 0.0002;//0.0;//0.0001;//0.05;// These parameters can be adjusted quite a bit, all the way down to 0.0001, but here seems ok
+  Q_v = 0.0002;//0.0;//0.0001;//0.07;
+  Q_w = 0.009;//0.01;
+  //biases don't change fast:
+  Q_bp = 0.00000000051;
+  Q_bq = 0.00000000005;
+  Q_br = 0.000000000051;
+  Q_ax = 0.000000001;
+  Q_ay = 0.000000001;
+  //Shouldn't these be zero, as they are constants???  Need to think about that.
+  Q_cqx = 0.0000000001;
+  Q_cqy = 0.0000000001;
+  Q_cqz = 0.0000000001;
+  Q_cx = 0.000000001;
+  Q_cy = 0.000000001;
+  Q_cz = 0.000000001;
+
+#else  // THE LASER IS BEING USED
+  // ESTIMATOR CONSTANTS:
+  acc_z_switch = -8.8; // -9.7;/// -8.90665;
+  acc_y_inflate = 8.0;// 15.0;//
+  acc_x_inflate = 10.0;// 15.0;//
+  alt_inflate = 2.5;
+  camera_x_inflate = 1.0; //1.255;//
+  camera_qx_inflate = 1000.0;//10.0;
+  gamma = 1.0;//0.8;
+  lambda = 100.d;
+
+  // Hardware parameters:
+  mass = 4.05;//3.95;
+  lam1x = 0.0015;//0.0015;// 0.0036;//0.0036;//0.0025; //0.002;
+  kF = 0.00033;
+  yaw_camera_body = 0.d;
+
+  // Calibration Constants: the static transformation from the camera coordinate frame to the body-fixed coordinate frame.
+  qx = -0.5;
+  qy = -0.5;
+  qz = -0.5;
+  qw = 0.5;
+  cx =  0.114;// 0.091;//
+  cy =  -0.019;// 0.002;//
+  cz =  0.089;// 0.1161;//
+
+  // Noise Parameters:
+  accelx_bias = 0.23;
+  accely_bias = -0.015;
+  accel_x_std = 0.32;
+  accel_y_std = 0.30;
+  accel_z_std = 0.33;
+  gyrox_bias = 0.0005;//0.00000305;
+  gyroy_bias = 8.82e-5;//0.0005;//0.00000305;
+  gyroz_bias = 0.00000305;
+  gyrox_std = 0.030;
+  gyroy_std = 0.033;
+  gyroz_std = 0.030;
+
+  //General Estimator Constants:
+  // Number of "babysteps" for Prediction step: - not really used with quaternions...
+  normal_steps = 1;
+  catchup_steps = 1;
+
+  /// Constants for Initializing P, the covariance
+  P_5mm = 0.000025;     // 0.000025 represents 5mm of uncertainty
+  P_05ms = 0.0025;       // 0.0025 represents 0.05 m/s of uncertainty
+  P_1deg = 0.0003;       // 0.0003 represents about 1 degree of uncertainty
+  P_001 = 0.000001;     // 0.000001 represents a std of 100% of the initialized value, 0.001;
+  P_1 = 0.01;      // .1*.1 = .01
+
+  /// Altitude Noise Characteristics
+  alt_std = 0.04;
+  alt_w_std = 0.20;
+
+  /// Laser Specific Constants
+  delta_x_las = 0.20;//0.315;
+  delta_z_las = 0.075;//0.1500;
+  las_bias = 0.029;//0.0950;
+  failed_return_distance = 4.0;
+  prob_false_allow = 0.05;
+  window_size = 8;
+  window_failure_count = 6;
+  threshold_covariance_inflate = 0.115;
+  threshold_mean_inflate = 1.20;
+
+  /// Process Noise (the diagonal of Q)
+  Q_f = 0.003;//0.0;//0.035;//I can have these two at zero, but this gives better position performance
+  Q_r = 0.020;//0.0;//0.06;//0.065
+  Q_d = 0.000001;//Don't really need faster response on down, it's already quite fast
+  Q_qx = 0.0002;//0.0001;//The IMU and enhanced model do a good job with attitude as is
+  Q_qy = 0.0008;//0.0001;
+  Q_qz = 0.00000000000000001;
+  Q_u = 0.0001;//0.0;//0.0001;//0.05;// These parameters can be adjusted quite a bit, all the way down to 0.0001, but here seems ok
+  Q_v = 0.0003;//0.0;//0.0001;//0.07;
+  Q_w = 0.05;//0.01;
+  //biases don't change fast:
+  Q_bp = 0.00000000051;
+  Q_bq = 0.00000000005;
+  Q_br = 0.000000000051;
+  Q_ax = 0.000000001;
+  Q_ay = 0.000000001;
+  Q_cqx = 0.0000000001;
+  Q_cqy = 0.0000000001;
+  Q_cqz = 0.0000000001;
+  Q_cx = 0.00000001;
+  Q_cy = 0.00000001;
+  Q_cz = 0.00000001;
+
+#endif
+
+  /// Estimator Bank Constants
+  bank_prob_false_allow = 0.01;
+  bank_window_size = 20;
+  bank_failure_count = 12;
+
+  /// Fixed-Lag Smoother Constants
+  smoother_window = 10;
+  smoother_iterations = 3;
+  smoother_relinearize = 0.01;
+
+  updateCalibration();
+}
+
+
+
+//
+// Read the constants from the parameter server
+//
+bool Constants::load(const ros::NodeHandle &nh)
+{
+  //The whole namespace is read, so the names that aren't constants (a typo would keep a default) are found too
+  XmlRpc::XmlRpcValue parameters;
+  if(!nh.getParam(nh.getNamespace(), parameters))
+    return true; //nothing there, the defaults are kept
+  if(parameters.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+  {
+    ROS_ERROR("%s is not a namespace of constants", nh.getNamespace().c_str());
+    return false;
+  }
+
+  bool good = true;
+  for(XmlRpc::XmlRpcValue::iterator i = parameters.begin(); i != parameters.end(); i++)
+  {
+    double number;
+    if(i->second.getType() == XmlRpc::XmlRpcValue::TypeDouble)
+      number = static_cast<double&>(i->second);
+    else if(i->second.getType() == XmlRpc::XmlRpcValue::TypeInt)
+      number = static_cast<int&>(i->second);
+    else
+    {
+      ROS_ERROR("The constant %s/%s is not a number", nh.getNamespace().c_str(), i->first.c_str());
+      good = false;
+      continue;
+    }
+    if(!set(i->first, number))
+    {
+      ROS_ERROR("%s/%s is not a constant (ignored)", nh.getNamespace().c_str(), i->first.c_str());
+      good = false;
+    }
+  }
+
+  updateCalibration();
+  return good;
+}
+
+
+
+//
+// Read the constants from a flat YAML file
+//
+bool Constants::loadFile(const std::string &file_name)
+{
+  std::ifstream file(file_name.c_str());
+  if(!file.is_open())
+  {
+    ROS_ERROR("Unable to open the constants file %s", file_name.c_str());
+    return false;
+  }
+
+  bool good = true;
+  std::string line;
+  for(int line_number = 1; good && std::getline(file, line); line_number++)
+  {
+    line = line.substr(0, line.find('#'));
+    std::string::size_type colon = line.find(':');
+    std::istringstream name_stream(line.substr(0, colon));
+    std::string name;
+    if(!(name_stream >> name))
+      continue; //a blank or comment line
+
+    char *end = NULL;
+    std::string value = colon == std::string::npos ? "" : line.substr(colon + 1);
+    double number = strtod(value.c_str(), &end);
+    good = end != value.c_str() && std::string(end).find_first_not_of(" \t\r") == std::string::npos &&
+           set(name, number);
+    if(!good)
+      ROS_ERROR("%s:%d is not a constant and a number: %s", file_name.c_str(), line_number, line.c_str());
+  }
+
+  updateCalibration();
+  return good;
+}
+
+
+
+//
+// Set a constant by name
+//
+bool Constants::set(const std::string &name, double value)
+{
+  for(int i = 0; i < DOUBLE_COUNT; i++)
+  {
+    if(name == DOUBLE_CONSTANTS[i].name)
+    {
+      this->*DOUBLE_CONSTANTS[i].value = value;
+      return true;
+    }
+  }
+  for(int i = 0; i < INT_COUNT; i++)
+  {
+    if(name == INT_CONSTANTS[i].name)
+    {
+      this->*INT_CONSTANTS[i].value = (int)floor(value + 0.5);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+
+//
+// Rebuild the calibration transformation from its constants
+//
+void Constants::updateCalibration()
 {
   //Vision platform constants :
   // Calibration Constants: the static transformation from the camera coordinate frame to the body-fixed coordinate frame.
@@ -35,3 +398,5 @@ Constants::Constants()
 
 //  return rotation3;
 //}
+
+}
@@ -14,14 +14,16 @@
 #include "rel_estimator/estimator.h"
 #include "rel_estimator/eigen_utils.h"
 #include <boost/math/distributions/normal.hpp>
-#include <boost/math/distributions/chi_squared.hpp>
+
+namespace rel_MEKF
+{
 
 using namespace Eigen;
 
 //
 //  Constructor
 //
-Estimator::Estimator(Constants *mk_const): mk_consts_(mk_const)
+Estimator::Estimator(Constants *mk_const, bool log): mk_consts_(mk_const)
 {    
   int covar_len = COVAR_LENGTH;
   int state_len = STATE_LENGTH;
@@ -41,9 +43,17 @@ Estimator::Estimator(Constants *mk_const): mk_consts_(mk_const)
   num_laser_updates_ = 0;
   normal_update_ = false;
 
-  //Constants computed at runtime:
-  omega_h_ = sqrt(mk_consts_->g * mk_consts_->mass / (mk_consts_->kF * 6)); /// \note: 6 is for the number of rotors
-  mu_ = mk_consts_->lam1x * 6 * omega_h_; /// 6 for number of rotors here as well
+  //Estimator Bank Variables
+  excluded_sensor_ = -1;
+  keep_innovations_ = false;
+  repropagating_ = false;
+  retrodict_ = false;
+  transition_.setIdentity();
+#ifdef DETECT
+  laser_detector_ = new FaultDetector(1, mk_consts_->window_size, mk_consts_->prob_false_allow,
+                                      mk_consts_->threshold_mean_inflate, mk_consts_->threshold_covariance_inflate,
+                                      mk_consts_->window_failure_count);
+#endif
 
   //Initialize all the variables:
   //State and covariance
@@ -73,6 +83,9 @@ Estimator::Estimator(Constants *mk_const): mk_consts_(mk_const)
   //Vision
   R_v_.setZero(); //variable, set with when vision data comes in
 
+  //The noise and drag computed from the constants (only once, they don't change):
+  buildNoise();
+
   node_id_incrementer_ = 0;
   global_R_yaw_.setIdentity();
   global_node_position_.setZero();
@@ -82,6 +95,9 @@ Estimator::Estimator(Constants *mk_const): mk_consts_(mk_const)
   lpf_old_ = 0;
 
   //Setup the Log:
+  if(!log)
+    return;
+
   time_t rawtime;
   struct tm *utc_time; 
 
@@ -117,12 +133,74 @@ Estimator::~Estimator()
 {
   //Destroy stuff...
   delete mk_consts_;
+#ifdef DETECT
+  delete laser_detector_;
+#endif
 
   //close stuff
   log_file_.close();
 }
 
 
+//
+// Build the noise matrices and drag parameters from the constants
+//
+void Estimator::buildNoise()
+{
+  //Constants computed at runtime:
+  omega_h_ = sqrt(mk_consts_->g * mk_consts_->mass / (mk_consts_->kF * 6)); /// \note: 6 is for the number of rotors
+  mu_ = mk_consts_->lam1x * 6 * omega_h_; /// 6 for number of rotors here as well
+
+  //                 [0  1  2  3   4   5   6  7  8  9   10  11  12  13    14   15   16   17  18  19 ]
+  // Process Q_ =    [df dr dd dqx dqy dqz du dv dw dbp dbq dbr dax day | dcqx dcqy dcqz dcx dxy dcz]
+  Q_(0,0) = mk_consts_->Q_f;
+  Q_(1,1) = mk_consts_->Q_r;
+  Q_(2,2) = mk_consts_->Q_d;
+  Q_(3,3) = mk_consts_->Q_qx;
+  Q_(4,4) = mk_consts_->Q_qy;
+  Q_(5,5) = mk_consts_->Q_qz;
+  Q_(6,6) = mk_consts_->Q_u;
+  Q_(7,7) = mk_consts_->Q_v;
+  Q_(8,8) = mk_consts_->Q_w;
+  Q_(9,9) = mk_consts_->Q_bp;
+  Q_(10,10) = mk_consts_->Q_bq;
+  Q_(11,11) = mk_consts_->Q_br;
+  Q_(12,12) = mk_consts_->Q_ax;
+  Q_(13,13) = mk_consts_->Q_ay;
+  if(COVAR_LENGTH > 14)
+  {
+    //Calibrating
+    Q_(14,14) = mk_consts_->Q_cqx;
+    Q_(15,15) = mk_consts_->Q_cqy;
+    Q_(16,16) = mk_consts_->Q_cqz;
+    Q_(17,17) = mk_consts_->Q_cx;
+    Q_(18,18) = mk_consts_->Q_cy;
+    Q_(19,19) = mk_consts_->Q_cz;
+  }
+
+  G_(0,0) = mk_consts_->gyrox_std*mk_consts_->gyrox_std;
+  G_(1,1) = mk_consts_->gyroy_std*mk_consts_->gyroy_std;
+  G_(2,2) = mk_consts_->gyroz_std*mk_consts_->gyroz_std;
+
+  R_i_(0,0) = mk_consts_->accel_x_std*mk_consts_->accel_x_std*mk_consts_->acc_x_inflate;
+  R_i_(1,1) = mk_consts_->accel_y_std*mk_consts_->accel_y_std*mk_consts_->acc_y_inflate;
+
+  R_a_ = mk_consts_->alt_std*mk_consts_->alt_std;
+
+  //The constants of the prediction and updates, folded so they aren't read through mk_consts_ at the IMU rate:
+  gravity_ = Vector3d(0, 0, mk_consts_->g);
+  drag_ = mu_/mk_consts_->mass;
+  G_gamma_ = mk_consts_->gamma*G_;
+  accel_covariance_ = Vector3d(mk_consts_->accel_x_std*mk_consts_->accel_x_std,
+                               mk_consts_->accel_y_std*mk_consts_->accel_y_std,
+                               mk_consts_->accel_z_std*mk_consts_->accel_z_std).asDiagonal();
+  R_a_inflated_ = R_a_*mk_consts_->alt_inflate;
+  laser_offset_ = mk_consts_->las_bias - mk_consts_->delta_z_las;
+  failed_return_distance_ = mk_consts_->failed_return_distance;
+}
+
+
+
 //
 // Initialize the filter: (usually, we enter this function MANY times before taking off)
 //
@@ -203,65 +281,6 @@ void Estimator::Initialize(IMU_message &imu_data, Hex_message *hex_data,
     P_(19,19) = 0.0001;//mk_consts_->P_1;
   }
 
-  /// \note: Increase Q on a parameter for faster response. Increase R on a measurement for smoothing (more filtering)
-  /// I have noticed that position is good when Q_ for v is high and velocity is good when Q_ for v is low.  So then I
-  /// started adjusting the R values for the measurement updates...  I would set these and the R's back to bland values and start
-  /// from there, if I needed to tune again...
-//  Q_(0,0) = 0.01;//0.001;//0.035;//I can have these two at zero, but this gives better position performance
-//  Q_(1,1) = 0.01;//0.001;//0.06;//0.065
-//  Q_(2,2) = 0.0001;//Don't really need faster response on down, it's already quite fast
-//  Q_(3,3) = 0.0025;//;//The IMU and enhanced model do a good job with attitude as is
-//  Q_(4,4) = 0.0025;//;
-//  Q_(5,5) = 0.0;
-//  Q_(6,6) = 0.007;//0.0001;//0.05;// These parameters can be adjusted quite a bit, all the way down to 0.0001, but here seems ok
-//  Q_(7,7) = 0.02;//0.0001;//0.07;
-//  Q_(8,8) = 0.0007;//0.01;
-//  //biases don't change fast:
-//  Q_(9,9) =   0.00000000051;//
-//  Q_(10,10) = 0.00000000005;//
-//  Q_(11,11) = 0.000000000051;//
-//  Q_(12,12) = 0.000000001;//
-//  Q_(13,13) = 0.000000001;//
-//  if(COVAR_LENGTH > 14)
-//  {
-//    //Shouldn't these be zero, as they are constants???  Need to think about that.
-//    Q_(14,14) = 0.0000000001;//
-//    Q_(15,15) = 0.0000000001;//
-//    Q_(16,16) = 0.0000000001;//
-//    Q_(17,17) = 0.000000001;//
-//    Q_(18,18) = 0.000000001;//
-//    Q_(19,19) = 0.000000001;//
-//  }
-
-
-  //Saving these original working params, just in case:
-  Q_(0,0) = 0.01;//0.001;//0.035;//I can have these two at zero, but this gives better position performance
-  Q_(1,1) = 0.01;//0.001;//0.06;//0.065
-  Q_(2,2) = 0.0001;//Don't really need faster response on down, it's already quite fast
-  Q_(3,3) = 0.00025;//;//The IMU and enhanced model do a good job with attitude as is
-  Q_(4,4) = 0.00025;//;
-  Q_(5,5) = 0.0;
-  Q_(6,6) = 0.0002;//0.0;//0.0001;//0.05;// These parameters can be adjusted quite a bit, all the way down to 0.0001, but here seems ok
-  Q_(7,7) = 0.0002;//0.0;//0.0001;//0.07;
-  Q_(8,8) = 0.009;//0.01;
-  //biases don't change fast:
-  Q_(9,9) =   0.00000000051;//
-  Q_(10,10) = 0.00000000005;//
-  Q_(11,11) = 0.000000000051;//
-  Q_(12,12) = 0.000000001;//
-  Q_(13,13) = 0.000000001;//
-  if(COVAR_LENGTH > 14)
-  {
-    //Shouldn't these be zero, as they are constants???  Need to think about that.
-    Q_(14,14) = 0.0000000001;//
-    Q_(15,15) = 0.0000000001;//
-    Q_(16,16) = 0.0000000001;//
-    Q_(17,17) = 0.000000001;//
-    Q_(18,18) = 0.000000001;//
-    Q_(19,19) = 0.000000001;//
-  }
-
-
 #else //LASER IN USE!
 
   //                 [0  1  2  3   4   5   6  7  8  9   10  11  12  13    14   15   16   17  18  19 ]
@@ -292,49 +311,8 @@ void Estimator::Initialize(IMU_message &imu_data, Hex_message *hex_data,
     P_(19,19) = 0.0001;//mk_consts_->P_1;
   }
 
-  /// \note: Increase Q on a parameter for faster response. Increase R on a measurement for smoothing (more filtering)
-  /// I have noticed that position is good when Q_ for v is high and velocity is good when Q_ for v is low.  So then I
-  /// started adjusting the R values for the measurement updates...  I would set these and the R's back to bland values and start
-  /// from there, if I needed to tune again...
-  Q_(0,0) = 0.003;//0.0;//0.035;//I can have these two at zero, but this gives better position performance
-  Q_(1,1) = 0.020;//0.0;//0.06;//0.065
-  Q_(2,2) = 0.000001;//Don't really need faster response on down, it's already quite fast
-  Q_(3,3) = 0.0002;//0.0001;//The IMU and enhanced model do a good job with attitude as is
-  Q_(4,4) = 0.0008;//0.0001;
-  Q_(5,5) = 0.00000000000000001;
-  Q_(6,6) = 0.0001;//0.0;//0.0001;//0.05;// These parameters can be adjusted quite a bit, all the way down to 0.0001, but here seems ok
-  Q_(7,7) = 0.0003;//0.0;//0.0001;//0.07;
-  Q_(8,8) = 0.05;//0.01;
-  //biases don't change fast:
-  Q_(9,9) =   0.00000000051;//
-  Q_(10,10) = 0.00000000005;//
-  Q_(11,11) = 0.000000000051;//
-  Q_(12,12) = 0.000000001;//
-  Q_(13,13) = 0.000000001;//
-  if(COVAR_LENGTH > 14)
-  {
-    Q_(14,14) = 0.0000000001;//
-    Q_(15,15) = 0.0000000001;//
-    Q_(16,16) = 0.0000000001;//
-    Q_(17,17) = 0.00000001;//
-    Q_(18,18) = 0.00000001;//
-    Q_(19,19) = 0.00000001;//
-  }
-
 #endif
 
-
-
-
-  G_(0,0) = mk_consts_->gyrox_std*mk_consts_->gyrox_std;
-  G_(1,1) = mk_consts_->gyroy_std*mk_consts_->gyroy_std;
-  G_(2,2) = mk_consts_->gyroz_std*mk_consts_->gyroz_std;
-
-  R_i_(0,0) = mk_consts_->accel_x_std*mk_consts_->accel_x_std*mk_consts_->acc_x_inflate;
-  R_i_(1,1) = mk_consts_->accel_y_std*mk_consts_->accel_y_std*mk_consts_->acc_y_inflate;
-
-  R_a_ = mk_consts_->alt_std*mk_consts_->alt_std;  
-
 //  R_q_ = mk_consts_->quat_std*mk_consts_->quat_std;
 
   //Initialize the first node (use truth if available)
@@ -476,6 +454,7 @@ void Estimator::prepareQueuedItems(ros::Time timestamp)
   {
     ROS_INFO("Situation has occured: Camera update sent and recieved in-between 1 IMU update cycle!!!");
     i_queue_.clear();
+    p_queue_.clear();
   }
   else
   {
@@ -483,6 +462,7 @@ void Estimator::prepareQueuedItems(ros::Time timestamp)
     {
       i_queue_.pop_front();
       a_queue_.pop_front();
+      p_queue_.pop_front();
     }
   }
 }
@@ -495,11 +475,33 @@ void Estimator::prepareQueuedItems(ros::Time timestamp)
 void Estimator::delayedVisionUpdate(VO_message &vo_data,
                                     TRUTH_message *truth_data)
 {
-  if ((int)state_queue_.size() > 2 && (int)i_queue_.size() > 2)
+  VO_batch vo_batch(1, vo_data);
+  delayedVisionUpdate(vo_batch, truth_data);
+}
+
+
+
+//
+//  Delayed Vision Update of several VO messages: one rollback and one repropagation for all of them
+//
+void Estimator::delayedVisionUpdate(VO_batch &vo_batch,
+                                    TRUTH_message *truth_data)
+{
+  bool keyframe = false; //a new keyframe is declared at the time of its image, so it needs the rollback
+  for (int v = 0; v < (int)vo_batch.size(); v++)
+    keyframe = keyframe || vo_batch[v].NewReference();
+
+  if (retrodict_ && !keyframe && (int)state_queue_.size() > 2 && (int)i_queue_.size() > 2)
+  {
+    //Fuse the messages at the current time, through the saved transitions (nothing is repropagated)
+    for (int v = 0; v < (int)vo_batch.size(); v++)
+      retrodictedVisionUpdate(vo_batch[v], truth_data);
+  }
+  else if ((int)state_queue_.size() > 2 && (int)i_queue_.size() > 2)
   {
     //Do not attempt this version of the update if the state queue is empty!
 
-    /// First step is to reverse time and replace x_ and P_ with the saved version:
+    /// First step is to reverse time and replace x_ and P_ with the saved version (for the oldest image):
     StatePacket tempstate;
     IMU_message tempimu;
     sensor_msgs::Range tempalt;
@@ -508,13 +510,12 @@ void Estimator::delayedVisionUpdate(VO_message &vo_data,
     state_queue_.pop_front();
     x_ = tempstate.getState();
     P_ = tempstate.getCovariance();
+    transition_.setIdentity(); //the saved transitions are replaced as the packets are repropagated
 
-    //Predict the state forward in time to the camera time and then apply the update
     tempimu = i_queue_.front();
     i_queue_.pop_front();
     a_queue_.pop_front();
-    double dt_1 = vo_data.Timestamp().toSec() - tempimu.header.stamp.toSec();
-    int start_at; //the IMU packet to start at for the repropagation below
+    p_queue_.pop_front();
 
     //approximate the first prediction, using the gyros from this sensor reading and zero out the delta values
     saved_gyros_(0) = tempimu.angular_velocity.x;
@@ -523,106 +524,256 @@ void Estimator::delayedVisionUpdate(VO_message &vo_data,
     saved_deltatheta_.setZero();
     saved_deltaV_.setZero();
 
-    if (dt_1 > 0)
+    //the IMU packets in the queue are reapplied in order, and each image is applied between the two packets around it
+    int count = (int)i_queue_.size();
+    int next = 0; //the next IMU packet to reapply
+    double old_time = tempimu.header.stamp.toSec(); //the time of the state
+    repropagating_ = true;
+
+    for (int v = 0; v < (int)vo_batch.size(); v++)
     {
-      //VO should be applied between IMU timesteps
-      //If there isn't sufficient info to go all the way back, do not do this step, it will be with a negative dt!
+      VO_message &vo_data = vo_batch[v];
 
-      prediction(mk_consts_->catchup_steps, dt_1,tempimu);  //predict based on the gyros for dt_1 timespan
-    }
+      //
+      /// Repropagate the IMU and altitude information up to the time the image was taken
+      while (next < count && i_queue_.at(next).header.stamp <= vo_data.Timestamp())
+      {
+        tempimu = i_queue_.at(next);
+        repropagateStep(next, old_time);
+        next++;
+      }
 
-    //
-    /// Process the visual odometry measurement update at the time the image was taken:
-    // This is done in the directVisionUpdate function (that way we don't the same code twice)
-    directVisionUpdate(vo_data, true, truth_data);
+      //Predict the state forward in time to the camera time and then apply the update.  If there isn't sufficient info
+      //to go all the way back (or the image is newer than the IMU), it is applied now, not with a negative dt!
+      double dt_1 = vo_data.Timestamp().toSec() - old_time;
+      //(a preintegrated packet can't be split, so the image goes at the start of its interval)
+      bool between = (dt_1 > 0 && next < count && p_queue_.at(next).deltaTime() <= 0.0); //VO should be applied between IMU timesteps
 
-    if (dt_1 > 0)
-    {
-      //Predict the state forward to the next IMU timestep (we did the vision update between IMU measurements)
-      tempimu = i_queue_.front();
-      tempalt = a_queue_.front();
-      start_at = 1; //the IMU packet to start at for the repropagation
-      double dt_2 = tempimu.header.stamp.toSec() - vo_data.Timestamp().toSec(); //second dt to the next IMU packet time
-      // This prediction will use the same values as the previous one did
-      prediction(mk_consts_->catchup_steps, dt_2,tempimu);
-      imuMeasurementUpdate(tempimu);  //complete the IMU measurement update at this timestep
+      if (between)
+        prediction(mk_consts_->catchup_steps, dt_1,tempimu);  //predict based on the gyros for dt_1 timespan
 
-#ifdef DETECT
-      altitudeMeasurementUpdate(&tempalt, false);
-#else
-      altitudeMeasurementUpdate(&tempalt);
-#endif
+      //
+      /// Process the visual odometry measurement update at the time the image was taken:
+      // This is done in the directVisionUpdate function (that way we don't the same code twice)
+      repropagating_ = false;
+      directVisionUpdate(vo_data, true, truth_data);
+      repropagating_ = true;
 
-      //update the state and covariance that are saved in the queue:
-      state_queue_.at(0).setState(x_);
-      state_queue_.at(0).setCovariance(P_);
-    }
-    else
-    {
-      start_at = 0; //the IMU packet to start at for the repropagation
+      if (between)
+      {
+        //Predict the state forward to the next IMU timestep (we did the vision update between IMU measurements)
+        // This prediction will use the same values as the previous one did
+        tempimu = i_queue_.at(next);
+        old_time = vo_data.Timestamp().toSec(); //second dt to the next IMU packet time
+        repropagateStep(next, old_time);
+        next++;
+      }
+
+      //
+      /// If this data is from a new node image, need to replace the states!
+      if (vo_data.NewReference())
+        declareNode(truth_data);
     }
+
     //
-    /// If this data is from a new node image, need to replace the states!
-    if (vo_data.NewReference())
+    /// Repropagate the rest of the IMU and altitude information back to current time
+    while (next < count)
     {
-      //create the edge
-      NavEdge newedge(x_, P_, node_id_incrementer_, node_id_incrementer_+1);
-      edge_queue_.push_back(newedge);
-      //create the new node
-      NavNode newnode(node_id_incrementer_+1);
-      node_id_incrementer_++; //increment to reflect the new current node
-
-      if(truth_data)
-        newnode.setTruePose(*truth_data);
-
-      //Find the global estimated position and orientation of the new node
-      global_node_position_ = global_node_position_ + global_R_yaw_ * newedge.getTranslation();
-      //Save the global estimates
-      Quaterniond temp(x_(6,0),x_(3,0),x_(4,0),x_(5,0));
-      newnode.setEstimatePosition(global_node_position_,global_yaw_,temp);
-      //update the global estimates for the next node
-      global_R_yaw_ = global_R_yaw_ * newedge.getR_curr_next().transpose();  //update the rotation matrix, the current rotation is used for the NEXT translation
-      global_yaw_ = global_yaw_ + newedge.getPsi_i();  //the angle applies to the next node!
-      //store the node
-      node_queue_.push_back(newnode);
-
-      //Augment and Marginalize the State and Covariance!
-      augmentMarginalize(saved_deltatheta_);
+      repropagateStep(next, old_time);
+      next++;
     }
+    repropagating_ = false;
+  }
+  else
+  {
+      //If the state queue is empty, just apply the camera updates at the current time:
+      ROS_INFO("NON-DELAYED UPDATE OCCURING!!! Not sufficient data or VO coming in very fast!");
+      for (int v = 0; v < (int)vo_batch.size(); v++)
+        directVisionUpdate(vo_batch[v],false,truth_data);
+  }
+}
 
-    //
-    /// Repropagate the IMU and altitude information back to current time
-    //
 
-    //Now, iterate through the IMU information in the queue and reapply it:
-    int count = (int)i_queue_.size();
-    double old_time = tempimu.header.stamp.toSec();
 
-    for (int i = start_at; i < count; i++)
-    {
-      tempimu = i_queue_.at(i);
-      tempalt = a_queue_.at(i);
-      double dt = tempimu.header.stamp.toSec() - old_time;
-      old_time = tempimu.header.stamp.toSec();
-      prediction(mk_consts_->catchup_steps, dt,tempimu);
-      imuMeasurementUpdate(tempimu);
+//
+//  Declare a new node at the current state
+//
+void Estimator::declareNode(TRUTH_message *truth_data)
+{
+  //create the edge
+  NavEdge newedge(x_, P_, node_id_incrementer_, node_id_incrementer_+1);
+  edge_queue_.push_back(newedge);
+  //create the new node
+  NavNode newnode(node_id_incrementer_+1);
+  node_id_incrementer_++; //increment to reflect the new current node
+
+  if(truth_data)
+    newnode.setTruePose(*truth_data);
+
+  //Find the global estimated position and orientation of the new node
+  global_node_position_ = global_node_position_ + global_R_yaw_ * newedge.getTranslation();
+  //Save the global estimates
+  Quaterniond temp(x_(6,0),x_(3,0),x_(4,0),x_(5,0));
+  newnode.setEstimatePosition(global_node_position_,global_yaw_,temp);
+  //update the global estimates for the next node
+  global_R_yaw_ = global_R_yaw_ * newedge.getR_curr_next().transpose();  //update the rotation matrix, the current rotation is used for the NEXT translation
+  global_yaw_ = global_yaw_ + newedge.getPsi_i();  //the angle applies to the next node!
+  //store the node
+  node_queue_.push_back(newnode);
+
+  //Augment and Marginalize the State and Covariance!
+  augmentMarginalize(saved_deltatheta_);
+}
+
+
+
+//
+//  Retrodicted (OOSM) vision update: fuse a delayed VO message at the current time, without repropagating
+//
+void Estimator::retrodictedVisionUpdate(VO_message &vo_data, TRUTH_message *truth_data)
+{
+  //The last packet saved before the image was taken (the one prepareQueuedItems() leaves at the front, for the first)
+  int count = (int)state_queue_.size();
+  int j = 0;
+  while (j + 1 < count && state_queue_.at(j + 1).getTime() <= vo_data.Timestamp())
+    j++;
+
+  if (j + 1 == count)
+  {
+    //The image is newer than the last IMU packet, so the current state is the one to update
+    directVisionUpdate(vo_data, true, truth_data);
+    return;
+  }
+
+  //Keep the current filter, the saved state is predicted to the image time in its place
+  Matrix<double,STATE_LENGTH,1> x_now = x_;
+  Matrix<double,COVAR_LENGTH,COVAR_LENGTH> P_now = P_;
+  Matrix<double,COVAR_LENGTH,COVAR_LENGTH> transition_now = transition_;
+  Vector3d gyros_now = saved_gyros_;
+  Vector3d deltatheta_now = saved_deltatheta_;
+  Vector3d deltaV_now = saved_deltaV_;
+
+  StatePacket tempstate = state_queue_.at(j);
+  IMU_message tempimu = i_queue_.at(j);
+  x_ = tempstate.getState();
+  P_ = tempstate.getCovariance();
+  transition_.setIdentity();
+
+  //approximate the prediction as in delayedVisionUpdate, using the gyros from this packet and zero delta values
+  saved_gyros_(0) = tempimu.angular_velocity.x;
+  saved_gyros_(1) = tempimu.angular_velocity.y;
+  saved_gyros_(2) = tempimu.angular_velocity.z;
+  saved_deltatheta_.setZero();
+  saved_deltaV_.setZero();
+
+  double dt_1 = vo_data.Timestamp().toSec() - tempstate.getTime().toSec();
+  if (dt_1 > 0)
+    prediction(mk_consts_->catchup_steps, dt_1, tempimu);
+
+  //The measurement at the image time, and the covariance of the state there with the current state:
+  Matrix<double,6,1> residual;
+  Matrix<double,6,COVAR_LENGTH> C_v;
+  Matrix<double,6,6> R_v;
+  visionMeasurement(vo_data, truth_data, residual, C_v, R_v);
+
+  //Its covariance with the packets: e_s = transition_*e_j + noise, so P_js = P_j*transition_'.  The later packets (and
+  //now) get e_s through the transitions after the image, e_i = F_i*...*F_j+1*inv(transition_)*e_s + noise after the
+  //image (independent of e_s), so that product times P_s is the covariance.  Each F_i holds the (I - L*C) of every
+  //update in its step as well as the prediction (see trackUpdate()).
+  Matrix<double,6,6> S = R_v + C_v * P_ * C_v.transpose();
+  Matrix<double,COVAR_LENGTH,6> PC_j = tempstate.getCovariance() * transition_.transpose() * C_v.transpose();
+  Matrix<double,COVAR_LENGTH,6> PC = transition_.partialPivLu().solve(P_ * C_v.transpose());
+
+  x_ = x_now;
+  P_ = P_now;
+  transition_ = transition_now;
+  saved_gyros_ = gyros_now;
+  saved_deltatheta_ = deltatheta_now;
+  saved_deltaV_ = deltaV_now;
+
+  recordInnovation<3>(VISION_SENSOR, 0, residual.head<3>(), S.topLeftCorner<3,3>());
+  recordInnovation<3>(VISION_SENSOR, 3, residual.tail<3>(), S.bottomRightCorner<3,3>());
+  if (excluded_sensor_ == VISION_SENSOR)
+    return; //only tested
+
+  Matrix<double,6,6> S_inverse = S.inverse();
+  Matrix<double,6,1> weighted = S_inverse * residual;
+
+  //The saved packets from j on take the measurement too, or the messages still to come (with older packets than
+  //now) would use it again
+  smoothPacket(state_queue_.at(j), PC_j, S_inverse, weighted);
+  for (int i = j + 1; i < count; i++)
+  {
+    PC = state_queue_.at(i).getTransition() * PC;
+    smoothPacket(state_queue_.at(i), PC, S_inverse, weighted);
+  }
+
+  //The update of the current state, both measurements at once.  It is an update of the current error too, for the
+  //messages still to come: its measurement projected on the current error is C = PC'*inv(P_), so the transition takes
+  //(I - L*C) like the other updates.  (Through the transitions since the image instead, the inverse of their updates
+  //is too badly conditioned.)
+  PC = transition_ * PC;
+  Matrix<double,COVAR_LENGTH,1> delta_x = PC * weighted;
+  Matrix<double,6,COVAR_LENGTH> C_now = P_.ldlt().solve(PC).transpose();
+  trackUpdate<6>(PC * S_inverse, C_now);
+  P_ = P_ - PC * S_inverse * PC.transpose();
+  P_ = 0.5 * (P_ + P_.transpose());
+  applyCorrection(delta_x);
+}
+
+
+
+//
+//  Correct a saved packet with a retrodicted vision measurement
+//
+void Estimator::smoothPacket(StatePacket &packet, const Matrix<double,COVAR_LENGTH,6> &PC,
+                             const Matrix<double,6,6> &S_inverse, const Matrix<double,6,1> &weighted)
+{
+  Matrix<double,STATE_LENGTH,1> x_now = x_;
+  Matrix<double,COVAR_LENGTH,COVAR_LENGTH> P = packet.getCovariance();
+  Matrix<double,COVAR_LENGTH,1> delta_x = PC * weighted;
+
+  //applyCorrection() works on x_, so the packet's state takes its place for the correction
+  x_ = packet.getState();
+  applyCorrection(delta_x);
+  packet.setState(x_);
+  x_ = x_now;
+
+  P = P - PC * S_inverse * PC.transpose();
+  P = 0.5 * (P + P.transpose());
+  packet.setCovariance(P);
+}
+
+
+
+//
+//  Reapply a queued IMU and altitude packet during the delayed update
+//
+void Estimator::repropagateStep(int i, double &old_time)
+{
+  IMU_message tempimu = i_queue_.at(i);
+  sensor_msgs::Range tempalt = a_queue_.at(i);
+  double dt = tempimu.header.stamp.toSec() - old_time;
+  old_time = tempimu.header.stamp.toSec();
+  if (p_queue_.at(i).deltaTime() > 0.0)
+    preintegratedPrediction(p_queue_.at(i)); //the interval is corrected for the new biases, not integrated again
+  else
+    prediction(mk_consts_->catchup_steps, dt,tempimu);
+  imuMeasurementUpdate(tempimu);
 
 #ifdef DETECT
-      altitudeMeasurementUpdate(&tempalt, false);
+  altitudeMeasurementUpdate(&tempalt, false);
 #else
-      altitudeMeasurementUpdate(&tempalt);
+  altitudeMeasurementUpdate(&tempalt);
 #endif
 
-      // Update the state & covariance packet during this repropagation so that the info is correct
-      state_queue_.at(i).setState(x_);
-      state_queue_.at(i).setCovariance(P_);
-    }
-  }
-  else
+  // Update the state & covariance packet during this repropagation so that the info is correct
+  state_queue_.at(i).setState(x_);
+  state_queue_.at(i).setCovariance(P_);
+  if(retrodict_)
   {
-      //If the state queue is empty, just apply the camera update at the current time:
-      ROS_INFO("NON-DELAYED UPDATE OCCURING!!! Not sufficient data or VO coming in very fast!");
-      directVisionUpdate(vo_data,false,truth_data);
+    state_queue_.at(i).setTransition(transition_);
+    transition_.setIdentity();
   }
 }
 
@@ -665,9 +816,9 @@ void Estimator::prediction(int N, double dt, IMU_message &imu_data)
     f_(4,0) = 0.5*(q*qw - r*qx + p*qz); //qydot
     f_(5,0) = 0.5*(r*qw + q*qx - p*qy); //qzdot
     f_(6,0) = 0.5*(-p*qx - q*qy -r*qz);  //qwdot
-    f_(7,0) = r*v - q*w + mk_consts_->g*2.0*(qx*qz - qy*qw) - mu_/mk_consts_->mass*u; //udot: corriolis + gravity + drag
-    f_(8,0) = p*w - r*u + mk_consts_->g*2.0*(qy*qz + qx*qw) - mu_/mk_consts_->mass*v; //vdot: corriolis + gravity + drag
-    f_(9,0) = q*u - p*v + mk_consts_->g*(qz*qz + qw*qw - qx*qx - qy*qy) + imu_data.linear_acceleration.z;
+    f_(7,0) = r*v - q*w + gravity_(2)*2.0*(qx*qz - qy*qw) - drag_*u; //udot: corriolis + gravity + drag
+    f_(8,0) = p*w - r*u + gravity_(2)*2.0*(qy*qz + qx*qw) - drag_*v; //vdot: corriolis + gravity + drag
+    f_(9,0) = q*u - p*v + gravity_(2)*(qz*qz + qw*qw - qx*qx - qy*qy) + imu_data.linear_acceleration.z;
               ///(mk_consts_->kF/mk_consts_->mass)*6.0*omega_h_*omega_h_; //wdot
 
 
@@ -683,12 +834,10 @@ void Estimator::prediction(int N, double dt, IMU_message &imu_data)
 
     //Used in the DeltaP equations:
     Vector3d v_hat(u,v,w);
-    Vector3d gravity(0,0,mk_consts_->g*1.0);
     Vector3d beta(x_(10,0),x_(11,0),x_(12,0));
     Vector3d omega(saved_gyros_(0),saved_gyros_(1),saved_gyros_(2));
     Quaterniond q_t(qw,qx,qy,qz);
-    Matrix3d MU;
-    MU << -mu_ ,0 ,0,0,-mu_,0,0,0,0;
+    Matrix3d drag = Vector3d(-drag_, -drag_, 0.0).asDiagonal();
 
     A_.setZero();
     //DeltaPdot
@@ -700,8 +849,8 @@ void Estimator::prediction(int N, double dt, IMU_message &imu_data)
     A_.block<3,3>(3,9) = -1.0*Matrix3d::Identity(); //d(delta theta dot)/d(delta beta)
 
     //DeltaVdot
-    A_.block<3,3>(6,3) = skew(q_t.toRotationMatrix()*gravity); //d(deltaV dot)/d(delta theta)
-    A_.block<3,3>(6,6) = -skew(omega - beta) + MU/(mk_consts_->mass*1.0); //d(deltaV dot)/d(deltaV)
+    A_.block<3,3>(6,3) = skew(q_t.toRotationMatrix()*gravity_); //d(deltaV dot)/d(delta theta)
+    A_.block<3,3>(6,6) = -skew(omega - beta) + drag; //d(deltaV dot)/d(deltaV)
     A_.block<3,3>(6,9) = skew(v_hat); //d(deltaV dot)/d(delta beta)
 
     //
@@ -714,7 +863,13 @@ void Estimator::prediction(int N, double dt, IMU_message &imu_data)
 
     // Propagate the state and covariance:
     x_ = x_ + (dt/(double)N)*f_;
-    P_ = P_ + (dt/(double)N)*(A_*P_ + P_*A_.transpose() + Q_ + 1.0*mk_consts_->gamma*B_*G_*B_.transpose());
+    P_ = P_ + (dt/(double)N)*(A_*P_ + P_*A_.transpose() + Q_ + B_*G_gamma_*B_.transpose());
+    if(retrodict_)
+    {
+      //only rows 0-8 and columns 3-11 of A_ are filled (above)
+      Matrix<double,9,COVAR_LENGTH> step = (dt/(double)N)*A_.block<9,9>(0,3)*transition_.block<9,COVAR_LENGTH>(3,0);
+      transition_.block<9,COVAR_LENGTH>(0,0) += step;
+    }
 
     //May need this:
     normalizeQuaternion();
@@ -722,6 +877,183 @@ void Estimator::prediction(int N, double dt, IMU_message &imu_data)
 }
 
 
+
+//
+// Preintegrated Prediction: jump the state and covariance across an interval
+//
+void Estimator::preintegratedPrediction(const ImuPreintegration &preintegration)
+{
+  if(preintegration.deltaTime() <= 0.0)
+    return;
+
+  Matrix<double,STATE_LENGTH,1> x_end;
+  Matrix<double,COVAR_LENGTH,COVAR_LENGTH> F;
+  Matrix<double,COVAR_LENGTH,9> G_delta;
+  preintegratedJacobians(x_, preintegration, x_end, F, G_delta);
+
+  // Propagate the state and covariance (Q_ is the same process noise prediction() adds over the interval):
+  x_ = x_end;
+  P_ = F*P_*F.transpose() + G_delta*preintegration.covariance()*G_delta.transpose() + preintegration.deltaTime()*Q_;
+  P_ = 0.5*(P_ + P_.transpose());
+  if(retrodict_)
+    transition_ = F*transition_;
+
+  normalizeQuaternion();
+}
+
+
+
+//
+// The state at the end of a preintegrated interval and the Jacobians of the jump
+//
+void Estimator::preintegratedJacobians(const Matrix<double,STATE_LENGTH,1> &x, const ImuPreintegration &preintegration,
+                                       Matrix<double,STATE_LENGTH,1> &x_end, Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &F,
+                                       Matrix<double,COVAR_LENGTH,9> &G_delta)
+{
+  //The jump is a function of the error state and the noise of the deltas, so its Jacobians are taken numerically
+  //(central differences, the error of the step is well below the covariance)
+  const double step = 1e-5;
+  Matrix<double,STATE_LENGTH,1> x_start = x;
+  Matrix<double,STATE_LENGTH,1> x_now = x_; //applyCorrection() works on x_
+  Matrix<double,9,1> noise = Matrix<double,9,1>::Zero();
+  x_end = preintegratedState(x_start, preintegration, noise);
+
+  for(int k = 0; k < COVAR_LENGTH; k++)
+  {
+    Matrix<double,COVAR_LENGTH,1> delta_x = Matrix<double,COVAR_LENGTH,1>::Zero();
+    delta_x(k) = step;
+    x_ = x_start;
+    applyCorrection(delta_x);
+    Matrix<double,COVAR_LENGTH,1> plus = stateDifference(preintegratedState(x_, preintegration, noise), x_end);
+
+    delta_x(k) = -step;
+    x_ = x_start;
+    applyCorrection(delta_x);
+    Matrix<double,COVAR_LENGTH,1> minus = stateDifference(preintegratedState(x_, preintegration, noise), x_end);
+    F.col(k) = (plus - minus)/(2.0*step);
+  }
+
+  for(int k = 0; k < 9; k++)
+  {
+    noise(k) = step;
+    Matrix<double,COVAR_LENGTH,1> plus = stateDifference(preintegratedState(x_start, preintegration, noise), x_end);
+    noise(k) = -step;
+    Matrix<double,COVAR_LENGTH,1> minus = stateDifference(preintegratedState(x_start, preintegration, noise), x_end);
+    noise(k) = 0.0;
+    G_delta.col(k) = (plus - minus)/(2.0*step);
+  }
+
+  x_ = x_now;
+}
+
+
+
+//
+// Preintegrate IMU samples and apply them in one prediction
+//
+void Estimator::batchPrediction(std::vector<IMU_message> &samples, double &old_time, ImuPreintegration &preintegration)
+{
+  preintegration = startPreintegration(x_);
+
+  Vector3d gyro = saved_gyros_;
+  for(int i = 0; i < (int)samples.size(); i++)
+  {
+    IMU_message &sample = samples[i];
+    double dt = sample.header.stamp.toSec() - old_time;
+    if(dt > 1000)
+      dt = 0.d; //for the first time through
+    old_time = sample.header.stamp.toSec();
+
+    Vector3d accel(sample.linear_acceleration.x, sample.linear_acceleration.y, sample.linear_acceleration.z);
+    preintegration.integrate(gyro, accel, dt);
+    gyro = Vector3d(sample.angular_velocity.x, sample.angular_velocity.y, sample.angular_velocity.z);
+  }
+
+  preintegratedPrediction(preintegration);
+  saved_gyros_ = gyro;
+  saved_deltatheta_.setZero();
+  saved_deltaV_.setZero();
+}
+
+
+
+//
+// A new interval, with the sensor noise and the biases of a state
+//
+ImuPreintegration Estimator::startPreintegration(const Matrix<double,STATE_LENGTH,1> &x)
+{
+  ImuPreintegration preintegration(G_, accel_covariance_);
+  preintegration.reset(Vector3d(x(10,0),x(11,0),x(12,0)), Vector3d(x(13,0),x(14,0),0.0));
+  return preintegration;
+}
+
+
+//
+// The state at the end of a preintegrated interval
+//
+Matrix<double,STATE_LENGTH,1> Estimator::preintegratedState(const Matrix<double,STATE_LENGTH,1> &x,
+                                                           const ImuPreintegration &preintegration,
+                                                           const Matrix<double,9,1> &noise)
+{
+  //            [0 1 2 3  4  5  6  7 8 9 10 11 12 13 14   15  16  17  18  19 20 21]
+  // state x_ = [f r d qx qy qz qw u v w bp bq br ax ay | cqx cqy cqz cqw cx cy cz]
+  Vector3d gyro_bias(x(10,0),x(11,0),x(12,0));
+  Vector3d accel_bias(x(13,0),x(14,0),0.0);
+  Matrix3d delta_R = preintegration.correctedDeltaR(gyro_bias)*ImuPreintegration::expMap(noise.segment<3>(0));
+  Vector3d delta_v = preintegration.correctedDeltaV(gyro_bias, accel_bias) + noise.segment<3>(3);
+  Vector3d delta_p = preintegration.correctedDeltaP(gyro_bias, accel_bias) + noise.segment<3>(6);
+  double T = preintegration.deltaTime();
+
+  Quaterniond q(x(6,0),x(3,0),x(4,0),x(5,0));
+  Matrix3d R = q.toRotationMatrix(); //body to node frame (as in the position equations of prediction())
+  Vector3d v_node = R*x.block<3,1>(7,0);
+
+  Matrix<double,STATE_LENGTH,1> x_end = x;
+  x_end.block<3,1>(0,0) += v_node*T + 0.5*gravity_*T*T + R*delta_p;
+  v_node += gravity_*T + R*delta_v;
+
+  Quaterniond q_end = q*Quaterniond(delta_R); //R_end = R*delta_R
+  q_end.normalize();
+  x_end(3,0) = q_end.x();
+  x_end(4,0) = q_end.y();
+  x_end(5,0) = q_end.z();
+  x_end(6,0) = q_end.w();
+  x_end.block<3,1>(7,0) = q_end.toRotationMatrix().transpose()*v_node; //back to the body frame
+  return x_end;
+}
+
+
+
+//
+// The error state between two states (the inverse of applyCorrection)
+//
+Matrix<double,COVAR_LENGTH,1> Estimator::stateDifference(const Matrix<double,STATE_LENGTH,1> &x1,
+                                                        const Matrix<double,STATE_LENGTH,1> &x0)
+{
+  Matrix<double,COVAR_LENGTH,1> delta_x;
+
+  //applyCorrection does q1 = deltaq*q0, and deltaq has the half angle in its vector part:
+  Quaterniond deltaq = Quaterniond(x1(6,0),x1(3,0),x1(4,0),x1(5,0))*Quaterniond(x0(6,0),x0(3,0),x0(4,0),x0(5,0)).inverse();
+  if(deltaq.w() < 0)
+    deltaq.coeffs() = -deltaq.coeffs();
+
+  delta_x.block<3,1>(0,0) = x1.block<3,1>(0,0) - x0.block<3,1>(0,0);
+  delta_x.block<3,1>(3,0) = 2.0*deltaq.vec();
+  delta_x.block<8,1>(6,0) = x1.block<8,1>(7,0) - x0.block<8,1>(7,0);
+
+  if(STATE_LENGTH > 15)
+  {
+    //estimating calibration:
+    deltaq = Quaterniond(x1(18,0),x1(15,0),x1(16,0),x1(17,0))*Quaterniond(x0(18,0),x0(15,0),x0(16,0),x0(17,0)).inverse();
+    if(deltaq.w() < 0)
+      deltaq.coeffs() = -deltaq.coeffs();
+    delta_x.block<3,1>(14,0) = 2.0*deltaq.vec();
+    delta_x.block<3,1>(17,0) = x1.block<3,1>(19,0) - x0.block<3,1>(19,0);
+  }
+  return delta_x;
+}
+
+
 //
 // IMU measurement update:
 //
@@ -754,13 +1086,13 @@ void Estimator::imuMeasurementUpdate(IMU_message &imu_data)
 //  C_i(1,11) = -x_(7,0);
 //  C_i(1,13) = 1; //for accel y bias
 
-  h_i(0) = -mu_/mk_consts_->mass*x_(7,0) + x_(13,0);
-  h_i(1) = -mu_/mk_consts_->mass*x_(8,0) + x_(14,0);
+  h_i(0) = -drag_*x_(7,0) + x_(13,0);
+  h_i(1) = -drag_*x_(8,0) + x_(14,0);
 
   //Populate C_i, the Jacobian of h_i w.r.t. delta_x
-  C_i(0,6) = -mu_/mk_consts_->mass; //for u
+  C_i(0,6) = -drag_; //for u
   C_i(0,12) = 1; //for accel x bias
-  C_i(1,7) = -mu_/mk_consts_->mass; //for v
+  C_i(1,7) = -drag_; //for v
   C_i(1,13) = 1; //for accel y bias
 
   residual(0) = imu_data.linear_acceleration.x - h_i(0);
@@ -770,15 +1102,21 @@ void Estimator::imuMeasurementUpdate(IMU_message &imu_data)
   Matrix2d S;
   S.setZero();
   S = (R_i_ + C_i * P_ * C_i.transpose());
-  L_i = P_ * C_i.transpose() * S.inverse();
 
-  //Calc the error state & update the covariance
-  delta_x = L_i * residual;
-  P_ = (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_i * C_i) * P_*
-      (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_i * C_i).transpose() + L_i * R_i_ * L_i.transpose();
+  recordInnovation(ACCEL_SENSOR, 0, residual, S);
+  if(excluded_sensor_ != ACCEL_SENSOR) //else only tested, delta_x stays zero for the next prediction
+  {
+    L_i = P_ * C_i.transpose() * S.inverse();
 
-  //Update the state
-  applyCorrection(delta_x);
+    //Calc the error state & update the covariance
+    delta_x = L_i * residual;
+    P_ = (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_i * C_i) * P_*
+        (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_i * C_i).transpose() + L_i * R_i_ * L_i.transpose();
+    trackUpdate(L_i, C_i);
+
+    //Update the state
+    applyCorrection(delta_x);
+  }
 
   //use these gyros for the next prediction
   saved_gyros_(0) = imu_data.angular_velocity.x;
@@ -829,7 +1167,12 @@ void Estimator:: altitudeMeasurementUpdate(sensor_msgs::Range *alt_data, bool no
   }
 
   double residual = measurement_a - x_(2,0);
-  double R_a2 = R_a_*more_uncertainty*mk_consts_->alt_inflate;
+  double R_a2 = R_a_inflated_*more_uncertainty;
+
+  recordInnovation(ALTITUDE_SENSOR, residual, R_a2 + P_(2,2));
+  if(excluded_sensor_ == ALTITUDE_SENSOR)
+    return; //only tested
+
   // Calculate the Kalman gain
   L_a = P_ * C_a.transpose() * (1.d / (R_a2 + P_(2, 2)));
 
@@ -837,6 +1180,7 @@ void Estimator:: altitudeMeasurementUpdate(sensor_msgs::Range *alt_data, bool no
   delta_x = L_a * residual;
   P_ = (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_a * C_a) * P_*
       (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_a * C_a).transpose() + L_a * R_a2 * L_a.transpose();
+  trackUpdate(L_a, C_a);
 
   //Update the state
   applyCorrection(delta_x);
@@ -862,7 +1206,7 @@ void Estimator:: altitudeMeasurementUpdate(sensor_msgs::Range *alt_data, bool no
   d_apriori_ = x_(2) + node_position(2);
 
 //  double predicted_measurement = (-(x_(2) + node_position(2))-mk_consts_->delta_x_las*sin(theta_current)-mk_consts_->delta_z_las*cos(theta_current))/(cos(theta_current)*cos(phi_current)) - mk_consts_->las_bias;
-  double predicted_measurement = -d_apriori_ - mk_consts_->delta_z_las + mk_consts_->las_bias;
+  double predicted_measurement = -d_apriori_ + laser_offset_;
 //  C_a(0,2) = -1/std::pow(-(4*std::pow(qw*qy - qx*qz, 2) - 1)/(std::pow(2*qw*qy - 2*qx*qz, 2)/std::pow(2*qw*qw + 2*qz*qz - 1, 2) + 1), 1.0/2);
 
 //  C_a(0,3) = (2*mk_consts_->delta_x_las*qz - (4*mk_consts_->delta_z_las*qz*(qw*qy - qx*qz))/std::pow(1 - 4*std::pow(qw*qy - qx*qz, 2), 1.0/2))/std::pow(-(4*std::pow(qw*qy - qx*qz, 2) - 1)/(std::pow(2*qw*qy - 2*qx*qz, 2)/std::pow(2*qw*qw + 2*qz*qz - 1, 2) + 1), 1.0/2) + (((8*qz*(qw*qy - qx*qz))/(std::pow(2*qw*qy - 2*qx*qz, 2)/std::pow(2*qw*qw + 2*qz*qz - 1, 2) + 1) - (4*qz*(4*std::pow(qw*qy - qx*qz, 2) - 1)*(2*qw*qy - 2*qx*qz))/(std::pow(std::pow(2*qw*qy - 2*qx*qz, 2)/std::pow(2*qw*qw + 2*qz*qz - 1, 2) + 1, 2)*std::pow(2*qw*qw + 2*qz*qz - 1, 2)))*(x_(2) + node_position(2) + mk_consts_->delta_z_las*std::pow(1 - 4*std::pow(qw*qy - qx*qz, 2), 1.0/2) + 2*mk_consts_->delta_x_las*(qw*qy - qx*qz)))/(2*std::pow(-(4*std::pow(qw*qy - qx*qz, 2) - 1)/(std::pow(2*qw*qy - 2*qx*qz, 2)/std::pow(2*qw*qw + 2*qz*qz - 1, 2) + 1), 3.0/2));
@@ -892,117 +1236,30 @@ void Estimator:: altitudeMeasurementUpdate(sensor_msgs::Range *alt_data, bool no
   //////////////////////////////////////
   // OUTLIER REJECTION
   //////////////////////////////////////
-
-  if (measurement_a >= mk_consts_->failed_return_distance || measurement_a <= alt_data->min_range)
-  {
-      //Then it is an outlier
-      fault_flag_ += 4;
-  }
-
-
-  //////////////////////////////////////
-  // TEST OF MEAN
-  //////////////////////////////////////
-
-  //add the current normalized residual to the deque of normalized residuals for windowed analysis
-  residual_queue_.push_back(residual_normalized_);
-
-  //remove elements which are outside the current window of data
-  if (residual_queue_.size() > mk_consts_->window_size)
-  {
-      residual_queue_.pop_front();
-  }
-
-  std::deque<double>::iterator it;
-  for (it = residual_queue_.begin(); it != residual_queue_.end(); it++)
-  {
-      window_mean_ += *it;
-  }
-  window_mean_ = window_mean_/residual_queue_.size();
-
-  //Determine the mean statistic
-  mean_statistic_ = residual_queue_.size()*window_mean_*window_mean_; //This works for the scalar case, but would need to be chaged for the vector case
-
-  //Determine the threshold
-  boost::math::chi_squared stat_distro_mean(1);//The dofs would increase for the vector case
-
-  threshold_mean_ = mk_consts_->threshold_mean_inflate*quantile(stat_distro_mean, 1-mk_consts_->prob_false_allow);
-
-  //Compare to threshold
-  if (mean_statistic_ >= threshold_mean_)
-  {
-      fault_flag_ += 1;
-  }
-
+  bool outlier = (measurement_a >= failed_return_distance_ || measurement_a <= alt_data->min_range);
 
   //////////////////////////////////////
-  // TEST OF COVARIANCE
+  // TESTS OF MEAN AND COVARIANCE, and if it is a sensor failure rather than noise (see FaultDetector)
   //////////////////////////////////////
+  fault_flag_ = laser_detector_->update(residual_normalized_, outlier);
 
-  //Compute the Covariance
-  for(it = residual_queue_.begin(); it !=residual_queue_.end(); it++)
-  {
-      window_covariance_ += std::pow(*it - window_mean_, 2);
-  }
-  if(residual_queue_.size() > 1)
-  {
-    window_covariance_ = window_covariance_/(residual_queue_.size()-1);
-  }
-
-  //Determine the covariance statistic
-  covariance_statistic_ = (residual_queue_.size()-1)*window_covariance_; //really (N-1)*trace(S)
-  //Determine the threshold
-  if (residual_queue_.size() > 1)
-  {
-      boost::math::chi_squared covariance_distro(residual_queue_.size()-1);//if vector, need to multiply this dof with dim of vector
-      threshold_covariance_ = mk_consts_->threshold_covariance_inflate*quantile(covariance_distro, 1-mk_consts_->prob_false_allow);
-  }
-  else
-  {
-      threshold_covariance_ = 0.000000000000001;
-  }
-
+  window_mean_ = laser_detector_->mean();
+  mean_statistic_ = laser_detector_->meanStatistic();
+  threshold_mean_ = laser_detector_->meanThreshold();
+  window_covariance_ = laser_detector_->covariance();
+  covariance_statistic_ = laser_detector_->covarianceStatistic();
+  threshold_covariance_ = laser_detector_->covarianceThreshold();
+  num_window_faults_ = laser_detector_->windowFaults();
+  sensor_failure_ = laser_detector_->sensorFailure();
 
-  //Compare to threshold
-  if (covariance_statistic_ >= threshold_covariance_)
-  {
-      fault_flag_ += 2;
-  }
-
-  //////////////////////////////////////////////////////////
-  //////////////////////////////////////////////////////////
-  // Determine if it is a sensor failure rather than noise
-  //////////////////////////////////////////////////////////
-  //////////////////////////////////////////////////////////
-  flag_queue_.push_back(fault_flag_);
-
-  if (flag_queue_.size() > mk_consts_->window_size)
-  {
-    flag_queue_.pop_front();
   }
+#endif
+  double R_a2 = R_a_inflated_;
 
-  std::deque<int>::iterator iter;
-  for(iter = flag_queue_.begin(); iter != flag_queue_.end(); iter++)
-  {
-    if(*iter != 0)
-      num_window_faults_ += 1.d;
-  }
+  recordInnovation(ALTITUDE_SENSOR, residual_a_, R_a2 + P_(2,2));
+  if(excluded_sensor_ == ALTITUDE_SENSOR)
+    return; //only tested
 
-  if(flag_queue_.size() == mk_consts_->window_size)
-  {
-    if(num_window_faults_>=6.0)
-      sensor_failure_ = true;
-    else
-      sensor_failure_ = false;
-  }
-  else
-  {
-    sensor_failure_ = false;
-  }
-
-  }
-#endif
-  double R_a2 = R_a_*mk_consts_->alt_inflate;
   // Calculate the Kalman gain
   L_a = P_ * C_a.transpose() * (1.d / (R_a2 + P_(2, 2)));
 
@@ -1010,6 +1267,7 @@ void Estimator:: altitudeMeasurementUpdate(sensor_msgs::Range *alt_data, bool no
   delta_x = L_a * residual_a_;
   P_ = (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_a * C_a) * P_*
       (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_a * C_a).transpose() + L_a * R_a2 * L_a.transpose();
+  trackUpdate(L_a, C_a);
 
   //Update the state
   applyCorrection(delta_x);
@@ -1058,7 +1316,12 @@ void Estimator:: altitudeMeasurementUpdate(sensor_msgs::Range *alt_data)
   }
 
   double residual = measurement_a - x_(2,0);
-  double R_a2 = R_a_*more_uncertainty*mk_consts_->alt_inflate;
+  double R_a2 = R_a_inflated_*more_uncertainty;
+
+  recordInnovation(ALTITUDE_SENSOR, residual, R_a2 + P_(2,2));
+  if(excluded_sensor_ == ALTITUDE_SENSOR)
+    return; //only tested
+
   // Calculate the Kalman gain
   L_a = P_ * C_a.transpose() * (1.d / (R_a2 + P_(2, 2)));
 
@@ -1066,6 +1329,7 @@ void Estimator:: altitudeMeasurementUpdate(sensor_msgs::Range *alt_data)
   delta_x = L_a * residual;
   P_ = (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_a * C_a) * P_*
       (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_a * C_a).transpose() + L_a * R_a2 * L_a.transpose();
+  trackUpdate(L_a, C_a);
 
   //Update the state
   applyCorrection(delta_x);
@@ -1090,12 +1354,17 @@ void Estimator:: altitudeMeasurementUpdate(sensor_msgs::Range *alt_data)
   d_apriori_ = x_(2) + node_position(2);
 
 //  double predicted_measurement = (-(x_(2) + node_position(2))-mk_consts_->delta_x_las*sin(theta_current)-mk_consts_->delta_z_las*cos(theta_current))/(cos(theta_current)*cos(phi_current)) - mk_consts_->las_bias;
-  double predicted_measurement = -d_apriori_ - mk_consts_->delta_z_las + mk_consts_->las_bias;
+  double predicted_measurement = -d_apriori_ + laser_offset_;
   C_a(0,2) = -1.d;
 
   residual_a_ = measurement_a - predicted_measurement;
 
-  double R_a2 = R_a_*mk_consts_->alt_inflate;
+  double R_a2 = R_a_inflated_;
+
+  recordInnovation(ALTITUDE_SENSOR, residual_a_, R_a2 + P_(2,2));
+  if(excluded_sensor_ == ALTITUDE_SENSOR)
+    return; //only tested
+
   // Calculate the Kalman gain
   L_a = P_ * C_a.transpose() * (1.d / (R_a2 + P_(2, 2)));
 
@@ -1103,6 +1372,7 @@ void Estimator:: altitudeMeasurementUpdate(sensor_msgs::Range *alt_data)
   delta_x = L_a * residual_a_;
   P_ = (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_a * C_a) * P_*
       (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_a * C_a).transpose() + L_a * R_a2 * L_a.transpose();
+  trackUpdate(L_a, C_a);
 
   //Update the state
   applyCorrection(delta_x);
@@ -1114,10 +1384,42 @@ void Estimator:: altitudeMeasurementUpdate(sensor_msgs::Range *alt_data)
 
 
 
+//
+// The altitude measurement of a state (the models of altitudeMeasurementUpdate)
+//
+bool Estimator::altitudeMeasurement(const sensor_msgs::Range &alt_data, const Matrix<double,STATE_LENGTH,1> &x,
+                                    double &residual, Matrix<double,1,COVAR_LENGTH> &C_a, double &variance)
+{
+  if(fabs(alt_data.range) <= 0.00000001)
+    return false;
+
+  NavNode current(0);
+  current = node_queue_.back(); //last node in queue is the one we are navigating w/ respect to
+  Vector3d node_position = current.getEstimatePosition();
+  C_a.setZero();
+
+#ifndef LASER
+  double more_uncertainty = 1.0;
+  if(node_position(2) >= -0.30)
+    more_uncertainty = 20.0; //When we are below this height, the altimeter measurements can be pretty incorrect.
+
+  residual = alt_data.range - node_position(2) - x(2,0);
+  C_a(0,2) = 1.d;
+  variance = R_a_inflated_*more_uncertainty;
+#else
+  residual = alt_data.range - (-(x(2,0) + node_position(2)) + laser_offset_);
+  C_a(0,2) = -1.d;
+  variance = R_a_inflated_;
+#endif
+  return true;
+}
+
+
+
 //
 // Save data in the queues
 //
-void Estimator::saveData(IMU_message &imu_data, sensor_msgs::Range *alt_data)
+void Estimator::saveData(IMU_message &imu_data, sensor_msgs::Range *alt_data, const ImuPreintegration *preintegration)
 {
   sensor_msgs::Range alt_packet;
   if(alt_data == NULL)
@@ -1131,7 +1433,17 @@ void Estimator::saveData(IMU_message &imu_data, sensor_msgs::Range *alt_data)
 
   i_queue_.push_back(imu_data);
   a_queue_.push_back(alt_packet);
+  if(preintegration == NULL)
+    p_queue_.push_back(ImuPreintegration()); //zero length, predicted one sample at a time
+  else
+    p_queue_.push_back(*preintegration);
   StatePacket temp(x_,P_,imu_data.header.stamp);
+  if(retrodict_)
+  {
+    //the transition from the previous packet, the next one starts over
+    temp.setTransition(transition_);
+    transition_.setIdentity();
+  }
   state_queue_.push_back(temp);
 }
 
@@ -1222,6 +1534,28 @@ geometry_msgs::TransformStamped Estimator::computeGlobalPoseEstimate(ros::Time s
 }
 
 
+
+//
+// The true position relative to the current node
+//
+bool Estimator::relativeTruePosition(TRUTH_message &truth_data, Vector3d &position)
+{
+  NavNode current(0);
+  current = node_queue_.back();
+  if(!current.TruthSet())
+    return false;
+
+  Vector3d true_pos(truth_data.transform.translation.x, truth_data.transform.translation.y,
+                    truth_data.transform.translation.z);
+  Matrix3d psi;
+  psi << cos(current.getTrueYaw()),sin(current.getTrueYaw()),0,-sin(current.getTrueYaw()),cos(current.getTrueYaw()),
+      0,0,0,1;
+  position = psi*(true_pos - current.getTruePosition());//relative truth, in node frame
+  return true;
+}
+
+
+
 //
 // Write the log:
 //
@@ -1236,10 +1570,9 @@ void Estimator::writeToLog(IMU_message &imu_data, geometry_msgs::TransformStampe
   w = 0.d;
   int num = 0;
   int new_node = 0;
-  Vector3d true_pos,true_rel;
+  Vector3d true_rel;
   Quaterniond true_angle;
   true_rel.setZero();
-  true_pos.setZero();
   true_angle.setIdentity();
 
   if(alt_data != NULL)
@@ -1257,22 +1590,12 @@ void Estimator::writeToLog(IMU_message &imu_data, geometry_msgs::TransformStampe
   }
   if(truth_data != NULL)
   {
-    true_pos(0) = truth_data->transform.translation.x;
-    true_pos(1) = truth_data->transform.translation.y;
-    true_pos(2) = truth_data->transform.translation.z;
-
     true_angle.x() = truth_data->transform.rotation.x;
     true_angle.y() = truth_data->transform.rotation.y;
     true_angle.z() = truth_data->transform.rotation.z;
     true_angle.w() = truth_data->transform.rotation.w;
     //Calc the true relative information:
-    if(current.TruthSet())
-    {
-      Matrix3d psi;
-      psi << cos(current.getTrueYaw()),sin(current.getTrueYaw()),0,-sin(current.getTrueYaw()),cos(current.getTrueYaw()),
-          0,0,0,1;
-      true_rel = psi*(true_pos - current.getTruePosition());//relative truth, in node frame
-    }
+    relativeTruePosition(*truth_data, true_rel);
   }
 
   log_file_.precision(20);
@@ -1517,10 +1840,11 @@ rel_MEKF::relative_state Estimator::packageStateInMessage(ros::Time timestamp)
 //
 //  Pack up the node global state
 //
-geometry_msgs::TransformStamped Estimator::packageCurrentNode(ros::Time timestamp, std::string &global_name, std::string &base_name)
+geometry_msgs::TransformStamped Estimator::packageCurrentNode(ros::Time timestamp, std::string &global_name, std::string &base_name,
+                                                             int previous)
 {
   NavNode new_node(0);
-  new_node = node_queue_.back();
+  new_node = node_queue_.at(node_queue_.size() - 1 - previous);
   Vector3d position;
   Quaterniond q;
   position = new_node.getEstimatePosition();
@@ -1545,13 +1869,13 @@ geometry_msgs::TransformStamped Estimator::packageCurrentNode(ros::Time timestam
 //
 //  Pack up the edge
 //
-rel_MEKF::edge Estimator::packageCurrentEdge(ros::Time timestamp)
+rel_MEKF::edge Estimator::packageCurrentEdge(ros::Time timestamp, int previous)
 {
   rel_MEKF::edge edge;
   NavEdge temp;
   std::string name1 = "node_";
   Vector3d pos;
-  temp = edge_queue_.back();
+  temp = edge_queue_.at(edge_queue_.size() - 1 - previous);
   pos = temp.getTranslation();
   char buffer[20];
   sprintf(buffer,"node_%d",temp.getFromID());
@@ -1572,11 +1896,11 @@ rel_MEKF::edge Estimator::packageCurrentEdge(ros::Time timestamp)
 
 
 //
-// Direct vision update - contains the code to process the vision measurement.  Called during the delayed update or
-//  directly if there isn't much of a delay on the vo data.
+// The vision measurement model: the residuals, Jacobians and noise of the VO translation and rotation, at the current
+//  state.  Used by the direct and the retrodicted vision updates.
 //
-void Estimator::directVisionUpdate(VO_message &vo_data, bool override_keyframe,
-                                   TRUTH_message *truth_data)
+void Estimator::visionMeasurement(VO_message &vo_data, TRUTH_message *truth_data, Matrix<double,6,1> &residual,
+                                  Matrix<double,6,COVAR_LENGTH> &C_v, Matrix<double,6,6> &R_v)
 {
   //  The state is transformed into the current camera frame to take the innovation.
   //            [0 1 2 3  4  5  6  7 8 9 10 11 12 13 14   15  16  17  18  19 20 21]
@@ -1642,15 +1966,10 @@ void Estimator::directVisionUpdate(VO_message &vo_data, bool override_keyframe,
   //Rotation:
   q_cr_c = q_camera_to_body*q_node_to_body.conjugate()*q_node_x*q_camera_to_body.conjugate();
 
-  /// Now do the update with the data expressed in the right reference frame
-  /// First the position update:
+  /// The position measurement:
   Vector3d residualP;
-  Matrix<double,COVAR_LENGTH,1> delta_xP; // the error state, computed in the measurement update
   Matrix<double,3,COVAR_LENGTH> C_vP; // the Jacobian of the h_v_ w.r.t. the state
-  Matrix<double,COVAR_LENGTH,3> L_vP; // the Kalman gain for the vision measurement update
-  delta_xP.setZero();
   C_vP.setZero();
-  L_vP.setZero();
 
   residualP = vo_data.Translation() - T_c; // camera x
 
@@ -1688,26 +2007,7 @@ void Estimator::directVisionUpdate(VO_message &vo_data, bool override_keyframe,
   R_voP(0,0)*=1.0;//0.5;
   R_voP*=1.0*mk_consts_->camera_x_inflate;
 
-  // Calculate the Kalman gain
-  Matrix3d S;
-  S.setZero();
-  S = (R_voP + C_vP * P_ * C_vP.transpose());
-  L_vP = P_ * C_vP.transpose() * S.inverse();
-
-  //Calc the error state & update the covariance
-  delta_xP = L_vP * residualP;
-  P_ = (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_vP * C_vP) * P_*
-      (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_vP * C_vP).transpose() + L_vP * R_voP * L_vP.transpose();
-  //Update the state
-  applyCorrection(delta_xP);
-
-  //DEBUG: For performing VO updates separetly
-  bool apply_q = true;
-
-  if(apply_q)
-  {
-  //*******************************************************************************************
-  /// Apply the rotation update:
+  /// The rotation measurement:
   Vector4d vq_cr_c(q_cr_c_measured.x(),q_cr_c_measured.y(),q_cr_c_measured.z(),q_cr_c_measured.w());
   Matrix<double,3,4> gammaT; //use this matrix to rotate the measured vector into the form needed
   gammaT.block<3,3>(0,0) = Matrix<double,3,3>::Identity()*q_cr_c.w() - skew(q_cr_c.vec());
@@ -1716,12 +2016,8 @@ void Estimator::directVisionUpdate(VO_message &vo_data, bool override_keyframe,
   Matrix3d R_voQ;
   double gain = mk_consts_->camera_qx_inflate;
 
-  Matrix<double,COVAR_LENGTH,1> delta_xQ; // the error state, computed in the measurement update
   Matrix<double,3,COVAR_LENGTH> C_vQ; // the Jacobian of the h_v_ w.r.t. the state
-  Matrix<double,COVAR_LENGTH,3> L_vQ; // the Kalman gain for the vision measurement update
-  delta_xQ.setZero();
   C_vQ.setZero();
-  L_vQ.setZero();
 
   /// Begin Roumeliotis Method:
   Matrix3d onesQ;
@@ -1773,20 +2069,93 @@ void Estimator::directVisionUpdate(VO_message &vo_data, bool override_keyframe,
   /// End ETH Method
 
 
+  residual << residualP, residualQ;
+  C_v.topRows<3>() = C_vP;
+  C_v.bottomRows<3>() = C_vQ;
+  R_v.setZero();
+  R_v.topLeftCorner<3,3>() = R_voP;
+  R_v.bottomRightCorner<3,3>() = R_voQ;
+}
+
+
+
+//
+// Direct vision update - contains the code to process the vision measurement.  Called during the delayed update or
+//  directly if there isn't much of a delay on the vo data.
+//
+void Estimator::directVisionUpdate(VO_message &vo_data, bool override_keyframe,
+                                   TRUTH_message *truth_data)
+{
+  //Both residuals are taken with the state before the update (see visionMeasurement())
+  Matrix<double,6,1> residual;
+  Matrix<double,6,COVAR_LENGTH> C_v;
+  Matrix<double,6,6> R_v;
+  visionMeasurement(vo_data, truth_data, residual, C_v, R_v);
+
+  /// First the position update:
+  Vector3d residualP = residual.head<3>();
+  Matrix<double,COVAR_LENGTH,1> delta_xP; // the error state, computed in the measurement update
+  Matrix<double,3,COVAR_LENGTH> C_vP = C_v.topRows<3>(); // the Jacobian of the h_v_ w.r.t. the state
+  Matrix<double,COVAR_LENGTH,3> L_vP; // the Kalman gain for the vision measurement update
+  delta_xP.setZero();
+  L_vP.setZero();
+  Matrix3d R_voP = R_v.topLeftCorner<3,3>();
+
+  // Calculate the Kalman gain
+  Matrix3d S;
+  S.setZero();
+  S = (R_voP + C_vP * P_ * C_vP.transpose());
+
+  recordInnovation(VISION_SENSOR, 0, residualP, S);
+  if(excluded_sensor_ != VISION_SENSOR) //else only tested (the rotation residual is taken with the same state)
+  {
+  L_vP = P_ * C_vP.transpose() * S.inverse();
+
+  //Calc the error state & update the covariance
+  delta_xP = L_vP * residualP;
+  P_ = (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_vP * C_vP) * P_*
+      (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_vP * C_vP).transpose() + L_vP * R_voP * L_vP.transpose();
+  trackUpdate(L_vP, C_vP);
+  //Update the state
+  applyCorrection(delta_xP);
+  }
+
+  //DEBUG: For performing VO updates separetly
+  bool apply_q = true;
+
+  if(apply_q)
+  {
+  //*******************************************************************************************
+  /// Apply the rotation update:
+  Vector3d residualQ = residual.tail<3>();
+  Matrix3d R_voQ = R_v.bottomRightCorner<3,3>();
+
+  Matrix<double,COVAR_LENGTH,1> delta_xQ; // the error state, computed in the measurement update
+  Matrix<double,3,COVAR_LENGTH> C_vQ = C_v.bottomRows<3>(); // the Jacobian of the h_v_ w.r.t. the state
+  Matrix<double,COVAR_LENGTH,3> L_vQ; // the Kalman gain for the vision measurement update
+  delta_xQ.setZero();
+  L_vQ.setZero();
+
   /// Apply the Update:
   // Calculate the Kalman gain
   Matrix3d Sq;
   Sq.setZero();
   Sq = (R_voQ + C_vQ* P_ * C_vQ.transpose());
+
+  recordInnovation(VISION_SENSOR, 3, residualQ, Sq);
+  if(excluded_sensor_ != VISION_SENSOR)
+  {
   L_vQ = P_ * C_vQ.transpose() * Sq.inverse();
 
   //Calc the error state & update the covariance
   delta_xQ = L_vQ * residualQ;
   P_ = (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_vQ * C_vQ) * P_*
       (MatrixXd::Identity(COVAR_LENGTH,COVAR_LENGTH) - L_vQ * C_vQ).transpose() + L_vQ * R_voQ * L_vQ.transpose();
+  trackUpdate(L_vQ, C_vQ);
   //std::cout << P_ << std::endl;
   //Update the state
   applyCorrection(delta_xQ);
+  }
 
 
   //DEBUG:
@@ -1873,9 +2242,27 @@ void Estimator::augmentMarginalize(Vector3d &delta_quat)
   //As the covariance is in the reduced form, the procedure is slightly different.  The same equations are used, but
   //for the error quaternion.  As we are dealing with the error quaternion, I eliminated 2nd order terms (terms of the
   //error quaternion multiplying other error quaternion terms).  We are also zeroing out the position information.
+  Matrix<double,3,2> J = resetJacobian(delta_quat);
+  resetCovariance(P_, J);
+
+  //The same reset for the error state transition: the position rows are zeroed and the attitude rows are J times the
+  //old dqx, dqy rows
+  if(retrodict_)
+  {
+    Matrix<double,3,COVAR_LENGTH> attitude = J*transition_.block<2,COVAR_LENGTH>(3,0);
+    transition_.block<6,COVAR_LENGTH>(0,0).setZero();
+    transition_.block<3,COVAR_LENGTH>(3,0) = attitude;
+  }
+}
+
 
-  Matrix<double,6,COVAR_LENGTH> A;
-  A.setZero();
+
+//
+//  The non-zero block of the Jacobian of the keyframe reset
+//
+Matrix<double,3,2> Estimator::resetJacobian(const Vector3d &delta_quat)
+{
+  Matrix<double,3,2> J;
 
   //Common terms for the derivatives:
   double asiny,atanx,x,y;
@@ -1884,29 +2271,62 @@ void Estimator::augmentMarginalize(Vector3d &delta_quat)
   asiny = 0.5*asin(y);
   atanx = 0.5*atan2(x,1);
 
-  // Jacobian of the change w.r.t. delta theta
-  A(3,3) = -0.5*cos(asiny)*cos(atanx)/(x*x + 1);
-  A(3,4) = -0.5*sin(asiny)*sin(atanx)/sqrt(1-y*y);
-  A(4,3) = 0.5*sin(asiny)*sin(atanx)/(x*x + 1);
-  A(4,4) = 0.5*cos(asiny)*cos(atanx)/sqrt(1-y*y);
-  A(5,3) = 0.5*sin(asiny)*cos(atanx)/(x*x + 1);
-  A(5,4) = -0.5*cos(asiny)*sin(atanx)/sqrt(1-y*y);
+  // Jacobian of the change w.r.t. delta theta (rows dqx dqy dqz, columns dqx dqy)
+  J(0,0) = -0.5*cos(asiny)*cos(atanx)/(x*x + 1);
+  J(0,1) = -0.5*sin(asiny)*sin(atanx)/sqrt(1-y*y);
+  J(1,0) = 0.5*sin(asiny)*sin(atanx)/(x*x + 1);
+  J(1,1) = 0.5*cos(asiny)*cos(atanx)/sqrt(1-y*y);
+  J(2,0) = 0.5*sin(asiny)*cos(atanx)/(x*x + 1);
+  J(2,1) = -0.5*cos(asiny)*sin(atanx)/sqrt(1-y*y);
+
+  return J;
+}
+
+
+
+//
+//  Apply the keyframe reset to the covariance, in place
+//
+void Estimator::resetCovariance(Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &P, const Matrix<double,3,2> &J)
+{
+  //The full Jacobian A is 6xCOVAR_LENGTH, but only J (rows 3-5, columns 3-4) is non-zero, so A*P*A' only touches the
+  //first 6 rows and columns: the positions are zeroed and the attitude rows become J times the old dqx, dqy rows.
+  const int rest = COVAR_LENGTH - 6;
+
+  //from the old rows, before they are overwritten:
+  Matrix<double,3,rest> cross = J*P.block<2,rest>(3,6);
+  Matrix3d center = J*P.block<2,2>(3,3)*J.transpose();
+
+  P.block<6,COVAR_LENGTH>(0,0).setZero();
+  P.block<COVAR_LENGTH,6>(0,0).setZero();
+  P.block<3,rest>(3,6) = cross;
+  P.block<rest,3>(6,3) = cross.transpose();
+  P.block<3,3>(3,3) = center;
+}
+
+
+
+//
+//  The keyframe reset with the full Jacobian
+//
+void Estimator::resetCovarianceDense(Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &P, const Matrix<double,3,2> &J)
+{
+  Matrix<double,6,COVAR_LENGTH> A;
+  A.setZero();
+  A.block<3,2>(3,3) = J;
 
   //Replace the Covariance:
   Matrix<double,6,6> center;
   Matrix<double,6,COVAR_LENGTH> right;
   Matrix<double,COVAR_LENGTH,6> left;
-  center.setZero();
-  right.setZero();
-  left.setZero();
 
-  center = A*P_*A.transpose();
-  right = A*P_;
-  left = P_.transpose()*A.transpose();
+  center = A*P*A.transpose();
+  right = A*P;
+  left = P.transpose()*A.transpose();
 
-  P_.topLeftCorner(6,COVAR_LENGTH) = right;
-  P_.topLeftCorner(COVAR_LENGTH,6) = left;
-  P_.topLeftCorner(6,6) = center;
+  P.topLeftCorner(6,COVAR_LENGTH) = right;
+  P.topLeftCorner(COVAR_LENGTH,6) = left;
+  P.topLeftCorner(6,6) = center;
 }
 
 
@@ -1943,6 +2363,22 @@ std::string Estimator::timeStructFilename(tm *time_struct)
 }
 
 
+//
+// Return the oldest innovation of a sensor (once)
+//
+int Estimator::innovation(int sensor, Eigen::Matrix<double,6,1> &whitened)
+{
+  if(innovations_[sensor].empty())
+    return 0;
+
+  int length = innovation_lengths_[sensor].front();
+  whitened = innovations_[sensor].front();
+  innovations_[sensor].pop_front();
+  innovation_lengths_[sensor].pop_front();
+  return length;
+}
+
+
 //
 // Apply the delta_state correction to the current state
 //
@@ -2258,6 +2694,8 @@ void Estimator::applyCorrection(Eigen::Matrix<double, COVAR_LENGTH,1> &delta_x)
   //}
 }
 
+}
+
 
 
 
@@ -0,0 +1,375 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file estimator_bank.cpp
+ *  \author agent
+ *  \date October 2026
+*/
+
+
+#include "rel_estimator/estimator_bank.h"
+
+namespace rel_MEKF
+{
+
+//
+// BankStep Constructor: copy the loop's data
+//
+BankStep::BankStep(const std::vector<IMU_message> &imu_samples, sensor_msgs::Range *alt_data, const VO_batch &vo_batch,
+                   TRUTH_message *truth_data, Hex_message *hex_data): imu(imu_samples), vo(vo_batch)
+{
+  //the altitude goes with the last sample, unless the server pairs it with another
+  alt_index = -1;
+  if(alt_data != NULL)
+  {
+    alt = *alt_data;
+    alt_index = (int)imu.size() - 1;
+  }
+
+  has_truth = (truth_data != NULL);
+  if(has_truth)
+    truth = *truth_data;
+
+  has_hex = (hex_data != NULL);
+  if(has_hex)
+    hex = *hex_data;
+
+  startup = true;
+  just_landed = false;
+}
+
+
+
+//
+// Constructor: start the hypotheses
+//
+EstimatorBank::EstimatorBank(Constants *mk_const)
+{
+  isolated_ = -1;
+  running_ = true;
+  normal_steps_ = mk_const->normal_steps;
+  dropped_steps_ = 0;
+
+  for(int sensor = 0; sensor < Estimator::SENSOR_COUNT; sensor++)
+  {
+    //the estimators delete their constants, so each gets a copy (and they aren't logged)
+    estimators_[sensor] = new Estimator(new Constants(*mk_const), false);
+    estimators_[sensor]->excludeSensor(sensor);
+
+    //the innovations are whitened, so the tests aren't inflated
+    for(int tested = 0; tested < Estimator::SENSOR_COUNT; tested++)
+    {
+      detectors_[sensor][tested] = new FaultDetector(innovationLength(tested), mk_const->bank_window_size,
+                                                     mk_const->bank_prob_false_allow, 1.0, 1.0,
+                                                     mk_const->bank_failure_count);
+      failed_[sensor][tested] = false;
+    }
+    stalled_[sensor] = false;
+  }
+
+  for(int sensor = 0; sensor < Estimator::SENSOR_COUNT; sensor++)
+  {
+    threads_[sensor] = boost::thread(&EstimatorBank::work, this, sensor);
+  }
+
+  ROS_INFO("Estimator bank started: one filter without each of the accelerometer, %s, and visual odometry.",
+           sensorName(Estimator::ALTITUDE_SENSOR));
+}
+
+
+
+//
+// Destructor: stop the threads
+//
+EstimatorBank::~EstimatorBank()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    running_ = false;
+  }
+  posted_.notify_all();
+
+  for(int sensor = 0; sensor < Estimator::SENSOR_COUNT; sensor++)
+  {
+    threads_[sensor].join();
+    delete estimators_[sensor];
+    for(int tested = 0; tested < Estimator::SENSOR_COUNT; tested++)
+      delete detectors_[sensor][tested];
+  }
+}
+
+
+
+//
+// Queue a loop of data for the hypotheses
+//
+void EstimatorBank::post(const boost::shared_ptr<const BankStep> &step)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    for(int sensor = 0; sensor < Estimator::SENSOR_COUNT; sensor++)
+    {
+      //a hypothesis that fell too far behind can't skip the steps it missed, so it waits for the next startup
+      if(stalled_[sensor] && !step->startup)
+        continue;
+
+      if((int)queues_[sensor].size() >= MAX_QUEUE_)
+      {
+        dropped_steps_ += (int)queues_[sensor].size();
+        queues_[sensor].clear();
+        stalled_[sensor] = true;
+        for(int tested = 0; tested < Estimator::SENSOR_COUNT; tested++)
+          failed_[sensor][tested] = false;
+        if(isolated_ == sensor)
+          isolated_ = -1;
+        ROS_ERROR("Estimator bank: the filter without the %s fell %d steps behind, it is stopped until the estimator "
+                  "starts up again (%d steps dropped so far).", sensorName(sensor), MAX_QUEUE_, dropped_steps_);
+        if(!step->startup)
+          continue;
+      }
+
+      queues_[sensor].push_back(step);
+    }
+  }
+  posted_.notify_all();
+}
+
+
+
+//
+// The isolated sensor
+//
+int EstimatorBank::isolatedSensor()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  bool stalled = false;
+  for(int sensor = 0; sensor < Estimator::SENSOR_COUNT; sensor++)
+    stalled = stalled || stalled_[sensor];
+
+  //the isolation needs every hypothesis
+  if(isolated_ < 0 && !stalled)
+  {
+    //the sensor fails in the hypothesis without it, which is consistent with the other sensors, and the hypotheses
+    //that use it are contaminated
+    int candidates = 0, candidate = -1;
+    for(int sensor = 0; sensor < Estimator::SENSOR_COUNT; sensor++)
+    {
+      bool consistent = failed_[sensor][sensor];
+      for(int hypothesis = 0; hypothesis < Estimator::SENSOR_COUNT; hypothesis++)
+      {
+        bool contaminated = false;
+        for(int tested = 0; tested < Estimator::SENSOR_COUNT; tested++)
+        {
+          if(tested != sensor && failed_[sensor][tested])
+            consistent = false;
+          if(failed_[hypothesis][tested])
+            contaminated = true;
+        }
+        if(hypothesis != sensor && !contaminated)
+          consistent = false;
+      }
+
+      if(consistent)
+      {
+        candidates++;
+        candidate = sensor;
+      }
+    }
+
+    //two sensors with the same measurement (a bias in the height) can't be told apart, so don't guess
+    if(candidates == 1)
+      isolated_ = candidate;
+    else if(candidates > 1)
+      ROS_WARN_THROTTLE(1.0, "ESTIMATOR BANK: The sensors disagree but the faulty one can't be isolated.");
+
+    if(isolated_ >= 0)
+    {
+      ROS_ERROR("ESTIMATOR BANK: THE %s IS FAULTY! Publishing the estimate without it.", sensorName(isolated_));
+    }
+  }
+
+  return isolated_;
+}
+
+
+
+//
+// The state of the hypothesis without the isolated sensor
+//
+bool EstimatorBank::isolatedState(rel_MEKF::relative_state &state)
+{
+  int sensor = isolatedSensor();
+  if(sensor < 0)
+    return false;
+
+  boost::mutex::scoped_lock lock(mutex_);
+  state = states_[sensor];
+  return true;
+}
+
+
+
+//
+// Sensor names
+//
+const char* EstimatorBank::sensorName(int sensor)
+{
+  switch(sensor)
+  {
+  case Estimator::ACCEL_SENSOR:
+    return "accelerometer";
+  case Estimator::ALTITUDE_SENSOR:
+#ifdef LASER
+    return "laser";
+#else
+    return "altimeter";
+#endif
+  case Estimator::VISION_SENSOR:
+    return "visual odometry";
+  default:
+    return "unknown sensor";
+  }
+}
+
+
+
+//
+// Innovation lengths
+//
+int EstimatorBank::innovationLength(int sensor)
+{
+  switch(sensor)
+  {
+  case Estimator::ACCEL_SENSOR:
+    return 2; //x and y
+  case Estimator::ALTITUDE_SENSOR:
+    return 1;
+  default:
+    return 6; //position and rotation
+  }
+}
+
+
+
+//
+// The thread of a hypothesis
+//
+void EstimatorBank::work(int sensor)
+{
+  while(true)
+  {
+    boost::shared_ptr<const BankStep> step;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      while(running_ && queues_[sensor].empty())
+        posted_.wait(lock);
+
+      if(!running_)
+        return;
+
+      step = queues_[sensor].front();
+      queues_[sensor].pop_front();
+    }
+
+    process(sensor, *step);
+  }
+}
+
+
+
+//
+// Run a hypothesis through one loop (the same as the main filter in ROSServer::Run())
+//
+void EstimatorBank::process(int sensor, const BankStep &step)
+{
+  Estimator *estimator = estimators_[sensor];
+
+  //the estimator functions take references, so the shared data is copied out
+  IMU_message imu_data = step.imu.back();
+  sensor_msgs::Range alt = step.alt;
+  TRUTH_message truth = step.truth;
+  TRUTH_message *truth_data = step.has_truth ? &truth : NULL;
+
+  if(step.startup)
+    estimator->startup_flag_ = true; //follow the server (it sets the flag when we've landed)
+  estimator->just_landed_ = step.just_landed;
+
+  if(estimator->startup_flag_)
+  {
+    Hex_message hex = step.hex;
+    estimator->Initialize(imu_data, step.has_hex ? &hex : NULL, step.alt_index >= 0 ? &alt : NULL, truth_data);
+
+    //a new flight, a new chance for the sensors
+    boost::mutex::scoped_lock lock(mutex_);
+    for(int tested = 0; tested < Estimator::SENSOR_COUNT; tested++)
+    {
+      detectors_[sensor][tested]->reset();
+      failed_[sensor][tested] = false;
+    }
+    if(isolated_ == sensor)
+      isolated_ = -1;
+    stalled_[sensor] = false;
+    return;
+  }
+
+  //vision first, it's delayed (the innovation of each image of the batch is tested)
+  if(!step.vo.empty())
+  {
+    VO_batch vo = step.vo;
+    estimator->prepareQueuedItems(vo.front().Timestamp());
+    estimator->delayedVisionUpdate(vo, truth_data);
+    testInnovations(sensor);
+  }
+
+  for(int i = 0; i < (int)step.imu.size() && i < (int)step.dt.size(); i++)
+  {
+    IMU_message sample = step.imu[i];
+    sensor_msgs::Range *alt_now = (i == step.alt_index) ? &alt : NULL;
+
+    estimator->prediction(normal_steps_, step.dt[i], sample);
+    estimator->imuMeasurementUpdate(sample);
+    testInnovations(sensor);
+
+#ifdef DETECT
+    estimator->altitudeMeasurementUpdate(alt_now, true);
+#else
+    estimator->altitudeMeasurementUpdate(alt_now);
+#endif
+    testInnovations(sensor);
+
+    estimator->saveData(sample, alt_now);
+  }
+
+  rel_MEKF::relative_state state = estimator->packageStateInMessage(imu_data.header.stamp);
+  boost::mutex::scoped_lock lock(mutex_);
+  states_[sensor] = state;
+}
+
+
+
+//
+// Test a hypothesis' new innovations
+//
+void EstimatorBank::testInnovations(int sensor)
+{
+  for(int tested = 0; tested < Estimator::SENSOR_COUNT; tested++)
+  {
+    FaultDetector *detector = detectors_[sensor][tested];
+    Eigen::Matrix<double,6,1> whitened;
+    int length;
+    while((length = estimators_[sensor]->innovation(tested, whitened)) != 0)
+    {
+      ROS_ASSERT(length == innovationLength(tested));
+      detector->update(whitened.data(), false);
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    if(!stalled_[sensor])
+      failed_[sensor][tested] = detector->sensorFailure();
+  }
+}
+
+}
@@ -0,0 +1,768 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*! \file estimator_montecarlo.cpp
+  * \author agent
+  * \date October 2026
+  * \brief estimator_montecarlo.cpp runs the Estimator on many simulated flights at once and tests the consistency of
+  * its covariance (NEES) and of its innovations (NIS), to tune the noise parameters in Constants without flying.
+  *
+  * Usage:
+  * \code
+  *   estimator_montecarlo [--runs 200] [--threads <cores>] [--duration 30] [--vo_rate 15] [--vo_delay 0.07]
+  *                        [--vo_position_std 0.02] [--vo_rotation_std 0.002] [--seed 1] [--constants <file>]
+  *                        [--oosm]
+  * \endcode
+  *
+  * Each run is a flight with its own random inputs, noise and initial state, on its own Estimator, and the runs are
+  * split between the threads.  A run starts with a takeoff pulse (like a flight) until the filter starts, then the true
+  * state is drawn from the initial estimate and its covariance.  The truth is integrated with the equations of motion
+  * of Estimator::prediction() (the drag model, with the accz as the input) in small steps, with the gyros of the last
+  * sample held across each interval like the filter does.  The body rates come from random sinusoidal angles, and the
+  * accz is the thrust of a height controller that climbs to a random height and moves around it.
+  *
+  * The IMU runs at 100 Hz, the altitude at a third of that, and the VO is taken at IMU samples (--vo_rate) and applied
+  * --vo_delay later, the same way the ROSServer main loop applies it (prepareQueuedItems() and delayedVisionUpdate()
+  * with every VO message that arrived since the last loop).  The sensors are simulated with the noise of the
+  * Constants (the VO with the options above), and the VO is always relative to the first node (no keyframes).  The
+  * Constants of both the simulation and the filter are the defaults, or loaded from the --constants file (the same
+  * "name: value" lines as the parameters under ~constants, see Constants::loadFile()).  With --oosm the filters fuse the
+  * VO with the OOSM update (see Estimator::useRetrodiction()), to check its consistency against the rollback.
+  *
+  * Every 0.1 s the NEES (the error times the inverse covariance times the error) of the position, attitude, velocity
+  * and biases, and of the whole error state, is taken.  Averaged over the runs (the ANEES) it should stay within the
+  * two-sided 95% chi-square bounds of its dimension, and the table gives its mean, the bounds and how much of the
+  * flight it was inside them.  The NIS of each sensor is the squared norm of its whitened innovation (see
+  * Estimator::innovation()), and its mean over all the updates of all the runs is tested the same way.  The percent of
+  * single NIS above the 95% quantile should be near 5.  (The vision innovation is whitened by position and rotation
+  * separately, so its NIS leaves out their cross-covariance.)
+  *
+  * A run whose NEES isn't finite at some time has diverged.  The ANEES is then given both without the diverged runs and
+  * with them (a NEES or NIS that isn't finite counts as infinite, so those times are outside the bounds), and the check
+  * fails (exits non-zero).  The NIS is always over all the runs that started.
+  *
+  * The wall time, the CPU time of a run and the speedup of the threads (the CPU time of all the runs over the wall
+  * time) are printed last.
+*/
+
+#include <ros/ros.h>
+#include <boost/bind.hpp>
+#include <boost/math/distributions/chi_squared.hpp>
+#include <boost/math/special_functions/fpclassify.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <string>
+#include <vector>
+#include "rel_estimator/estimator.h"
+#include "rel_estimator/eigen_utils.h"
+
+using namespace rel_MEKF;
+
+
+static const double IMU_RATE = 100.0; //!< the rate of the simulated IMU (Hz)
+static const int TRUTH_STEPS = 10; //!< the truth is integrated in this many steps between IMU samples
+static const int ALT_PERIOD = 3; //!< an altitude measurement every this many IMU samples
+static const int NEES_PERIOD = 10; //!< the NEES is taken every this many IMU samples
+static const int STARTUP_SAMPLES = 100; //!< the run fails if the filter hasn't started after this many samples
+static const double TAKEOFF_ACCZ = -10.6; //!< the accz of the takeoff pulse (below Estimator::ACCZ_THRESHOLD_)
+static const double TAKEOFF_RANGE = 0.5; //!< the laser range of the takeoff (above the laser startup height)
+static const double HEIGHT_KP = 4.0; //!< the gains of the height controller (on the down position and velocity)
+static const double HEIGHT_KD = 3.0;
+static const double CLIMB_TIME = 3.0; //!< the time to climb to the flight height (s)
+static const double CONFIDENCE = 0.95; //!< of the chi-square bounds
+static const int BLOCK_COUNT = 5; //!< the parts of the error state the NEES is taken of
+static const int BLOCK_START[BLOCK_COUNT] = {0, 3, 6, 9, 0};
+static const int BLOCK_LENGTH[BLOCK_COUNT] = {3, 3, 3, 5, COVAR_LENGTH};
+static const char *BLOCK_NAME[BLOCK_COUNT] = {"position", "attitude", "velocity", "biases", "full_state"};
+#ifndef LASER
+static const char *SENSOR_NAME[Estimator::SENSOR_COUNT] = {"accelerometer", "altimeter", "visual_odometry"};
+#else
+static const char *SENSOR_NAME[Estimator::SENSOR_COUNT] = {"accelerometer", "laser", "visual_odometry"};
+#endif
+
+typedef Eigen::Matrix<double,STATE_LENGTH,1> State;
+typedef boost::variate_generator<boost::mt19937&, boost::normal_distribution<> > NormalGenerator;
+typedef boost::variate_generator<boost::mt19937&, boost::uniform_real<> > UniformGenerator;
+
+
+/*!
+ *  \class MonteCarloEstimator
+ *  \brief The Estimator, with its state, covariance, drag and error state open to the harness
+*/
+class MonteCarloEstimator : public Estimator
+{
+public:
+  MonteCarloEstimator(Constants *mk_const): Estimator(mk_const, false) {}
+
+  const State& state() const {return x_;}
+  const Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH>& covariance() const {return P_;}
+  double drag() const {return mu_;}
+  static Eigen::Matrix<double,COVAR_LENGTH,1> error(const State &truth, const State &estimate)
+  {
+    return stateDifference(truth, estimate);
+  }
+};
+
+
+/*!
+ *  \struct MonteCarloOptions
+ *  \brief The options of the harness (see the usage above)
+*/
+struct MonteCarloOptions
+{
+  MonteCarloOptions(): runs(200), threads(std::max(1, (int)boost::thread::hardware_concurrency())), duration(30.0),
+    vo_rate(15.0), vo_delay(0.07), vo_position_std(0.02), vo_rotation_std(0.002), seed(1), oosm(false) {}
+
+  int runs;
+  int threads;
+  double duration; //!< of a flight, after the filter starts (s)
+  double vo_rate; //!< (Hz)
+  double vo_delay; //!< from the image to its VO message (s)
+  double vo_position_std; //!< of the VO translation (m)
+  double vo_rotation_std; //!< of the VO rotation (rad)
+  unsigned int seed;
+  bool oosm; //!< fuse the VO with the OOSM update (Estimator::useRetrodiction()) instead of repropagating
+  Constants constants; //!< of the simulation and of every filter
+};
+
+
+/*!
+ *  \struct RunResult
+ *  \brief The statistics of one run
+*/
+struct RunResult
+{
+  RunResult(): started(false), diverged(false), seconds(0.0)
+  {
+    for(int i = 0; i < Estimator::SENSOR_COUNT; i++)
+      nis_length[i] = 0;
+  }
+
+  std::vector<double> nees[BLOCK_COUNT]; //!< every NEES_PERIOD samples after the filter started
+  std::vector<double> nis[Estimator::SENSOR_COUNT]; //!< every update of each sensor
+  int nis_length[Estimator::SENSOR_COUNT]; //!< the dimension of the innovations of each sensor
+  bool started; //!< false if the filter never started
+  bool diverged; //!< true if the NEES wasn't finite at some time (the run fails the check)
+  double seconds; //!< the CPU time of the run
+};
+
+
+/*!
+ *  \struct Flight
+ *  \brief The random inputs of a flight: each body rate is the rate of a sum of sinusoidal angles (so the attitude
+ *  stays near level), and the height climbs to a random height and moves around it with a sinusoid
+*/
+struct Flight
+{
+  Flight(UniformGenerator &uniform)
+  {
+    for(int axis = 0; axis < 3; axis++)
+    {
+      double amplitude = axis < 2 ? 0.1 : 0.3; //rad
+      for(int i = 0; i < 2; i++)
+      {
+        angle_amplitude[axis][i] = amplitude*(2.0*uniform() - 1.0);
+        angle_frequency[axis][i] = 2.0*M_PI*(0.1 + 0.4*uniform());
+      }
+    }
+    height = 0.7 + 0.6*uniform();
+    height_amplitude = 0.3*uniform();
+    height_frequency = 2.0*M_PI*(0.05 + 0.15*uniform());
+  }
+
+  //the body rates at a time of the flight (the angles are a*(1 - cos(f*t)), so the rates start at zero)
+  Eigen::Vector3d rates(double t) const
+  {
+    Eigen::Vector3d omega;
+    for(int axis = 0; axis < 3; axis++)
+    {
+      omega(axis) = 0.0;
+      for(int i = 0; i < 2; i++)
+        omega(axis) += angle_amplitude[axis][i]*angle_frequency[axis][i]*sin(angle_frequency[axis][i]*t);
+    }
+    return omega;
+  }
+
+  //the reference for the down position
+  double downReference(double t) const
+  {
+    double climb = std::min(1.0, t/CLIMB_TIME);
+    return -climb*(height + height_amplitude*sin(height_frequency*t));
+  }
+
+  double angle_amplitude[3][2];
+  double angle_frequency[3][2];
+  double height;
+  double height_amplitude;
+  double height_frequency;
+};
+
+
+/*!
+ *  \brief The derivative of the true state, the equations of motion of Estimator::prediction() with the true rates
+*/
+static State derivative(const State &x, const Eigen::Vector3d &omega, double accel_z, double drag,
+                        const Constants &consts)
+{
+  double p = omega(0), q = omega(1), r = omega(2);
+  double qx = x(3), qy = x(4), qz = x(5), qw = x(6);
+  double u = x(7), v = x(8), w = x(9);
+
+  State f = State::Zero(); //the biases (and the calibration) are constant
+  f(0) = u*(qx*qx + qw*qw - qy*qy - qz*qz) + v*2.0*(qx*qy - qz*qw) + w*2.0*(qx*qz + qy*qw);
+  f(1) = u*2.0*(qx*qy + qz*qw) + v*(qy*qy + qw*qw - qx*qx -qz*qz) + w*2.0*(qy*qz - qx*qw);
+  f(2) = u*2.0*(qx*qz - qy*qw) + v*2.0*(qy*qz + qx*qw) + w*(qz*qz + qw*qw - qx*qx - qy*qy);
+  f(3) = 0.5*(p*qw + r*qy - q*qz);
+  f(4) = 0.5*(q*qw - r*qx + p*qz);
+  f(5) = 0.5*(r*qw + q*qx - p*qy);
+  f(6) = 0.5*(-p*qx - q*qy -r*qz);
+  f(7) = r*v - q*w + consts.g*2.0*(qx*qz - qy*qw) - drag/consts.mass*u;
+  f(8) = p*w - r*u + consts.g*2.0*(qy*qz + qx*qw) - drag/consts.mass*v;
+  f(9) = q*u - p*v + consts.g*(qz*qz + qw*qw - qx*qx - qy*qy) + accel_z;
+  return f;
+}
+
+
+/*!
+ *  \brief The accz (specific force) of the height controller, which drives the down position to its reference
+*/
+static double heightControl(const State &x, const Eigen::Vector3d &omega, double down_reference,
+                            const Constants &consts)
+{
+  double p = omega(0), q = omega(1);
+  double qx = x(3), qy = x(4), qz = x(5), qw = x(6);
+  double w_dot = HEIGHT_KP*(down_reference - x(2)) - HEIGHT_KD*x(9);
+  return w_dot - (q*x(7) - p*x(8) + consts.g*(qz*qz + qw*qw - qx*qx - qy*qy));
+}
+
+
+/*!
+ *  \brief Integrates the true state across an IMU interval, with the rates and the accz held
+*/
+static void propagateTruth(State &truth, const Eigen::Vector3d &omega, double accel_z, double dt, double drag,
+                           const Constants &consts)
+{
+  for(int i = 0; i < TRUTH_STEPS; i++)
+  {
+    truth += (dt/TRUTH_STEPS)*derivative(truth, omega, accel_z, drag, consts);
+    truth.segment<4>(3).normalize();
+  }
+}
+
+
+/*!
+ *  \brief Draws the true state from the estimate and its covariance (the attitude error is applied like
+ *  Estimator::applyCorrection() applies a correction)
+*/
+static State drawTruth(const MonteCarloEstimator &estimator, NormalGenerator &normal)
+{
+  Eigen::Matrix<double,COVAR_LENGTH,1> draw;
+  for(int i = 0; i < COVAR_LENGTH; i++)
+    draw(i) = normal();
+  Eigen::Matrix<double,COVAR_LENGTH,1> error = estimator.covariance().llt().matrixL()*draw;
+
+  State truth = estimator.state();
+  truth.segment<3>(0) += error.segment<3>(0);
+  Eigen::Quaterniond q(truth(6), truth(3), truth(4), truth(5));
+  Eigen::Vector3d theta = error.segment<3>(3);
+  q = quaternionFromSmallAngle(theta)*q;
+  q.normalize();
+  truth(3) = q.x();
+  truth(4) = q.y();
+  truth(5) = q.z();
+  truth(6) = q.w();
+  truth.segment<8>(7) += error.segment<8>(6);
+  return truth;
+}
+
+
+/*!
+ *  \brief Simulates an IMU sample of the truth
+*/
+static IMU_message imuSample(double t, const State &truth, const Eigen::Vector3d &omega, double accel_z, double drag,
+                             const Constants &consts, NormalGenerator &normal)
+{
+  IMU_message imu;
+  imu.header.stamp = ros::Time(t);
+  imu.angular_velocity.x = omega(0) + truth(10) + consts.gyrox_std*normal();
+  imu.angular_velocity.y = omega(1) + truth(11) + consts.gyroy_std*normal();
+  imu.angular_velocity.z = omega(2) + truth(12) + consts.gyroz_std*normal();
+  imu.linear_acceleration.x = -drag/consts.mass*truth(7) + truth(13) + consts.accel_x_std*normal();
+  imu.linear_acceleration.y = -drag/consts.mass*truth(8) + truth(14) + consts.accel_y_std*normal();
+  imu.linear_acceleration.z = accel_z + consts.accel_z_std*normal();
+  return imu;
+}
+
+
+/*!
+ *  \brief Simulates an altitude measurement of the truth (the models of Estimator::altitudeMeasurement(), with the
+ *  first node at the origin)
+*/
+static sensor_msgs::Range altitudeSample(double t, const State &truth, const Constants &consts,
+                                         NormalGenerator &normal)
+{
+  sensor_msgs::Range alt;
+  alt.header.stamp = ros::Time(t);
+#ifndef LASER
+  alt.range = truth(2) + consts.alt_std*normal();
+#else
+  alt.range = -truth(2) - consts.delta_z_las + consts.las_bias + consts.alt_std*normal();
+#endif
+  return alt;
+}
+
+
+/*!
+ *  \brief Simulates the VO of an image (the model of Estimator::visionMeasurement(), with the first node level at the
+ *  origin).  The rotation noise is a small angle on the rotation, and the covariance of the message holds the noise.
+*/
+static VO_message visionSample(double t, int seq, const State &truth, const MonteCarloOptions &options,
+                               const Constants &consts, NormalGenerator &normal)
+{
+  Eigen::Quaterniond q_camera_to_body = consts.q_camera_to_body;
+  Eigen::Vector3d T_body = consts.T_camera_to_body;
+  if(STATE_LENGTH > 15)
+  {
+    q_camera_to_body = Eigen::Quaterniond(truth(18), truth(15), truth(16), truth(17));
+    T_body << truth(19), truth(20), truth(21);
+  }
+  Eigen::Quaterniond q_node_x(truth(6), truth(3), truth(4), truth(5));
+  Eigen::Vector3d T_node_x(truth(0), truth(1), truth(2));
+
+  Eigen::Vector3d T_c = (q_node_x*q_camera_to_body.conjugate()).conjugate()*T_body -
+                        (q_node_x*q_camera_to_body.conjugate()).conjugate()*T_node_x - q_camera_to_body*T_body;
+  Eigen::Quaterniond q_cr_c = q_camera_to_body*q_node_x*q_camera_to_body.conjugate();
+
+  Eigen::Vector3d theta;
+  for(int i = 0; i < 3; i++)
+  {
+    T_c(i) += options.vo_position_std*normal();
+    theta(i) = options.vo_rotation_std*normal();
+  }
+  q_cr_c = q_cr_c*quaternionFromSmallAngle(theta);
+  Eigen::Quaterniond q_measured = q_cr_c.conjugate(); //the VO gives the rotation back to the reference camera frame
+
+  k_message vo;
+  vo.header.stamp = ros::Time(t);
+  vo.header.seq = seq;
+  vo.newReference = false;
+  vo.inliers = 100;
+  vo.corresponding = 100;
+  vo.trace_id = 0;
+  vo.transform.translation.x = T_c(0);
+  vo.transform.translation.y = T_c(1);
+  vo.transform.translation.z = T_c(2);
+  vo.transform.rotation.x = q_measured.x();
+  vo.transform.rotation.y = q_measured.y();
+  vo.transform.rotation.z = q_measured.z();
+  vo.transform.rotation.w = q_measured.w();
+  for(int i = 0; i < 49; i++)
+    vo.covariance[i] = 0.0;
+  for(int i = 0; i < 3; i++)
+  {
+    vo.covariance[i*8] = options.vo_position_std*options.vo_position_std;
+    vo.covariance[(i + 3)*8] = 0.25*options.vo_rotation_std*options.vo_rotation_std; //the quaternion is half the angle
+  }
+  vo.covariance[48] = 1e-8; //the w of the quaternion hardly moves
+  return VOData(vo);
+}
+
+
+/*!
+ *  \brief Saves the new innovations of a sensor, if there are any
+*/
+static void takeInnovation(MonteCarloEstimator &estimator, int sensor, RunResult &result)
+{
+  Eigen::Matrix<double,6,1> whitened;
+  int length;
+  while((length = estimator.innovation(sensor, whitened)) != 0)
+  {
+    result.nis[sensor].push_back(whitened.head(length).squaredNorm());
+    result.nis_length[sensor] = length;
+  }
+}
+
+
+/*!
+ *  \brief Saves the NEES of each block of the error state
+*/
+static void takeNees(const MonteCarloEstimator &estimator, const State &truth, RunResult &result)
+{
+  Eigen::Matrix<double,COVAR_LENGTH,1> error = MonteCarloEstimator::error(truth, estimator.state());
+  for(int i = 0; i < BLOCK_COUNT; i++)
+  {
+    Eigen::MatrixXd P = estimator.covariance().block(BLOCK_START[i], BLOCK_START[i], BLOCK_LENGTH[i], BLOCK_LENGTH[i]);
+    Eigen::VectorXd e = error.segment(BLOCK_START[i], BLOCK_LENGTH[i]);
+    double nees = e.dot(P.ldlt().solve(e));
+    if(!(boost::math::isfinite)(nees))
+      result.diverged = true;
+    result.nees[i].push_back(nees);
+  }
+}
+
+
+/*!
+ *  \brief Simulates one flight and runs the Estimator on it, the same way the ROSServer main loop does
+*/
+static void runFlight(int run, const MonteCarloOptions &options, RunResult &result)
+{
+  boost::mt19937 engine(options.seed*100003u + run);
+  NormalGenerator normal(engine, boost::normal_distribution<>(0.0, 1.0));
+  UniformGenerator uniform(engine, boost::uniform_real<>(0.0, 1.0));
+  Flight flight(uniform);
+
+  const Constants &consts = options.constants;
+  MonteCarloEstimator estimator(new Constants(consts));
+  estimator.keepInnovations(true);
+  estimator.useRetrodiction(options.oosm);
+  const double dt = 1.0/IMU_RATE;
+  double t = 100.0; //the stamps start away from zero
+
+  //the takeoff, at rest with the nominal biases, until the filter starts:
+  State rest = State::Zero();
+  rest(6) = 1.0;
+  rest(10) = consts.gyrox_bias;
+  rest(11) = consts.gyroy_bias;
+  rest(12) = consts.gyroz_bias;
+  rest(13) = consts.accelx_bias;
+  rest(14) = consts.accely_bias;
+  for(int i = 0; i < STARTUP_SAMPLES && estimator.startup_flag_; i++)
+  {
+    t += dt;
+    IMU_message imu = imuSample(t, rest, Eigen::Vector3d::Zero(), TAKEOFF_ACCZ, 0.0, consts, normal);
+#ifndef LASER
+    estimator.Initialize(imu, NULL, NULL, NULL);
+#else
+    sensor_msgs::Range alt;
+    alt.header.stamp = ros::Time(t);
+    alt.range = TAKEOFF_RANGE;
+    estimator.Initialize(imu, NULL, &alt, NULL);
+#endif
+  }
+  if(estimator.startup_flag_)
+    return;
+  result.started = true;
+
+  State truth = drawTruth(estimator, normal);
+  const double drag = estimator.drag();
+  const int samples = (int)(options.duration*IMU_RATE);
+  const int vo_period = std::max(1, (int)(IMU_RATE/options.vo_rate + 0.5));
+  const double start = t;
+  Eigen::Vector3d omega = flight.rates(0.0); //held across the interval, like Estimator::prediction() does
+  VO_batch vo_pending; //the VO of the images that hasn't arrived yet
+  std::deque<double> vo_arrival; //and the times it arrives
+
+  for(int k = 1; k <= samples; k++)
+  {
+    t = start + k*dt;
+
+    //the vision that arrived since the last loop is applied first, all at once:
+    VO_batch vo_batch;
+    while(!vo_pending.empty() && vo_arrival.front() <= t)
+    {
+      vo_batch.push_back(vo_pending.front());
+      vo_pending.pop_front();
+      vo_arrival.pop_front();
+    }
+    if(!vo_batch.empty())
+    {
+      estimator.prepareQueuedItems(vo_batch.front().Timestamp());
+      estimator.delayedVisionUpdate(vo_batch, NULL);
+      takeInnovation(estimator, Estimator::VISION_SENSOR, result);
+    }
+
+    //the truth across the interval, and the IMU sample at its end:
+    double accel_z = heightControl(truth, omega, flight.downReference((k - 1)*dt), consts);
+    propagateTruth(truth, omega, accel_z, dt, drag, consts);
+    omega = flight.rates(k*dt);
+    IMU_message imu = imuSample(t, truth, omega, accel_z, drag, consts, normal);
+
+    sensor_msgs::Range alt;
+    sensor_msgs::Range *alt_data = NULL;
+    if(k % ALT_PERIOD == 0)
+    {
+      alt = altitudeSample(t, truth, consts, normal);
+      alt_data = &alt;
+    }
+
+    estimator.prediction(consts.normal_steps, dt, imu);
+    estimator.imuMeasurementUpdate(imu);
+    takeInnovation(estimator, Estimator::ACCEL_SENSOR, result);
+#ifdef DETECT
+    estimator.altitudeMeasurementUpdate(alt_data, true);
+#else
+    estimator.altitudeMeasurementUpdate(alt_data);
+#endif
+    takeInnovation(estimator, Estimator::ALTITUDE_SENSOR, result);
+    estimator.saveData(imu, alt_data);
+
+    if(k % vo_period == 0)
+    {
+      vo_pending.push_back(visionSample(t, k, truth, options, consts, normal));
+      vo_arrival.push_back(t + options.vo_delay);
+    }
+    if(k % NEES_PERIOD == 0)
+      takeNees(estimator, truth, result);
+  }
+}
+
+
+/*!
+ *  \brief Returns the CPU time of the calling thread (s)
+*/
+static double threadSeconds()
+{
+  timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return now.tv_sec + 1e-9*now.tv_nsec;
+}
+
+
+/*!
+ *  \brief Runs the flights, taking the next one until they are all done
+*/
+static void runWorker(const MonteCarloOptions &options, std::vector<RunResult> &results, int &next_run,
+                      boost::mutex &mutex)
+{
+  while(true)
+  {
+    int run;
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      run = next_run++;
+    }
+    if(run >= options.runs)
+      return;
+
+    double start = threadSeconds();
+    runFlight(run, options, results[run]);
+    results[run].seconds = threadSeconds() - start;
+  }
+}
+
+
+/*!
+ *  \brief Returns the two-sided CONFIDENCE bounds of the mean of count chi-square values of a dimension
+*/
+static void chiSquareBounds(int dimension, int count, double &lower, double &upper)
+{
+  boost::math::chi_squared distribution((double)dimension*count);
+  lower = boost::math::quantile(distribution, 0.5*(1.0 - CONFIDENCE))/count;
+  upper = boost::math::quantile(distribution, 0.5*(1.0 + CONFIDENCE))/count;
+}
+
+
+/*!
+ *  \brief Returns value, or infinity if it isn't finite (so a diverged run counts against the statistics)
+*/
+static double finiteOrInfinite(double value)
+{
+  return (boost::math::isfinite)(value) ? value : std::numeric_limits<double>::infinity();
+}
+
+
+/*!
+ *  \brief Prints the ANEES of each block: its mean over the flight, its bounds and the percent of the flight inside
+ *
+ *  \param title is the heading of the table
+ *  \param used are the indices of the runs to average
+*/
+static void printNees(const std::string &title, const std::vector<RunResult> &results, const std::vector<int> &used)
+{
+  int count = (int)used.size();
+  int times = (int)results[used.front()].nees[0].size();
+  std::cout << std::left << std::setw(18) << title << std::right << std::setw(8) << "dim" << std::setw(10) << "mean"
+            << std::setw(10) << "lower" << std::setw(10) << "upper" << std::setw(10) << "inside%" << std::endl;
+  for(int i = 0; i < BLOCK_COUNT; i++)
+  {
+    double lower, upper;
+    chiSquareBounds(BLOCK_LENGTH[i], count, lower, upper);
+    double sum = 0.0;
+    int inside = 0;
+    for(int k = 0; k < times; k++)
+    {
+      double anees = 0.0;
+      for(int j = 0; j < count; j++)
+        anees += finiteOrInfinite(results[used[j]].nees[i][k]);
+      anees /= count;
+      sum += anees;
+      if(anees >= lower && anees <= upper)
+        inside++;
+    }
+    std::cout << std::left << std::setw(18) << BLOCK_NAME[i] << std::right << std::setw(8) << BLOCK_LENGTH[i]
+              << std::setw(10) << sum/times << std::setw(10) << lower << std::setw(10) << upper
+              << std::setw(10) << 100.0*inside/times << std::endl;
+  }
+}
+
+
+/*!
+ *  \brief Prints the NIS of each sensor: its mean over all the updates, its bounds and the percent of single NIS
+ *  above their CONFIDENCE quantile (one that isn't finite counts as infinite)
+*/
+static void printNis(const std::vector<RunResult> &results, const std::vector<int> &used)
+{
+  std::cout << std::left << std::setw(18) << "NIS" << std::right << std::setw(8) << "dim" << std::setw(10) << "count"
+            << std::setw(10) << "mean" << std::setw(10) << "lower" << std::setw(10) << "upper"
+            << std::setw(10) << "above%" << std::endl;
+  for(int sensor = 0; sensor < Estimator::SENSOR_COUNT; sensor++)
+  {
+    int dimension = 0, count = 0;
+    double sum = 0.0;
+    for(int j = 0; j < (int)used.size(); j++)
+    {
+      const RunResult &result = results[used[j]];
+      dimension = std::max(dimension, result.nis_length[sensor]);
+      count += result.nis[sensor].size();
+      for(int k = 0; k < (int)result.nis[sensor].size(); k++)
+        sum += finiteOrInfinite(result.nis[sensor][k]);
+    }
+    std::cout << std::left << std::setw(18) << SENSOR_NAME[sensor] << std::right << std::setw(8) << dimension
+              << std::setw(10) << count;
+    if(count == 0)
+    {
+      std::cout << std::endl;
+      continue;
+    }
+
+    double lower, upper;
+    chiSquareBounds(dimension, count, lower, upper);
+    double single = boost::math::quantile(boost::math::chi_squared((double)dimension), CONFIDENCE);
+    int above = 0;
+    for(int j = 0; j < (int)used.size(); j++)
+    {
+      const std::vector<double> &nis = results[used[j]].nis[sensor];
+      for(int k = 0; k < (int)nis.size(); k++)
+        if(!(nis[k] <= single))
+          above++;
+    }
+    std::cout << std::setw(10) << sum/count << std::setw(10) << lower << std::setw(10) << upper
+              << std::setw(10) << 100.0*above/count << std::endl;
+  }
+}
+
+
+
+int main(int argc, char **argv)
+{
+  MonteCarloOptions options;
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if(arg == "--runs" && i + 1 < argc)
+      options.runs = atoi(argv[++i]);
+    else if(arg == "--threads" && i + 1 < argc)
+      options.threads = atoi(argv[++i]);
+    else if(arg == "--duration" && i + 1 < argc)
+      options.duration = atof(argv[++i]);
+    else if(arg == "--vo_rate" && i + 1 < argc)
+      options.vo_rate = atof(argv[++i]);
+    else if(arg == "--vo_delay" && i + 1 < argc)
+      options.vo_delay = atof(argv[++i]);
+    else if(arg == "--vo_position_std" && i + 1 < argc)
+      options.vo_position_std = atof(argv[++i]);
+    else if(arg == "--vo_rotation_std" && i + 1 < argc)
+      options.vo_rotation_std = atof(argv[++i]);
+    else if(arg == "--seed" && i + 1 < argc)
+      options.seed = atoi(argv[++i]);
+    else if(arg == "--oosm")
+      options.oosm = true;
+    else if(arg == "--constants" && i + 1 < argc)
+    {
+      if(!options.constants.loadFile(argv[++i]))
+      {
+        std::cerr << "estimator_montecarlo: couldn't load the constants from " << argv[i] << std::endl;
+        return 1;
+      }
+    }
+    else
+    {
+      std::cerr << "Usage: estimator_montecarlo [--runs 200] [--threads <cores>] [--duration 30] [--vo_rate 15]"
+                << " [--vo_delay 0.07] [--vo_position_std 0.02] [--vo_rotation_std 0.002] [--seed 1]"
+                << " [--constants <file>] [--oosm]" << std::endl;
+      return 1;
+    }
+  }
+  if(options.runs < 1 || options.threads < 1 || options.duration*IMU_RATE < NEES_PERIOD || options.vo_rate <= 0.0)
+  {
+    std::cerr << "estimator_montecarlo: needs at least one run and thread, a flight of at least "
+              << NEES_PERIOD/IMU_RATE << " s and a VO rate" << std::endl;
+    return 1;
+  }
+
+  ros::Time::init();
+  std::vector<RunResult> results(options.runs);
+  int next_run = 0;
+  boost::mutex mutex;
+  ros::WallTime start = ros::WallTime::now();
+  boost::thread_group workers;
+  for(int i = 0; i < std::min(options.threads, options.runs); i++)
+    workers.create_thread(boost::bind(&runWorker, boost::cref(options), boost::ref(results), boost::ref(next_run),
+                                      boost::ref(mutex)));
+  workers.join_all();
+  double wall = (ros::WallTime::now() - start).toSec();
+
+  std::vector<int> started, used;
+  int failed = 0, diverged = 0;
+  double cpu = 0.0;
+  for(int i = 0; i < options.runs; i++)
+  {
+    cpu += results[i].seconds;
+    if(!results[i].started)
+    {
+      failed++;
+      continue;
+    }
+    started.push_back(i);
+    if(results[i].diverged)
+      diverged++;
+    else
+      used.push_back(i);
+  }
+
+  std::cout << options.runs << " runs of " << options.duration << " s (" << failed << " didn't start, " << diverged
+            << " diverged)" << std::endl;
+  if(started.empty())
+    return 1;
+
+  std::cout << std::fixed << std::setprecision(3) << std::endl;
+  if(!used.empty())
+  {
+    printNees("NEES", results, used);
+    std::cout << std::endl;
+  }
+  if(diverged)
+  {
+    printNees("NEES (all runs)", results, started);
+    std::cout << std::endl;
+  }
+  printNis(results, started);
+
+  std::cout << std::endl << "Run time (s):" << std::endl;
+  std::cout << std::left << std::setw(18) << "wall" << std::right << std::setw(10) << wall << std::endl;
+  std::cout << std::left << std::setw(18) << "per_run" << std::right << std::setw(10) << cpu/options.runs << std::endl;
+  std::cout << std::left << std::setw(18) << "speedup" << std::right << std::setw(10) << cpu/std::max(wall, 1e-9)
+            << "  (" << std::min(options.threads, options.runs) << " threads)" << std::endl;
+  std::cout << std::left << std::setw(18) << "realtime" << std::right << std::setw(10)
+            << options.duration*options.runs/std::max(cpu, 1e-9) << "  (simulated s per CPU s)" << std::endl;
+
+  if(diverged)
+  {
+    std::cout << std::endl << "FAIL: " << diverged << " of " << started.size() << " runs diverged" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,605 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*! \file estimator_replay.cpp
+  * \author agent
+  * \date October 2026
+  * \brief estimator_replay.cpp runs the Estimator on recorded flights (bags of the IMU, altitude, VO and truth
+  * topics) the same way the ROSServer main loop does, and times the parts of the filter.
+  *
+  * Usage:
+  * \code
+  *   estimator_replay <bag> [<bag> ...] [--imu_topic /imu/data] [--alt_topic /alt_msgs] [--vo_topic <topic>]
+  *                    [--mocap_topic /evart/heavy_ros/base] [--compare_oosm] [--preintegrate <samples>] [--smoother]
+  * \endcode
+  *
+  * Each bag is a flight and starts a new Estimator.  Every IMU message is one loop of the main loop: the altitude, VO
+  * and truth that arrived before it are queued and taken like ROSServer::Run takes them, and the vision is applied
+  * first, with prepareQueuedItems() and delayedVisionUpdate() (every VO message that arrived since the last loop, in
+  * one update).  The replay runs as fast as it can, so the VO delay is the recorded one.
+  *
+  * The count, mean, 50th, 90th, 99th percentile and the max of each part are printed in microseconds:
+  * - imu_step: the prediction, the accelerometer and the altitude updates, and saveData() of an IMU sample
+  * - vision_update: a delayed vision update (rolled back and repropagated once, however many VO messages it has)
+  * - keyframe_update: the vision updates that declared a new node (they include the keyframe reset)
+  * - reset, reset_dense: the keyframe reset of the covariance (Estimator::resetCovariance()) and its original dense
+  *   form (Estimator::resetCovarianceDense()), on the covariance of the filter at every vision update
+  *
+  * The two resets are also compared on those covariances, and the replay fails (returns 1) if they differ by more than
+  * the round off.
+  *
+  * With --compare_oosm a second Estimator runs on the same data with the retrodicted (OOSM) vision update (see
+  * Estimator::useRetrodiction()), and its times are added to the table:
+  * - oosm_imu_step: the IMU step, which also keeps the error state transition
+  * - oosm_update: the vision updates without a new node, fused at the current time (no repropagation)
+  * - oosm_keyframe: the vision updates that declared a new node (rolled back and repropagated, as above)
+  *
+  * After each IMU step its state is compared to the state of the repropagated filter, and the differences of the
+  * position (m), attitude (deg) and velocity (m/s) are printed in the same form.
+  *
+  * With --preintegrate another Estimator predicts the IMU in batches of that many samples, with one preintegrated
+  * prediction each (Estimator::batchPrediction(), as ROSServer does with ~preintegrate_imu_batch).  A batch is also
+  * ended by a vision update, which is applied after it.  Its times are added to the table:
+  * - preint_step: the preintegrated prediction of a batch, the accelerometer and altitude updates of its last sample,
+  *   and saveData()
+  * - preint_update: its vision updates (the packets of the batches are reapplied with one prediction each)
+  *
+  * and after each batch its state is compared to the filter that predicts every sample, like the OOSM filter is.
+  *
+  * With --smoother a FixedLagSmoother runs on the same loops (as ROSServer does with ~use_smoother, but without its
+  * thread).  The times of its solves are added to the table (smoother_solve, one for each image).  For each of its
+  * states, when there is truth, the position errors of the filter and the smoother (from the truth relative to their
+  * current node, see Estimator::relativeTruePosition()) are printed side by side.
+*/
+
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <boost/foreach.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <Eigen/Geometry>
+#include <iostream>
+#include <iomanip>
+#include <queue>
+#include <vector>
+#include "rel_estimator/estimator.h"
+#include "rel_estimator/fixed_lag_smoother.h"
+#include "timing_table.h"
+
+using namespace rel_MEKF;
+using kinect_vo::printTimes;
+using kinect_vo::printTimesHeader;
+
+
+static const double ACCZ_LANDED = -20.0; //!< two accz below this and it has landed (ROSServer::ACCZ_LANDED_)
+static const int RESET_REPEATS = 1000; //!< the resets are repeated to time them (they take well under a microsecond)
+static const double RESET_TOLERANCE = 1e-12; //!< the largest difference of the resets, relative to the largest entry
+static const int NAME_WIDTH = 18; //!< of the name column of the tables
+
+
+/*!
+ *  \class ReplayEstimator
+ *  \brief The Estimator, with its covariance and the delta quaternion of the reset open to the replay
+*/
+class ReplayEstimator : public Estimator
+{
+public:
+  ReplayEstimator(Constants *mk_const): Estimator(mk_const, false) {}
+
+  const Eigen::Matrix<double,STATE_LENGTH,1>& state() const {return x_;}
+  const Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH>& covariance() const {return P_;}
+  const Eigen::Vector3d& deltaTheta() const {return saved_deltatheta_;}
+};
+
+
+/*!
+ *  \struct ReplayTimes
+ *  \brief The times of the parts of the filter (in microseconds) and the comparison of the resets
+*/
+struct ReplayTimes
+{
+  ReplayTimes(): imu_count(0), vo_count(0), update_count(0), keyframe_count(0), reset_difference(0.0) {}
+
+  std::vector<double> imu_step;
+  std::vector<double> vision_update;
+  std::vector<double> keyframe_update;
+  std::vector<double> reset;
+  std::vector<double> reset_dense;
+  std::vector<double> oosm_imu_step;
+  std::vector<double> oosm_update;
+  std::vector<double> oosm_keyframe;
+  std::vector<double> position_difference; //!< between the OOSM and the repropagated filter, after each IMU step
+  std::vector<double> attitude_difference;
+  std::vector<double> velocity_difference;
+  std::vector<double> preint_step;
+  std::vector<double> preint_update;
+  std::vector<double> preint_position_difference; //!< between the preintegrated and the per sample filter, after each batch
+  std::vector<double> preint_attitude_difference;
+  std::vector<double> preint_velocity_difference;
+  std::vector<double> smoother_solve;
+  std::vector<double> filter_position_error; //!< from the relative truth, at the states of the smoother
+  std::vector<double> smoother_position_error;
+  int imu_count;
+  int vo_count;
+  int update_count; //!< the vision updates (fewer than vo_count when the VO backed up)
+  int keyframe_count;
+  double reset_difference; //!< the largest difference between the resets, relative to the largest entry of P
+};
+
+
+/*!
+ *  \brief Times the keyframe reset and its dense form on the current covariance of the filter, and compares them
+*/
+static void timeReset(const ReplayEstimator &estimator, ReplayTimes &times)
+{
+  typedef Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> Covariance;
+  Eigen::Matrix<double,3,2> J = Estimator::resetJacobian(estimator.deltaTheta());
+  Covariance structured = estimator.covariance(), dense = estimator.covariance();
+
+  //each run starts from the filter's covariance (the copy is in both times)
+  ros::WallTime start = ros::WallTime::now();
+  for(int i = 0; i < RESET_REPEATS; i++)
+  {
+    structured = estimator.covariance();
+    Estimator::resetCovariance(structured, J);
+  }
+  times.reset.push_back((ros::WallTime::now() - start).toSec()*1e6/RESET_REPEATS);
+
+  start = ros::WallTime::now();
+  for(int i = 0; i < RESET_REPEATS; i++)
+  {
+    dense = estimator.covariance();
+    Estimator::resetCovarianceDense(dense, J);
+  }
+  times.reset_dense.push_back((ros::WallTime::now() - start).toSec()*1e6/RESET_REPEATS);
+
+  double scale = std::max(estimator.covariance().cwiseAbs().maxCoeff(), 1e-300);
+  times.reset_difference = std::max(times.reset_difference, (structured - dense).cwiseAbs().maxCoeff()/scale);
+}
+
+
+/*!
+ *  \brief The vision update of one loop (see ROSServer::Run)
+ *  \returns the time it took, in microseconds
+*/
+static double visionStep(ReplayEstimator &estimator, VO_batch &vo_batch, TRUTH_message *truth_data)
+{
+  ros::WallTime start = ros::WallTime::now();
+  estimator.prepareQueuedItems(vo_batch.front().Timestamp());
+  estimator.delayedVisionUpdate(vo_batch, truth_data);
+  return (ros::WallTime::now() - start).toSec()*1e6;
+}
+
+
+/*!
+ *  \brief The prediction and updates of an IMU sample (see ROSServer::Run)
+ *  \returns the time it took, in microseconds
+*/
+static double imuStep(ReplayEstimator &estimator, int steps, double dt, IMU_message &imu_data,
+                      sensor_msgs::Range *alt_data)
+{
+  ros::WallTime start = ros::WallTime::now();
+  estimator.prediction(steps, dt, imu_data);
+  estimator.imuMeasurementUpdate(imu_data);
+#ifdef DETECT
+  estimator.altitudeMeasurementUpdate(alt_data, true);
+#else
+  estimator.altitudeMeasurementUpdate(alt_data);
+#endif
+  estimator.saveData(imu_data, alt_data);
+  return (ros::WallTime::now() - start).toSec()*1e6;
+}
+
+
+/*!
+ *  \brief The preintegrated prediction and updates of a batch of IMU samples (see ROSServer::Run)
+ *  \returns the time it took, in microseconds
+*/
+static double batchStep(ReplayEstimator &estimator, std::vector<IMU_message> &imu_batch, double &old_time,
+                        sensor_msgs::Range *alt_data)
+{
+  ros::WallTime start = ros::WallTime::now();
+  ImuPreintegration preintegration;
+  estimator.batchPrediction(imu_batch, old_time, preintegration);
+  estimator.imuMeasurementUpdate(imu_batch.back());
+#ifdef DETECT
+  estimator.altitudeMeasurementUpdate(alt_data, true);
+#else
+  estimator.altitudeMeasurementUpdate(alt_data);
+#endif
+  estimator.saveData(imu_batch.back(), alt_data, &preintegration);
+  return (ros::WallTime::now() - start).toSec()*1e6;
+}
+
+
+/*!
+ *  \brief Saves the differences of the position, attitude and velocity of a filter (OOSM or preintegrated) from the
+ *  reference one
+*/
+static void compareStates(const ReplayEstimator &estimator, const ReplayEstimator &other,
+                          std::vector<double> &position, std::vector<double> &attitude, std::vector<double> &velocity)
+{
+  const Eigen::Matrix<double,STATE_LENGTH,1> &x = estimator.state(), &x_other = other.state();
+  Eigen::Quaterniond q(x(6), x(3), x(4), x(5)), q_other(x_other(6), x_other(3), x_other(4), x_other(5));
+
+  position.push_back((x.segment<3>(0) - x_other.segment<3>(0)).norm());
+  attitude.push_back(q.normalized().angularDistance(q_other.normalized())*180.0/M_PI);
+  velocity.push_back((x.segment<3>(7) - x_other.segment<3>(7)).norm());
+}
+
+
+/*!
+ *  \brief Replays one bag (one flight) through a new Estimator
+ *  \param compare_oosm also replays it through an Estimator with the retrodicted vision update, to compare
+ *  \param preintegrate is the number of IMU samples of a preintegrated batch (0 for no preintegrated Estimator)
+ *  \param use_smoother also replays it through a FixedLagSmoother
+ *  \returns false if the bag couldn't be read
+*/
+static bool replayBag(const std::string &bag_file, const std::vector<std::string> &topics, bool compare_oosm,
+                      int preintegrate, bool use_smoother, ReplayTimes &times)
+{
+  rosbag::Bag bag;
+  try
+  {
+    bag.open(bag_file, rosbag::bagmode::Read);
+  }
+  catch(rosbag::BagException &e)
+  {
+    std::cout << "Unable to open " << bag_file << ": " << e.what() << std::endl;
+    return false;
+  }
+
+  ReplayEstimator estimator(new Constants);
+  ReplayEstimator oosm(new Constants);
+  oosm.useRetrodiction(true);
+  ReplayEstimator preint(new Constants);
+  std::vector<IMU_message> preint_batch; //the samples of the batch being collected
+  sensor_msgs::Range preint_alt; //the latest altitude of the batch
+  bool preint_alt_set = false;
+  double preint_time = 0.0;
+  Constants consts;
+  FixedLagSmoother smoother(&consts, false);
+  std::queue<sensor_msgs::Range> alt_queue;
+  VO_batch vo_queue;
+  std::queue<TRUTH_message> truth_queue;
+  double old_time = 0.0, past_accz = 0.0;
+  ros::Time landed_time;
+
+  //topics: imu, alt, vo, truth
+  rosbag::View view(bag, rosbag::TopicQuery(topics));
+  BOOST_FOREACH(rosbag::MessageInstance const m, view)
+  {
+    if(m.getTopic() == topics[1])
+    {
+      sensor_msgs::Range::ConstPtr alt = m.instantiate<sensor_msgs::Range>();
+      if(alt)
+        alt_queue.push(*alt);
+      continue;
+    }
+    if(m.getTopic() == topics[2])
+    {
+      k_message::ConstPtr vo = m.instantiate<k_message>();
+      if(vo)
+        vo_queue.push_back(VOData(*vo));
+      continue;
+    }
+    if(m.getTopic() == topics[3])
+    {
+      TRUTH_message::ConstPtr truth = m.instantiate<TRUTH_message>();
+      if(truth)
+        truth_queue.push(*truth);
+      continue;
+    }
+    IMU_message::ConstPtr imu_ptr = m.instantiate<IMU_message>();
+    if(!imu_ptr)
+      continue;
+
+    //
+    //One loop of ROSServer::Run (the IMU queue is always empty here)
+    IMU_message imu_data = *imu_ptr;
+    sensor_msgs::Range alt_temp, *alt_data = NULL;
+    VO_batch vo_batch;
+    TRUTH_message truth_temp, *truth_data = NULL;
+
+    if((int)alt_queue.size() > 5 && !estimator.startup_flag_)
+    {
+      while((int)alt_queue.size() > 2)
+        alt_queue.pop();
+    }
+    if(!alt_queue.empty())
+    {
+      alt_temp = alt_queue.front();
+      alt_queue.pop();
+      alt_data = &alt_temp;
+    }
+
+    vo_batch.swap(vo_queue);
+
+    if((int)truth_queue.size() > 5 && !estimator.startup_flag_)
+    {
+      while((int)truth_queue.size() > 1)
+        truth_queue.pop();
+    }
+    if(!truth_queue.empty())
+    {
+      truth_temp = truth_queue.front();
+      truth_queue.pop();
+      truth_data = &truth_temp;
+    }
+
+    //the smoother's copy of the loop
+    boost::shared_ptr<BankStep> step;
+    if(use_smoother)
+    {
+      step.reset(new BankStep(std::vector<IMU_message>(1, imu_data), alt_data, vo_batch, truth_data, NULL));
+      step->startup = estimator.startup_flag_;
+    }
+
+    if(estimator.startup_flag_)
+    {
+      //2 seconds is the min touchdown time
+      if(estimator.just_landed_ && (imu_data.header.stamp - landed_time).toSec() > 2.0)
+        estimator.just_landed_ = false;
+
+      estimator.Initialize(imu_data, NULL, alt_data, truth_data);
+      if(compare_oosm)
+      {
+        oosm.just_landed_ = estimator.just_landed_;
+        oosm.Initialize(imu_data, NULL, alt_data, truth_data);
+      }
+      if(preintegrate > 0)
+      {
+        preint.just_landed_ = estimator.just_landed_;
+        preint.Initialize(imu_data, NULL, alt_data, truth_data);
+        preint_batch.clear();
+        preint_alt_set = false;
+        preint_time = imu_data.header.stamp.toSec();
+      }
+      if(use_smoother)
+      {
+        step->just_landed = estimator.just_landed_;
+        smoother.post(step);
+      }
+      old_time = imu_data.header.stamp.toSec();
+      continue;
+    }
+
+    if(!vo_batch.empty())
+    {
+      timeReset(estimator, times);
+
+      double elapsed = visionStep(estimator, vo_batch, truth_data);
+
+      times.vision_update.push_back(elapsed);
+      times.update_count++;
+      bool new_node = false;
+      for(int i = 0; i < (int)vo_batch.size(); i++)
+      {
+        times.vo_count++;
+        if(vo_batch[i].NewReference())
+        {
+          times.keyframe_count++;
+          new_node = true;
+        }
+      }
+      if(new_node)
+        times.keyframe_update.push_back(elapsed);
+
+      if(compare_oosm)
+      {
+        elapsed = visionStep(oosm, vo_batch, truth_data);
+        if(new_node)
+          times.oosm_keyframe.push_back(elapsed);
+        else
+          times.oosm_update.push_back(elapsed);
+      }
+
+      if(preintegrate > 0)
+      {
+        //the batch ends with the vision
+        if(!preint_batch.empty())
+        {
+          times.preint_step.push_back(batchStep(preint, preint_batch, preint_time, preint_alt_set ? &preint_alt : NULL));
+          preint_batch.clear();
+          preint_alt_set = false;
+        }
+        times.preint_update.push_back(visionStep(preint, vo_batch, truth_data));
+      }
+    }
+
+    double dt = imu_data.header.stamp.toSec() - old_time;
+    if(dt > 1000)
+      dt = 0.0; //for the first time through
+    old_time = imu_data.header.stamp.toSec();
+
+    times.imu_step.push_back(imuStep(estimator, consts.normal_steps, dt, imu_data, alt_data));
+    times.imu_count++;
+    if(compare_oosm)
+    {
+      times.oosm_imu_step.push_back(imuStep(oosm, consts.normal_steps, dt, imu_data, alt_data));
+      compareStates(estimator, oosm, times.position_difference, times.attitude_difference, times.velocity_difference);
+    }
+    if(preintegrate > 0)
+    {
+      preint_batch.push_back(imu_data);
+      if(alt_data != NULL)
+      {
+        preint_alt = *alt_data;
+        preint_alt_set = true;
+      }
+      if((int)preint_batch.size() >= preintegrate)
+      {
+        times.preint_step.push_back(batchStep(preint, preint_batch, preint_time, preint_alt_set ? &preint_alt : NULL));
+        preint_batch.clear();
+        preint_alt_set = false;
+        compareStates(estimator, preint, times.preint_position_difference, times.preint_attitude_difference,
+                      times.preint_velocity_difference);
+      }
+    }
+    if(use_smoother)
+    {
+      step->just_landed = estimator.just_landed_;
+      smoother.post(step);
+      smoother.solveTimes(times.smoother_solve);
+
+      rel_MEKF::relative_state smoothed;
+      Eigen::Vector3d truth, smoother_truth;
+      if(smoother.smoothedState(smoothed) && truth_data != NULL && estimator.relativeTruePosition(*truth_data, truth) &&
+         smoother.relativeTruePosition(*truth_data, smoother_truth))
+      {
+        Eigen::Vector3d position(smoothed.translation.x, smoothed.translation.y, smoothed.translation.z);
+        times.filter_position_error.push_back((estimator.state().segment<3>(0) - truth).norm());
+        times.smoother_position_error.push_back((position - smoother_truth).norm());
+      }
+    }
+
+    if(imu_data.linear_acceleration.z <= ACCZ_LANDED && past_accz <= ACCZ_LANDED)
+    {
+      estimator.startup_flag_ = true;
+      estimator.just_landed_ = true;
+      oosm.startup_flag_ = true;
+      preint.startup_flag_ = true;
+      landed_time = imu_data.header.stamp;
+    }
+    past_accz = imu_data.linear_acceleration.z;
+  }
+
+  bag.close();
+  return true;
+}
+
+
+/*!
+ *  \brief Replays the bags and prints the times of the parts of the filter.
+*/
+int main(int argc, char **argv)
+{
+  if(argc < 2)
+  {
+    std::cout << "Usage: estimator_replay <bag> [<bag> ...] [--imu_topic /imu/data] [--alt_topic /alt_msgs] "
+              << "[--vo_topic <topic>] [--mocap_topic /evart/heavy_ros/base] [--compare_oosm] "
+              << "[--preintegrate <samples>] [--smoother]" << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> bag_files;
+  bool compare_oosm = false;
+  int preintegrate = 0;
+  bool use_smoother = false;
+  std::vector<std::string> topics(4);
+  topics[0] = "/imu/data";
+#ifndef LASER
+  topics[1] = "/alt_msgs";
+#else
+  topics[1] = "/scan";
+#endif
+  topics[2] = "/kinect_visual_odometry/vo_transformation";
+  topics[3] = "/evart/heavy_ros/base";
+
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if(arg == "--imu_topic" && i + 1 < argc)
+      topics[0] = argv[++i];
+    else if(arg == "--alt_topic" && i + 1 < argc)
+      topics[1] = argv[++i];
+    else if(arg == "--vo_topic" && i + 1 < argc)
+      topics[2] = argv[++i];
+    else if(arg == "--mocap_topic" && i + 1 < argc)
+      topics[3] = argv[++i];
+    else if(arg == "--compare_oosm")
+      compare_oosm = true;
+    else if(arg == "--preintegrate" && i + 1 < argc)
+      preintegrate = std::max(0, atoi(argv[++i]));
+    else if(arg == "--smoother")
+      use_smoother = true;
+    else if(arg.compare(0, 2, "--") == 0)
+    {
+      std::cout << "Unknown argument: " << arg << std::endl;
+      return 1;
+    }
+    else
+      bag_files.push_back(arg);
+  }
+
+  ros::Time::init();
+
+  ReplayTimes times;
+  for(int b = 0; b < (int)bag_files.size(); b++)
+  {
+    if(!replayBag(bag_files[b], topics, compare_oosm, preintegrate, use_smoother, times))
+      return 1;
+  }
+
+  std::cout << "Replayed " << times.imu_count << " IMU samples and " << times.vo_count << " VO messages ("
+            << times.keyframe_count << " new nodes) in " << times.update_count << " vision updates from "
+            << bag_files.size() << " bag(s)" << std::endl;
+  if(times.imu_count == 0)
+    return 1;
+
+  std::cout << std::endl;
+  printTimesHeader("Part (us)", NAME_WIDTH);
+  std::cout << std::fixed << std::setprecision(2);
+  printTimes("imu_step", times.imu_step, NAME_WIDTH);
+  printTimes("vision_update", times.vision_update, NAME_WIDTH);
+  printTimes("keyframe_update", times.keyframe_update, NAME_WIDTH);
+  if(compare_oosm)
+  {
+    printTimes("oosm_imu_step", times.oosm_imu_step, NAME_WIDTH);
+    printTimes("oosm_update", times.oosm_update, NAME_WIDTH);
+    printTimes("oosm_keyframe", times.oosm_keyframe, NAME_WIDTH);
+  }
+  if(preintegrate > 0)
+  {
+    printTimes("preint_step", times.preint_step, NAME_WIDTH);
+    printTimes("preint_update", times.preint_update, NAME_WIDTH);
+  }
+  if(use_smoother)
+    printTimes("smoother_solve", times.smoother_solve, NAME_WIDTH);
+  std::cout << std::setprecision(4);
+  printTimes("reset", times.reset, NAME_WIDTH);
+  printTimes("reset_dense", times.reset_dense, NAME_WIDTH);
+
+  std::cout << std::endl << std::scientific << std::setprecision(2) << "Largest difference of the resets: "
+            << times.reset_difference << " of the largest covariance entry" << std::endl;
+  if(times.reset_difference > RESET_TOLERANCE)
+  {
+    std::cout << "The keyframe reset doesn't match its dense form!" << std::endl;
+    return 1;
+  }
+
+  if(compare_oosm)
+  {
+    std::cout << std::endl;
+    printTimesHeader("OOSM difference", NAME_WIDTH);
+    std::cout << std::fixed << std::setprecision(5);
+    printTimes("position (m)", times.position_difference, NAME_WIDTH);
+    printTimes("attitude (deg)", times.attitude_difference, NAME_WIDTH);
+    printTimes("velocity (m/s)", times.velocity_difference, NAME_WIDTH);
+  }
+
+  if(preintegrate > 0)
+  {
+    std::cout << std::endl;
+    printTimesHeader("Preint difference", NAME_WIDTH);
+    std::cout << std::fixed << std::setprecision(5);
+    printTimes("position (m)", times.preint_position_difference, NAME_WIDTH);
+    printTimes("attitude (deg)", times.preint_attitude_difference, NAME_WIDTH);
+    printTimes("velocity (m/s)", times.preint_velocity_difference, NAME_WIDTH);
+  }
+
+  if(use_smoother)
+  {
+    std::cout << std::endl;
+    printTimesHeader("Position error", NAME_WIDTH);
+    std::cout << std::fixed << std::setprecision(5);
+    printTimes("filter (m)", times.filter_position_error, NAME_WIDTH);
+    printTimes("smoother (m)", times.smoother_position_error, NAME_WIDTH);
+  }
+
+  return 0;
+}
@@ -0,0 +1,166 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file fault_detector.cpp
+ *  \author agent
+ *  \date October 2026
+*/
+
+
+#include <boost/math/distributions/chi_squared.hpp>
+#include "rel_estimator/fault_detector.h"
+
+namespace rel_MEKF
+{
+
+//
+// Constructor: compute the threshold tables
+//
+FaultDetector::FaultDetector(int dimension, int window_size, double prob_false_allow, double mean_inflate,
+                             double covariance_inflate, int failure_count)
+{
+  dimension_ = dimension;
+  window_size_ = window_size;
+  failure_count_ = failure_count;
+
+  //the mean statistic always has dimension_ degrees of freedom:
+  boost::math::chi_squared mean_distro(dimension_);
+  mean_quantile_ = mean_inflate*quantile(mean_distro, 1 - prob_false_allow);
+
+  //the covariance statistic has (N-1)*dimension_, for every window length N (no test with a single residual):
+  covariance_threshold_table_.assign(window_size_ + 1, 0.0);
+  for(int n = 2; n <= window_size_; n++)
+  {
+    boost::math::chi_squared covariance_distro((n - 1)*dimension_);
+    covariance_threshold_table_[n] = covariance_inflate*quantile(covariance_distro, 1 - prob_false_allow);
+  }
+
+  residuals_.resize(window_size_*dimension_);
+  flags_.resize(window_size_);
+  mean_.resize(dimension_);
+  m2_.resize(dimension_);
+  reset();
+}
+
+
+
+//
+// Empty the windows
+//
+void FaultDetector::reset()
+{
+  head_ = 0;
+  count_ = 0;
+  window_faults_ = 0;
+  m2_total_ = 0.0;
+  for(int i = 0; i < dimension_; i++)
+  {
+    mean_[i] = 0.0;
+    m2_[i] = 0.0;
+  }
+
+  mean_statistic_ = 0.0;
+  covariance_statistic_ = 0.0;
+  mean_threshold_ = mean_quantile_;
+  covariance_threshold_ = 0.0;
+  sensor_failure_ = false;
+}
+
+
+
+//
+// Add a residual and run the tests
+//
+int FaultDetector::update(const double *normalized_residual, bool outlier)
+{
+  int flag = outlier ? OUTLIER_FAULT : 0;
+
+  //slide the window:
+  if(count_ == window_size_)
+  {
+    removeOldest();
+  }
+  int tail = (head_ + count_) % window_size_;
+  count_++;
+
+  //Welford update of the mean and the squared deviations:
+  double mean_squared = 0.0;
+  m2_total_ = 0.0;
+  for(int i = 0; i < dimension_; i++)
+  {
+    double x = normalized_residual[i];
+    residuals_[tail*dimension_ + i] = x;
+
+    double delta = x - mean_[i];
+    mean_[i] += delta/count_;
+    m2_[i] += delta*(x - mean_[i]);
+    if(m2_[i] < 0.0)
+      m2_[i] = 0.0; //round off
+
+    m2_total_ += m2_[i];
+    mean_squared += mean_[i]*mean_[i];
+  }
+
+  //Test of mean:
+  mean_statistic_ = count_*mean_squared;
+  mean_threshold_ = mean_quantile_;
+  if(mean_statistic_ >= mean_threshold_)
+  {
+    flag += MEAN_FAULT;
+  }
+
+  //Test of covariance: (N-1)*trace(S) is the sum of the squared deviations
+  covariance_statistic_ = m2_total_;
+  covariance_threshold_ = covariance_threshold_table_[count_];
+  if(count_ > 1 && covariance_statistic_ >= covariance_threshold_)
+  {
+    flag += COVARIANCE_FAULT;
+  }
+
+  //Determine if it is a sensor failure rather than noise:
+  flags_[tail] = flag;
+  if(flag != 0)
+  {
+    window_faults_++;
+  }
+  sensor_failure_ = (count_ == window_size_ && window_faults_ >= failure_count_);
+
+  return flag;
+}
+
+
+
+//
+// Remove the oldest residual from the running statistics
+//
+void FaultDetector::removeOldest()
+{
+  int oldest = head_;
+  head_ = (head_ + 1) % window_size_;
+  count_--;
+
+  if(flags_[oldest] != 0)
+  {
+    window_faults_--;
+  }
+
+  for(int i = 0; i < dimension_; i++)
+  {
+    if(count_ == 0)
+    {
+      mean_[i] = 0.0;
+      m2_[i] = 0.0;
+      continue;
+    }
+    //Welford in reverse: mean_(n-1) = mean_n - (y - mean_n)/(n-1),  M2_(n-1) = M2_n - (y - mean_n)*(y - mean_(n-1))
+    double y = residuals_[oldest*dimension_ + i];
+    double delta = y - mean_[i];
+    mean_[i] -= delta/count_;
+    m2_[i] -= delta*(y - mean_[i]);
+  }
+}
+
+}
@@ -0,0 +1,586 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file fixed_lag_smoother.cpp
+ *  \author agent
+ *  \date October 2026
+*/
+
+
+#include "rel_estimator/fixed_lag_smoother.h"
+
+namespace rel_MEKF
+{
+
+using namespace Eigen;
+
+
+//
+// SmootherState Constructor
+//
+SmootherState::SmootherState()
+{
+  time = 0.0;
+  x.setZero();
+  linearization.setZero();
+  F.setIdentity();
+  information.setZero();
+  linearized = false;
+  has_imu = false;
+  has_vo = false;
+  has_alt = false;
+}
+
+
+
+//
+// Constructor: start the thread
+//
+FixedLagSmoother::FixedLagSmoother(Constants *mk_const, bool threaded): Estimator(new Constants(*mk_const), false)
+{
+  //the estimator deletes its constants, so the smoother gets a copy (and it isn't logged)
+  prior_state_.setZero();
+  prior_information_.setZero();
+  previous_gyro_.setZero();
+  sample_time_ = 0.0;
+  alt_time_ = 0.0;
+  alt_pending_ = false;
+  fresh_ = false;
+  running_ = true;
+
+  threaded_ = threaded;
+  if(threaded_)
+  {
+    thread_ = boost::thread(&FixedLagSmoother::work, this);
+    ROS_INFO("Fixed-lag smoother started: a window of %d VO images.", mk_consts_->smoother_window);
+  }
+}
+
+
+
+//
+// Destructor: stop the thread
+//
+FixedLagSmoother::~FixedLagSmoother()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    running_ = false;
+  }
+  posted_.notify_all();
+
+  if(threaded_)
+    thread_.join();
+}
+
+
+
+//
+// Queue a loop of data
+//
+void FixedLagSmoother::post(const boost::shared_ptr<const BankStep> &step)
+{
+  if(!threaded_)
+  {
+    process(*step);
+    return;
+  }
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    queue_.push_back(step);
+    if((int)queue_.size() == MAX_QUEUE_)
+    {
+      ROS_WARN("Fixed-lag smoother: %d steps behind!", MAX_QUEUE_);
+    }
+  }
+  posted_.notify_all();
+}
+
+
+
+//
+// The latest smoothed state
+//
+bool FixedLagSmoother::smoothedState(rel_MEKF::relative_state &state)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if(!fresh_)
+    return false;
+
+  state = state_;
+  fresh_ = false;
+  return true;
+}
+
+
+
+//
+// The times of the solves
+//
+void FixedLagSmoother::solveTimes(std::vector<double> &times)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  times.insert(times.end(), solve_times_.begin(), solve_times_.end());
+  solve_times_.clear();
+}
+
+
+
+//
+// The thread of the smoother
+//
+void FixedLagSmoother::work()
+{
+  while(true)
+  {
+    boost::shared_ptr<const BankStep> step;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      while(running_ && queue_.empty())
+        posted_.wait(lock);
+
+      if(!running_)
+        return;
+
+      step = queue_.front();
+      queue_.pop_front();
+    }
+
+    process(*step);
+  }
+}
+
+
+
+//
+// Run the smoother through one loop
+//
+void FixedLagSmoother::process(const BankStep &step)
+{
+  //the estimator functions take references, so the shared data is copied out
+  IMU_message imu_data = step.imu.back();
+  sensor_msgs::Range alt = step.alt;
+  TRUTH_message truth = step.truth;
+  TRUTH_message *truth_data = step.has_truth ? &truth : NULL;
+
+  if(step.startup)
+    startup_flag_ = true; //follow the server (it sets the flag when we've landed)
+  just_landed_ = step.just_landed;
+
+  if(startup_flag_)
+  {
+    Hex_message hex = step.hex;
+    Initialize(imu_data, step.has_hex ? &hex : NULL, step.alt_index >= 0 ? &alt : NULL, truth_data);
+
+    window_.clear();
+    samples_.clear();
+    pending_vo_.clear();
+    alt_pending_ = false;
+    if(!startup_flag_)
+    {
+      startWindow(imu_data.header.stamp.toSec());
+      previous_gyro_ = saved_gyros_;
+    }
+    return;
+  }
+
+  //buffer the IMU and the altitude until the images come
+  for(int i = 0; i < (int)step.imu.size(); i++)
+  {
+    double last = samples_.empty() ? sample_time_ : samples_.back().header.stamp.toSec();
+    if(step.imu[i].header.stamp.toSec() > last)
+      samples_.push_back(step.imu[i]);
+
+    if(i == step.alt_index)
+    {
+      alt_ = step.alt;
+      alt_time_ = step.imu[i].header.stamp.toSec();
+      alt_pending_ = true;
+    }
+  }
+
+  pending_vo_.insert(pending_vo_.end(), step.vo.begin(), step.vo.end());
+  while((int)pending_vo_.size() > MAX_PENDING_VO_)
+    pending_vo_.pop_front();
+
+  //a state for each image, once the IMU has caught up with it
+  while(!pending_vo_.empty())
+  {
+    VO_message &vo_data = pending_vo_.front();
+    double image_time = vo_data.Timestamp().toSec();
+    if(samples_.empty() || samples_.back().header.stamp.toSec() < image_time)
+      break;
+
+    ros::WallTime start = ros::WallTime::now();
+    bool new_node = vo_data.NewReference();
+    bool added = addState(vo_data);
+    pending_vo_.pop_front();
+    if(!added)
+      continue;
+
+    while((int)window_.size() > mk_consts_->smoother_window)
+      marginalizeOldest();
+
+    Matrix<double,COVAR_LENGTH,COVAR_LENGTH> covariance;
+    solve(covariance);
+    if(new_node)
+    {
+      declareSmoothedNode(truth_data);
+      covariance = P_;
+    }
+
+    publishState(covariance, (ros::WallTime::now() - start).toSec()*1e6);
+  }
+}
+
+
+
+//
+// Start the window at the estimator's state
+//
+void FixedLagSmoother::startWindow(double time)
+{
+  SmootherState state;
+  state.time = time;
+  state.x = x_;
+  window_.clear();
+  window_.push_back(state);
+  sample_time_ = time;
+
+  //the covariance is singular after a new node (the position is exactly zero), so it's regularized
+  prior_state_ = x_;
+  prior_information_ = (P_ + 1e-10*Matrix<double,COVAR_LENGTH,COVAR_LENGTH>::Identity()).ldlt().solve(
+        Matrix<double,COVAR_LENGTH,COVAR_LENGTH>::Identity());
+}
+
+
+
+//
+// Add a state at an image
+//
+bool FixedLagSmoother::addState(VO_message &vo_data)
+{
+  double image_time = vo_data.Timestamp().toSec();
+  const SmootherState &last = window_.back();
+  if(image_time <= last.time || samples_.empty() || samples_.front().header.stamp.toSec() > image_time)
+    return false; //older than the window, or no IMU between (the state would be the same)
+
+  //the samples up to the image (the state is at the last one, like the image is in the MEKF's queues)
+  SmootherState state;
+  state.preintegration = startPreintegration(last.x);
+  while(!samples_.empty() && samples_.front().header.stamp.toSec() <= image_time)
+  {
+    IMU_message &sample = samples_.front();
+    Vector3d accel(sample.linear_acceleration.x, sample.linear_acceleration.y, sample.linear_acceleration.z);
+    state.preintegration.integrate(previous_gyro_, accel, sample.header.stamp.toSec() - sample_time_);
+    previous_gyro_ = Vector3d(sample.angular_velocity.x, sample.angular_velocity.y, sample.angular_velocity.z);
+    sample_time_ = sample.header.stamp.toSec();
+    state.imu = sample;
+    samples_.pop_front();
+  }
+
+  state.time = sample_time_;
+  state.x = preintegratedState(last.x, state.preintegration, Matrix<double,9,1>::Zero());
+  state.has_imu = true;
+  state.vo = vo_data;
+  state.has_vo = true;
+  if(alt_pending_ && alt_time_ <= state.time)
+  {
+    state.alt = alt_;
+    state.has_alt = true;
+    alt_pending_ = false;
+  }
+
+  window_.push_back(state);
+  return true;
+}
+
+
+
+//
+// Gauss-Newton on the window
+//
+void FixedLagSmoother::solve(Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &covariance)
+{
+  typedef Matrix<double,COVAR_LENGTH,COVAR_LENGTH> Block;
+  typedef Matrix<double,COVAR_LENGTH,1> Vector;
+  const int K = (int)window_.size();
+
+  //The states are only linked to their neighbours, so the normal equations are block tridiagonal:
+  //D (the diagonal blocks), U (the blocks above them, U[k] links k and k+1) and b
+  std::vector<Block, aligned_allocator<Block> > D(K), U(K), S(K);
+  std::vector<Vector, aligned_allocator<Vector> > b(K), y(K), delta(K);
+
+  for(int iteration = 0; iteration < mk_consts_->smoother_iterations; iteration++)
+  {
+    for(int k = 0; k < K; k++)
+    {
+      D[k].setZero();
+      U[k].setZero();
+      b[k].setZero();
+    }
+
+    addPrior(window_[0], D[0], b[0]);
+    for(int k = 0; k < K; k++)
+    {
+      addMeasurements(window_[k], D[k], b[k]);
+      if(k > 0)
+        addImuFactor(window_[k-1], window_[k], D[k-1], U[k-1], D[k], b[k-1], b[k]);
+    }
+
+    //Block Cholesky (forward elimination): S[k] = D[k] - U[k-1]' S[k-1]^-1 U[k-1]
+    std::vector<LLT<Block>, aligned_allocator<LLT<Block> > > factors(K);
+    S[0] = D[0];
+    y[0] = b[0];
+    factors[0].compute(S[0]);
+    for(int k = 1; k < K; k++)
+    {
+      Block L = factors[k-1].solve(U[k-1]).transpose(); //U[k-1]' S[k-1]^-1
+      S[k] = D[k] - L*U[k-1];
+      y[k] = b[k] - L*y[k-1];
+      factors[k].compute(S[k]);
+    }
+
+    //Back substitution
+    delta[K-1] = factors[K-1].solve(y[K-1]);
+    for(int k = K - 2; k >= 0; k--)
+      delta[k] = factors[k].solve(y[k] - U[k]*delta[k+1]);
+
+    double largest = 0.0;
+    for(int k = 0; k < K; k++)
+    {
+      window_[k].x = correctedState(window_[k].x, delta[k]);
+      largest = std::max(largest, delta[k].cwiseAbs().maxCoeff());
+    }
+
+    //the marginal covariance of the last state is the inverse of its last Schur complement
+    covariance = factors[K-1].solve(Block::Identity());
+    if(largest < 1e-9)
+      break;
+  }
+}
+
+
+
+//
+// Marginalize the oldest state
+//
+void FixedLagSmoother::marginalizeOldest()
+{
+  typedef Matrix<double,COVAR_LENGTH,COVAR_LENGTH> Block;
+  Block H_00 = Block::Zero(), H_01 = Block::Zero(), H_11 = Block::Zero();
+  Matrix<double,COVAR_LENGTH,1> b_0 = Matrix<double,COVAR_LENGTH,1>::Zero(), b_1 = b_0;
+
+  //the factors of the oldest state, at the current estimates
+  addPrior(window_[0], H_00, b_0);
+  addMeasurements(window_[0], H_00, b_0);
+  addImuFactor(window_[0], window_[1], H_00, H_01, H_11, b_0, b_1);
+
+  //Schur complement, the information and the mean of the new prior:
+  LDLT<Block> oldest(H_00);
+  prior_information_ = H_11 - H_01.transpose()*oldest.solve(H_01);
+  prior_information_ = 0.5*(prior_information_ + prior_information_.transpose());
+  Matrix<double,COVAR_LENGTH,1> g = b_1 - H_01.transpose()*oldest.solve(b_0);
+  prior_state_ = correctedState(window_[1].x, prior_information_.ldlt().solve(g));
+
+  window_.pop_front();
+}
+
+
+
+//
+// Collapse the window at a new node
+//
+void FixedLagSmoother::declareSmoothedNode(TRUTH_message *truth_data)
+{
+  while((int)window_.size() > 1)
+    marginalizeOldest();
+
+  //the estimate of the last state with its prior and measurements
+  typedef Matrix<double,COVAR_LENGTH,COVAR_LENGTH> Block;
+  Block H = Block::Zero();
+  Matrix<double,COVAR_LENGTH,1> b = Matrix<double,COVAR_LENGTH,1>::Zero();
+  addPrior(window_[0], H, b);
+  addMeasurements(window_[0], H, b);
+  LDLT<Block> last(H);
+  x_ = correctedState(window_[0].x, last.solve(b));
+  P_ = last.solve(Block::Identity());
+  P_ = 0.5*(P_ + P_.transpose());
+
+  //the node is declared like the MEKF does (its state and covariance are reset), and the window starts there
+  saved_deltatheta_.setZero();
+  declareNode(truth_data);
+
+  double time = window_[0].time;
+  startWindow(time);
+}
+
+
+
+//
+// Predict the last state to the latest sample
+//
+void FixedLagSmoother::publishState(const Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &covariance, double elapsed)
+{
+  x_ = window_.back().x;
+  P_ = covariance;
+
+  ros::Time stamp = ros::Time(window_.back().time);
+  if(!samples_.empty())
+  {
+    ImuPreintegration preintegration = startPreintegration(x_);
+    Vector3d gyro = previous_gyro_;
+    double time = sample_time_;
+    for(int i = 0; i < (int)samples_.size(); i++)
+    {
+      IMU_message &sample = samples_[i];
+      Vector3d accel(sample.linear_acceleration.x, sample.linear_acceleration.y, sample.linear_acceleration.z);
+      preintegration.integrate(gyro, accel, sample.header.stamp.toSec() - time);
+      gyro = Vector3d(sample.angular_velocity.x, sample.angular_velocity.y, sample.angular_velocity.z);
+      time = sample.header.stamp.toSec();
+    }
+    stamp = samples_.back().header.stamp;
+
+    Matrix<double,STATE_LENGTH,1> x_end;
+    Matrix<double,COVAR_LENGTH,COVAR_LENGTH> F;
+    Matrix<double,COVAR_LENGTH,9> G_delta;
+    preintegratedJacobians(x_, preintegration, x_end, F, G_delta);
+    x_ = x_end;
+    P_ = F*P_*F.transpose() + G_delta*preintegration.covariance()*G_delta.transpose() + preintegration.deltaTime()*Q_;
+    P_ = 0.5*(P_ + P_.transpose());
+  }
+
+  rel_MEKF::relative_state state = packageStateInMessage(stamp);
+  boost::mutex::scoped_lock lock(mutex_);
+  state_ = state;
+  fresh_ = true;
+  solve_times_.push_back(elapsed);
+}
+
+
+
+//
+// The prior factor
+//
+void FixedLagSmoother::addPrior(const SmootherState &state, Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &H,
+                                Matrix<double,COVAR_LENGTH,1> &b)
+{
+  Matrix<double,COVAR_LENGTH,1> error = stateDifference(state.x, prior_state_);
+  H += prior_information_;
+  b -= prior_information_*error;
+}
+
+
+
+//
+// The measurement factors of a state
+//
+void FixedLagSmoother::addMeasurements(SmootherState &state, Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &H,
+                                       Matrix<double,COVAR_LENGTH,1> &b)
+{
+  //the measurement models work on x_
+  x_ = state.x;
+
+  if(state.has_vo)
+  {
+    Matrix<double,6,1> residual;
+    Matrix<double,6,COVAR_LENGTH> C_v;
+    Matrix<double,6,6> R_v;
+    visionMeasurement(state.vo, NULL, residual, C_v, R_v);
+    Matrix<double,COVAR_LENGTH,6> CW = C_v.transpose()*R_v.inverse();
+    H += CW*C_v;
+    b += CW*residual;
+  }
+
+  if(state.has_alt)
+  {
+    double residual, variance;
+    Matrix<double,1,COVAR_LENGTH> C_a;
+    if(altitudeMeasurement(state.alt, state.x, residual, C_a, variance))
+    {
+      H += C_a.transpose()*C_a/variance;
+      b += C_a.transpose()*residual/variance;
+    }
+  }
+
+  if(state.has_imu)
+  {
+    //the drag model of imuMeasurementUpdate()
+    Vector2d residual;
+    Matrix<double,2,COVAR_LENGTH> C_i = Matrix<double,2,COVAR_LENGTH>::Zero();
+    C_i(0,6) = -drag_;
+    C_i(0,12) = 1;
+    C_i(1,7) = -drag_;
+    C_i(1,13) = 1;
+    residual(0) = state.imu.linear_acceleration.x - (-drag_*state.x(7,0) + state.x(13,0));
+    residual(1) = state.imu.linear_acceleration.y - (-drag_*state.x(8,0) + state.x(14,0));
+
+    Matrix<double,COVAR_LENGTH,2> CW = C_i.transpose()*R_i_.inverse();
+    H += CW*C_i;
+    b += CW*residual;
+  }
+}
+
+
+
+//
+// The IMU factor between two states
+//
+void FixedLagSmoother::addImuFactor(const SmootherState &previous, SmootherState &state,
+                                    Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &H_pp,
+                                    Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &H_ps,
+                                    Matrix<double,COVAR_LENGTH,COVAR_LENGTH> &H_ss,
+                                    Matrix<double,COVAR_LENGTH,1> &b_p, Matrix<double,COVAR_LENGTH,1> &b_s)
+{
+  typedef Matrix<double,COVAR_LENGTH,COVAR_LENGTH> Block;
+  Matrix<double,STATE_LENGTH,1> predicted;
+
+  //the Jacobians are kept until the previous state moves (they change slowly, and they are most of the cost)
+  if(!state.linearized ||
+     stateDifference(previous.x, state.linearization).cwiseAbs().maxCoeff() > mk_consts_->smoother_relinearize)
+  {
+    Matrix<double,COVAR_LENGTH,9> G_delta;
+    preintegratedJacobians(previous.x, state.preintegration, predicted, state.F, G_delta);
+    Block noise = G_delta*state.preintegration.covariance()*G_delta.transpose() +
+        state.preintegration.deltaTime()*Q_ + 1e-15*Block::Identity();
+    state.information = noise.ldlt().solve(Block::Identity());
+    state.linearization = previous.x;
+    state.linearized = true;
+  }
+  else
+  {
+    predicted = preintegratedState(previous.x, state.preintegration, Matrix<double,9,1>::Zero());
+  }
+
+  //error = state - f(previous), with the Jacobians I and -F
+  Matrix<double,COVAR_LENGTH,1> error = stateDifference(state.x, predicted);
+  Block FW = state.F.transpose()*state.information;
+  H_pp += FW*state.F;
+  H_ps -= FW;
+  H_ss += state.information;
+  b_p += FW*error;
+  b_s -= state.information*error;
+}
+
+
+
+//
+// A corrected copy of a state
+//
+Matrix<double,STATE_LENGTH,1> FixedLagSmoother::correctedState(const Matrix<double,STATE_LENGTH,1> &x,
+                                                               Matrix<double,COVAR_LENGTH,1> delta_x)
+{
+  Matrix<double,STATE_LENGTH,1> x_now = x_;
+  x_ = x;
+  applyCorrection(delta_x);
+  normalizeQuaternion();
+  Matrix<double,STATE_LENGTH,1> corrected = x_;
+  x_ = x_now;
+  return corrected;
+}
+
+}
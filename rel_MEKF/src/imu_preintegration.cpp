@@ -0,0 +1,194 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*!
+ *  \file imu_preintegration.cpp
+ *  \author agent
+ *  \date October 2026
+*/
+
+
+#include <iostream>
+#include "rel_estimator/imu_preintegration.h"
+#include "rel_estimator/eigen_utils.h"
+
+namespace rel_MEKF
+{
+
+using namespace Eigen;
+
+
+//
+// Default Constructor
+//
+ImuPreintegration::ImuPreintegration()
+{
+  gyro_covariance_.setZero();
+  accel_covariance_.setZero();
+  reset(Vector3d::Zero(), Vector3d::Zero());
+}
+
+
+
+//
+// Constructor: save the sensor noise
+//
+ImuPreintegration::ImuPreintegration(const Matrix3d &gyro_covariance, const Matrix3d &accel_covariance)
+{
+  gyro_covariance_ = gyro_covariance;
+  accel_covariance_ = accel_covariance;
+  reset(Vector3d::Zero(), Vector3d::Zero());
+}
+
+
+
+//
+// Start a new interval
+//
+void ImuPreintegration::reset(const Vector3d &gyro_bias, const Vector3d &accel_bias)
+{
+  gyro_bias_ = gyro_bias;
+  accel_bias_ = accel_bias;
+
+  delta_R_.setIdentity();
+  delta_v_.setZero();
+  delta_p_.setZero();
+  delta_t_ = 0.0;
+
+  covariance_.setZero();
+  dR_dbg_.setZero();
+  dV_dbg_.setZero();
+  dV_dba_.setZero();
+  dP_dbg_.setZero();
+  dP_dba_.setZero();
+}
+
+
+
+//
+// Add one IMU sample
+//
+void ImuPreintegration::integrate(const Vector3d &gyro, const Vector3d &accel, double dt)
+{
+  if(dt <= 0.0)
+    return;
+
+  Vector3d omega = gyro - gyro_bias_;
+  Vector3d a = accel - accel_bias_;
+  Vector3d phi = omega*dt;
+  Matrix3d step_R = expMap(phi); //the rotation over this sample
+  Matrix3d J_r = rightJacobian(phi);
+  Matrix3d R_a = delta_R_*skew(a); //dR*[a]x, used everywhere below
+
+  //The covariance is propagated with the deltas before this sample (the order matters):
+  //                 [dphi                 dv      dp]
+  //  A =  dphi      [step_R'              0       0 ]
+  //       dv        [-dR*[a]x*dt          I       0 ]
+  //       dp        [-0.5*dR*[a]x*dt^2    I*dt    I ]
+  Matrix<double,9,9> A;
+  A.setIdentity();
+  A.block<3,3>(0,0) = step_R.transpose();
+  A.block<3,3>(3,0) = -R_a*dt;
+  A.block<3,3>(6,0) = -0.5*R_a*dt*dt;
+  A.block<3,3>(6,3) = Matrix3d::Identity()*dt;
+
+  Matrix<double,9,3> B_g; //noise input of the gyro
+  B_g.setZero();
+  B_g.block<3,3>(0,0) = J_r*dt;
+
+  Matrix<double,9,3> B_a; //noise input of the accelerometer
+  B_a.setZero();
+  B_a.block<3,3>(3,0) = delta_R_*dt;
+  B_a.block<3,3>(6,0) = 0.5*delta_R_*dt*dt;
+
+  covariance_ = A*covariance_*A.transpose() + B_g*gyro_covariance_*B_g.transpose()
+      + B_a*accel_covariance_*B_a.transpose();
+
+  //The bias Jacobians, position first since it uses the old velocity ones:
+  dP_dba_ += dV_dba_*dt - 0.5*delta_R_*dt*dt;
+  dP_dbg_ += dV_dbg_*dt - 0.5*R_a*dR_dbg_*dt*dt;
+  dV_dba_ -= delta_R_*dt;
+  dV_dbg_ -= R_a*dR_dbg_*dt;
+  dR_dbg_ = step_R.transpose()*dR_dbg_ - J_r*dt;
+
+  //And the deltas themselves:
+  delta_p_ += delta_v_*dt + 0.5*delta_R_*a*dt*dt;
+  delta_v_ += delta_R_*a*dt;
+  delta_R_ = delta_R_*step_R;
+  delta_t_ += dt;
+}
+
+
+
+//
+// Delta rotation with new bias estimates
+//
+Matrix3d ImuPreintegration::correctedDeltaR(const Vector3d &gyro_bias) const
+{
+  return delta_R_*expMap(dR_dbg_*(gyro_bias - gyro_bias_));
+}
+
+
+
+//
+// Delta velocity with new bias estimates
+//
+Vector3d ImuPreintegration::correctedDeltaV(const Vector3d &gyro_bias, const Vector3d &accel_bias) const
+{
+  return delta_v_ + dV_dbg_*(gyro_bias - gyro_bias_) + dV_dba_*(accel_bias - accel_bias_);
+}
+
+
+
+//
+// Delta position with new bias estimates
+//
+Vector3d ImuPreintegration::correctedDeltaP(const Vector3d &gyro_bias, const Vector3d &accel_bias) const
+{
+  return delta_p_ + dP_dbg_*(gyro_bias - gyro_bias_) + dP_dba_*(accel_bias - accel_bias_);
+}
+
+
+
+//
+// Exponential map of SO(3)
+//
+Matrix3d ImuPreintegration::expMap(const Vector3d &phi)
+{
+  double theta = phi.norm();
+  if(theta < 1e-10)
+    return Matrix3d::Identity() + skew(phi);
+
+  return AngleAxisd(theta, phi/theta).toRotationMatrix();
+}
+
+
+
+//
+// Logarithm map of SO(3)
+//
+Vector3d ImuPreintegration::logMap(const Matrix3d &R)
+{
+  AngleAxisd rotation(R);
+  return rotation.angle()*rotation.axis();
+}
+
+
+
+//
+// Right Jacobian of SO(3)
+//
+Matrix3d ImuPreintegration::rightJacobian(const Vector3d &phi)
+{
+  double theta = phi.norm();
+  Matrix3d phi_x = skew(phi);
+  if(theta < 1e-5)
+    return Matrix3d::Identity() - 0.5*phi_x; //the second order term is below round off
+
+  double theta2 = theta*theta;
+  return Matrix3d::Identity() - (1.0 - cos(theta))/theta2*phi_x + (theta - sin(theta))/(theta2*theta)*phi_x*phi_x;
+}
+
+}
@@ -18,6 +18,8 @@
 #include "rel_estimator/constants.h"
 #include <boost/thread.hpp>
 
+using namespace rel_MEKF;
+
 
 
 /*!
@@ -32,10 +34,10 @@ int main(int argc, char **argv)
 
   /// \note Any string passed into the node handle like this will be prepended to any topics published by this node
   ros::NodeHandle nh("relative");
+  ros::NodeHandle private_nh("~");
 
-  Constants consts;
-
-  ROSServer server(nh, &consts);
+  //The Estimator deletes its constants, so they are allocated here and handed over:
+  ROSServer server(nh, private_nh, new Constants);
 
   //Start another thread to run the main loop:
   boost::thread* process_thread = new boost::thread(&ROSServer::Run,&server);
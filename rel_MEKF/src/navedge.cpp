@@ -6,6 +6,9 @@
 
 #include "rel_estimator/navedge.h"
 
+namespace rel_MEKF
+{
+
 using namespace Eigen;
 
 //
@@ -80,5 +83,7 @@ void NavEdge::yawRotation(Quaterniond &orientation)
                  0,0,1;
 }
 
+}
+
 
 
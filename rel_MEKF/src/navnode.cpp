@@ -15,6 +15,9 @@
 #include "rel_estimator/navnode.h"
 #include "rel_estimator/navedge.h"
 
+namespace rel_MEKF
+{
+
 using namespace Eigen;
 
 
@@ -107,3 +110,5 @@ void NavNode::createRotationMatrix()
 
   R_node_to_body_ = roll*pitch;
 }
+
+}
@@ -0,0 +1,73 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*! \file nodelet.cpp
+  * \brief A nodelet version of the relative_MEKF node.  It runs the ROSServer (and its estimation thread) inside a
+  * nodelet manager, so the VO input and the state output are passed without being serialized or copied.
+  *
+*/
+
+#include <ros/ros.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include "pluginlib/class_list_macros.h"
+#include "nodelet/nodelet.h"
+#include "rel_estimator/ros_server.h"
+#include "rel_estimator/constants.h"
+
+
+namespace rel_MEKF
+{
+
+/*!
+ *  \class EstimatorNodelet nodelet.cpp "src/nodelet.cpp"
+ *  \brief Nodelet wrapper for ROSServer.  Does what main.cpp does for the node: the topics are in the "relative"
+ *  namespace and ROSServer::Run() is started on its own thread, which is stopped when the nodelet is unloaded.
+*/
+class EstimatorNodelet : public nodelet::Nodelet
+{
+public:
+  //Constructor
+  EstimatorNodelet()
+  {
+  }
+
+  ~EstimatorNodelet()
+  {
+    if(server_)
+    {
+      //send signal to the estimation thread to exit, and wait for it before the server is destroyed (however long it
+      //takes, Run() uses the server until it returns)
+      server_->accessWhileTrue(0);
+      if(!process_thread_.timed_join(boost::posix_time::seconds(2)))
+      {
+        NODELET_ERROR("The estimation thread did not finish in 2 s, still waiting for it");
+        process_thread_.join();
+      }
+    }
+  }
+
+private:
+
+  virtual void onInit()
+  {
+    /// \note The Run() thread and the callbacks share the data through the mutexes in ros_server.h, the callbacks
+    /// themselves are not written to run concurrently so use the single threaded queue
+    ros::NodeHandle nh(getNodeHandle(), "relative");
+    ros::NodeHandle& private_nh = getPrivateNodeHandle();
+
+    //the Estimator deletes its constants, so they are allocated here and handed over
+    server_.reset(new ROSServer(nh, private_nh, new Constants));
+
+    process_thread_ = boost::thread(&ROSServer::Run, server_.get());
+  }
+
+  boost::shared_ptr<ROSServer> server_; //!< the estimator's ROS interface
+  boost::thread process_thread_; //!< runs ROSServer::Run()
+};
+
+//This code is essential for making the nodelet
+PLUGINLIB_DECLARE_CLASS(rel_MEKF, EstimatorNodelet, rel_MEKF::EstimatorNodelet, nodelet::Nodelet);
+}
@@ -0,0 +1,127 @@
+ /* \copyright Written by agent <agent@local> in 2026, as a contribution to this package.  It is not a work of the
+  * U.S. Government; the author dedicates it to the public domain to match the rest of the package, so it can be
+  * used by anyone for any purpose.
+  */
+
+/*! \file reset_check.cpp
+  * \author agent
+  * \date October 2026
+  * \brief reset_check.cpp checks the keyframe reset of the covariance (Estimator::resetCovariance()) against its
+  * original dense form (Estimator::resetCovarianceDense()) on random covariances.  No ROS or bag is needed.
+  *
+  * Usage:
+  * \code
+  *   reset_check [--trials 10000] [--seed 1]
+  * \endcode
+  *
+  * Each trial draws a random SPD covariance (with its scales spread over several decades, like the filter's) and a
+  * random attitude correction, resets a copy of the covariance both ways and takes the largest difference of an entry
+  * relative to its standard deviations (see relativeDifference()).  The reset covariance has to stay symmetric too.
+  * Exits non-zero if any trial is off by more than a few rounding errors.
+*/
+
+#include "rel_estimator/estimator.h"
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/variate_generator.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace rel_MEKF;
+
+typedef Eigen::Matrix<double,COVAR_LENGTH,COVAR_LENGTH> Covariance;
+typedef boost::variate_generator<boost::mt19937&, boost::normal_distribution<> > NormalGenerator;
+
+static const double TOLERANCE = 1e-12; //!< of the relative difference (the dense form sums a few more zeros)
+
+
+/*!
+ *  \brief A random SPD covariance, D*M*M'*D + a small diagonal, with the scales D spread over 1e-4 to 1e2
+*/
+static Covariance randomCovariance(NormalGenerator &normal)
+{
+  Covariance M, D = Covariance::Zero();
+  for(int i = 0; i < COVAR_LENGTH; i++)
+  {
+    for(int j = 0; j < COVAR_LENGTH; j++)
+      M(i,j) = normal();
+    D(i,i) = std::pow(10.0, -4.0 + 6.0*i/(COVAR_LENGTH - 1));
+  }
+  Covariance P = D*M*M.transpose()*D;
+  P.diagonal() += 1e-3*D.diagonal().cwiseAbs2();
+  return P;
+}
+
+
+
+/*!
+ *  \brief The largest entry of A - B, each relative to the standard deviations of its row and column in P.  The first
+ *  6 rows take those of dqx, dqy (the reset leaves the positions zero and the attitude from dqx, dqy).
+*/
+static double relativeDifference(const Covariance &A, const Covariance &B, const Covariance &P)
+{
+  Eigen::Matrix<double,COVAR_LENGTH,1> sigma = P.diagonal().cwiseSqrt();
+  sigma.head<6>().setConstant(std::max(sigma(3), sigma(4)));
+  return ((A - B).cwiseAbs().array() / (sigma*sigma.transpose()).array()).maxCoeff();
+}
+
+
+
+int main(int argc, char **argv)
+{
+  int trials = 10000;
+  unsigned int seed = 1;
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if(arg == "--trials" && i + 1 < argc)
+      trials = atoi(argv[++i]);
+    else if(arg == "--seed" && i + 1 < argc)
+      seed = atoi(argv[++i]);
+    else
+    {
+      fprintf(stderr, "Usage: reset_check [--trials 10000] [--seed 1]\n");
+      return 1;
+    }
+  }
+
+  boost::mt19937 engine(seed);
+  NormalGenerator normal(engine, boost::normal_distribution<>(0.0, 1.0));
+
+  double worst = 0.0, worst_symmetry = 0.0;
+  int failed = 0;
+  for(int t = 0; t < trials; t++)
+  {
+    Covariance P = randomCovariance(normal);
+    //attitude corrections from tiny to large (about 0.5 rad)
+    Eigen::Vector3d delta_quat(normal(), normal(), normal());
+    delta_quat *= 0.2*std::pow(10.0, -3.0*(t % 4)/3.0);
+    Eigen::Matrix<double,3,2> J = Estimator::resetJacobian(delta_quat);
+
+    Covariance structured = P, dense = P;
+    Estimator::resetCovariance(structured, J);
+    Estimator::resetCovarianceDense(dense, J);
+
+    double difference = relativeDifference(structured, dense, P);
+    double symmetry = relativeDifference(structured, structured.transpose(), P);
+    worst = std::max(worst, difference);
+    worst_symmetry = std::max(worst_symmetry, symmetry);
+    if(!(difference <= TOLERANCE) || !(symmetry <= TOLERANCE))
+    {
+      if(failed < 5)
+        printf("FAIL: trial %d differs by %g, asymmetry %g (relative)\n", t, difference, symmetry);
+      failed++;
+    }
+  }
+
+  printf("%d trials: largest relative difference %g, asymmetry %g\n", trials, worst, worst_symmetry);
+  if(failed)
+  {
+    printf("FAIL: %d trials off by more than %g\n", failed, TOLERANCE);
+    return 1;
+  }
+  printf("OK\n");
+  return 0;
+}
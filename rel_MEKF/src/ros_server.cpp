@@ -14,6 +14,9 @@
 
 #include "rel_estimator/ros_server.h"
 
+namespace rel_MEKF
+{
+
 pthread_mutex_t w_mutex_ = PTHREAD_MUTEX_INITIALIZER; //!< the mutex for the while_true_ access
 pthread_mutex_t i_mutex_ = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t v_mutex_ = PTHREAD_MUTEX_INITIALIZER;
@@ -24,61 +27,95 @@ pthread_mutex_t h_mutex_ = PTHREAD_MUTEX_INITIALIZER;
 //
 // Constructor
 //
-ROSServer::ROSServer(ros::NodeHandle &nh, Constants *mk_const): mk_consts_(mk_const)
+ROSServer::ROSServer(ros::NodeHandle &nh, ros::NodeHandle &private_nh, Constants *mk_const): mk_consts_(mk_const)
 {
+  //load the constants (the defaults are kept for any not on the server), before anything copies them:
+  if(!mk_const->load(ros::NodeHandle(private_nh, "constants")))
+    ROS_WARN("Some parameters under ~constants were not used (see the errors above), check their names.");
+
   //setup the Estimator:
   estimator_ = new Estimator(mk_const);
 
   //initialize while_true_
   while_true_ = 1;
 
-  std::string imu_topic,vo_topic,alt_topic,truth_topic,hex_topic,pose_topic,global_topic,global_node_topic,edge_topic;
+  bool use_imu_batch;
+  bool use_estimator_bank;
+  bool use_smoother;
+  bool use_oosm;
+  std::string latency_trace_topic;
+  bool latency_trace;
+  std::string imu_topic,imu_batch_topic,vo_topic,alt_topic,truth_topic,hex_topic,pose_topic,smoothed_topic,global_topic,global_node_topic,edge_topic;
 
   //retrieve names from server
 #ifndef LASER
-  ros::param::param<std::string>("~alt_topic", alt_topic, "/alt_msgs");
+  private_nh.param<std::string>("alt_topic", alt_topic, "/alt_msgs");
 #else
   ROS_WARN("****************************************************************************************");
   ROS_WARN("LASER IN USE: SONAR ALTIMETER IS NOT IN USE - NOT RECOMMENDED FOR AUTONOMOUS BEHAVIOUR!!");
   ROS_WARN("****************************************************************************************");
-  ros::param::param<std::string>("~alt_topic", alt_topic, "/scan");
+  private_nh.param<std::string>("alt_topic", alt_topic, "/scan");
 #endif
 
-  ros::param::param<std::string>("~imu_topic", imu_topic, "/imu/data");
-  ros::param::param<std::string>("~vo_topic", vo_topic, "/kinect_visual_odometry/vo_transformation");
-  ros::param::param<std::string>("~mocap_topic", truth_topic, "/evart/heavy_ros/base");
-  ros::param::param<std::string>("~hex_debug_topic", hex_topic, "/mikoImu"); // /imu/data
-  ros::param::param<std::string>("~output_rel_topic", pose_topic, "states");
-  ros::param::param<std::string>("~estimated_global_topic", global_topic, "global_pose");
-  ros::param::param<std::string>("~node_global_pose_topic",global_node_topic,"cur_node/global");
-  ros::param::param<std::string>("~current_edge_topic",edge_topic,"cur_edge/pose");
-  ros::param::param<std::string>("~node_frame_name", node_frame_name_, "/node_frame");
-  ros::param::param<std::string>("~body_frame_name", body_frame_name_, "/node_frame/body_fixed");
-  ros::param::param<std::string>("~global_frame_name", global_frame_name_, "/global_frame"); //gives the global frame a name
-  ros::param::param<std::string>("~global_body_name", global_body_frame_name_, "/global_frame/body-fixed"); //the current pose in the global coordinates
-  ros::param::param<std::string>("~base__node_name", base_node_name_, "/global_frame/node_"); //the basic name that is appended with the node id for the name
+  private_nh.param<std::string>("imu_topic", imu_topic, "/imu/data");
+  private_nh.param<bool>("use_imu_batch", use_imu_batch, false);
+  private_nh.param<std::string>("imu_batch_topic", imu_batch_topic, "/imu/data_batch");
+  private_nh.param<std::string>("vo_topic", vo_topic, "/kinect_visual_odometry/vo_transformation");
+  private_nh.param<std::string>("mocap_topic", truth_topic, "/evart/heavy_ros/base");
+  private_nh.param<std::string>("hex_debug_topic", hex_topic, "/mikoImu"); // /imu/data
+  private_nh.param<std::string>("output_rel_topic", pose_topic, "states");
+  private_nh.param<std::string>("smoothed_rel_topic", smoothed_topic, "smoothed_states");
+  private_nh.param<std::string>("estimated_global_topic", global_topic, "global_pose");
+  private_nh.param<std::string>("node_global_pose_topic",global_node_topic,"cur_node/global");
+  private_nh.param<std::string>("current_edge_topic",edge_topic,"cur_edge/pose");
+  private_nh.param<std::string>("node_frame_name", node_frame_name_, "/node_frame");
+  private_nh.param<std::string>("body_frame_name", body_frame_name_, "/node_frame/body_fixed");
+  private_nh.param<std::string>("global_frame_name", global_frame_name_, "/global_frame"); //gives the global frame a name
+  private_nh.param<std::string>("global_body_name", global_body_frame_name_, "/global_frame/body-fixed"); //the current pose in the global coordinates
+  private_nh.param<std::string>("base__node_name", base_node_name_, "/global_frame/node_"); //the basic name that is appended with the node id for the name
+  private_nh.param<bool>("latency_trace", latency_trace, true);
+  private_nh.param<std::string>("latency_trace_topic", latency_trace_topic, "/latency_trace");
+  private_nh.param<bool>("use_estimator_bank", use_estimator_bank, false);
+  private_nh.param<bool>("use_smoother", use_smoother, false);
+  private_nh.param<bool>("use_oosm", use_oosm, false);
+  private_nh.param<bool>("preintegrate_imu_batch", preintegrate_imu_batch_, false);
 
 
   /*!
     This segment documents the parameters available to modify on the parameter server:
     \code{.cpp}
-  ros::param::param<std::string>("~imu_topic", imu_topic, "/imu/data");  //!< the IMU topic name
-  ros::param::param<std::string>("~vo_topic", vo_topic, "/kinect_visual_odometry/vo_transformation"); //!< the visual odometry topic name
-  ros::param::param<std::string>("~alt_topic", alt_topic, "/alt_msgs"); //!< the altimeter topic (not sure what to do about laser topic)
-  ros::param::param<std::string>("~mocap_topic", truth_topic, "/evart/heavy_ros/base"); //!< the topic for the motion capture truth
-  ros::param::param<std::string>("~hex_debug_topic", hex_topic, "/mikoImu"); //!< the topic for the hexacopter debug data
-  ros::param::param<std::string>("~output_rel_topic", pose_topic, "relative/pose");  //!< the pose topic that is published by this class
-  ros::param::param<std::string>("~estimated_global_topic", global_topic, "global_pose");
-  ros::param::param<std::string>("~node_global_pose_topic",global_node_topic,"/cur_node/global"); //!< topic on which we publish the current node global pose
-  ros::param::param<std::string>("~current_edge_topic",edge_topic,"/cur_edge/pose");
-  ros::param::param<std::string>("~global_frame_name", global_frame_name_, "/node_frame");//!< name for the node coord. frame
-  ros::param::param<std::string>("~body_frame_name", body_frame_name_, "/body_fixed");//!< name for the body fixed frame
+  private_nh.param<std::string>("imu_topic", imu_topic, "/imu/data");  //!< the IMU topic name
+  private_nh.param<bool>("use_imu_batch", use_imu_batch, false); //!< subscribe to the batched IMU samples instead
+  private_nh.param<std::string>("imu_batch_topic", imu_batch_topic, "/imu/data_batch"); //!< the batched IMU topic name
+  private_nh.param<std::string>("vo_topic", vo_topic, "/kinect_visual_odometry/vo_transformation"); //!< the visual odometry topic name
+  private_nh.param<std::string>("alt_topic", alt_topic, "/alt_msgs"); //!< the altimeter topic (not sure what to do about laser topic)
+  private_nh.param<std::string>("mocap_topic", truth_topic, "/evart/heavy_ros/base"); //!< the topic for the motion capture truth
+  private_nh.param<std::string>("hex_debug_topic", hex_topic, "/mikoImu"); //!< the topic for the hexacopter debug data
+  private_nh.param<std::string>("output_rel_topic", pose_topic, "relative/pose");  //!< the pose topic that is published by this class
+  private_nh.param<std::string>("smoothed_rel_topic", smoothed_topic, "smoothed_states");  //!< the topic of the smoother's states
+  private_nh.param<std::string>("estimated_global_topic", global_topic, "global_pose");
+  private_nh.param<std::string>("node_global_pose_topic",global_node_topic,"/cur_node/global"); //!< topic on which we publish the current node global pose
+  private_nh.param<std::string>("current_edge_topic",edge_topic,"/cur_edge/pose");
+  private_nh.param<std::string>("global_frame_name", global_frame_name_, "/node_frame");//!< name for the node coord. frame
+  private_nh.param<std::string>("body_frame_name", body_frame_name_, "/body_fixed");//!< name for the body fixed frame
+  private_nh.param<bool>("latency_trace", latency_trace, true); //!< publish the estimator stages of the VO frames' latency trace
+  private_nh.param<std::string>("latency_trace_topic", latency_trace_topic, "/latency_trace"); //!< topic for the stages (same in every node)
+  private_nh.param<bool>("use_estimator_bank", use_estimator_bank, false); //!< run the filters without each sensor (3 more threads) to isolate faults
+  private_nh.param<bool>("use_smoother", use_smoother, false); //!< run the fixed-lag smoother (one more thread) and publish its states at the VO rate
+  private_nh.param<bool>("use_oosm", use_oosm, false); //!< fuse delayed VO without repropagating, except for new keyframes (Estimator::useRetrodiction())
+  private_nh.param<bool>("preintegrate_imu_batch", preintegrate_imu_batch_, false); //!< one preintegrated prediction per loop instead of one per IMU sample (Estimator::batchPrediction())
+  ros::param::get("~constants/<name>", value); //!< overrides the Constants member <name> (e.g. ~constants/Q_u), read once at startup (Constants::load())
     \endcode
 
   */
 
+  estimator_->useRetrodiction(use_oosm);
+
   //assign callbacks to the subscribers:
-  imu_subscriber_ = nh.subscribe(imu_topic,5,&ROSServer::imuCallback,this);
+  if(use_imu_batch)
+    imu_subscriber_ = nh.subscribe(imu_batch_topic,5,&ROSServer::imuBatchCallback,this);
+  else
+    imu_subscriber_ = nh.subscribe(imu_topic,5,&ROSServer::imuCallback,this);
   vo_subscriber_ = nh.subscribe(vo_topic,5,&ROSServer::visualCallback,this);
   alt_subscriber_ = nh.subscribe(alt_topic,5,&ROSServer::altCallback,this);
   truth_subscriber_ = nh.subscribe(truth_topic,5,&ROSServer::truthCallback,this);
@@ -89,9 +126,13 @@ ROSServer::ROSServer(ros::NodeHandle &nh, Constants *mk_const): mk_consts_(mk_co
 
   //publishers:
   rel_state_publisher_ = nh.advertise<rel_MEKF::relative_state>(pose_topic,5);
+  if(use_smoother)
+    smoothed_state_publisher_ = nh.advertise<rel_MEKF::relative_state>(smoothed_topic,5);
   global_pose_publisher_ = nh.advertise<geometry_msgs::TransformStamped>(global_topic, 5);
   node_global_pub_ = nh.advertise<geometry_msgs::TransformStamped>(global_node_topic,5);
   edge_pub_ = nh.advertise<rel_MEKF::edge>(edge_topic,5);
+  if(latency_trace)
+    latency_trace_.advertise(nh, latency_trace_topic);
 
 #ifdef LASER
 #ifdef DETECT
@@ -104,6 +145,16 @@ ROSServer::ROSServer(ros::NodeHandle &nh, Constants *mk_const): mk_consts_(mk_co
 
   past_accz_ = 0;
 
+  //the bank runs on its own threads, next to the main filter
+  bank_ = NULL;
+  if(use_estimator_bank)
+    bank_ = new EstimatorBank(mk_const);
+
+  //and so does the smoother
+  smoother_ = NULL;
+  if(use_smoother)
+    smoother_ = new FixedLagSmoother(mk_const);
+
   ROS_INFO_ONCE("Listening to the IMU, VO, Altimeter, Hex, and Truth Topics!");
 }
 
@@ -113,7 +164,8 @@ ROSServer::ROSServer(ros::NodeHandle &nh, Constants *mk_const): mk_consts_(mk_co
 //
 ROSServer::~ROSServer()
 {
-  estimator_->~Estimator();
+  delete bank_;
+  delete smoother_;
   delete estimator_;
 }
 
@@ -124,19 +176,27 @@ ROSServer::~ROSServer()
 void ROSServer::Run()
 {
   IMU_message imu_data;
+  std::vector<IMU_message> imu_batch; //the samples processed this loop (one, unless the IMU comes in batches)
+  std::deque<std::vector<IMU_message> > batches;
+  VO_batch vo_batch; //the VO messages that arrived since the last loop
+  //the data of a loop, pointing at alt_temp, vo_batch, truth_temp and hex_temp (NULL when there wasn't any), not owned
   VO_message *vo_data;
   sensor_msgs::Range *alt_data;
   TRUTH_message *truth_data;
   Hex_message *hex_data;
   geometry_msgs::TransformStamped global_pose;  
   bool iflag,vflag; //flags for imu, altimeter, vision, and truth data
+  uint32_t trace_id = 0; //the latency trace id of the latest vision update in the state
+  ros::Time trace_stamp; //and its image timestamp
+  bool trace_pending = false; //true until the first state with that update is published
+  double filter_time = 0.0, solve_time = 0.0; //the total times of the EKF loops and the smoother solves (us)
+  int filter_count = 0, solve_count = 0;
 
   //
   //Main Loop
   while(while_true_ == 1)
   {
     //Data for pointers to use
-    VO_message vo_temp;
     sensor_msgs::Range alt_temp;
     TRUTH_message truth_temp;
     Hex_message hex_temp;
@@ -144,25 +204,31 @@ void ROSServer::Run()
 
 
     //check IMU:
+    imu_batch.clear();
     pthread_mutex_lock(&i_mutex_);
     if((int)imu_queue_.size() > 0)
     {
-      ROS_INFO_ONCE("IMU DATA RECEIVED BY ESTIMATOR!");
-      imu_data = imu_queue_.front();
+      imu_batch.push_back(imu_queue_.front());
       imu_queue_.pop();
+    }
+    batches.swap(imu_batch_queue_); //take every batch that has arrived
+    imu_queue_size = (int)imu_queue_.size();
+    pthread_mutex_unlock(&i_mutex_);
+
+    for(int i = 0; i < (int)batches.size(); i++)
+      imu_batch.insert(imu_batch.end(),batches[i].begin(),batches[i].end());
+    batches.clear();
+
+    if(!imu_batch.empty())
+    {
+      ROS_INFO_ONCE("IMU DATA RECEIVED BY ESTIMATOR!");
+      imu_data = imu_batch.back();
       iflag = true;
-      dt_ = imu_data.header.stamp.toSec() - old_time_;
-      if(dt_ > 1000)
-        dt_ = 0.d; //for the first time through
-      old_time_ = imu_data.header.stamp.toSec();
-      imu_queue_size = (int)imu_queue_.size();
     }
     else
     {
       iflag = false;
-      imu_queue_size = 0;
     }
-    pthread_mutex_unlock(&i_mutex_);
 
 
     //If there's IMU, check for other measurements and calc, if not, skip and wait until the next loop
@@ -193,40 +259,29 @@ void ROSServer::Run()
         }
       pthread_mutex_unlock(&a_mutex_);
 
-      //Vision data
+      //Vision data: take every message that has arrived, they are applied together (one rollback, see
+      //Estimator::delayedVisionUpdate()), so none are dropped when the queue backs up
+      vo_batch.clear();
       pthread_mutex_lock(&v_mutex_);
-        if((int)vo_queue_.size() > 0)
-        {
-          ROS_INFO_ONCE("VO DATA RECEIVED BY ESTIMATOR!");
-          if((int)vo_queue_.size() > 5 && !estimator_->startup_flag_)
-          {
-            ROS_WARN("Vision Queue Size is Large!");            
-            //eliminate them if they are not a reference...
-            vo_temp = vo_queue_.front();
-            while(!vo_temp.NewReference() && vo_queue_.size() >1)
-            {
-              vo_queue_.pop_front();
-              vo_temp = vo_queue_.front();
-            }
-            vo_data = &vo_temp;
-            vflag = true;
-            vo_queue_.pop_front();            
-          }
-          else
-          {
-            vo_temp = vo_queue_.front();
-            vo_queue_.pop_front();
-            vo_data = &vo_temp;
-            vflag = true;
-          }
-        }
-        else
+        if((int)vo_queue_.size() > 5 && !estimator_->startup_flag_)
         {
-          vflag = false;
-          vo_data = 0;
+          ROS_WARN("Vision Queue Size is Large!");
         }
+        vo_batch.swap(vo_queue_);
       pthread_mutex_unlock(&v_mutex_);
 
+      if(!vo_batch.empty())
+      {
+        ROS_INFO_ONCE("VO DATA RECEIVED BY ESTIMATOR!");
+        vo_data = &vo_batch.back();
+        vflag = true;
+      }
+      else
+      {
+        vflag = false;
+        vo_data = 0;
+      }
+
       //Truth data
       pthread_mutex_lock(&t_mutex_);
 
@@ -270,8 +325,17 @@ void ROSServer::Run()
         }
       pthread_mutex_unlock(&h_mutex_);
 
+      //The estimator bank and the smoother get a copy of this loop (one, shared by them)
+      boost::shared_ptr<BankStep> bank_step;
+      if(bank_ != NULL || smoother_ != NULL)
+      {
+        bank_step.reset(new BankStep(imu_batch,alt_data,vo_batch,truth_data,hex_data));
+        bank_step->startup = estimator_->startup_flag_;
+      }
+
       //
       //Start Processing the data that was available:
+      ros::WallTime filter_start = ros::WallTime::now();
       if(estimator_->startup_flag_)
       {
         //2 seconds is the min touchdown time
@@ -279,8 +343,11 @@ void ROSServer::Run()
         {
           estimator_->just_landed_ = false;
         }
+        if(bank_step)
+          bank_step->just_landed = estimator_->just_landed_;
 
         estimator_->Initialize(imu_data,hex_data,alt_data,truth_data);
+        old_time_ = imu_data.header.stamp.toSec();
 
       }
       else
@@ -293,16 +360,32 @@ void ROSServer::Run()
         /// measurement updates.
         if(vflag)
         {
-          estimator_->prepareQueuedItems(vo_data->Timestamp());
+          estimator_->prepareQueuedItems(vo_batch.front().Timestamp());
 
-          estimator_->delayedVisionUpdate(*vo_data,truth_data);
+          estimator_->delayedVisionUpdate(vo_batch,truth_data);
 
-          if(vo_data->NewReference())
+          std::vector<ros::Time> new_nodes; //the images of the nodes that the update created
+          for(int i = 0; i < (int)vo_batch.size(); i++)
           {
+            if(vo_batch[i].TraceID() != 0)
+            {
+              trace_id = vo_batch[i].TraceID();
+              trace_stamp = vo_batch[i].Timestamp();
+              trace_pending = true;
+              latency_trace_.stamp(trace_id, trace_stamp, kinect_vo::latency_stage::EST_UPDATED);
+            }
+            if(vo_batch[i].NewReference())
+              new_nodes.push_back(vo_batch[i].Timestamp());
+          }
+
+          //publish the new edges and nodes, oldest first
+          for(int i = 0; i < (int)new_nodes.size(); i++)
+          {
+            int previous = (int)new_nodes.size() - 1 - i;
             rel_MEKF::edge edge_message;
-            edge_message = estimator_->packageCurrentEdge(vo_data->Timestamp());
+            edge_message = estimator_->packageCurrentEdge(new_nodes[i], previous);
             geometry_msgs::TransformStamped transform;
-            transform = estimator_->packageCurrentNode(vo_data->Timestamp(),global_frame_name_,base_node_name_);
+            transform = estimator_->packageCurrentNode(new_nodes[i],global_frame_name_,base_node_name_,previous);
             edge_pub_.publish(edge_message);
             node_global_pub_.publish(transform);
           }
@@ -310,18 +393,76 @@ void ROSServer::Run()
 
         /// \todo Add the capability to simulate vision using truth
 
-        //Process IMU & Altitude
-        estimator_->prediction(mk_consts_->normal_steps,dt_,imu_data);
-        estimator_->imuMeasurementUpdate(imu_data);
+        //Process IMU & Altitude, one sample at a time.  The altitude goes with the first sample at or after its
+        //timestamp (the last one, if they are all older)
+        sensor_msgs::Range *alt_pending = alt_data;
+        if(preintegrate_imu_batch_ && imu_batch.size() > 1)
+        {
+          //The whole batch in one prediction, then the accelerometer and altitude updates with its last sample
+          if(bank_step)
+          {
+            //the bank still runs one sample at a time
+            double bank_time = old_time_;
+            for(int i = 0; i < (int)imu_batch.size(); i++)
+            {
+              double dt = imu_batch[i].header.stamp.toSec() - bank_time;
+              bank_step->dt.push_back(dt > 1000 ? 0.d : dt);
+              bank_time = imu_batch[i].header.stamp.toSec();
+            }
+            if(alt_pending != NULL)
+              bank_step->alt_index = (int)imu_batch.size() - 1;
+          }
+
+          ImuPreintegration preintegration;
+          estimator_->batchPrediction(imu_batch,old_time_,preintegration);
+          estimator_->imuMeasurementUpdate(imu_batch.back());
 
 #ifdef DETECT
-        estimator_->altitudeMeasurementUpdate(alt_data, true);
+          estimator_->altitudeMeasurementUpdate(alt_pending, true);
 #else
-        estimator_->altitudeMeasurementUpdate(alt_data);
+          estimator_->altitudeMeasurementUpdate(alt_pending);
 #endif
 
-        //Save the IMU, Altitude, and State in queues for use with delayed updates
-        estimator_->saveData(imu_data,alt_data);
+          estimator_->saveData(imu_batch.back(),alt_pending,&preintegration);
+        }
+        else
+        {
+          for(int i = 0; i < (int)imu_batch.size(); i++)
+          {
+            IMU_message &sample = imu_batch[i];
+            dt_ = sample.header.stamp.toSec() - old_time_;
+            if(dt_ > 1000)
+              dt_ = 0.d; //for the first time through
+            old_time_ = sample.header.stamp.toSec();
+
+            sensor_msgs::Range *alt_now = NULL;
+            if(alt_pending != NULL && (i == (int)imu_batch.size() - 1 || sample.header.stamp >= alt_pending->header.stamp))
+            {
+              alt_now = alt_pending;
+              alt_pending = NULL;
+            }
+
+            if(bank_step)
+            {
+              //the bank uses the same timesteps and altitude pairing
+              bank_step->dt.push_back(dt_);
+              if(alt_now != NULL)
+                bank_step->alt_index = i;
+            }
+
+            estimator_->prediction(mk_consts_->normal_steps,dt_,sample);
+            estimator_->imuMeasurementUpdate(sample);
+
+#ifdef DETECT
+            estimator_->altitudeMeasurementUpdate(alt_now, true);
+#else
+            estimator_->altitudeMeasurementUpdate(alt_now);
+#endif
+
+            //Save the IMU, Altitude, and State in queues for use with delayed updates
+            estimator_->saveData(sample,alt_now);
+          }
+        }
 
         //Calc the global pose (May think about doing this at a slower rate than every loop - especially after we start
         //leaving the cortex room and there isn't really any global pose to compare this to)
@@ -349,18 +490,61 @@ void ROSServer::Run()
         status_pub_.publish(laser_status);
 #endif
 #endif        
+
+        filter_time += (ros::WallTime::now() - filter_start).toSec()*1e6;
+        filter_count++;
       }
+
+      if(bank_ != NULL)
+        bank_->post(bank_step);
+      if(smoother_ != NULL)
+        smoother_->post(bank_step);
+
       //Log data (here so that it will log before we actual start the estimator
       estimator_->writeToLog(imu_data,global_pose,alt_data,vo_data,truth_data);
 
       //Publish the relative state and the tf:
-      rel_MEKF::relative_state rel_state;
+      //published as a shared pointer, so the control (as a nodelet in the same process) gets it without a copy
+      rel_MEKF::relative_statePtr rel_state_ptr(new rel_MEKF::relative_state);
+      rel_MEKF::relative_state &rel_state = *rel_state_ptr;
       rel_state = estimator_->packageStateInMessage(imu_data.header.stamp);
 
+      //Once the bank has isolated a faulty sensor, the filter without it is published instead
+      if(bank_ != NULL)
+        bank_->isolatedState(rel_state);
+
       //assign the frame names from the param server:
       rel_state.header.frame_id = node_frame_name_;
       rel_state.child_frame_id = body_frame_name_;
-      rel_state_publisher_.publish(rel_state);
+      rel_state.trace_id = trace_id;
+      rel_state.trace_stamp = trace_stamp;
+      rel_state_publisher_.publish(rel_state_ptr);
+      if(trace_pending)
+      {
+        latency_trace_.stamp(trace_id, trace_stamp, kinect_vo::latency_stage::STATE_PUBLISHED);
+        trace_pending = false;
+      }
+
+      //The smoother's state comes after each of its solves (at the VO rate)
+      if(smoother_ != NULL)
+      {
+        rel_MEKF::relative_statePtr smoothed_ptr(new rel_MEKF::relative_state);
+        if(smoother_->smoothedState(*smoothed_ptr))
+        {
+          smoothed_ptr->header.frame_id = node_frame_name_;
+          smoothed_ptr->child_frame_id = body_frame_name_;
+          smoothed_state_publisher_.publish(smoothed_ptr);
+        }
+
+        std::vector<double> solves;
+        smoother_->solveTimes(solves);
+        for(int i = 0; i < (int)solves.size(); i++)
+          solve_time += solves[i];
+        solve_count += (int)solves.size();
+        ROS_INFO_THROTTLE(10.0, "Mean times: EKF loop %.1f us (%d), smoother solve %.1f us (%d)",
+                          filter_count > 0 ? filter_time/filter_count : 0.0, filter_count,
+                          solve_count > 0 ? solve_time/solve_count : 0.0, solve_count);
+      }
 
       //Publish transform for mapping in the node frame - ROS Convention is North-West-Up, we will follow that with the tf:
       tf::Transform transform;
@@ -385,12 +569,6 @@ void ROSServer::Run()
     while_true_ = 0;
   pthread_mutex_unlock(&w_mutex_);
 
-  //delete the pointers
-  delete alt_data;
-  delete vo_data;
-  delete truth_data;
-  delete hex_data;
-
 }//end *ROSServer::Run(void *ptr)
 
 
@@ -433,6 +611,34 @@ void ROSServer::imuCallback(const IMU_message &imu_message)
 }
 
 
+//
+// IMU Batch Callback
+//
+void ROSServer::imuBatchCallback(const microstrain_3dmgx2_imu::ImuBatch &batch)
+{
+  //convert the samples before taking the lock:
+  std::vector<IMU_message> samples(batch.stamps.size());
+  for(int i = 0; i < (int)samples.size(); i++)
+  {
+    IMU_message &sample = samples[i];
+    sample.header.frame_id = batch.header.frame_id;
+    sample.header.stamp = batch.stamps[i];
+    sample.orientation = batch.orientation[i];
+    sample.angular_velocity = batch.angular_velocity[i];
+    sample.linear_acceleration = batch.linear_acceleration[i];
+    sample.orientation_covariance = batch.orientation_covariance;
+    sample.angular_velocity_covariance = batch.angular_velocity_covariance;
+    sample.linear_acceleration_covariance = batch.linear_acceleration_covariance;
+  }
+
+  //queue the whole batch (the swap doesn't copy the samples):
+  pthread_mutex_lock(&i_mutex_);
+  imu_batch_queue_.push_back(std::vector<IMU_message>());
+  imu_batch_queue_.back().swap(samples);
+  pthread_mutex_unlock(&i_mutex_);
+}
+
+
 //
 // VO Callback
 //
@@ -442,6 +648,7 @@ void ROSServer::visualCallback(const k_message &vo_message)
   pthread_mutex_lock(&v_mutex_);
   vo_queue_.push_back(vo_data);
   pthread_mutex_unlock(&v_mutex_);
+  latency_trace_.stamp(vo_message.trace_id, vo_message.header.stamp, kinect_vo::latency_stage::EST_RECEIVED);
 }
 
 
@@ -477,4 +684,6 @@ void ROSServer::hexCallback(const Hex_message &hex_message)
   pthread_mutex_unlock(&h_mutex_);
 }
 
+}
+
 
@@ -13,6 +13,9 @@
 
 #include "rel_estimator/vodata.h"
 
+namespace rel_MEKF
+{
+
 using namespace Eigen;
 
 //
@@ -21,6 +24,7 @@ using namespace Eigen;
 VOData::VOData()
 {
   total_covariance_.setZero();
+  trace_id_ = 0;
   parent_frame_id_ = "";
   child_frame_id_ = "";
   translation_.setZero();
@@ -46,6 +50,7 @@ void VOData::SetData( k_message vo_message)
   timestamp_ = vo_message.header.stamp;
   parent_frame_id_ = vo_message.header.frame_id;
   image_number_ = vo_message.header.seq;
+  trace_id_ = vo_message.trace_id;
   child_frame_id_ = vo_message.child_frame_id;
   new_reference_ = vo_message.newReference;
   inliers_ = vo_message.inliers;
@@ -61,3 +66,5 @@ void VOData::SetData( k_message vo_message)
   cov2 = cov; //this step is just to be sure I don't get a data corruption issue...
   total_covariance_ = cov2;
 }
+
+}